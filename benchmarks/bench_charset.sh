@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Measure the speed of the character set conversions.
+
+set -e
+
+case "$1" in
+--fast) times=10000; shift ;;
+*) times=1000000 ;;
+esac
+
+sed "s/#TIMES#/$times/g" benchmarks/bench_charset.txt
+
+test/bench_charset $times 2>/dev/null |
+awk -F '	' '{
+    print "<row><entry>" $1 "</entry><entry>" $2 "</entry>"
+    print "<entry>" $3 "</entry><entry>" $4 "</entry></row>"
+}'
+
+cat <<EOF
+</tbody>
+</tgroup>
+</table>
+
+</sect1>
+EOF
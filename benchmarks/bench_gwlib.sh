@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Measure the speed of the gwlib core primitives with 1 to 4 threads.
+# The results are also written as JSON to bench_gwlib.json so that
+# runs can be compared with each other, as with bench_load.json.
+
+set -e
+
+case "$1" in
+--fast) rounds=20000; shift ;;
+*) rounds=500000 ;;
+esac
+
+sed "s/#ROUNDS#/$rounds/g" benchmarks/bench_gwlib.txt
+
+test/bench_gwlib -r $rounds -t 4 -o bench_gwlib.json 2>/dev/null |
+awk -F '	' '{
+    print "<row><entry>" $1 "</entry><entry>" $2 "</entry>"
+    print "<entry>" $3 "</entry><entry>" $4 "</entry></row>"
+}'
+
+cat <<EOF
+</tbody>
+</tgroup>
+</table>
+
+</sect1>
+EOF
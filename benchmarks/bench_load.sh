@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Drive MO, MT and DLR traffic through bearerbox and smsbox with
+# `test/bench_load' and report throughput and latency of each stage.
+#
+# The JSON report is left in bench_load.json and compared with
+# benchmarks/bench_load.baseline: the benchmark fails if a stage got more
+# than 10% slower. The baseline depends on the machine, so none is
+# shipped. Without one the comparison is skipped with a notice; copy
+# bench_load.json there to record one.
+
+set -e
+
+case "$1" in
+--fast) times=1000; shift ;;
+*) times=20000 ;;
+esac
+
+baseline=""
+if [ -f benchmarks/bench_load.baseline ]
+then
+    baseline="-B benchmarks/bench_load.baseline"
+fi
+
+rm -f bench_load_*.log bench_load.json
+
+test/bench_load -m $times -t $times -c 20 -d -b 2 -k -o bench_load.json \
+    $baseline 2> bench_load_gen.log > bench_load.dat &
+pid=$!
+sleep 1
+gw/bearerbox -v 4 benchmarks/bench_load.conf &
+sleep 1
+gw/smsbox -v 4 benchmarks/bench_load.conf &
+
+if ! wait $pid
+then
+    echo "$0 failed" 1>&2
+    echo "See bench_load*.log for info" 1>&2
+    wait
+    exit 1
+fi
+wait
+
+sed "s/#TIMES#/$times/g" benchmarks/bench_load.txt
+
+awk -F '	' '{
+    print "<row><entry>" $1 "</entry><entry>" $2 "</entry><entry>" $3 "</entry>"
+    print "<entry>" $4 "</entry><entry>" $5 "</entry><entry>" $6 "</entry>"
+    print "<entry>" $7 "</entry><entry>" $8 "</entry></row>"
+}' bench_load.dat
+
+cat <<EOF
+</tbody>
+</tgroup>
+</table>
+
+</sect1>
+EOF
+
+rm -f bench_load*.log bench_load.dat
+
+if [ -z "$baseline" ]
+then
+    echo "$0: no benchmarks/bench_load.baseline, not compared" 1>&2
+    echo "Copy bench_load.json there to record one" 1>&2
+fi
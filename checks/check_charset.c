@@ -0,0 +1,649 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_charset.c - Check the character set conversions
+ *
+ * Converts random text between the character sets charset_convert
+ * handles without iconv, and compares the results with the same
+ * conversions done by iconv, using aliases of the character set names
+ * that charset_convert does not know. Invalid input is mixed in, too.
+ *
+ * The GSM conversions are compared with copies of their old, plain
+ * implementations on random bytes, and charset_utf8_is_gsm with the
+ * result of a trip to GSM and back. Also checks that GSM text survives
+ * the trip to UTF-8 and back.
+ */
+
+#include "gwlib/gwlib.h"
+
+#define ROUNDS 2000
+
+/*
+ * The GSM conversions as they were before they were rewritten for speed,
+ * as reference for the current ones.
+ */
+
+
+/* Code used for non-representable characters */
+#define NRP '?'
+
+#include "gwlib/latin1_to_gsm.h"
+
+
+/* This is the extension table defined in GSM 03.38.  It is the mapping
+ * used for the character after a GSM 27 (Escape) character.  All characters
+ * not in the table, as well as characters we can't represent, will map
+ * to themselves.  We cannot represent the euro symbol, which is an escaped
+ * 'e', so we left it out of this table. */
+static const struct {
+    int gsmesc;
+    int latin1;
+} gsm_esctolatin1[] = {
+    {  10, 12 }, /* ASCII page break */
+    {  20, '^' },
+    {  40, '{' },
+    {  41, '}' },
+    {  47, '\\' },
+    {  60, '[' },
+    {  61, '~' },
+    {  62, ']' },
+    {  64, '|' },
+    { 101, 128 },
+    { -1, -1 }
+};
+
+
+/**
+ * Struct maps escaped GSM chars to unicode codeposition.
+ */
+static const struct {
+    int gsmesc;
+    int unichar;
+} gsm_esctouni[] = {
+    { 10, 12 }, /* ASCII page break */
+    { 20, '^' },
+    { 40, '{' },
+    { 41, '}' },
+    { 47, '\\' },
+    { 60, '[' },
+    { 61, '~' },
+    { 62, ']' },
+    { 64, '|' },
+    { 'e', 0x20AC },  /* euro symbol */
+    { -1, -1 }
+};
+
+
+/* Map GSM default alphabet characters to ISO-Latin-1 characters.
+ * The greek characters at positions 16 and 18 through 26 are not
+ * mappable.  They are mapped to '?' characters.
+ * The escape character, at position 27, is mapped to a space,
+ * though normally the function that indexes into this table will
+ * treat it specially. */
+static const unsigned char gsm_to_latin1[128] = {
+     '@', 0xa3,  '$', 0xa5, 0xe8, 0xe9, 0xf9, 0xec,   /* 0 - 7 */
+    0xf2, 0xc7,   10, 0xd8, 0xf8,   13, 0xc5, 0xe5,   /* 8 - 15 */
+     '?',  '_',  '?',  '?',  '?',  '?',  '?',  '?',   /* 16 - 23 */
+         '?',  '?',  '?',  ' ', 0xc6, 0xe6, 0xdf, 0xc9,   /* 24 - 31 */
+     ' ',  '!',  '"',  '#', 0xa4,  '%',  '&', '\'',   /* 32 - 39 */
+     '(',  ')',  '*',  '+',  ',',  '-',  '.',  '/',   /* 40 - 47 */
+     '0',  '1',  '2',  '3',  '4',  '5',  '6',  '7',   /* 48 - 55 */
+     '8',  '9',  ':',  ';',  '<',  '=',  '>',  '?',   /* 56 - 63 */
+        0xa1,  'A',  'B',  'C',  'D',  'E',  'F',  'G',   /* 64 - 71 */
+         'H',  'I',  'J',  'K',  'L',  'M',  'N',  'O',   /* 73 - 79 */
+         'P',  'Q',  'R',  'S',  'T',  'U',  'V',  'W',   /* 80 - 87 */
+         'X',  'Y',  'Z', 0xc4, 0xd6, 0xd1, 0xdc, 0xa7,   /* 88 - 95 */
+        0xbf,  'a',  'b',  'c',  'd',  'e',  'f',  'g',   /* 96 - 103 */
+         'h',  'i',  'j',  'k',  'l',  'm',  'n',  'o',   /* 104 - 111 */
+         'p',  'q',  'r',  's',  't',  'u',  'v',  'w',   /* 112 - 119 */
+         'x',  'y',  'z', 0xe4, 0xf6, 0xf1, 0xfc, 0xe0    /* 120 - 127 */
+};
+
+/** 
+ * Map GSM default alphabet characters to unicode codeposition.
+ * The escape character, at position 27, is mapped to a NRP,
+ * though normally the function that indexes into this table will
+ * treat it specially.
+ */
+static const int gsm_to_unicode[128] = {
+      '@',  0xA3,   '$',  0xA5,  0xE8,  0xE9,  0xF9,  0xEC,   /* 0 - 7 */
+     0xF2,  0xC7,    10,  0xd8,  0xF8,    13,  0xC5,  0xE5,   /* 8 - 15 */
+    0x394,   '_', 0x3A6, 0x393, 0x39B, 0x3A9, 0x3A0, 0x3A8,   /* 16 - 23 */
+    0x3A3, 0x398, 0x39E,   NRP,  0xC6,  0xE6,  0xDF,  0xC9,   /* 24 - 31 */
+      ' ',   '!',   '"',   '#',  0xA4,   '%',   '&',  '\'',   /* 32 - 39 */
+      '(',   ')',   '*',   '+',   ',',   '-',   '.',   '/',   /* 40 - 47 */
+      '0',   '1',   '2',   '3',   '4',   '5',   '6',   '7',   /* 48 - 55 */
+      '8',   '9',   ':',   ';',   '<',   '=',   '>',   '?',   /* 56 - 63 */
+      0xA1,  'A',   'B',   'C',   'D',   'E',   'F',   'G',   /* 64 - 71 */
+      'H',   'I',   'J',   'K',   'L',   'M',   'N',   'O',   /* 73 - 79 */
+      'P',   'Q',   'R',   'S',   'T',   'U',   'V',   'W',   /* 80 - 87 */
+      'X',   'Y',   'Z',  0xC4,  0xD6,  0xD1,  0xDC,  0xA7,   /* 88 - 95 */
+     0xBF,   'a',   'b',   'c',   'd',   'e',   'f',   'g',   /* 96 - 103 */
+      'h',   'i',   'j',   'k',   'l',   'm',   'n',   'o',   /* 104 - 111 */
+      'p',   'q',   'r',   's',   't',   'u',   'v',   'w',   /* 112 - 119 */
+      'x',   'y',   'z',  0xE4,  0xF6,  0xF1,  0xFC,  0xE0    /* 120 - 127 */
+};
+
+
+static void ref_gsm_to_utf8(Octstr *ostr)
+{
+    long pos, len;
+    Octstr *newostr;
+
+    if (ostr == NULL)
+        return;
+
+    newostr = octstr_create("");
+    len = octstr_len(ostr);
+    
+    for (pos = 0; pos < len; pos++) {
+        int c, i;
+        
+        c = octstr_get_char(ostr, pos);
+        if (c > 127) {
+            warning(0, "Could not convert GSM (0x%02x) to Unicode.", c);
+            continue;
+        }
+        
+        if(c == 27 && pos + 1 < len) {
+            c = octstr_get_char(ostr, ++pos);
+            for (i = 0; gsm_esctouni[i].gsmesc >= 0; i++) {
+                if (gsm_esctouni[i].gsmesc == c)
+                    break;
+            }   
+            if (gsm_esctouni[i].gsmesc == c) {
+                /* found a value for escaped char */
+                c = gsm_esctouni[i].unichar;
+            } else {
+	        /* nothing found, look esc in our table */
+		c = gsm_to_unicode[27];
+                pos--;
+	    }
+        } else if (c < 128) {
+            c = gsm_to_unicode[c];
+        }
+        /* unicode to utf-8 */
+        if(c < 128) {
+            /* 0-127 are ASCII chars that need no conversion */
+            octstr_append_char(newostr, c);
+        } else { 
+            /* test if it can be converterd into a two byte char */
+            if(c < 0x0800) {
+                octstr_append_char(newostr, ((c >> 6) | 0xC0) & 0xFF); /* add 110xxxxx */
+                octstr_append_char(newostr, (c & 0x3F) | 0x80); /* add 10xxxxxx */
+            } else {
+                /* else we encode with 3 bytes. This only happens in case of euro symbol */
+                octstr_append_char(newostr, ((c >> 12) | 0xE0) & 0xFF); /* add 1110xxxx */
+                octstr_append_char(newostr, (((c >> 6) & 0x3F) | 0x80) & 0xFF); /* add 10xxxxxx */
+                octstr_append_char(newostr, ((c  & 0x3F) | 0x80) & 0xFF); /* add 10xxxxxx */
+            }
+            /* There are no 4 bytes encoded characters in GSM charset */
+        }
+    }
+
+    octstr_truncate(ostr, 0);
+    octstr_append(ostr, newostr);
+    octstr_destroy(newostr);
+}
+
+/**
+ * Convert octet string in UTF-8 format to GSM 03.38.
+ * Because not all UTF-8 charater can be converted to GSM 03.38 non
+ * convertable character replaces with NRP character (see define above).
+ * Special characters will be formed into escape sequences.
+ * Incomplete UTF-8 characters at the end of the string will be skipped.
+ */
+static void ref_utf8_to_gsm(Octstr *ostr)
+{
+    long pos, len;
+    int val1, val2;
+    Octstr *newostr;
+
+    if (ostr == NULL)
+        return;
+    
+    newostr = octstr_create("");
+    len = octstr_len(ostr);
+    
+    for (pos = 0; pos < len; pos++) {
+        val1 = octstr_get_char(ostr, pos);
+        
+        /* check range */
+        if (val1 < 0 || val1 > 255) {
+            warning(0, "Char (0x%02x) in UTF-8 string not in the range (0, 255). Skipped.", val1);
+            continue;
+        }
+        
+        /* Convert UTF-8 to unicode code */
+        
+        /* test if two byte utf8 char */
+        if ((val1 & 0xE0) == 0xC0) {
+            /* test if incomplete utf char */
+            if(pos + 1 < len) {
+                val2 = octstr_get_char(ostr, ++pos);
+                val1 = (((val1 & ~0xC0) << 6) | (val2 & 0x3F));
+            } else {
+                /* incomplete, ignore it */
+                warning(0, "Incomplete UTF-8 char discovered, skipped. 1");
+                pos += 1;
+                continue;
+            }
+        } else if ((val1 & 0xF0) == 0xE0) { /* test for three byte utf8 char */
+            if(pos + 2 < len) {
+                val2 = octstr_get_char(ostr, ++pos);
+                val1 = (((val1 & ~0xE0) << 6) | (val2 & 0x3F));
+                val2 = octstr_get_char(ostr, ++pos);
+                val1 = (val1 << 6) | (val2 & 0x3F);
+            } else {
+                /* incomplete, ignore it */
+                warning(0, "Incomplete UTF-8 char discovered, skipped. 2");
+                pos += 2;
+                continue;
+            }
+        }
+
+        /* test Latin code page 1 char */
+        if(val1 <= 255) {
+            val1 = latin1_to_gsm[val1];
+            /* needs to be escaped ? */
+            if(val1 < 0) {
+                octstr_append_char(newostr, 27);
+                val1 *= -1;
+            }
+        } else {
+            /* Its not a Latin1 char, test for allowed GSM chars */
+            switch(val1) {
+            case 0x394:
+                val1 = 0x10; /* GREEK CAPITAL LETTER DELTA */
+                break;
+            case 0x3A6:
+                val1 = 0x12; /* GREEK CAPITAL LETTER PHI */
+                break;
+            case 0x393:
+                val1 = 0x13; /* GREEK CAPITAL LETTER GAMMA */
+                break;
+            case 0x39B:
+                val1 = 0x14; /* GREEK CAPITAL LETTER LAMBDA */
+                break;
+            case 0x3A9:
+                val1 = 0x15; /* GREEK CAPITAL LETTER OMEGA */
+                break;
+            case 0x3A0:
+                val1 = 0x16; /* GREEK CAPITAL LETTER PI */
+                break;
+            case 0x3A8:
+                val1 = 0x17; /* GREEK CAPITAL LETTER PSI */
+                break;
+            case 0x3A3:
+                val1 = 0x18; /* GREEK CAPITAL LETTER SIGMA */
+                break;
+            case 0x398:
+                val1 = 0x19; /* GREEK CAPITAL LETTER THETA */
+                break;
+            case 0x39E:
+                val1 = 0x1A; /* GREEK CAPITAL LETTER XI */
+                break;
+            case 0x20AC:
+                val1 = 'e'; /* EURO SIGN */
+                octstr_append_char(newostr, 27);
+                break;
+            default: val1 = NRP; /* character cannot be represented in GSM 03.38 */
+            }
+        }
+        octstr_append_char(newostr, val1);
+    }
+
+    octstr_truncate(ostr, 0);
+    octstr_append(ostr, newostr);
+    octstr_destroy(newostr);
+}
+
+
+static void ref_gsm_to_latin1(Octstr *ostr)
+{
+    long pos, len;
+
+    len = octstr_len(ostr);
+    for (pos = 0; pos < len; pos++) {
+    int c, new, i;
+
+    c = octstr_get_char(ostr, pos);
+    if (c == 27 && pos + 1 < len) {
+        /* GSM escape code.  Delete it, then process the next
+             * character specially. */
+        octstr_delete(ostr, pos, 1);
+        len--;
+        c = octstr_get_char(ostr, pos);
+        for (i = 0; gsm_esctolatin1[i].gsmesc >= 0; i++) {
+        if (gsm_esctolatin1[i].gsmesc == c)
+            break;
+        }
+        if (gsm_esctolatin1[i].gsmesc == c)
+        new = gsm_esctolatin1[i].latin1;
+        else if (c < 128)
+        new = gsm_to_latin1[c];
+        else
+        continue;
+    } else if (c < 128) {
+            new = gsm_to_latin1[c];
+    } else {
+        continue;
+    }
+    if (new != c)
+        octstr_set_char(ostr, pos, new);
+    }
+}
+
+
+static void ref_latin1_to_gsm(Octstr *ostr)
+{
+    long pos, len;
+    int c, new;
+    unsigned char esc = 27;
+
+    len = octstr_len(ostr);
+    for (pos = 0; pos < len; pos++) {
+    c = octstr_get_char(ostr, pos);
+    gw_assert(c >= 0);
+    gw_assert(c <= 256);
+    new = latin1_to_gsm[c];
+    if (new < 0) {
+         /* Escaped GSM code */
+        octstr_insert_data(ostr, pos, (char*) &esc, 1);
+        pos++;
+        len++;
+        new = -new;
+    }
+    if (new != c)
+        octstr_set_char(ostr, pos, new);
+    }
+}
+
+/* End of the reference conversions. */
+
+
+static struct {
+    char *name;
+    char *alias;
+} charsets[] = {
+    { "UTF-8", "ISO-10646/UTF8/" },
+    { "ISO-8859-1", "CSISOLATIN1" },
+    { "UCS-2BE", "UNICODEBIG" },
+    { "UTF-16BE", "UTF16BE" },
+};
+#define NUM_CHARSETS ((int) (sizeof(charsets) / sizeof(charsets[0])))
+
+
+static void append_utf8(Octstr *os, long c)
+{
+    if (c < 0x80)
+        octstr_append_char(os, c);
+    else if (c < 0x800) {
+        octstr_append_char(os, 0xC0 | (c >> 6));
+        octstr_append_char(os, 0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        octstr_append_char(os, 0xE0 | (c >> 12));
+        octstr_append_char(os, 0x80 | ((c >> 6) & 0x3F));
+        octstr_append_char(os, 0x80 | (c & 0x3F));
+    } else {
+        octstr_append_char(os, 0xF0 | (c >> 18));
+        octstr_append_char(os, 0x80 | ((c >> 12) & 0x3F));
+        octstr_append_char(os, 0x80 | ((c >> 6) & 0x3F));
+        octstr_append_char(os, 0x80 | (c & 0x3F));
+    }
+}
+
+
+static Octstr *random_text(void)
+{
+    Octstr *os;
+    long i, len, c, r;
+
+    os = octstr_create("");
+    len = gw_rand() % 40;
+    for (i = 0; i < len; i++) {
+        r = gw_rand() % 10;
+        if (r < 5)
+            c = 0x20 + gw_rand() % 0x60;
+        else if (r < 7)
+            c = 0x80 + gw_rand() % 0x80;
+        else if (r < 9) {
+            do {
+                c = 0x100 + gw_rand() % 0xFF00;
+            } while (c >= 0xD800 && c <= 0xDFFF);
+        } else
+            c = 0x10000 + gw_rand() % 0x100000;
+        append_utf8(os, c);
+    }
+    return os;
+}
+
+
+/* Break the text now and then: change a byte or cut it short. */
+static void mutate(Octstr *os)
+{
+    long len;
+
+    len = octstr_len(os);
+    if (len == 0 || gw_rand() % 10 != 0)
+        return;
+    if (gw_rand() % 2)
+        octstr_set_char(os, gw_rand() % len, gw_rand() % 256);
+    else
+        octstr_truncate(os, gw_rand() % len);
+}
+
+
+static void check_pair(Octstr *text, int from, int to)
+{
+    Octstr *fast, *slow;
+    int ret_fast, ret_slow;
+
+    fast = octstr_duplicate(text);
+    slow = octstr_duplicate(text);
+    ret_fast = charset_convert(fast, charsets[from].name, charsets[to].name);
+    ret_slow = charset_convert(slow, charsets[from].alias, charsets[to].alias);
+    if (ret_fast != ret_slow || octstr_compare(fast, slow) != 0) {
+        octstr_dump(text, 0);
+        octstr_dump(fast, 0);
+        octstr_dump(slow, 0);
+        panic(0, "%s to %s differs from iconv (%d, %d)", charsets[from].name,
+              charsets[to].name, ret_fast, ret_slow);
+    }
+    octstr_destroy(fast);
+    octstr_destroy(slow);
+}
+
+
+/* Random bytes, with long runs of plain letters, escapes, special
+ * GSM characters and pieces of UTF-8, valid and not. */
+static Octstr *random_bytes(void)
+{
+    static char *pieces[] = {
+        "\x1b", "e", "$", "@", "_", "[", "]", "`", "{", "~", "\\", "\x0c",
+        "\n", "\r", "\x00", "\x7f", "\xa3", "\xe9", "\x80", "\xff",
+        "\xc3\xa9", "\xc2\xa3", "\xe2\x82\xac", "\xce\x94", "\xce\xa9",
+        "\xd0\x96", "\xf0\x9f\x98\x80", "\xc1\x81", "\xed\xa0\x80", "\xe2\x82",
+    };
+    Octstr *os;
+    long i, j, n;
+
+    os = octstr_create("");
+    n = gw_rand() % 12;
+    for (i = 0; i < n; i++) {
+        if (gw_rand() % 3 == 0) {
+            for (j = gw_rand() % 40; j > 0; j--)
+                octstr_append_char(os, "Hello world 0123456789"[gw_rand() % 22]);
+        } else
+            octstr_append_cstr(os, pieces[gw_rand() % 
+                                          (sizeof(pieces) / sizeof(pieces[0]))]);
+    }
+    return os;
+}
+
+
+static void compare(Octstr *input, void (*convert)(Octstr *),
+                    void (*reference)(Octstr *), char *name)
+{
+    Octstr *a, *b;
+
+    a = octstr_duplicate(input);
+    b = octstr_duplicate(input);
+    convert(a);
+    reference(b);
+    if (octstr_compare(a, b) != 0) {
+        octstr_dump(input, 0);
+        octstr_dump(a, 0);
+        octstr_dump(b, 0);
+        panic(0, "%s differs from the reference", name);
+    }
+    octstr_destroy(a);
+    octstr_destroy(b);
+}
+
+
+static void check_gsm_differences(void)
+{
+    Octstr *input, *trip;
+    long i;
+    int same;
+
+    for (i = 0; i < ROUNDS * 10; i++) {
+        input = random_bytes();
+        compare(input, charset_gsm_to_utf8, ref_gsm_to_utf8, "gsm_to_utf8");
+        compare(input, charset_utf8_to_gsm, ref_utf8_to_gsm, "utf8_to_gsm");
+        compare(input, charset_gsm_to_latin1, ref_gsm_to_latin1, 
+                "gsm_to_latin1");
+        compare(input, charset_latin1_to_gsm, ref_latin1_to_gsm, 
+                "latin1_to_gsm");
+
+        trip = octstr_duplicate(input);
+        ref_utf8_to_gsm(trip);
+        ref_gsm_to_utf8(trip);
+        same = (octstr_compare(trip, input) == 0);
+        if (charset_utf8_is_gsm(input) != same) {
+            octstr_dump(input, 0);
+            panic(0, "charset_utf8_is_gsm says %d, trip to GSM says %d",
+                  !same, same);
+        }
+        octstr_destroy(trip);
+        octstr_destroy(input);
+    }
+}
+
+
+static void check_gsm(void)
+{
+    Octstr *gsm, *utf8;
+    int c;
+
+    gsm = octstr_create("");
+    for (c = 0; c < 128; c++) {
+        if (c != 27)
+            octstr_append_char(gsm, c);
+    }
+    /* all escaped characters */
+    octstr_append_from_hex(gsm, "1b0a1b141b281b291b2f1b3c1b3d1b3e1b401b65");
+
+    utf8 = octstr_duplicate(gsm);
+    charset_gsm_to_utf8(utf8);
+    if (octstr_search(utf8, octstr_imm("\xe2\x82\xac"), 0) < 0)
+        panic(0, "no euro sign in GSM text converted to UTF-8");
+    charset_utf8_to_gsm(utf8);
+    if (octstr_compare(utf8, gsm) != 0) {
+        octstr_dump(gsm, 0);
+        octstr_dump(utf8, 0);
+        panic(0, "GSM text changed on the way to UTF-8 and back");
+    }
+    octstr_destroy(utf8);
+    octstr_destroy(gsm);
+}
+
+
+int main(void)
+{
+    Octstr *utf8, *text;
+    long i;
+    int from, to;
+
+    gwlib_init();
+    /* iconv complains about the invalid input, on purpose */
+    log_set_output_level(GW_PANIC);
+
+    for (i = 0; i < ROUNDS; i++) {
+        utf8 = random_text();
+        for (from = 0; from < NUM_CHARSETS; from++) {
+            text = octstr_duplicate(utf8);
+            if (from > 0 && charset_convert(text, charsets[0].alias, 
+                                            charsets[from].alias) != 0) {
+                octstr_destroy(text);
+                continue;
+            }
+            mutate(text);
+            for (to = 0; to < NUM_CHARSETS; to++)
+                check_pair(text, from, to);
+            octstr_destroy(text);
+        }
+        octstr_destroy(utf8);
+    }
+
+    check_gsm_differences();
+    check_gsm();
+
+    gwlib_shutdown();
+    return 0;
+}
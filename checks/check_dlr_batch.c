@@ -0,0 +1,208 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_dlr_batch.c - Check the DLR write-behind queue
+ *
+ * Runs DLRs through the internal storage with dlr-batch-delay set, from
+ * several threads at once, and checks that each DLR is found exactly
+ * once, both when it is looked up before it has reached the storage and
+ * after, and that the storage ends up holding what it should.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gwlib/gwlib.h"
+#include "gw/msg.h"
+#include "gw/dlr.h"
+
+#define THREADS 4
+#define PER_THREAD 2000
+#define DELAY_MS 50
+
+static Octstr *smsc;
+
+static Octstr *timestamp(long t, long i)
+{
+    return octstr_format("%ld-%ld", t, i);
+}
+
+static Octstr *receiver(long t, long i)
+{
+    return octstr_format("+358401%03ld%04ld", t, i);
+}
+
+/* find the DLR twice, expecting it only the first time */
+static void find_once(long t, long i)
+{
+    Octstr *ts, *dst;
+    Msg *msg;
+
+    ts = timestamp(t, i);
+    dst = receiver(t, i);
+
+    /* intermediate report, keeps the entry */
+    msg = dlr_find(smsc, ts, dst, DLR_BUFFERED, 1);
+    if (msg == NULL)
+        panic(0, "Buffered DLR %s not found", octstr_get_cstr(ts));
+    msg_destroy(msg);
+
+    msg = dlr_find(smsc, ts, dst, DLR_SUCCESS, 1);
+    if (msg == NULL)
+        panic(0, "DLR %s not found", octstr_get_cstr(ts));
+    if (octstr_compare(msg->sms.receiver, dst) != 0)
+        panic(0, "DLR %s for wrong receiver %s", octstr_get_cstr(ts),
+              octstr_get_cstr(msg->sms.receiver));
+    msg_destroy(msg);
+
+    msg = dlr_find(smsc, ts, dst, DLR_SUCCESS, 1);
+    if (msg != NULL)
+        panic(0, "DLR %s found twice", octstr_get_cstr(ts));
+
+    octstr_destroy(ts);
+    octstr_destroy(dst);
+}
+
+/* add DLRs, look up every other one right away */
+static void add_and_find(void *arg)
+{
+    long t, i;
+    Octstr *ts;
+    Msg *msg;
+
+    t = *(long *) arg;
+    for (i = 0; i < PER_THREAD; i++) {
+        msg = msg_create(sms);
+        msg->sms.sender = octstr_create("12345");
+        msg->sms.receiver = receiver(t, i);
+        msg->sms.service = octstr_create("check");
+        msg->sms.dlr_mask = DLR_SUCCESS | DLR_FAIL | DLR_BUFFERED;
+        ts = timestamp(t, i);
+        dlr_add(smsc, ts, msg);
+        octstr_destroy(ts);
+        msg_destroy(msg);
+
+        if (i % 2 == 0)
+            find_once(t, i);
+    }
+}
+
+static Cfg *create_cfg(void)
+{
+    char name[] = "/tmp/check_dlr_batch.XXXXXX";
+    Octstr *conf;
+    Cfg *cfg;
+    int fd;
+
+    conf = octstr_format("group = core\n"
+                         "dlr-storage = internal\n"
+                         "dlr-batch-delay = %d\n"
+                         "dlr-batch-size = 64\n", DELAY_MS);
+    if ((fd = mkstemp(name)) == -1 ||
+        write(fd, octstr_get_cstr(conf), octstr_len(conf)) != octstr_len(conf))
+        panic(errno, "Cannot write configuration");
+    close(fd);
+    octstr_destroy(conf);
+
+    cfg = cfg_create(octstr_imm(name));
+    if (cfg_read(cfg) == -1)
+        panic(0, "Cannot read configuration");
+    unlink(name);
+
+    return cfg;
+}
+
+int main(void)
+{
+    long ids[THREADS], threads[THREADS];
+    long i, t, left;
+    Cfg *cfg;
+
+    gwlib_init();
+    log_set_output_level(GW_ERROR);
+
+    smsc = octstr_create("check");
+    cfg = create_cfg();
+    dlr_init(cfg);
+
+    for (t = 0; t < THREADS; t++) {
+        ids[t] = t;
+        threads[t] = gwthread_create(add_and_find, &ids[t]);
+    }
+    for (t = 0; t < THREADS; t++)
+        gwthread_join(threads[t]);
+
+    /* by now everything has reached the storage */
+    gwthread_sleep(3 * DELAY_MS / 1000.0);
+    left = THREADS * PER_THREAD / 2;
+    if (dlr_messages() != left)
+        panic(0, "%ld DLRs stored, expected %ld", dlr_messages(), left);
+
+    for (t = 0; t < THREADS; t++)
+        for (i = 1; i < PER_THREAD; i += 2)
+            find_once(t, i);
+    gwthread_sleep(3 * DELAY_MS / 1000.0);
+    if (dlr_messages() != 0)
+        panic(0, "%ld DLRs stored, expected none", dlr_messages());
+
+    dlr_shutdown();
+    cfg_destroy(cfg);
+    octstr_destroy(smsc);
+    gwlib_shutdown();
+    return 0;
+}
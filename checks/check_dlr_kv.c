@@ -0,0 +1,249 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_dlr_kv.c - Check the kv DLR storage
+ *
+ * Adds and resolves DLRs through the kv storage, then checks that the
+ * entries left are there after a restart, both from the log written on
+ * shutdown and from a copy of the log taken while running, with a
+ * record cut short at its end as a crash would leave it.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gwlib/gwlib.h"
+#include "gw/msg.h"
+#include "gw/dlr.h"
+
+#define DLRS 10000
+/* pending at once, well past the initial size of the index */
+#define PENDING 50000
+
+static Octstr *smsc;
+static char dir[] = "/tmp/check_dlr_kv.XXXXXX";
+
+static Octstr *timestamp(long i)
+{
+    return octstr_format("%ld", i);
+}
+
+static Octstr *receiver(long i)
+{
+    return octstr_format("+35840%07ld", i);
+}
+
+static Octstr *url(long i)
+{
+    return octstr_format("http://localhost/dlr?id=%ld", i);
+}
+
+static void add(long i)
+{
+    Octstr *ts;
+    Msg *msg;
+
+    msg = msg_create(sms);
+    msg->sms.sender = octstr_create("12345");
+    msg->sms.receiver = receiver(i);
+    msg->sms.service = octstr_create("check");
+    msg->sms.dlr_url = url(i);
+    msg->sms.dlr_mask = DLR_SUCCESS | DLR_FAIL | DLR_BUFFERED;
+    ts = timestamp(i);
+    dlr_add(smsc, ts, msg);
+    octstr_destroy(ts);
+    msg_destroy(msg);
+}
+
+/* report DLR of given type, expecting the entry there if found is set */
+static void find(long i, int typ, int found)
+{
+    Octstr *ts, *dst, *u;
+    Msg *msg;
+
+    ts = timestamp(i);
+    dst = receiver(i);
+    u = url(i);
+    msg = dlr_find(smsc, ts, dst, typ, 1);
+    if (found && msg == NULL)
+        panic(0, "DLR %ld not found", i);
+    if (!found && msg != NULL)
+        panic(0, "DLR %ld found, it should be gone", i);
+    if (msg != NULL && (octstr_compare(msg->sms.receiver, dst) != 0 ||
+                        octstr_compare(msg->sms.dlr_url, u) != 0))
+        panic(0, "DLR %ld has wrong content", i);
+    msg_destroy(msg);
+    octstr_destroy(ts);
+    octstr_destroy(dst);
+    octstr_destroy(u);
+}
+
+static void write_file(Octstr *name, Octstr *data)
+{
+    FILE *f;
+
+    if ((f = fopen(octstr_get_cstr(name), "w")) == NULL ||
+        octstr_print(f, data) == -1 || fclose(f) != 0)
+        panic(errno, "Cannot write `%s'", octstr_get_cstr(name));
+}
+
+static Cfg *create_cfg(void)
+{
+    Octstr *name, *conf;
+    Cfg *cfg;
+
+    name = octstr_format("%s/kannel.conf", dir);
+    conf = octstr_format("group = core\n"
+                         "dlr-storage = kv\n"
+                         "dlr-kv-file = %s/dlr.log\n", dir);
+    write_file(name, conf);
+    octstr_destroy(conf);
+
+    cfg = cfg_create(name);
+    if (cfg_read(cfg) == -1)
+        panic(0, "Cannot read configuration");
+    unlink(octstr_get_cstr(name));
+    octstr_destroy(name);
+
+    return cfg;
+}
+
+static void start(Cfg *cfg, long expected)
+{
+    dlr_init(cfg);
+    if (dlr_messages() != expected)
+        panic(0, "%ld DLRs after start, expected %ld", dlr_messages(), expected);
+}
+
+int main(void)
+{
+    Octstr *log, *crashed;
+    Cfg *cfg;
+    long i;
+
+    gwlib_init();
+    log_set_output_level(GW_ERROR);
+
+    if (mkdtemp(dir) == NULL)
+        panic(errno, "Cannot create directory");
+    log = octstr_format("%s/dlr.log", dir);
+    smsc = octstr_create("check");
+    cfg = create_cfg();
+    start(cfg, 0);
+
+    /* resolve every even DLR, with an intermediate report first */
+    for (i = 0; i < DLRS; i++) {
+        add(i);
+        if (i % 2 == 0) {
+            find(i, DLR_BUFFERED, 1);
+            find(i, DLR_SUCCESS, 1);
+        }
+    }
+    if (dlr_messages() != DLRS / 2)
+        panic(0, "%ld DLRs stored, expected %d", dlr_messages(), DLRS / 2);
+
+    /* what would be on disk if we crashed now */
+    if ((crashed = octstr_read_file(octstr_get_cstr(log))) == NULL)
+        panic(0, "No log file written");
+
+    for (i = 1; i < DLRS; i += 4)
+        find(i, DLR_FAIL, 1);
+
+    dlr_shutdown();
+    start(cfg, DLRS / 4);
+    for (i = 0; i < DLRS; i++)
+        find(i, DLR_BUFFERED, i % 4 == 3);
+
+    /* crash in the middle of writing a record */
+    octstr_append_data(crashed, "\0\0\0\100a\005check", 10);
+    dlr_shutdown();
+    write_file(log, crashed);
+    start(cfg, DLRS / 2);
+    for (i = 0; i < DLRS; i++)
+        find(i, DLR_BUFFERED, i % 2 == 1);
+
+    /* many pending DLRs, kept across a restart */
+    dlr_flush();
+    for (i = 0; i < PENDING; i++)
+        add(i);
+    if (dlr_messages() != PENDING)
+        panic(0, "%ld DLRs stored, expected %d", dlr_messages(), PENDING);
+    dlr_shutdown();
+    start(cfg, PENDING);
+    for (i = PENDING - 1; i >= 0; i--)
+        find(i, DLR_SUCCESS, 1);
+    if (dlr_messages() != 0)
+        panic(0, "%ld DLRs left, expected none", dlr_messages());
+
+    dlr_flush();
+    dlr_shutdown();
+    start(cfg, 0);
+    dlr_shutdown();
+
+    unlink(octstr_get_cstr(log));
+    octstr_append(log, octstr_imm(".bak"));
+    unlink(octstr_get_cstr(log));
+    rmdir(dir);
+
+    octstr_destroy(log);
+    octstr_destroy(crashed);
+    cfg_destroy(cfg);
+    octstr_destroy(smsc);
+    gwlib_shutdown();
+    return 0;
+}
@@ -10,6 +10,14 @@ times=2
 port=8040
 url="http://$host:$port/hello.wml"
 loglevel=0
+metrics_port=13005
+
+# the sample configuration, with the caches and their metrics
+sed "/^group = wapbox/a\\
+metrics-port = $metrics_port\\
+metrics-interval = 1\\
+content-cache-size = 100000\\
+http-cache-size = 100000" gw/wapkannel.conf > check_wapkannel.conf
 
 test/test_http_server -f test/hello.wml -p $port > check_http.log 2>&1 &
 httppid=$!
@@ -19,7 +27,7 @@ bbpid=$!
 
 sleep 2
 
-gw/wapbox -v $loglevel gw/wapkannel.conf > check_wap.log 2>&1 &
+gw/wapbox -v $loglevel check_wapkannel.conf > check_wap.log 2>&1 &
 wappid=$!
 
 sleep 2
@@ -27,6 +35,12 @@ sleep 2
 test/fakewap -g $host -m $times $url > check_fake.log 2>&1
 ret=$?
 
+# the cache statistics are served while wapbox runs
+sleep 2
+test/test_http -qv 4 -o check_wapmetrics.log http://$host:$metrics_port/metrics || ret=1
+grep -q "^kannel_wapbox_content_cache_misses_total" check_wapmetrics.log || ret=1
+grep -q "^kannel_wapbox_http_cache_misses_total" check_wapmetrics.log || ret=1
+
 test/test_http -qv 4 http://$host:$port/quit
 
 kill -INT $bbpid 
@@ -37,10 +51,11 @@ if [ "$ret" != 0 ]
 then
 	echo check_fakewap failed 1>&2
 	echo See check_bb.log, check_wap.log, check_fake.log, 1>&2
-	echo check_http.log for info 1>&2
+	echo check_http.log, check_wapmetrics.log for info 1>&2
 	exit 1
 fi
 
-rm -f check_bb.log check_wap.log check_fake.log check_http.log
+rm -f check_bb.log check_wap.log check_fake.log check_http.log \
+    check_wapmetrics.log check_wapkannel.conf
 
 exit 0
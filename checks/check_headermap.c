@@ -0,0 +1,186 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_headermap.c - Check the HTTP header map
+ *
+ * Adds and removes random headers in a header map and in a header list
+ * of http.h side by side and checks that lookups give the same results,
+ * then converts between the two.
+ */
+
+#include <stdlib.h>
+
+#include "gwlib/gwlib.h"
+
+/* a few common names in different cases, and names that are not common */
+static char *names[] = {
+    "Content-Type", "content-type", "CONTENT-TYPE", "Host", "Accept",
+    "X-Kannel-To", "x-kannel-to", "X-Foo", "x-foo", "X-Bar", "Via",
+};
+#define NUM_NAMES ((long) (sizeof(names) / sizeof(names[0])))
+
+static void check_same(gw_headermap_t *map, List *list)
+{
+    Octstr *name, *value, *expected, *os;
+    List *all, *expected_all;
+    long i, j;
+
+    if (gw_headermap_len(map) != gwlist_len(list))
+        panic(0, "map has %ld headers, list %ld", gw_headermap_len(map),
+              gwlist_len(list));
+
+    for (i = 0; i < gwlist_len(list); i++) {
+        gw_headermap_get_index(map, i, &name, &value);
+        os = octstr_format("%S: %S", name, value);
+        if (octstr_compare(os, gwlist_get(list, i)) != 0)
+            panic(0, "header %ld is <%s>, not <%s>", i, octstr_get_cstr(os),
+                  octstr_get_cstr(gwlist_get(list, i)));
+        octstr_destroy(os);
+    }
+
+    for (i = 0; i < NUM_NAMES; i++) {
+        value = gw_headermap_get(map, names[i]);
+        expected = http_header_find_first(list, names[i]);
+        if ((value == NULL) != (expected == NULL) ||
+            (value != NULL && octstr_compare(value, expected) != 0))
+            panic(0, "first %s is <%s>, not <%s>", names[i],
+                  value ? octstr_get_cstr(value) : "NULL",
+                  expected ? octstr_get_cstr(expected) : "NULL");
+        octstr_destroy(expected);
+
+        all = gw_headermap_get_all(map, names[i]);
+        expected_all = http_header_find_all(list, names[i]);
+        if (gwlist_len(all) != gwlist_len(expected_all))
+            panic(0, "%ld headers %s, not %ld", gwlist_len(all), names[i],
+                  gwlist_len(expected_all));
+        for (j = 0; j < gwlist_len(all); j++) {
+            os = gwlist_get(expected_all, j);
+            os = octstr_copy(os, octstr_search_char(os, ':', 0) + 2,
+                             octstr_len(os));
+            if (octstr_compare(gwlist_get(all, j), os) != 0)
+                panic(0, "header %s %ld differs", names[i], j);
+            octstr_destroy(os);
+        }
+        gwlist_destroy(all, octstr_destroy_item);
+        gwlist_destroy(expected_all, octstr_destroy_item);
+    }
+}
+
+
+int main(void)
+{
+    gw_headermap_t *map, *copy;
+    List *list, *other;
+    Octstr *name, *value;
+    long i, n, removed, expected;
+
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    srandom(1);
+    map = gw_headermap_create();
+    list = http_create_empty_headers();
+    for (i = 0; i < 5000; i++) {
+        n = random() % NUM_NAMES;
+        switch (random() % 4) {
+        case 0:
+            removed = gw_headermap_remove_all(map, names[n]);
+            expected = http_header_remove_all(list, names[n]);
+            if (removed != expected)
+                panic(0, "removed %ld headers %s, not %ld", removed,
+                      names[n], expected);
+            break;
+        case 1:
+            name = octstr_create(names[n]);
+            value = octstr_format("set %ld", i);
+            gw_headermap_set(map, name, value);
+            http_header_remove_all(list, names[n]);
+            http_header_add(list, names[n], octstr_get_cstr(value));
+            octstr_destroy(name);
+            octstr_destroy(value);
+            break;
+        default:
+            name = octstr_create(names[n]);
+            value = octstr_format("value %ld", i);
+            gw_headermap_add(map, name, value);
+            http_header_add(list, names[n], octstr_get_cstr(value));
+            octstr_destroy(name);
+            octstr_destroy(value);
+            break;
+        }
+        check_same(map, list);
+    }
+
+    /* converting to a list and back gives the same headers */
+    other = gw_headermap_to_list(map);
+    copy = gw_headermap_from_list(other);
+    check_same(copy, list);
+    check_same(map, other);
+    gw_headermap_destroy(copy);
+    http_destroy_headers(other);
+
+    /* setting a header to its own value */
+    if (gw_headermap_len(map) > 0) {
+        gw_headermap_get_index(map, 0, &name, &value);
+        gw_headermap_set(map, name, value);
+    }
+
+    gw_headermap_destroy(map);
+    http_destroy_headers(list);
+    gwlib_shutdown();
+    return 0;
+}
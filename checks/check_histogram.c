@@ -0,0 +1,171 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_histogram.c - check gw_histogram
+ *
+ * Checks bucket precision of percentiles and that concurrent recording
+ * does not lose values.
+ */
+
+#include "gw-config.h"
+#include "gwlib/gwlib.h"
+
+#define THREADS 8
+#define PER_THREAD 100000
+
+
+static void check_within(long long got, long long expected, const char *what)
+{
+    /* relative bucket width is 1/16 */
+    if (got < expected || got > expected + expected / 16 + 1)
+        panic(0, "%s: got %lld, expected %lld", what, got, expected);
+}
+
+
+static void check_precision(void)
+{
+    gw_histogram_t *hist;
+    long long v;
+
+    hist = gw_histogram_create();
+
+    if (gw_histogram_percentile(hist, 50) != 0 || gw_histogram_max(hist) != 0)
+        panic(0, "empty histogram not empty");
+
+    /* 1 .. 1000000 */
+    for (v = 1; v <= 1000000; v++)
+        gw_histogram_record(hist, v);
+
+    if (gw_histogram_count(hist) != 1000000)
+        panic(0, "wrong count %lu", gw_histogram_count(hist));
+    if (gw_histogram_sum(hist) != 500000500000ULL)
+        panic(0, "wrong sum %llu", gw_histogram_sum(hist));
+    if (gw_histogram_max(hist) != 1000000)
+        panic(0, "wrong max %lld", gw_histogram_max(hist));
+
+    check_within(gw_histogram_percentile(hist, 50), 500000, "p50");
+    check_within(gw_histogram_percentile(hist, 99), 990000, "p99");
+    check_within(gw_histogram_percentile(hist, 100), 1000000, "p100");
+    check_within(gw_histogram_percentile(hist, 0.001), 10, "p0.001");
+
+    if (gw_histogram_count_le(hist, 15) != 15)
+        panic(0, "small values not exact");
+    v = gw_histogram_count_le(hist, 100000);
+    if (v < 100000 || v > 100000 + 100000 / 16)
+        panic(0, "count_le out of bucket precision: %lld", v);
+
+    /* huge and negative values are clamped */
+    gw_histogram_record(hist, -5);
+    gw_histogram_record(hist, 1LL << 50);
+    if (gw_histogram_count_le(hist, 0) != 1)
+        panic(0, "negative value not counted as 0");
+    if (gw_histogram_count_le(hist, LLONG_MAX) != 1000002)
+        panic(0, "huge value lost");
+
+    gw_histogram_reset(hist);
+    if (gw_histogram_count(hist) != 0 || gw_histogram_count_le(hist, LLONG_MAX) != 0)
+        panic(0, "reset failed");
+
+    gw_histogram_destroy(hist);
+}
+
+
+static void recorder(void *arg)
+{
+    gw_histogram_t *hist = arg;
+    long i;
+
+    for (i = 0; i < PER_THREAD; i++)
+        gw_histogram_record(hist, i);
+}
+
+
+static void check_threads(void)
+{
+    gw_histogram_t *hist;
+    long threads[THREADS];
+    long i;
+
+    hist = gw_histogram_create();
+    for (i = 0; i < THREADS; i++)
+        threads[i] = gwthread_create(recorder, hist);
+    for (i = 0; i < THREADS; i++)
+        gwthread_join(threads[i]);
+
+    if (gw_histogram_count(hist) != THREADS * PER_THREAD ||
+        gw_histogram_count_le(hist, LLONG_MAX) != THREADS * PER_THREAD)
+        panic(0, "values lost");
+    if (gw_histogram_sum(hist) != (unsigned long long) THREADS * PER_THREAD * (PER_THREAD - 1) / 2)
+        panic(0, "wrong sum");
+    if (gw_histogram_max(hist) != PER_THREAD - 1)
+        panic(0, "wrong max");
+
+    gw_histogram_destroy(hist);
+}
+
+
+int main(void)
+{
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    check_precision();
+    check_threads();
+
+    gwlib_shutdown();
+    return 0;
+}
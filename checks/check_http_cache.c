@@ -0,0 +1,235 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_http_cache.c - Check the HTTP response cache of wapbox
+ *
+ * Runs requests and made-up responses through the cache and checks
+ * hits, queueing of concurrent requests, revalidation, Vary and the
+ * responses that must not be stored.
+ */
+
+#include "gwlib/gwlib.h"
+#include "gw/wap-http-cache.h"
+
+static int request(char *method, char *url, List *request_headers, long id)
+{
+    int status, ret;
+    List *headers;
+    Octstr *body, *age;
+
+    ret = wap_http_cache_request(octstr_imm(method), octstr_imm(url),
+                                 request_headers, (void *) id,
+                                 &status, &headers, &body);
+    if (ret == WAP_HTTP_CACHE_HIT) {
+        if (status != HTTP_OK || octstr_str_compare(body, url) != 0)
+            panic(0, "wrong cached response <%s> for <%s>",
+                  octstr_get_cstr(body), url);
+        if ((age = http_header_value(headers, octstr_imm("Age"))) == NULL)
+            panic(0, "no Age header in cached response");
+        octstr_destroy(age);
+        http_destroy_headers(headers);
+        octstr_destroy(body);
+    }
+    return ret;
+}
+
+
+static int get(char *url)
+{
+    List *request_headers;
+    int ret;
+
+    request_headers = http_create_empty_headers();
+    ret = request("GET", url, request_headers, 0);
+    http_destroy_headers(request_headers);
+    return ret;
+}
+
+
+/*
+ * Feed a response with the given extra headers, one per line, to the
+ * cache. The body of the response is the URL. Return the number of
+ * queued requests.
+ */
+static long respond(char *url, List *request_headers, int status,
+                    char *extra_headers)
+{
+    List *headers, *waiters, *lines;
+    Octstr *body, *line, *name;
+    long n, colon;
+
+    headers = http_create_empty_headers();
+    http_header_add(headers, "Content-Type", "text/plain");
+    lines = octstr_split(octstr_imm(extra_headers), octstr_imm("\n"));
+    while ((line = gwlist_extract_first(lines)) != NULL) {
+        colon = octstr_search_char(line, ':', 0);
+        name = octstr_copy(line, 0, colon);
+        octstr_delete(line, 0, colon + 1);
+        octstr_strip_blanks(line);
+        http_header_add(headers, octstr_get_cstr(name), octstr_get_cstr(line));
+        octstr_destroy(name);
+        octstr_destroy(line);
+    }
+    gwlist_destroy(lines, NULL);
+    body = octstr_create(status == HTTP_NOT_MODIFIED ? "" : url);
+
+    waiters = wap_http_cache_response(octstr_imm(url), request_headers,
+                                      &status, &headers, &body);
+    if (status == HTTP_OK && octstr_str_compare(body, url) != 0)
+        panic(0, "wrong response <%s> for <%s>", octstr_get_cstr(body), url);
+    n = gwlist_len(waiters);
+    gwlist_destroy(waiters, NULL);
+    http_destroy_headers(headers);
+    octstr_destroy(body);
+    return n;
+}
+
+
+static void expect(int got, int expected, char *what)
+{
+    if (got != expected)
+        panic(0, "%s: got %d, expected %d", what, got, expected);
+}
+
+
+int main(void)
+{
+    List *req, *fi, *en, *headers;
+    Octstr *value, *body;
+    int status;
+
+    gwlib_init();
+    /* no statistics at shutdown */
+    log_set_output_level(GW_WARNING);
+
+    wap_http_cache_init(100000);
+    req = http_create_empty_headers();
+
+    /* a fresh response is shared by waiting and later requests */
+    expect(request("GET", "http://a/1", req, 1), WAP_HTTP_CACHE_FETCH, 
+           "first request");
+    expect(request("GET", "http://a/1", req, 2), WAP_HTTP_CACHE_WAIT, 
+           "concurrent request");
+    expect(respond("http://a/1", req, HTTP_OK, 
+                   "Cache-Control: public, max-age=60"), 1, "queued requests");
+    if (!wap_http_cache_get(octstr_imm("http://a/1"), req, 
+                            &status, &headers, &body))
+        panic(0, "response for queued request not cached");
+    http_destroy_headers(headers);
+    octstr_destroy(body);
+    expect(get("http://a/1"), WAP_HTTP_CACHE_HIT, "later request");
+
+    /* other methods bypass the cache and invalidate the URL */
+    expect(request("POST", "http://a/1", req, 3), WAP_HTTP_CACHE_BYPASS,
+           "POST request");
+    expect(get("http://a/1"), WAP_HTTP_CACHE_FETCH, "GET after POST");
+    respond("http://a/1", req, HTTP_OK, "");
+
+    /* responses that must not be stored */
+    expect(get("http://a/2"), WAP_HTTP_CACHE_FETCH, "no-store");
+    respond("http://a/2", req, HTTP_OK, "Cache-Control: no-store");
+    expect(get("http://a/2"), WAP_HTTP_CACHE_FETCH, "Set-Cookie");
+    respond("http://a/2", req, HTTP_OK, 
+            "Cache-Control: max-age=60\nSet-Cookie: id=1");
+    expect(get("http://a/2"), WAP_HTTP_CACHE_FETCH, "invalid Expires");
+    respond("http://a/2", req, HTTP_OK, "Expires: 0");
+    expect(get("http://a/2"), WAP_HTTP_CACHE_FETCH, "not found");
+    respond("http://a/2", req, HTTP_NOT_FOUND, "Cache-Control: max-age=60");
+    expect(get("http://a/2"), WAP_HTTP_CACHE_FETCH, "last");
+    respond("http://a/2", req, HTTP_OK, "");
+
+    /* a stale response with a validator is revalidated */
+    expect(get("http://a/3"), WAP_HTTP_CACHE_FETCH, "etag");
+    respond("http://a/3", req, HTTP_OK, "ETag: \"v1\"");
+    expect(request("GET", "http://a/3", req, 4), WAP_HTTP_CACHE_FETCH,
+           "revalidation");
+    value = http_header_value(req, octstr_imm("If-None-Match"));
+    if (value == NULL || octstr_str_compare(value, "\"v1\"") != 0)
+        panic(0, "no If-None-Match in revalidation");
+    octstr_destroy(value);
+    /* respond() checks that the body of the 304 was replaced */
+    respond("http://a/3", req, HTTP_NOT_MODIFIED, "Cache-Control: max-age=60");
+    expect(get("http://a/3"), WAP_HTTP_CACHE_HIT, "revalidated");
+    http_destroy_headers(req);
+
+    /* variants */
+    fi = http_create_empty_headers();
+    http_header_add(fi, "Accept-Language", "fi");
+    en = http_create_empty_headers();
+    http_header_add(en, "Accept-Language", "en");
+    expect(request("GET", "http://a/4", fi, 5), WAP_HTTP_CACHE_FETCH, "vary");
+    respond("http://a/4", fi, HTTP_OK, 
+            "Cache-Control: max-age=60\nVary: Accept-Language");
+    expect(request("GET", "http://a/4", fi, 6), WAP_HTTP_CACHE_HIT, 
+           "same variant");
+    expect(request("GET", "http://a/4", en, 7), WAP_HTTP_CACHE_FETCH, 
+           "other variant");
+    respond("http://a/4", en, HTTP_OK, "Vary: *");
+    http_destroy_headers(fi);
+    http_destroy_headers(en);
+
+    /* credentials bypass the cache */
+    req = http_create_empty_headers();
+    http_header_add(req, "Authorization", "Basic Zm9vOmJhcg==");
+    expect(request("GET", "http://a/1", req, 8), WAP_HTTP_CACHE_BYPASS,
+           "Authorization");
+    http_destroy_headers(req);
+
+    wap_http_cache_shutdown();
+    gwlib_shutdown();
+    return 0;
+}
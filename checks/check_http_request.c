@@ -0,0 +1,205 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_http_request.c - check reading of HTTP requests
+ *
+ * Sends the HTTP server pipelined requests on one connection, with
+ * continuation lines, plain and chunked bodies and a trailer, first a
+ * few octets at a time and then all at once, and checks what the
+ * server makes of them.
+ */
+
+#include <stdlib.h>
+
+#include "gwlib/gwlib.h"
+
+#define PORT 18095
+
+static char *requests =
+    "GET /first?a=1 HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "X-Long: part one\r\n"
+    "  part two\r\n"
+    "\r\n"
+    "POST /second HTTP/1.1\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 11\r\n"
+    "\r\n"
+    "hello world"
+    "POST /third HTTP/1.1\n"
+    "Transfer-Encoding: chunked\n"
+    "\n"
+    "5;name=value\r\n"
+    "hello\r\n"
+    "1\r\n"
+    " \r\n"
+    "A\r\n"
+    "world, bye\r\n"
+    "0\r\n"
+    "X-Trailer: yes\r\n"
+    "\r\n"
+    "HEAD /last HTTP/1.1\r\n"
+    "\r\n";
+
+static struct {
+    char *url;
+    char *header;
+    char *value;
+    char *body;
+} expected[] = {
+    { "/first", "X-Long", "part one  part two", "" },
+    { "/second", "Content-Type", "text/plain", "hello world" },
+    { "/third", "X-Trailer", "yes", "hello world, bye" },
+    { "/last", "Host", NULL, "" },
+};
+#define NUM_REQUESTS ((int) (sizeof(expected) / sizeof(expected[0])))
+
+/* the client keeps its connection open until told to close it */
+static List *done;
+
+
+static void client_thread(void *arg)
+{
+    Connection *conn;
+    long i, n, len;
+    int pieces = *(int *) arg;
+
+    conn = conn_open_tcp(octstr_imm("127.0.0.1"), PORT, NULL);
+    if (conn == NULL)
+        panic(0, "Cannot connect to test server");
+
+    len = strlen(requests);
+    for (i = 0; i < len; i += n) {
+        n = pieces ? 1 + random() % 7 : len;
+        if (i + n > len)
+            n = len - i;
+        conn_write_data(conn, (unsigned char *) requests + i, n);
+        conn_flush(conn);
+        if (pieces)
+            gwthread_sleep(0.002);
+    }
+
+    gwlist_consume(done);
+    /* drain the replies so closing does not reset the connection */
+    while (conn_wait(conn, 0.1) == 0 && !conn_eof(conn))
+        octstr_destroy(conn_read_everything(conn));
+    conn_destroy(conn);
+}
+
+
+static void check_requests(int pieces)
+{
+    HTTPClient *client;
+    Octstr *ip, *url, *body, *value;
+    List *headers, *cgivars;
+    long thread;
+    int i;
+
+    thread = gwthread_create(client_thread, &pieces);
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        client = http_accept_request(PORT, &ip, &url, &headers, &body, &cgivars);
+        if (client == NULL)
+            panic(0, "Request %d was not received", i);
+        if (octstr_str_compare(url, expected[i].url) != 0)
+            panic(0, "Request %d has URL <%s>, not <%s>", i,
+                  octstr_get_cstr(url), expected[i].url);
+        value = http_header_find_first(headers, expected[i].header);
+        if ((value == NULL) != (expected[i].value == NULL) ||
+            (value != NULL && octstr_str_compare(value, expected[i].value) != 0))
+            panic(0, "Request %d has %s <%s>, not <%s>", i, expected[i].header,
+                  value ? octstr_get_cstr(value) : "NULL",
+                  expected[i].value ? expected[i].value : "NULL");
+        /* requests without a body have none */
+        if (body == NULL)
+            body = octstr_create("");
+        if (octstr_str_compare(body, expected[i].body) != 0)
+            panic(0, "Request %d has body <%s>, not <%s>", i,
+                  octstr_get_cstr(body), expected[i].body);
+
+        http_send_reply(client, HTTP_OK, NULL, NULL);
+        octstr_destroy(value);
+        octstr_destroy(ip);
+        octstr_destroy(url);
+        octstr_destroy(body);
+        http_destroy_headers(headers);
+        http_destroy_cgiargs(cgivars);
+    }
+    gwlist_produce(done, expected);
+    gwthread_join(thread);
+}
+
+
+int main(void)
+{
+    gwlib_init();
+    log_set_output_level(GW_WARNING);
+    srandom(1);
+    done = gwlist_create();
+    gwlist_add_producer(done);
+
+    if (http_open_port(PORT, 0) == -1)
+        panic(0, "Cannot open port %d", PORT);
+
+    check_requests(1);
+    check_requests(0);
+
+    http_close_all_ports();
+    gwlist_remove_producer(done);
+    gwlist_destroy(done, NULL);
+    gwlib_shutdown();
+    return 0;
+}
@@ -0,0 +1,218 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_levelqueue.c - check gw_levelqueue
+ *
+ * Checks that items come out in level order and FIFO within a level,
+ * that head insertion and batch removal work, and that concurrent
+ * producers and blocking consumers neither lose nor duplicate items.
+ */
+
+#include "gw-config.h"
+#include "gwlib/gwlib.h"
+
+#define LEVELS 4
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define PER_PRODUCER 20000
+
+struct item {
+    int level;
+    long seq;
+};
+
+static gw_levelqueue_t *queue;
+static long consumed[CONSUMERS];
+static Counter *sum;
+
+
+static int item_level(const void *a)
+{
+    return ((const struct item *) a)->level;
+}
+
+
+static struct item *item_create(int level, long seq)
+{
+    struct item *item = gw_malloc(sizeof(*item));
+
+    item->level = level;
+    item->seq = seq;
+    return item;
+}
+
+
+static void check_order(void)
+{
+    struct item *item, *batch[8];
+    long i, n, seq[LEVELS];
+    int prev;
+
+    queue = gw_levelqueue_create(LEVELS, item_level);
+
+    for (i = 0; i < 1000; i++)
+        gw_levelqueue_insert(queue, item_create(gw_rand() % LEVELS, i));
+    /* out of range levels are clamped */
+    gw_levelqueue_insert(queue, item_create(-1, 1000));
+    gw_levelqueue_insert(queue, item_create(LEVELS + 5, 1001));
+
+    if (gw_levelqueue_len(queue) != 1002)
+        panic(0, "wrong queue length %ld", gw_levelqueue_len(queue));
+
+    /* put first item back at the head */
+    item = gw_levelqueue_remove(queue);
+    if (item_level(item) < LEVELS - 1 && item->seq != 1001)
+        panic(0, "first item not from highest level");
+    gw_levelqueue_insert_head(queue, item);
+    if (gw_levelqueue_remove(queue) != item)
+        panic(0, "head inserted item not removed first");
+    gw_free(item);
+
+    prev = LEVELS;
+    for (i = 0; i < LEVELS; i++)
+        seq[i] = -1;
+    while ((n = gw_levelqueue_remove_batch(queue, (void**) batch, 8)) > 0) {
+        for (i = 0; i < n; i++) {
+            int level = batch[i]->level;
+            if (level < 0)
+                level = 0;
+            if (level >= LEVELS)
+                level = LEVELS - 1;
+            if (level > prev)
+                panic(0, "item of level %d after level %d", level, prev);
+            if (batch[i]->seq <= seq[level])
+                panic(0, "FIFO order broken in level %d", level);
+            prev = level;
+            seq[level] = batch[i]->seq;
+            gw_free(batch[i]);
+        }
+    }
+
+    if (gw_levelqueue_len(queue) != 0 || gw_levelqueue_remove(queue) != NULL)
+        panic(0, "queue not empty");
+
+    gw_levelqueue_destroy(queue, NULL);
+}
+
+
+static void producer(void *arg)
+{
+    long i, id = (long) arg;
+
+    for (i = 0; i < PER_PRODUCER; i++)
+        gw_levelqueue_produce(queue, item_create((id + i) % LEVELS, i + 1));
+    gw_levelqueue_remove_producer(queue);
+}
+
+
+static void consumer(void *arg)
+{
+    long id = (long) arg;
+    struct item *item;
+
+    while ((item = gw_levelqueue_consume(queue)) != NULL) {
+        consumed[id]++;
+        counter_increase_with(sum, item->seq);
+        gw_free(item);
+    }
+}
+
+
+static void check_threads(void)
+{
+    long producers[PRODUCERS], consumers[CONSUMERS];
+    long i, total;
+
+    queue = gw_levelqueue_create(LEVELS, item_level);
+    sum = counter_create();
+
+    for (i = 0; i < PRODUCERS; i++)
+        gw_levelqueue_add_producer(queue);
+    for (i = 0; i < CONSUMERS; i++)
+        consumers[i] = gwthread_create(consumer, (void*) i);
+    for (i = 0; i < PRODUCERS; i++)
+        producers[i] = gwthread_create(producer, (void*) i);
+
+    for (i = 0; i < PRODUCERS; i++)
+        gwthread_join(producers[i]);
+    for (i = 0; i < CONSUMERS; i++)
+        gwthread_join(consumers[i]);
+
+    total = 0;
+    for (i = 0; i < CONSUMERS; i++)
+        total += consumed[i];
+    if (total != PRODUCERS * PER_PRODUCER)
+        panic(0, "consumed %ld items, expected %ld", total, (long) PRODUCERS * PER_PRODUCER);
+    if (counter_value(sum) != (unsigned long) PRODUCERS * PER_PRODUCER * (PER_PRODUCER + 1) / 2)
+        panic(0, "items lost or duplicated");
+
+    counter_destroy(sum);
+    gw_levelqueue_destroy(queue, NULL);
+}
+
+
+int main(void)
+{
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    check_order();
+    check_threads();
+
+    gwlib_shutdown();
+    return 0;
+}
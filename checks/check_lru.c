@@ -0,0 +1,163 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_lru.c - Check the least recently used cache
+ *
+ * Fills a cache beyond its limit and checks which items were evicted,
+ * replacement of items, expiry and the statistics.
+ */
+
+#include <time.h>
+
+#include "gwlib/gwlib.h"
+
+static void *dup_item(void *item) {
+	return octstr_duplicate(item);
+}
+
+static void destroy_item(void *item) {
+	octstr_destroy(item);
+}
+
+static Octstr *key(long i) {
+	return octstr_format("key-%ld", i);
+}
+
+static int has(gw_lru_t *lru, long i) {
+	Octstr *k, *v;
+	int found;
+
+	k = key(i);
+	v = gw_lru_get(lru, k);
+	found = (v != NULL);
+	if (found && octstr_compare(v, k) != 0)
+		panic(0, "wrong item <%s> for key <%s>", octstr_get_cstr(v),
+		      octstr_get_cstr(k));
+	octstr_destroy(v);
+	octstr_destroy(k);
+	return found;
+}
+
+static void put(gw_lru_t *lru, long i, long size, time_t expires) {
+	Octstr *k;
+
+	k = key(i);
+	gw_lru_put(lru, k, octstr_duplicate(k), size, expires);
+	octstr_destroy(k);
+}
+
+
+int main(void) {
+	gw_lru_t *lru;
+	gw_lru_stats_t stats;
+	Octstr *k;
+	long i;
+
+	gwlib_init();
+	log_set_output_level(GW_INFO);
+
+	lru = gw_lru_create(100, dup_item, destroy_item);
+
+	/* ten items of size 10 fill the cache */
+	for (i = 0; i < 10; i++)
+		put(lru, i, 10, 0);
+	for (i = 0; i < 10; i++)
+		if (!has(lru, i))
+			panic(0, "item %ld missing from full cache", i);
+
+	/* use item 0, then add two more: items 1 and 2 get evicted */
+	has(lru, 0);
+	put(lru, 10, 10, 0);
+	put(lru, 11, 10, 0);
+	if (!has(lru, 0) || has(lru, 1) || has(lru, 2) || !has(lru, 3) ||
+	    !has(lru, 11))
+		panic(0, "wrong items evicted");
+
+	/* replacing an item does not count it twice */
+	put(lru, 3, 30, 0);
+	gw_lru_stats(lru, &stats);
+	if (stats.entries > 10 || stats.size > 100)
+		panic(0, "cache over limit: %ld entries, size %ld",
+		      stats.entries, stats.size);
+
+	/* too big items are refused */
+	k = key(99);
+	if (gw_lru_put(lru, k, octstr_duplicate(k), 101, 0))
+		panic(0, "item bigger than cache was stored");
+	octstr_destroy(k);
+
+	/* expired items are not returned */
+	put(lru, 20, 1, time(NULL) - 1);
+	if (has(lru, 20))
+		panic(0, "expired item returned");
+	put(lru, 21, 1, time(NULL) + 60);
+	if (!has(lru, 21))
+		panic(0, "item not expired yet missing");
+
+	gw_lru_remove(lru, octstr_imm("key-21"));
+	if (has(lru, 21))
+		panic(0, "removed item returned");
+
+	gw_lru_stats(lru, &stats);
+	if (stats.hits == 0 || stats.misses == 0 || stats.evictions < 2)
+		panic(0, "wrong statistics: %lld hits, %lld misses, %lld evictions",
+		      stats.hits, stats.misses, stats.evictions);
+
+	gw_lru_destroy(lru);
+	gwlib_shutdown();
+	return 0;
+}
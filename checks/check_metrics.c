@@ -0,0 +1,195 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_metrics.c - check the gw_metrics registry
+ *
+ * Checks the rendered Prometheus text of all metric types, label
+ * escaping, unregistering and the refreshed snapshot.
+ */
+
+#include "gw-config.h"
+#include "gwlib/gwlib.h"
+
+
+static void expect(Octstr *text, const char *line)
+{
+    if (octstr_search(text, octstr_imm(line), 0) == -1)
+        panic(0, "<%s> not found in:\n%s", line, octstr_get_cstr(text));
+}
+
+
+static void expect_not(Octstr *text, const char *line)
+{
+    if (octstr_search(text, octstr_imm(line), 0) != -1)
+        panic(0, "<%s> unexpected in:\n%s", line, octstr_get_cstr(text));
+}
+
+
+static double callback_value(void *arg)
+{
+    return *(long *) arg;
+}
+
+
+static void check_label(void)
+{
+    Octstr *label;
+
+    label = gw_metrics_label("smsc", octstr_imm("a\"b\\c\nd"));
+    if (octstr_str_compare(label, "smsc=\"a\\\"b\\\\c\\nd\"") != 0)
+        panic(0, "wrong label escaping: %s", octstr_get_cstr(label));
+    octstr_destroy(label);
+}
+
+
+static void check_render(void)
+{
+    gw_metric_t *counter, *gauge_a, *gauge_b, *callback, *hist_metric;
+    gw_histogram_t *hist;
+    Octstr *label_a, *label_b, *text;
+    long value = 42;
+
+    label_a = gw_metrics_label("queue", octstr_imm("a"));
+    label_b = gw_metrics_label("queue", octstr_imm("b"));
+
+    counter = gw_metrics_counter("test_total", "Test counter.", NULL);
+    gauge_a = gw_metrics_gauge("test_queue", "Test gauge.", label_a);
+    gauge_b = gw_metrics_gauge("test_queue", "Test gauge.", label_b);
+    callback = gw_metrics_callback("test_callback", "Test callback.",
+                                   GW_METRIC_GAUGE, NULL, callback_value, &value);
+    hist = gw_histogram_create();
+    gw_histogram_record(hist, 2000);     /* 2ms */
+    gw_histogram_record(hist, 2000000);  /* 2s */
+    hist_metric = gw_metrics_histogram("test_seconds", "Test histogram.",
+                                       label_a, hist, 0.000001);
+
+    gw_metric_increase(counter);
+    gw_metric_add(counter, 9);
+    gw_metric_set(gauge_a, 3);
+    gw_metric_set(gauge_b, -1);
+    gw_metric_increase(NULL);
+    if (gw_metric_value(counter) != 10)
+        panic(0, "wrong counter value %lld", gw_metric_value(counter));
+
+    text = gw_metrics_render();
+    expect(text, "# HELP test_total Test counter.\n# TYPE test_total counter\ntest_total 10\n");
+    expect(text, "# TYPE test_queue gauge\ntest_queue{queue=\"a\"} 3\ntest_queue{queue=\"b\"} -1\n");
+    expect(text, "test_callback 42\n");
+    expect(text, "# TYPE test_seconds histogram\n");
+    expect(text, "test_seconds_bucket{queue=\"a\",le=\"0.001\"} 0\n");
+    expect(text, "test_seconds_bucket{queue=\"a\",le=\"0.005\"} 1\n");
+    expect(text, "test_seconds_bucket{queue=\"a\",le=\"5\"} 2\n");
+    expect(text, "test_seconds_bucket{queue=\"a\",le=\"+Inf\"} 2\n");
+    expect(text, "test_seconds_count{queue=\"a\"} 2\n");
+    expect(text, "test_seconds_sum{queue=\"a\"} 2.002000\n");
+    octstr_destroy(text);
+
+    /* callbacks are evaluated at render time */
+    value = 7;
+    gw_metrics_unregister(gauge_b);
+    gw_metrics_unregister(counter);
+    text = gw_metrics_render();
+    expect(text, "test_callback 7\n");
+    expect(text, "test_queue{queue=\"a\"} 3\n");
+    expect_not(text, "queue=\"b\"");
+    expect_not(text, "test_total");
+    octstr_destroy(text);
+
+    gw_metrics_unregister(gauge_a);
+    gw_metrics_unregister(callback);
+    gw_metrics_unregister(hist_metric);
+    gw_histogram_destroy(hist);
+    octstr_destroy(label_a);
+    octstr_destroy(label_b);
+}
+
+
+static void check_snapshot(void)
+{
+    gw_metric_t *counter;
+    Octstr *text;
+
+    counter = gw_metrics_counter("snapshot_total", "Snapshot counter.", NULL);
+    gw_metrics_start(1);
+
+    /* scrapes see the last rendered page, not the current value */
+    gw_metric_add(counter, 5);
+    text = gw_metrics_snapshot();
+    expect(text, "snapshot_total 0\n");
+    octstr_destroy(text);
+
+    gwthread_sleep(2.5);
+    text = gw_metrics_snapshot();
+    expect(text, "snapshot_total 5\n");
+    octstr_destroy(text);
+
+    gw_metrics_unregister(counter);
+}
+
+
+int main(void)
+{
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    check_label();
+    check_render();
+    check_snapshot();
+
+    gwlib_shutdown();
+    return 0;
+}
@@ -58,6 +58,8 @@
  * check_octstr.c - checking of octet string functions
  */
 
+#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "gwlib/gwlib.h"
@@ -111,11 +113,126 @@ static void check_comparisons(void)
 }
 
 
+/*
+ * Plain byte loops doing what octstr_search, octstr_case_search and
+ * octstr_case_compare do, to check the vectorised versions against.
+ */
+
+static long ref_search(Octstr *haystack, Octstr *needle, long pos, int fold)
+{
+    long i, j, n = octstr_len(needle);
+
+    if (n == 0)
+        return 0;
+    for (i = pos; i <= octstr_len(haystack) - n; ++i) {
+        for (j = 0; j < n; ++j) {
+            if (fold ? toupper(octstr_get_char(haystack, i + j)) !=
+                       toupper(octstr_get_char(needle, j)) :
+                       octstr_get_char(haystack, i + j) !=
+                       octstr_get_char(needle, j))
+                break;
+        }
+        if (j == n)
+            return i;
+    }
+    return -1;
+}
+
+static int ref_case_compare(Octstr *os1, Octstr *os2)
+{
+    long i;
+    int c1, c2;
+
+    for (i = 0; i < octstr_len(os1) && i < octstr_len(os2); ++i) {
+        c1 = toupper(octstr_get_char(os1, i));
+        c2 = toupper(octstr_get_char(os2, i));
+        if (c1 != c2)
+            return c1 < c2 ? -1 : 1;
+    }
+    return signof(octstr_len(os1) - octstr_len(os2));
+}
+
+/* Random string from a few letters in both cases, the bytes next to
+ * them and bytes with the top bit set, so that there are many near
+ * matches. */
+static Octstr *random_octstr(long len)
+{
+    static const unsigned char chars[] = "aAbBzZ@[`{:\r\n\xc1\xe1";
+    Octstr *os;
+    long i;
+
+    os = octstr_create("");
+    for (i = 0; i < len; ++i)
+        octstr_append_char(os, chars[random() % (sizeof(chars) - 1)]);
+    return os;
+}
+
+static void check_searches(void)
+{
+    Octstr *haystack, *needle, *other;
+    long round, pos, start, len, found, expected;
+
+    srandom(1);
+    for (round = 0; round < 20000; ++round) {
+        haystack = random_octstr(random() % 100);
+        len = octstr_len(haystack);
+
+        /* Half of the needles are taken from the haystack, then
+         * changed in case or in one byte. */
+        if (round % 2 == 0 || len == 0)
+            needle = random_octstr(random() % 6);
+        else {
+            start = random() % len;
+            needle = octstr_copy(haystack, start, random() % 40);
+            if (octstr_len(needle) > 0 && round % 3 == 0)
+                octstr_set_char(needle, random() % octstr_len(needle), 'b');
+            if (round % 5 == 0)
+                octstr_convert_range(needle, 0, octstr_len(needle), toupper);
+        }
+
+        for (pos = 0; pos <= len + 1; pos += 1 + random() % 8) {
+            found = octstr_search(haystack, needle, pos);
+            expected = ref_search(haystack, needle, pos, 0);
+            if (found != expected)
+                panic(0, "octstr_search of `%s' from %ld in `%s' gave %ld, "
+                      "not %ld", octstr_get_cstr(needle), pos,
+                      octstr_get_cstr(haystack), found, expected);
+            found = octstr_case_search(haystack, needle, pos);
+            expected = ref_search(haystack, needle, pos, 1);
+            if (found != expected)
+                panic(0, "octstr_case_search of `%s' from %ld in `%s' gave "
+                      "%ld, not %ld", octstr_get_cstr(needle), pos,
+                      octstr_get_cstr(haystack), found, expected);
+        }
+
+        /* Compare with a copy changed in case and maybe in one byte. */
+        other = octstr_duplicate(haystack);
+        if (round % 2 == 0)
+            octstr_convert_range(other, 0, len, tolower);
+        if (len > 0 && round % 3 == 0)
+            octstr_set_char(other, random() % len, random() % 256);
+        if (round % 7 == 0)
+            octstr_truncate(other, random() % (len + 1));
+        if (signof(octstr_case_compare(haystack, other)) !=
+                ref_case_compare(haystack, other) ||
+            signof(octstr_case_compare(other, haystack)) !=
+                ref_case_compare(other, haystack))
+            panic(0, "octstr_case_compare of `%s' and `%s' differs",
+                  octstr_get_cstr(haystack), octstr_get_cstr(other));
+
+        octstr_destroy(other);
+        octstr_destroy(needle);
+        octstr_destroy(haystack);
+    }
+}
+
+
 int main(void)
 {
     gwlib_init();
     log_set_output_level(GW_INFO);
     check_comparisons();
+    check_searches();
     gwlib_shutdown();
     return 0;
 }
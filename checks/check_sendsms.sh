@@ -17,6 +17,11 @@ password=foobar
 url="http://$host:$sendsmsport/cgi-bin/sendsms?from=123&to=234&\
 text=test&username=$username&password=$password"
 
+# bulk sendsms is served only if its url is set
+sed "/^group = smsbox/a\\
+sendsms-bulk-url = /cgi-bin/sendsms-bulk" gw/smskannel.conf \
+    > check_sendsms_kannel.conf
+
 gw/bearerbox -v $loglevel gw/smskannel.conf > check_sendsms_bb.log 2>&1 &
 bbpid=$!
 
@@ -26,7 +31,7 @@ test/fakesmsc -H $host -r 20000 -i $interval -m $times '123 234 text nop' \
     > check_sendsms_smsc.log 2>&1 &
 
 sleep 1
-gw/smsbox -v $loglevel gw/smskannel.conf > check_sendsms_sms.log 2>&1 &
+gw/smsbox -v $loglevel check_sendsms_kannel.conf > check_sendsms_sms.log 2>&1 &
 
 sleep 2
 
@@ -125,6 +130,26 @@ then
 	exit 1
 fi
 
+printf 'to=345&text=bulk\nto=456&text=bulk\n\nto=&text=bulk\n' \
+    > check_sendsms_bulk.txt
+url="http://$host:$sendsmsport/cgi-bin/sendsms-bulk?from=123&\
+username=$username&password=$password"
+
+test/test_http -B check_sendsms_bulk.txt $url > check_sendsms_bulk.log 2>&1
+sleep 1
+
+if grep 'WARNING:|ERROR:|PANIC:' check_sendsms*.log >/dev/null ||
+   [ 1 -ne `grep -c '<123 345 text bulk>' check_sendsms_smsc.log` ] ||
+   [ 1 -ne `grep -c '<123 456 text bulk>' check_sendsms_smsc.log` ] ||
+   [ 1 -ne `grep -c 'sendsms-bulk: 4 lines from <127.0.0.1> answered' \
+       check_sendsms_sms.log` ]
+then
+	echo check_sendsms.sh failed with bulk sendsms 1>&2
+	echo See check_sendsms*.log for info 1>&2
+	exit 1
+fi
+rm -f check_sendsms_bulk.txt
+
 kill -INT $bbpid
 wait
 
@@ -136,7 +161,7 @@ then
 	exit 1
 fi
 
-rm -f check_sendsms*.log
+rm -f check_sendsms*.log check_sendsms_kannel.conf
 
 exit 0
 
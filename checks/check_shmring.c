@@ -0,0 +1,172 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_shmring.c - Check the shared memory message rings
+ *
+ * Creates a small ring pair and attaches to it again in the same
+ * process. One thread writes frames of random length to each side while
+ * another reads them and checks that they come out whole and in order,
+ * many times around the ring. Then checks timeouts and closing.
+ */
+
+#include "gwlib/gwlib.h"
+
+#define FRAMES 20000
+#define RING_SIZE 4096
+
+static gw_shmring_t *sides[2];
+
+
+/* Frame number i: its number followed by a random number of its bytes */
+static Octstr *frame(long i)
+{
+    Octstr *os;
+    long len;
+
+    os = octstr_format("%ld:", i);
+    for (len = (i * 7919) % 1500; len > 0; len--)
+        octstr_append_char(os, i & 0xFF);
+    return os;
+}
+
+
+static void writer(void *arg)
+{
+    gw_shmring_t *ring = arg;
+    Octstr *os;
+    long i;
+
+    for (i = 0; i < FRAMES; i++) {
+        os = frame(i);
+        if (gw_shmring_write(ring, os) != 0)
+            panic(0, "Could not write frame %ld", i);
+        octstr_destroy(os);
+    }
+}
+
+
+static void reader(void *arg)
+{
+    gw_shmring_t *ring = arg;
+    Octstr *os, *expected;
+    long i;
+
+    for (i = 0; i < FRAMES; i++) {
+        if (gw_shmring_read(ring, &os, 10.0) != 0)
+            panic(0, "Could not read frame %ld", i);
+        expected = frame(i);
+        if (octstr_compare(os, expected) != 0) {
+            octstr_dump(os, 0);
+            panic(0, "Frame %ld is wrong", i);
+        }
+        octstr_destroy(expected);
+        octstr_destroy(os);
+    }
+}
+
+
+int main(void)
+{
+    Octstr *dir, *os;
+    long threads[4];
+    int i;
+
+    gwlib_init();
+    /* attaching twice logs an error, on purpose */
+    log_set_output_level(GW_PANIC);
+
+    dir = octstr_create(".");
+    sides[0] = gw_shmring_create(dir, RING_SIZE);
+    if (sides[0] == NULL)
+        panic(0, "Could not create ring");
+    sides[1] = gw_shmring_attach(gw_shmring_path(sides[0]));
+    if (sides[1] == NULL)
+        panic(0, "Could not attach to ring");
+    if (gw_shmring_attach(gw_shmring_path(sides[0])) != NULL)
+        panic(0, "Could attach to ring twice");
+    gw_shmring_unlink(sides[0]);
+
+    threads[0] = gwthread_create(writer, sides[0]);
+    threads[1] = gwthread_create(reader, sides[1]);
+    threads[2] = gwthread_create(writer, sides[1]);
+    threads[3] = gwthread_create(reader, sides[0]);
+    for (i = 0; i < 4; i++)
+        gwthread_join(threads[i]);
+
+    if (gw_shmring_read(sides[1], &os, 0.1) != 1)
+        panic(0, "Reading empty ring did not time out");
+
+    /* what is written before closing can be read after it */
+    os = octstr_create("last words");
+    if (gw_shmring_write(sides[0], os) != 0)
+        panic(0, "Could not write last frame");
+    octstr_destroy(os);
+    gw_shmring_destroy(sides[0]);
+    if (gw_shmring_read(sides[1], &os, 1.0) != 0 ||
+        octstr_compare(os, octstr_imm("last words")) != 0)
+        panic(0, "Could not read last frame");
+    octstr_destroy(os);
+    if (gw_shmring_read(sides[1], &os, 1.0) != -1)
+        panic(0, "Closed ring did not return end of file");
+    if (gw_shmring_write(sides[1], octstr_imm("nobody")) != -1)
+        panic(0, "Could write to closed ring");
+    gw_shmring_destroy(sides[1]);
+
+    octstr_destroy(dir);
+    gwlib_shutdown();
+    return 0;
+}
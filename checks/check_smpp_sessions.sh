@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Use `test/drive_smpp' to test an SMPP connection of two sessions sharing
+# one send queue: each message must reach the SMS center exactly once, also
+# those a failing session leaves unanswered.
+
+set -e
+#set -x
+
+times=100
+drop=20
+
+# two transmitter sessions, the first failure handed over quickly
+sed -e 's/^log-file = "check_smpp_bb.log"/log-file = "check_smpp_sessions_bb.log"/' \
+    -e '/^smsc-id = smpp/a\
+sessions = 2\
+reconnect-delay = 2' test/drive_smpp.conf > check_smpp_sessions.conf
+
+test/drive_smpp -v 0 -m $times -f $drop > check_smpp_sessions_drive.log 2>&1 &
+drivepid=$!
+sleep 1
+
+gw/bearerbox -v 0 check_smpp_sessions.conf > /dev/null 2>&1 &
+bbpid=$!
+
+i=0
+while [ $i -lt 60 ] &&
+    ! grep "ESME has submitted all messages to SMSC." \
+        check_smpp_sessions_drive.log > /dev/null
+do
+    sleep 1
+    i=`expr $i + 1`
+done
+sleep 2
+
+kill -INT $bbpid
+wait
+
+if grep -E 'ERROR:|PANIC:' check_smpp_sessions_drive.log >/dev/null ||
+   grep 'PANIC:' check_smpp_sessions_bb.log >/dev/null ||
+   ! grep 'Dropping transmitter' check_smpp_sessions_drive.log >/dev/null ||
+   ! grep 'session [0-9]* failed, session [0-9]* takes over' \
+       check_smpp_sessions_bb.log >/dev/null
+then
+        echo check_smpp_sessions.sh failed 1>&2
+        echo See check_smpp_sessions*.log for info 1>&2
+        exit 1
+fi
+
+rm -f check_smpp_sessions*.log check_smpp_sessions.conf
+
+exit 0
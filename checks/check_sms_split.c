@@ -0,0 +1,256 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_sms_split.c - Check the splitting of long SMS messages
+ *
+ * Splits random 7 bit, 8 bit and UCS-2 messages with sms_split, with
+ * and without header, footer, suffix, split characters, UDH and
+ * catenation, and checks that the parts fit in a message, that no GSM
+ * escape or UCS-2 character is cut in half, that the text of the parts
+ * adds up to the original text and that the catenation UDH and the DLR
+ * request are right.
+ */
+
+#include "gwlib/gwlib.h"
+#include "gw/sms.h"
+#include "gw/dlr.h"
+
+#define ROUNDS 5000
+
+static char *pieces[] = {
+    "hello ", "world", " ", ".", ",", "a", "{", "[", "~", "\xe2\x82\xac",
+    "\xc3\xa9", "\xce\x94", "\xd0\x96", "\xf0\x9f\x98\x80",
+};
+#define NUM_PIECES ((long) (sizeof(pieces) / sizeof(pieces[0])))
+
+
+static Octstr *random_text(void)
+{
+    Octstr *os;
+    long n;
+
+    os = octstr_create("");
+    for (n = gw_rand() % 300; n > 0; n--)
+        octstr_append_cstr(os, pieces[gw_rand() % NUM_PIECES]);
+    return os;
+}
+
+
+/* Remove `prefix' from the start of `os', panic if it is not there. */
+static void strip_prefix(Octstr *os, Octstr *prefix)
+{
+    if (prefix == NULL)
+        return;
+    if (octstr_ncompare(os, prefix, octstr_len(prefix)) != 0)
+        panic(0, "Part does not start with `%s'", octstr_get_cstr(prefix));
+    octstr_delete(os, 0, octstr_len(prefix));
+}
+
+
+/* Remove `suffix' from the end of `os', panic if it is not there. */
+static void strip_suffix(Octstr *os, Octstr *suffix)
+{
+    long len;
+
+    if (suffix == NULL)
+        return;
+    len = octstr_len(os) - octstr_len(suffix);
+    if (len < 0 || octstr_search(os, suffix, len) != len)
+        panic(0, "Part does not end with `%s'", octstr_get_cstr(suffix));
+    octstr_truncate(os, len);
+}
+
+
+static void check_part(Msg *orig, Msg *part, long msgno, long total, 
+                       int catenate)
+{
+    Octstr *gsm;
+    long udh_len, len, c;
+
+    udh_len = octstr_len(part->sms.udhdata);
+    len = octstr_len(part->sms.msgdata);
+    if (orig->sms.coding == DC_7BIT) {
+        gsm = octstr_duplicate(part->sms.msgdata);
+        charset_utf8_to_gsm(gsm);
+        len = octstr_len(gsm);
+        if (len > (MAX_SMS_OCTETS - udh_len) * 8 / 7)
+            panic(0, "Part %ld/%ld has %ld septets, UDH %ld", msgno, total, len, udh_len);
+        if (len > 0 && octstr_get_char(gsm, len - 1) == 27)
+            panic(0, "Part %ld ends with an escape", msgno);
+        octstr_destroy(gsm);
+    } else if (len > MAX_SMS_OCTETS - udh_len)
+        panic(0, "Part %ld has %ld octets", msgno, len);
+
+    if (orig->sms.coding == DC_UCS2) {
+        if (len % 2 != 0)
+            panic(0, "UCS-2 part %ld has odd length", msgno);
+        c = (octstr_get_char(part->sms.msgdata, len - 2) << 8) |
+            octstr_get_char(part->sms.msgdata, len - 1);
+        if (c >= 0xD800 && c <= 0xDBFF)
+            panic(0, "UCS-2 part %ld ends with a high surrogate", msgno);
+    }
+
+    if (catenate && total > 1) {
+        if (octstr_get_char(part->sms.udhdata, udh_len - 1) != msgno ||
+            octstr_get_char(part->sms.udhdata, udh_len - 2) != total ||
+            octstr_get_char(part->sms.udhdata, 0) != udh_len - 1)
+            panic(0, "Part %ld has wrong catenation UDH", msgno);
+        if (part->sms.msg_left != total - msgno)
+            panic(0, "Part %ld has %ld messages left", msgno, 
+                  part->sms.msg_left);
+    } else if (orig->sms.udhdata != NULL && 
+               octstr_compare(part->sms.udhdata, orig->sms.udhdata) != 0)
+        panic(0, "Part %ld has changed UDH", msgno);
+
+    if (msgno > 1 && DLR_IS_ENABLED(part->sms.dlr_mask))
+        panic(0, "Part %ld asks for a DLR", msgno);
+    if (msgno == 1 && part->sms.dlr_mask != orig->sms.dlr_mask)
+        panic(0, "First part does not ask for a DLR");
+}
+
+
+static void check_split(int coding)
+{
+    Msg *orig, *part;
+    Octstr *header, *footer, *suffix, *split_chars, *text, *joined;
+    List *parts;
+    long i, total;
+    int catenate;
+
+    orig = msg_create(sms);
+    orig->sms.coding = coding;
+    orig->sms.msgdata = random_text();
+    text = octstr_duplicate(orig->sms.msgdata);
+    if (coding == DC_7BIT) {
+        charset_utf8_to_gsm(text);
+        charset_gsm_to_utf8(text);
+    } else if (coding == DC_UCS2) {
+        charset_convert(orig->sms.msgdata, "UTF-8", "UTF-16BE");
+        octstr_destroy(text);
+        text = octstr_duplicate(orig->sms.msgdata);
+    }
+    if (gw_rand() % 4 == 0)
+        orig->sms.udhdata = octstr_create("\x04\x24\x02\x01\x01");
+    if (gw_rand() % 2 == 0) {
+        orig->sms.dlr_mask = DLR_SUCCESS | DLR_FAIL;
+        orig->sms.dlr_url = octstr_create("http://localhost/dlr");
+    }
+
+    /* header, footer and suffix are one character and one septet */
+    header = footer = suffix = split_chars = NULL;
+    if (gw_rand() % 3 == 0)
+        header = octstr_create_from_data(coding == DC_UCS2 ? "\0(" : "(", 
+                               coding == DC_UCS2 ? 2 : 1);
+    if (gw_rand() % 3 == 0)
+        footer = octstr_create_from_data(coding == DC_UCS2 ? "\0)" : ")", 
+                                         coding == DC_UCS2 ? 2 : 1);
+    if (gw_rand() % 3 == 0)
+        suffix = octstr_create_from_data(coding == DC_UCS2 ? "\0+" : "+", 
+                                         coding == DC_UCS2 ? 2 : 1);
+    if (gw_rand() % 2 == 0)
+        split_chars = octstr_create(" .,");
+    catenate = gw_rand() % 2;
+
+    parts = sms_split(orig, header, footer, suffix, split_chars, catenate,
+                      42, 255, MAX_SMS_OCTETS);
+    total = gwlist_len(parts);
+    if (total < 1 || total > 255)
+        panic(0, "Message split into %ld parts", total);
+
+    joined = octstr_create("");
+    for (i = 0; i < total; i++) {
+        part = gwlist_get(parts, i);
+        check_part(orig, part, i + 1, total, catenate);
+        strip_prefix(part->sms.msgdata, header);
+        if (i + 1 < total)
+            strip_suffix(part->sms.msgdata, suffix);
+        strip_suffix(part->sms.msgdata, footer);
+        octstr_append(joined, part->sms.msgdata);
+    }
+    if (octstr_compare(joined, text) != 0) {
+        octstr_dump(text, 0);
+        octstr_dump(joined, 0);
+        panic(0, "Parts do not add up to the message");
+    }
+
+    octstr_destroy(joined);
+    octstr_destroy(text);
+    octstr_destroy(header);
+    octstr_destroy(footer);
+    octstr_destroy(suffix);
+    octstr_destroy(split_chars);
+    gwlist_destroy(parts, msg_destroy_item);
+    msg_destroy(orig);
+}
+
+
+int main(void)
+{
+    long i;
+
+    gwlib_init();
+    log_set_output_level(GW_WARNING);
+
+    for (i = 0; i < ROUNDS; i++) {
+        check_split(DC_7BIT);
+        check_split(DC_8BIT);
+        check_split(DC_UCS2);
+    }
+
+    gwlib_shutdown();
+    return 0;
+}
@@ -0,0 +1,242 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+/*
+ * check_timers.c - Check that WAP timers elapse in time and in order
+ *
+ * Starts timers with millisecond intervals, some of them longer than the
+ * lowest level of the timing wheel, stops and restarts some of them,
+ * and checks when and in which order their events come out, and that
+ * a timer started after the wheel was idle does not make it catch up.
+ */
+
+#define TIMERS 1000
+#define MAX_INTERVAL 1500
+#define SLACK 200
+#define IDLE 1500
+/* a timer may elapse up to one tick of the clock early */
+#define TICK 1
+
+#include "gwlib/gwlib.h"
+#include "wap/timers.h"
+
+static List *output;
+
+
+static WAPEvent *timeout_event(long handle) {
+	WAPEvent *e;
+
+	e = wap_event_create(TimerTO_A);
+	e->u.TimerTO_A.handle = handle;
+	return e;
+}
+
+
+/* Wait for the next event, check its handle and when it came */
+static void expect(long handle, long long start, long interval) {
+	WAPEvent *e;
+	long elapsed;
+
+	e = gwlist_consume(output);
+	elapsed = (date_monotonic_usec() - start) / 1000;
+	if (e->u.TimerTO_A.handle != handle)
+		panic(0, "timer %ld elapsed, expected timer %ld",
+		      e->u.TimerTO_A.handle, handle);
+	if (elapsed < interval - TICK || elapsed > interval + SLACK)
+		panic(0, "timer %ld of %ld ms elapsed after %ld ms",
+		      handle, interval, elapsed);
+	wap_event_destroy(e);
+}
+
+
+static void check_order(void) {
+	static long intervals[] = { 300, 100, 700, 200 };
+	static long order[] = { 1, 3, 0, 2 };
+	Timer *t[4];
+	long long start;
+	long i;
+
+	start = date_monotonic_usec();
+	for (i = 0; i < 4; i++) {
+		t[i] = gwtimer_create(output);
+		gwtimer_start_msec(t[i], intervals[i], timeout_event(i));
+	}
+	for (i = 0; i < 4; i++)
+		expect(order[i], start, intervals[order[i]]);
+	for (i = 0; i < 4; i++)
+		gwtimer_destroy(t[i]);
+}
+
+
+static void check_stop_and_restart(void) {
+	Timer *t;
+	long long start;
+
+	t = gwtimer_create(output);
+
+	/* a stopped timer must not elapse */
+	gwtimer_start_msec(t, 50, timeout_event(1));
+	gwtimer_stop(t);
+	gwthread_sleep(0.2);
+	if (gwlist_len(output) != 0)
+		panic(0, "stopped timer elapsed");
+
+	/* restarting takes back the event of an elapsed timer */
+	gwtimer_start_msec(t, 10, NULL);
+	gwthread_sleep(0.2);
+	if (gwlist_len(output) != 1)
+		panic(0, "timer did not elapse");
+	start = date_monotonic_usec();
+	gwtimer_start_msec(t, 400, NULL);
+	if (gwlist_len(output) != 0)
+		panic(0, "restarted timer left its event behind");
+	expect(1, start, 400);
+
+	/* moving a running timer */
+	start = date_monotonic_usec();
+	gwtimer_start_msec(t, 1000, NULL);
+	gwtimer_start_msec(t, 100, NULL);
+	expect(1, start, 100);
+
+	gwtimer_destroy(t);
+}
+
+
+static void check_many(void) {
+	Timer **t;
+	long *intervals;
+	long long start;
+	long i, elapsed;
+	WAPEvent *e;
+
+	t = gw_malloc(TIMERS * sizeof(*t));
+	intervals = gw_malloc(TIMERS * sizeof(*intervals));
+	start = date_monotonic_usec();
+	for (i = 0; i < TIMERS; i++) {
+		t[i] = gwtimer_create(output);
+		intervals[i] = gw_rand() % MAX_INTERVAL;
+		gwtimer_start_msec(t[i], intervals[i], timeout_event(i));
+	}
+	/* stop every other timer before it elapses */
+	for (i = 0; i < TIMERS; i += 2) {
+		if (intervals[i] > SLACK)
+			gwtimer_stop(t[i]);
+		else
+			intervals[i] = -1;
+	}
+
+	for (i = 1; i < TIMERS; i += 2) {
+		e = gwlist_consume(output);
+		elapsed = (date_monotonic_usec() - start) / 1000;
+		if (intervals[e->u.TimerTO_A.handle] < 0) {
+			/* elapsed before we could stop it */
+			wap_event_destroy(e);
+			i -= 2;
+			continue;
+		}
+		if (e->u.TimerTO_A.handle % 2 == 0)
+			panic(0, "stopped timer %ld elapsed", e->u.TimerTO_A.handle);
+		if (elapsed < intervals[e->u.TimerTO_A.handle] - TICK)
+			panic(0, "timer of %ld ms elapsed after %ld ms",
+			      intervals[e->u.TimerTO_A.handle], elapsed);
+		wap_event_destroy(e);
+	}
+	if (date_monotonic_usec() - start > (MAX_INTERVAL + SLACK) * 1000LL)
+		panic(0, "timers elapsed late");
+
+	for (i = 0; i < TIMERS; i++)
+		gwtimer_destroy(t[i]);
+	gw_free(t);
+	gw_free(intervals);
+}
+
+
+/* An idle wheel must not turn through the ticks it was idle for */
+static void check_after_idle(void) {
+	Timer *t;
+	long long start;
+	long ticks;
+
+	gwthread_sleep(IDLE / 1000.0);
+	ticks = timers_ticks_run();
+	t = gwtimer_create(output);
+	start = date_monotonic_usec();
+	gwtimer_start_msec(t, 50, timeout_event(1));
+	expect(1, start, 50);
+	ticks = timers_ticks_run() - ticks;
+	if (ticks > 50 + SLACK)
+		panic(0, "wheel turned %ld ticks for a timer of 50 ms", ticks);
+	gwtimer_destroy(t);
+}
+
+
+int main(void) {
+	gwlib_init();
+	log_set_output_level(GW_INFO);
+	timers_init();
+
+	output = gwlist_create();
+	check_order();
+	check_stop_and_restart();
+	check_many();
+	check_after_idle();
+	if (gwlist_len(output) != 0)
+		panic(0, "events left after all timers were consumed");
+
+	timers_shutdown();
+	gwlist_destroy(output, NULL);
+	gwlib_shutdown();
+	return 0;
+}
@@ -0,0 +1,127 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_tokenbucket.c - Check that token bucket rate limiting works
+ *
+ * Drains a bucket, checks the refill time and lets some threads consume
+ * tokens concurrently for a while, checking that the rate is obeyed.
+ */
+
+#ifndef THREADS
+#define THREADS 4
+#endif
+
+#define RATE 200.0
+#define BURST 10
+#define SECONDS 0.5
+
+#include "gwlib/gwlib.h"
+
+static gw_tokenbucket_t *bucket;
+static Counter *taken;
+static volatile int done;
+
+static void consumer(void *arg) {
+	while (!done) {
+		if (gw_tokenbucket_consume(bucket, 1))
+			counter_increase(taken);
+	}
+}
+
+
+int main(void) {
+	long threads[THREADS];
+	long i, n;
+	double wait, max;
+	
+	gwlib_init();
+	log_set_output_level(GW_INFO);
+
+	bucket = gw_tokenbucket_create(RATE, BURST);
+	for (i = 0; i < BURST; ++i)
+		if (!gw_tokenbucket_take(bucket, 1))
+			panic(0, "full bucket refused token %ld", i);
+	if (gw_tokenbucket_take(bucket, 1))
+		panic(0, "empty bucket gave token");
+	wait = gw_tokenbucket_wait_time(bucket, 1);
+	if (wait <= 0 || wait > 1.0 / RATE)
+		panic(0, "wrong wait time %f for empty bucket", wait);
+	gwthread_sleep_micro(wait);
+	if (gw_tokenbucket_wait_time(bucket, 1) > 0.1 / RATE)
+		panic(0, "bucket not refilled after waiting");
+
+	taken = counter_create();
+	for (i = 0; i < THREADS; ++i)
+		threads[i] = gwthread_create(consumer, NULL);
+	gwthread_sleep(SECONDS);
+	done = 1;
+	for (i = 0; i < THREADS; ++i)
+		gwthread_join(threads[i]);
+
+	/* allow one burst plus some scheduling slack */
+	n = counter_value(taken);
+	max = RATE * SECONDS * 1.2 + BURST;
+	if (n > max)
+		panic(0, "rate exceeded: %ld tokens taken in %.1f sec", n, SECONDS);
+	if (n < RATE * SECONDS / 2)
+		panic(0, "rate too low: %ld tokens taken in %.1f sec", n, SECONDS);
+
+	counter_destroy(taken);
+	gw_tokenbucket_destroy(bucket);
+	gwlib_shutdown();
+	return 0;
+}
@@ -0,0 +1,167 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * check_uuidmap.c - Check the uuid map
+ *
+ * Puts and removes random and time based uuids in a uuid map and in a
+ * Dict keyed by the uuids as text side by side, and checks that both
+ * give the same items.
+ */
+
+#include <stdlib.h>
+
+#include "gwlib/gwlib.h"
+
+#define NUM_KEYS 2000
+
+static uuid_t keys[NUM_KEYS];
+static long items[NUM_KEYS];
+
+
+static Octstr *key_text(const uuid_t key)
+{
+    char id[UUID_STR_LEN + 1];
+
+    uuid_unparse(key, id);
+    return octstr_create(id);
+}
+
+
+static void check_same(gw_uuidmap_t *map, Dict *dict)
+{
+    Octstr *os;
+    void *item, *expected;
+    long i;
+
+    if (gw_uuidmap_len(map) != dict_key_count(dict))
+        panic(0, "map has %ld items, dict %ld", gw_uuidmap_len(map),
+              dict_key_count(dict));
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        os = key_text(keys[i]);
+        item = gw_uuidmap_get(map, keys[i]);
+        expected = dict_get(dict, os);
+        if (item != expected)
+            panic(0, "item of %s is %p, not %p", octstr_get_cstr(os),
+                  item, expected);
+        octstr_destroy(os);
+    }
+}
+
+
+int main(void)
+{
+    gw_uuidmap_t *map;
+    Dict *dict;
+    List *left;
+    Octstr *os;
+    void *item, *expected;
+    long i, n;
+
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    srandom(1);
+    for (i = 0; i < NUM_KEYS; i++) {
+        if (i % 2)
+            uuid_generate_random(keys[i]);
+        else
+            uuid_generate_time(keys[i]);
+    }
+
+    map = gw_uuidmap_create(0);
+    dict = dict_create(NUM_KEYS, NULL);
+    for (i = 0; i < 50000; i++) {
+        /* a few keys first, runs wrap around the end of a small table */
+        n = random() % (i < 10000 ? 12 : NUM_KEYS);
+        os = key_text(keys[n]);
+        if (random() % 3 == 0) {
+            item = gw_uuidmap_remove(map, keys[n]);
+            expected = dict_remove(dict, os);
+        } else {
+            item = gw_uuidmap_put(map, keys[n], &items[n]);
+            expected = dict_get(dict, os);
+            dict_put(dict, os, &items[n]);
+        }
+        if (item != expected)
+            panic(0, "%s gave %p, not %p", octstr_get_cstr(os), item, expected);
+        octstr_destroy(os);
+        if (i % 1000 == 0)
+            check_same(map, dict);
+    }
+    check_same(map, dict);
+
+    /* what is left comes out once each */
+    n = gw_uuidmap_len(map);
+    left = gw_uuidmap_remove_all(map);
+    if (gwlist_len(left) != n || gw_uuidmap_len(map) != 0)
+        panic(0, "removed %ld items of %ld", gwlist_len(left), n);
+    while ((item = gwlist_extract_first(left)) != NULL) {
+        n = (long *) item - items;
+        os = key_text(keys[n]);
+        if (dict_remove(dict, os) != item)
+            panic(0, "item of %s removed twice", octstr_get_cstr(os));
+        octstr_destroy(os);
+    }
+    gwlist_destroy(left, NULL);
+    check_same(map, dict);
+
+    gw_uuidmap_destroy(map);
+    dict_destroy(dict);
+    gwlib_shutdown();
+    return 0;
+}
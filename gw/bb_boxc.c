@@ -103,7 +103,11 @@ extern long max_incoming_sms_qlength;
 static volatile sig_atomic_t smsbox_running;
 static volatile sig_atomic_t wapbox_running;
 static List	*wapbox_list;
+/* wapboxes by their id, for routing WDP */
+static Dict	*wapbox_by_id;
 static List	*smsbox_list;
+static gw_metric_t *smsbox_metric;
+static gw_metric_t *wapbox_metric;
 static RWLock   *smsbox_list_rwlock;
 
 /* dictionaries for holding the smsbox routing information */
@@ -123,6 +127,8 @@ static long smsbox_max_pending;
 
 static Octstr *box_allow_ip;
 static Octstr *box_deny_ip;
+/* boxes on this host may offer shared memory rings in this directory */
+static Octstr *box_shm_dir;
 
 
 static Counter *boxid;
@@ -147,12 +153,19 @@ typedef struct _boxc {
     Octstr        *boxc_id; /* identifies the connected smsbox instance */
     /* used to mark connection usable or still waiting for ident. msg */
     volatile int routable;
+    /* shared memory ring, used for sending once set, see boxc_attach_ring */
+    gw_shmring_t *ring;
+    /* the box sends through the ring, too */
+    volatile int ring_reading;
+    /* keeps senders off TCP while switching to the ring */
+    Mutex *send_lock;
 } Boxc;
 
 
 /* forward declaration */
 static void sms_to_smsboxes(void *arg);
 static int send_msg(Boxc *boxconn, Msg *pmsg);
+static void boxc_attach_ring(Boxc *boxc, Octstr *path);
 static void boxc_sent_push(Boxc*, Msg*);
 static void boxc_sent_pop(Boxc*, Msg*, Msg**);
 static void boxc_gwlist_destroy(List *list);
@@ -169,7 +182,17 @@ static Msg *read_from_box(Boxc *boxconn)
     Msg *msg;
 
     pack = NULL;
-    while (bb_status != BB_DEAD && boxconn->alive) {
+    while (boxconn->ring_reading && bb_status != BB_DEAD && boxconn->alive) {
+        ret = gw_shmring_read(boxconn->ring, &pack, 1.0);
+        if (ret == 0)
+            break;
+        if (ret == -1) {
+            info(0, "Connection closed by the box <%s>",
+                 octstr_get_cstr(boxconn->client_ip));
+            return NULL;
+        }
+    }
+    while (!boxconn->ring_reading && bb_status != BB_DEAD && boxconn->alive) {
             /* XXX: if box doesn't send (just keep conn open) we block here while shutdown */
 	    pack = conn_read_withlen(boxconn->conn);
 	    gw_claim_area(pack);
@@ -416,6 +439,14 @@ static void boxc_receiver(void *arg)
                 /* wakeup the dequeue thread */
                 gwthread_wakeup(sms_dequeue_thread);
             }
+            else if (msg_type(msg) == admin && msg->admin.command == cmd_shm_offer)
+                boxc_attach_ring(conn, msg->admin.boxc_id);
+            else if (msg_type(msg) == admin && 
+                     msg->admin.command == cmd_shm_accept && conn->ring != NULL) {
+                conn->ring_reading = 1;
+                info(0, "Box <%s> connected through shared memory ring.",
+                     octstr_get_cstr(conn->client_ip));
+            }
             else
                 warning(0, "boxc_receiver: unknown msg received from <%s>, "
                            "ignored", octstr_get_cstr(conn->client_ip));
@@ -432,6 +463,7 @@ static void boxc_receiver(void *arg)
 static int send_msg(Boxc *boxconn, Msg *pmsg)
 {
     Octstr *pack;
+    int ret;
 
     pack = msg_pack(pmsg);
 
@@ -445,7 +477,14 @@ static int send_msg(Boxc *boxconn, Msg *pmsg)
         debug("bb.boxc", 0, "send_msg: sending msg to box: <%s>",
           octstr_get_cstr(boxconn->client_ip));
 
-    if (conn_write_withlen(boxconn->conn, pack) == -1) {
+    mutex_lock(boxconn->send_lock);
+    if (boxconn->ring != NULL)
+        ret = gw_shmring_write(boxconn->ring, pack);
+    else
+        ret = conn_write_withlen(boxconn->conn, pack);
+    mutex_unlock(boxconn->send_lock);
+
+    if (ret == -1) {
     	error(0, "Couldn't write Msg to box <%s>, disconnecting",
 	      octstr_get_cstr(boxconn->client_ip));
         octstr_destroy(pack);
@@ -457,6 +496,50 @@ static int send_msg(Boxc *boxconn, Msg *pmsg)
 }
 
 
+/*
+ * The box offers a shared memory ring for the connection. Take it if
+ * rings are allowed in its directory and we can attach to it, which
+ * means the box runs on this host. Everything we send after the accept
+ * goes through the ring; the box tells when it switches in turn.
+ */
+static void boxc_attach_ring(Boxc *boxc, Octstr *path)
+{
+    gw_shmring_t *ring;
+    Octstr *prefix, *pack;
+    Msg *msg;
+
+    ring = NULL;
+    if (box_shm_dir != NULL && boxc->ring == NULL && path != NULL) {
+        prefix = octstr_format("%S/", box_shm_dir);
+        if (octstr_ncompare(path, prefix, octstr_len(prefix)) == 0 &&
+            octstr_search(path, octstr_imm("/.."), 0) == -1)
+            ring = gw_shmring_attach(path);
+        octstr_destroy(prefix);
+    }
+
+    msg = msg_create(admin);
+    if (ring == NULL) {
+        info(0, "Shared memory ring of box <%s> refused, using TCP.",
+             octstr_get_cstr(boxc->client_ip));
+        msg->admin.command = cmd_shm_reject;
+        send_msg(boxc, msg);
+        msg_destroy(msg);
+        return;
+    }
+
+    msg->admin.command = cmd_shm_accept;
+    pack = msg_pack(msg);
+    mutex_lock(boxc->send_lock);
+    if (conn_write_withlen(boxc->conn, pack) == -1)
+        gw_shmring_destroy(ring);
+    else
+        boxc->ring = ring;
+    mutex_unlock(boxc->send_lock);
+    octstr_destroy(pack);
+    msg_destroy(msg);
+}
+
+
 static void boxc_sent_push(Boxc *conn, Msg *m)
 {
     Octstr *os;
@@ -575,6 +658,9 @@ static Boxc *boxc_create(int fd, Octstr *ip, int ssl)
     boxc->connect_time = time(NULL);
     boxc->boxc_id = NULL;
     boxc->routable = 0;
+    boxc->ring = NULL;
+    boxc->ring_reading = 0;
+    boxc->send_lock = mutex_create();
     return boxc;
 }
 
@@ -587,6 +673,8 @@ static void boxc_destroy(Boxc *boxc)
 
     if (boxc->conn)
 	    conn_destroy(boxc->conn);
+    gw_shmring_destroy(boxc->ring);
+    mutex_destroy(boxc->send_lock);
     octstr_destroy(boxc->client_ip);
     octstr_destroy(boxc->boxc_id);
     gw_free(boxc);
@@ -739,6 +827,7 @@ static void run_wapbox(void *arg)
     Boxc *newconn;
     List *newlist;
     long sender;
+    Octstr *key;
 
     gwlist_add_producer(flow_threads);
     newconn = arg;
@@ -766,7 +855,9 @@ static void run_wapbox(void *arg)
 	          octstr_get_cstr(newconn->client_ip));
 	    goto cleanup;
     }
+    key = octstr_format("%ld", newconn->id);
     gwlist_append(wapbox_list, newconn);
+    dict_put(wapbox_by_id, key, newconn);
     gwlist_add_producer(newconn->outgoing);
     boxc_receiver(newconn);
 
@@ -775,7 +866,9 @@ static void run_wapbox(void *arg)
     gwlist_remove_producer(newconn->outgoing);
     gwlist_lock(wapbox_list);
     gwlist_delete_equal(wapbox_list, newconn);
+    dict_remove(wapbox_by_id, key);
     gwlist_unlock(wapbox_list);
+    octstr_destroy(key);
 
     while (gwlist_producer_count(newlist) > 0)
 	    gwlist_remove_producer(newlist);
@@ -797,53 +890,76 @@ cleanup:
  * main single thread functions
  */
 
+/*
+ * Routing info of a WDP client, keyed by its address and port in the
+ * route_info cache. A client keeps going to the same wapbox until it has
+ * been idle for ROUTE_IDLE_TIME, so that its WTP and WSP state is found.
+ * At most ROUTE_MAX_CLIENTS are remembered, the least recently used
+ * ones are forgotten first.
+ */
+#define ROUTE_IDLE_TIME (60 * 60)
+#define ROUTE_MAX_CLIENTS (256 * 1024)
+
 typedef struct _addrpar {
-    Octstr *address;
-    int	port;
-    int wapboxid;
+    long wapboxid;
+    time_t expires;
 } AddrPar;
 
-static void ap_destroy(AddrPar *addr)
+static void *ap_duplicate(void *ap)
 {
-    octstr_destroy(addr->address);
-    gw_free(addr);
+    AddrPar *copy;
+
+    copy = gw_malloc(sizeof(AddrPar));
+    *copy = *(AddrPar *) ap;
+    return copy;
 }
 
-static int cmp_route(void *ap, void *ms)
+static void ap_destroy(void *ap)
 {
-    AddrPar *addr = ap;
-    Msg *msg = ms;
-
-    if (msg->wdp_datagram.source_port == addr->port  &&
-	    octstr_compare(msg->wdp_datagram.source_address, addr->address)==0)
-	return 1;
-
-    return 0;
+    gw_free(ap);
 }
 
-static int cmp_boxc(void *bc, void *ap)
+static void route_put(gw_lru_t *route_info, Octstr *key, long wapboxid)
 {
-    Boxc *boxc = bc;
-    AddrPar *addr = ap;
+    AddrPar *ap;
 
-    if (boxc->id == addr->wapboxid) return 1;
-        return 0;
+    ap = gw_malloc(sizeof(AddrPar));
+    ap->wapboxid = wapboxid;
+    ap->expires = time(NULL) + ROUTE_IDLE_TIME;
+    gw_lru_put(route_info, key, ap, 1, ap->expires);
 }
 
-static Boxc *route_msg(List *route_info, Msg *msg)
+static Boxc *route_msg(gw_lru_t *route_info, Msg *msg)
 {
     AddrPar *ap;
     Boxc *conn, *best;
+    Octstr *key, *id;
     int i, b, len;
 
-    ap = gwlist_search(route_info, msg, cmp_route);
-    if (ap == NULL) {
+    key = octstr_format("%S:%ld", msg->wdp_datagram.source_address,
+                        msg->wdp_datagram.source_port);
+    conn = NULL;
+    ap = gw_lru_get(route_info, key);
+    if (ap != NULL) {
+        id = octstr_format("%ld", ap->wapboxid);
+        conn = dict_get(wapbox_by_id, id);
+        octstr_destroy(id);
+        /* wapbox may have disappeared, then just re-route */
+        if (conn == NULL)
+            debug("bb.boxc", 0, "Old wapbox has disappeared, re-routing");
+        /* renew the entry only once in a while, not for every datagram */
+        else if (ap->expires - time(NULL) < ROUTE_IDLE_TIME / 2)
+            route_put(route_info, key, conn->id);
+        ap_destroy(ap);
+    } else
 	    debug("bb.boxc", 0, "Did not find previous routing info for WDP, "
 	    	  "generating new");
-route:
 
-	    if (gwlist_len(wapbox_list) == 0)
+    if (conn == NULL) {
+	    if (gwlist_len(wapbox_list) == 0) {
+	        octstr_destroy(key);
 	        return NULL;
+	    }
 
 	    gwlist_lock(wapbox_list);
 
@@ -864,31 +980,17 @@ route:
 	    if (best == NULL) {
 	        warning(0, "wapbox_list empty!");
 	        gwlist_unlock(wapbox_list);
+	        octstr_destroy(key);
 	        return NULL;
 	    }
 	    conn = best;
 	    conn->load++;	/* simulate new client until we get new values */
 
-	    ap = gw_malloc(sizeof(AddrPar));
-	    ap->address = octstr_duplicate(msg->wdp_datagram.source_address);
-	    ap->port = msg->wdp_datagram.source_port;
-	    ap->wapboxid = conn->id;
-	    gwlist_produce(route_info, ap);
+	    route_put(route_info, key, conn->id);
 
 	    gwlist_unlock(wapbox_list);
-    } else
-	    conn = gwlist_search(wapbox_list, ap, cmp_boxc);
-
-    if (conn == NULL) {
-	/* routing failed; wapbox has disappeared!
-	 * ..remove routing info and re-route   */
-
-	    debug("bb.boxc", 0, "Old wapbox has disappeared, re-routing");
-
-	    gwlist_delete_equal(route_info, ap);
-	    ap_destroy(ap);
-	    goto route;
     }
+    octstr_destroy(key);
     return conn;
 }
 
@@ -899,8 +1001,7 @@ route:
  */
 static void wdp_to_wapboxes(void *arg)
 {
-    List *route_info;
-    AddrPar *ap;
+    gw_lru_t *route_info;
     Boxc *conn;
     Msg *msg;
     int i;
@@ -908,7 +1009,7 @@ static void wdp_to_wapboxes(void *arg)
     gwlist_add_producer(flow_threads);
     gwlist_add_producer(wapbox_list);
 
-    route_info = gwlist_create();
+    route_info = gw_lru_create(ROUTE_MAX_CLIENTS, ap_duplicate, ap_destroy);
 
 
     while(bb_status != BB_DEAD) {
@@ -929,11 +1030,7 @@ static void wdp_to_wapboxes(void *arg)
 	    gwlist_produce(conn->incoming, msg);
     }
     debug("bb", 0, "wdp_to_wapboxes: destroying lists");
-    while((ap = gwlist_extract_first(route_info)) != NULL)
-	ap_destroy(ap);
-
-    gw_assert(gwlist_len(route_info) == 0);
-    gwlist_destroy(route_info, NULL);
+    gw_lru_destroy(route_info);
 
     gwlist_lock(wapbox_list);
     for(i=0; i < gwlist_len(wapbox_list); i++) {
@@ -1029,6 +1126,8 @@ static void smsboxc_run(void *arg)
     gwthread_wakeup(sms_dequeue_thread);
     gwthread_join(sms_dequeue_thread);
 
+    gw_metrics_unregister(smsbox_metric);
+    smsbox_metric = NULL;
     gwlist_destroy(smsbox_list, NULL);
     smsbox_list = NULL;
     gw_rwlock_destroy(smsbox_list_rwlock);
@@ -1083,8 +1182,12 @@ static void wapboxc_run(void *arg)
     /* close listen socket */
     close(fd);
 
+    gw_metrics_unregister(wapbox_metric);
+    wapbox_metric = NULL;
     gwlist_destroy(wapbox_list, NULL);
     wapbox_list = NULL;
+    dict_destroy(wapbox_by_id);
+    wapbox_by_id = NULL;
 
     gwlist_remove_producer(flow_threads);
 }
@@ -1195,6 +1298,26 @@ static void init_smsbox_routes(Cfg *cfg)
 }
 
 
+static double box_connections(void *arg)
+{
+    return gwlist_len(arg);
+}
+
+
+static gw_metric_t *box_connections_metric(const char *type, List *list)
+{
+    gw_metric_t *metric;
+    Octstr *label;
+
+    label = gw_metrics_label("type", octstr_imm(type));
+    metric = gw_metrics_callback("kannel_box_connections", "Connected boxes.",
+                                 GW_METRIC_GAUGE, label, box_connections, list);
+    octstr_destroy(label);
+
+    return metric;
+}
+
+
 /*-------------------------------------------------------------
  * public functions
  *
@@ -1236,9 +1359,12 @@ int smsbox_start(Cfg *cfg)
         box_deny_ip = octstr_create("");
     if (box_allow_ip != NULL && box_deny_ip == NULL)
         info(0, "Box connection allowed IPs defined without any denied...");
+    if (box_shm_dir == NULL)
+        box_shm_dir = cfg_get(grp, octstr_imm("box-shm-directory"));
 
     smsbox_list = gwlist_create();	/* have a list of connections */
     smsbox_list_rwlock = gw_rwlock_create();
+    smsbox_metric = box_connections_metric("smsbox", smsbox_list);
     if (!boxid)
         boxid = counter_create();
 
@@ -1305,8 +1431,12 @@ int wapbox_start(Cfg *cfg)
     	box_deny_ip = octstr_create("");
     if (box_allow_ip != NULL && box_deny_ip == NULL)
 	    info(0, "Box connection allowed IPs defined without any denied...");
+    if (box_shm_dir == NULL)
+        box_shm_dir = cfg_get(grp, octstr_imm("box-shm-directory"));
 
     wapbox_list = gwlist_create();	/* have a list of connections */
+    wapbox_by_id = dict_create(10, NULL);
+    wapbox_metric = box_connections_metric("wapbox", wapbox_list);
     gwlist_add_producer(outgoing_wdp);
     if (!boxid)
         boxid = counter_create();
@@ -1469,6 +1599,8 @@ void boxc_cleanup(void)
     octstr_destroy(box_deny_ip);
     box_allow_ip = NULL;
     box_deny_ip = NULL;
+    octstr_destroy(box_shm_dir);
+    box_shm_dir = NULL;
     counter_destroy(boxid);
     boxid = NULL;
     octstr_destroy(smsbox_interface);
@@ -151,6 +151,13 @@ static Octstr *httpd_store_status(List *cgivars, int status_type)
     return store_status(status_type);
 }
 
+static Octstr *httpd_metrics(List *cgivars, int status_type)
+{
+    Octstr *reply;
+    if ((reply = httpd_check_authorization(cgivars, 1))!= NULL) return reply;
+    return gw_metrics_snapshot();
+}
+
 static Octstr *httpd_loglevel(List *cgivars, int status_type)
 {
     Octstr *reply;
@@ -336,22 +343,24 @@ static Octstr *httpd_reload_lists(List *cgivars, int status_type)
 static struct httpd_command {
     const char *command;
     Octstr * (*function)(List *cgivars, int status_type);
+    int plain; /* reply is plain text whatever format was requested */
 } httpd_commands[] = {
-    { "status", httpd_status },
-    { "store-status", httpd_store_status },
-    { "log-level", httpd_loglevel },
-    { "shutdown", httpd_shutdown },
-    { "suspend", httpd_suspend },
-    { "isolate", httpd_isolate },
-    { "resume", httpd_resume },
-    { "restart", httpd_restart },
-    { "flush-dlr", httpd_flush_dlr },
-    { "stop-smsc", httpd_stop_smsc },
-    { "start-smsc", httpd_restart_smsc },
-    { "add-smsc", httpd_add_smsc },
-    { "remove-smsc", httpd_remove_smsc },
-    { "reload-lists", httpd_reload_lists },
-    { NULL , NULL } /* terminate list */
+    { "status", httpd_status, 0 },
+    { "store-status", httpd_store_status, 0 },
+    { "metrics", httpd_metrics, 1 },
+    { "log-level", httpd_loglevel, 0 },
+    { "shutdown", httpd_shutdown, 0 },
+    { "suspend", httpd_suspend, 0 },
+    { "isolate", httpd_isolate, 0 },
+    { "resume", httpd_resume, 0 },
+    { "restart", httpd_restart, 0 },
+    { "flush-dlr", httpd_flush_dlr, 0 },
+    { "stop-smsc", httpd_stop_smsc, 0 },
+    { "start-smsc", httpd_restart_smsc, 0 },
+    { "add-smsc", httpd_add_smsc, 0 },
+    { "remove-smsc", httpd_remove_smsc, 0 },
+    { "reload-lists", httpd_reload_lists, 0 },
+    { NULL , NULL, 0 } /* terminate list */
 };
 
 static void httpd_serve(HTTPClient *client, Octstr *ourl, List *headers,
@@ -412,6 +421,8 @@ static void httpd_serve(HTTPClient *client, Octstr *ourl, List *headers,
 
     for (i=0; httpd_commands[i].command != NULL; i++) {
         if (octstr_str_compare(url, httpd_commands[i].command) == 0) {
+            if (httpd_commands[i].plain)
+                status_type = BBSTATUS_TEXT;
             reply = httpd_commands[i].function(cgivars, status_type);
             break;
         }
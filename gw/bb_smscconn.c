@@ -78,6 +78,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <limits.h>
 
 
 #include "gwlib/gwlib.h"
@@ -268,8 +269,19 @@ static void handle_split(SMSCConn *conn, Msg *msg, long reason)
 }
 
 
+void bb_smscconn_submitted(SMSCConn *conn, Msg *sms)
+{
+    sms->stamp.submitted = date_monotonic_usec();
+    if (conn != NULL && sms->stamp.queued > 0)
+        gw_histogram_record(conn->queue_latency, sms->stamp.submitted - sms->stamp.queued);
+}
+
+
 void bb_smscconn_sent(SMSCConn *conn, Msg *sms, Octstr *reply)
 {
+    if (conn != NULL && sms->stamp.submitted > 0)
+        gw_histogram_record(conn->submit_latency, date_monotonic_usec() - sms->stamp.submitted);
+
     if (sms->sms.split_parts != NULL) {
         handle_split(conn, sms, SMSCCONN_SUCCESS);
         octstr_destroy(reply);
@@ -405,6 +417,11 @@ long bb_smscconn_receive(SMSCConn *conn, Msg *sms)
    if (sms->sms.msgdata == NULL)
        sms->sms.msgdata = octstr_create("");
 
+    /* final DLR found in DLR storage, knowing when the SMSC acked */
+    if (conn != NULL && sms->sms.sms_type == report_mo && sms->stamp.acked > 0 &&
+        (sms->sms.dlr_mask & (DLR_SUCCESS | DLR_FAIL)))
+        gw_histogram_record(conn->dlr_latency, date_monotonic_usec() - sms->stamp.acked);
+
    /*
     * First normalize in smsc level and then on global level.
     * In outbound direction it's vise versa, hence first global then smsc.
@@ -1113,6 +1130,65 @@ void smsc2_cleanup(void)
 }
 
 
+/*
+ * Latency histograms. Text, HTML and XML status show some percentiles in
+ * milliseconds, the full histograms are exported with the metrics.
+ */
+static const char *latency_names[] = { "queue", "submit", "dlr" };
+
+
+static gw_histogram_t *latency_histogram(SMSCConn *conn, int i)
+{
+    switch (i) {
+        case 0: return conn->queue_latency;
+        case 1: return conn->submit_latency;
+        default: return conn->dlr_latency;
+    }
+}
+
+
+static void append_latency_status(Octstr *out, SMSCConn *conn, int status_type, char *lb)
+{
+    gw_histogram_t *hist;
+    unsigned long total = 0;
+    int i;
+
+    if (status_type == BBSTATUS_XML) {
+        octstr_append_cstr(out, "\t\t<latency>\n");
+        for (i = 0; i < 3; i++) {
+            hist = latency_histogram(conn, i);
+            octstr_format_append(out, "\t\t\t<%s><count>%lu</count><p50>%.3f</p50>"
+                "<p90>%.3f</p90><p99>%.3f</p99><max>%.3f</max></%s>\n",
+                latency_names[i], gw_histogram_count(hist),
+                gw_histogram_percentile(hist, 50) / 1000.0,
+                gw_histogram_percentile(hist, 90) / 1000.0,
+                gw_histogram_percentile(hist, 99) / 1000.0,
+                gw_histogram_max(hist) / 1000.0, latency_names[i]);
+        }
+        octstr_append_cstr(out, "\t\t</latency>\n");
+        return;
+    }
+
+    for (i = 0; i < 3; i++)
+        total += gw_histogram_count(latency_histogram(conn, i));
+    if (total == 0)
+        return;
+
+    octstr_append_cstr(out, status_type == BBSTATUS_HTML ?
+        "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;" : "        ");
+    octstr_append_cstr(out, "latency ms p50/p99/max:");
+    for (i = 0; i < 3; i++) {
+        hist = latency_histogram(conn, i);
+        octstr_format_append(out, "%s %s %.3f/%.3f/%.3f (%lu)", i ? "," : "",
+            latency_names[i],
+            gw_histogram_percentile(hist, 50) / 1000.0,
+            gw_histogram_percentile(hist, 99) / 1000.0,
+            gw_histogram_max(hist) / 1000.0, gw_histogram_count(hist));
+    }
+    octstr_append_cstr(out, lb);
+}
+
+
 Octstr *smsc2_status(int status_type)
 {
     Octstr *tmp;
@@ -1242,8 +1318,7 @@ Octstr *smsc2_status(int status_type)
                 "\t\t\t<sent>%ld</sent>\n"
                 "\t\t\t<inbound>%.2f,%.2f,%.2f</inbound>\n"
                 "\t\t\t<outbound>%.2f,%.2f,%.2f</outbound>\n"
-                "\t\t</dlr>\n"
-                "\t</smsc>\n", tmp3,
+                "\t\t</dlr>\n", tmp3,
                 info.failed, info.queued, info.received, info.sent,
                 incoming_sms_load_0, incoming_sms_load_1, incoming_sms_load_2,
                 outgoing_sms_load_0, outgoing_sms_load_1, outgoing_sms_load_2,
@@ -1266,6 +1341,10 @@ Octstr *smsc2_status(int status_type)
                 info.failed,
                 info.queued,
                 lb);
+
+        append_latency_status(tmp, conn, status_type, lb);
+        if (status_type == BBSTATUS_XML)
+            octstr_append_cstr(tmp, "\t</smsc>\n");
     }
 
 
@@ -87,6 +87,14 @@ void bb_smscconn_connected(SMSCConn *conn);
 void bb_smscconn_killed(void);
 
 
+/*
+ * Called when Msg 'sms' was written to the SMS center and the
+ * implementation starts waiting for the ack. Only records latency
+ * statistics, 'sms' stays with the caller.
+ */
+void bb_smscconn_submitted(SMSCConn *conn, Msg *sms);
+
+
 /*
  * Called after successful sending of Msg 'sms'. Generate dlr message if
  * DLR_SMSC_SUCCESS mask is set. 'reply' will be passed as msgdata to
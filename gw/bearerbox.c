@@ -146,6 +146,7 @@ static volatile sig_atomic_t bb_todo = 0;
 static Mutex *status_mutex;
 static time_t start_time;
 volatile sig_atomic_t restart = 0;
+static List *core_metrics = NULL;
 
 
 /* to avoid copied code */
@@ -162,6 +163,89 @@ static void set_shutdown_status(void)
 }
 
 
+/*-------------------------------------------------------
+ * metrics
+ */
+
+static double metric_counter(void *arg)
+{
+    return counter_value(arg);
+}
+
+
+static double metric_queue(void *arg)
+{
+    return gwlist_len(arg);
+}
+
+
+static double metric_store(void *arg)
+{
+    long messages = store_messages();
+
+    return (messages > 0 ? messages : 0);
+}
+
+
+static void metrics_counter(const char *name, const char *help, Counter *counter)
+{
+    gwlist_append(core_metrics, gw_metrics_callback(name, help, GW_METRIC_COUNTER,
+                  NULL, metric_counter, counter));
+}
+
+
+static void metrics_queue(const char *queue, List *list)
+{
+    Octstr *label = gw_metrics_label("queue", octstr_imm(queue));
+
+    gwlist_append(core_metrics, gw_metrics_callback("kannel_sms_queue_length",
+                  "Messages waiting in the bearerbox SMS queues.", GW_METRIC_GAUGE,
+                  label, metric_queue, list));
+    octstr_destroy(label);
+}
+
+
+static void start_metrics(CfgGroup *grp)
+{
+    long interval;
+
+    core_metrics = gwlist_create();
+
+    metrics_counter("kannel_sms_received_total", "SMS messages received from SMSCs.",
+                    incoming_sms_counter);
+    metrics_counter("kannel_sms_sent_total", "SMS messages sent to SMSCs.",
+                    outgoing_sms_counter);
+    metrics_counter("kannel_dlr_received_total", "Delivery reports received from SMSCs.",
+                    incoming_dlr_counter);
+    metrics_counter("kannel_dlr_sent_total", "Delivery reports sent to boxes.",
+                    outgoing_dlr_counter);
+    metrics_counter("kannel_wdp_received_total", "WDP datagrams received.",
+                    incoming_wdp_counter);
+    metrics_counter("kannel_wdp_sent_total", "WDP datagrams sent.",
+                    outgoing_wdp_counter);
+    metrics_queue("incoming", incoming_sms);
+    metrics_queue("outgoing", outgoing_sms);
+    gwlist_append(core_metrics, gw_metrics_callback("kannel_store_messages",
+                  "Messages held in the message store.", GW_METRIC_GAUGE,
+                  NULL, metric_store, NULL));
+
+    if (cfg_get_integer(&interval, grp, octstr_imm("metrics-interval")) == -1)
+        interval = 5;
+    gw_metrics_start(interval);
+}
+
+
+static void stop_metrics(void)
+{
+    gw_metric_t *metric;
+
+    while ((metric = gwlist_extract_first(core_metrics)) != NULL)
+        gw_metrics_unregister(metric);
+    gwlist_destroy(core_metrics, NULL);
+    core_metrics = NULL;
+}
+
+
 /*-------------------------------------------------------
  * signals
  */
@@ -534,6 +618,8 @@ static Cfg *init_bearerbox(Cfg *cfg)
     load_add_interval(outgoing_dlr_load, 300);
     load_add_interval(outgoing_dlr_load, -1);
 
+    start_metrics(grp);
+
     setup_signal_handlers();
     
     /* http-admin is REQUIRED */
@@ -776,6 +862,7 @@ int main(int argc, char **argv)
     info(0, "All flow threads have died, killing core");
     bb_status = BB_DEAD;
     httpadmin_stop();
+    stop_metrics();
 
     boxc_cleanup();
     smsc2_cleanup();
@@ -95,6 +95,49 @@
 /* Our callback functions */
 static struct dlr_storage *handles = NULL;
 
+/* lookup counters exported through the metrics registry */
+static gw_metric_t *added_metric = NULL;
+static gw_metric_t *found_metric = NULL;
+static gw_metric_t *not_found_metric = NULL;
+
+/*
+ * Write-behind queue. If dlr-batch-delay is set, dlr_add() and the
+ * removals and updates of dlr_find() do not go to the storage at once
+ * but into a queue, which a thread hands over to the storage every
+ * dlr-batch-delay milliseconds, or earlier once dlr-batch-size operations
+ * are waiting. Runs of adds and of removes go to the storage as one
+ * statement each if the storage supports it. Until the storage has done
+ * an operation, dlr_find() answers from the queue, so that a DLR arriving
+ * right after its message was sent is still found, and found only once.
+ */
+enum { WB_ADD, WB_REMOVE, WB_UPDATE };
+
+/* at most this many rows go into one statement */
+#define WB_MAX_ROWS 100
+
+/* callers flush themselves if the queue grows beyond this many batches */
+#define WB_MAX_BATCHES 16
+
+typedef struct {
+    int type;
+    /* WB_ADD: the entry, otherwise smsc, timestamp and destination only */
+    struct dlr_entry *entry;
+    int status;             /* WB_UPDATE */
+    Octstr *key;            /* smsc and timestamp, see wb_key() */
+    int in_flight;          /* being handed over to the storage */
+    int removed;            /* WB_ADD in flight, removed in the meantime */
+} wb_op;
+
+static Mutex *wb_lock = NULL;   /* NULL if there is no write-behind */
+static Mutex *wb_flush_lock;
+static List *wb_queue;
+static Dict *wb_added;          /* WB_ADD ops by key, not done yet */
+static Dict *wb_removed;        /* WB_REMOVE ops by key, not done yet */
+static long wb_delay;
+static long wb_size;
+static volatile int wb_running;
+static long wb_thread;
+
 /*
  * Function to allocate a new struct dlr_entry entry
  * and intialize it to zero
@@ -131,6 +174,7 @@ struct dlr_entry *dlr_entry_duplicate(const struct dlr_entry *dlr)
     ret->url = octstr_duplicate(dlr->url);
     ret->boxc_id = octstr_duplicate(dlr->boxc_id);
     ret->mask = dlr->mask;
+    ret->acked = dlr->acked;
 
     return ret;
 }
@@ -222,6 +266,359 @@ void dlr_db_fields_destroy(struct dlr_db_fields *fields)
 }
 
 
+/*
+ * Functions of the write-behind queue.
+ */
+static Octstr *wb_key(const Octstr *smsc, const Octstr *ts)
+{
+    Octstr *key;
+
+    key = octstr_duplicate(smsc);
+    octstr_append_char(key, '\0');
+    octstr_append(key, ts);
+    return key;
+}
+
+static wb_op *wb_op_create(int type, struct dlr_entry *entry, int status)
+{
+    wb_op *op;
+
+    op = gw_malloc(sizeof(*op));
+    op->type = type;
+    op->entry = entry;
+    op->status = status;
+    op->key = wb_key(entry->smsc, entry->timestamp);
+    op->in_flight = 0;
+    op->removed = 0;
+    return op;
+}
+
+static void wb_op_destroy(wb_op *op)
+{
+    dlr_entry_destroy(op->entry);
+    octstr_destroy(op->key);
+    gw_free(op);
+}
+
+static void wb_index_destroy(void *ops)
+{
+    gwlist_destroy(ops, NULL);
+}
+
+static void wb_index_add(Dict *index, wb_op *op)
+{
+    List *ops;
+
+    if ((ops = dict_get(index, op->key)) == NULL) {
+        ops = gwlist_create();
+        dict_put(index, op->key, ops);
+    }
+    gwlist_append(ops, op);
+}
+
+static void wb_index_remove(Dict *index, wb_op *op)
+{
+    List *ops;
+
+    if ((ops = dict_get(index, op->key)) == NULL)
+        return;
+    gwlist_delete_equal(ops, op);
+    if (gwlist_len(ops) == 0)
+        wb_index_destroy(dict_remove(index, op->key));
+}
+
+/*
+ * Does destination match dst the way the storages match it, i.e. does
+ * it end with dst? A NULL on either side matches anything.
+ */
+static int wb_dst_match(const Octstr *destination, const Octstr *dst)
+{
+    long pos;
+
+    if (destination == NULL || dst == NULL)
+        return 1;
+    pos = octstr_len(destination) - octstr_len(dst);
+    return pos >= 0 && octstr_search(destination, dst, pos) != -1;
+}
+
+/*
+ * Find the WB_ADD op for smsc, ts and dst that is not removed yet.
+ * Caller must hold wb_lock.
+ */
+static wb_op *wb_find_added(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
+{
+    Octstr *key;
+    List *ops;
+    wb_op *op;
+    long i;
+
+    key = wb_key(smsc, ts);
+    ops = dict_get(wb_added, key);
+    octstr_destroy(key);
+    for (i = 0; i < gwlist_len(ops); i++) {
+        op = gwlist_get(ops, i);
+        if (!op->removed && wb_dst_match(op->entry->destination, dst))
+            return op;
+    }
+    return NULL;
+}
+
+/*
+ * Look up an entry in the queue. Return a copy of it if it is waiting to
+ * be added, otherwise NULL, with *removed set if it is waiting to be
+ * removed from the storage.
+ */
+static struct dlr_entry *wb_get(const Octstr *smsc, const Octstr *ts, 
+                                const Octstr *dst, int *removed)
+{
+    struct dlr_entry *ret;
+    Octstr *key;
+    List *ops;
+    wb_op *op;
+    long i;
+
+    ret = NULL;
+    *removed = 0;
+    mutex_lock(wb_lock);
+    if ((op = wb_find_added(smsc, ts, dst)) != NULL)
+        ret = dlr_entry_duplicate(op->entry);
+    else {
+        key = wb_key(smsc, ts);
+        ops = dict_get(wb_removed, key);
+        octstr_destroy(key);
+        for (i = 0; i < gwlist_len(ops) && !*removed; i++) {
+            op = gwlist_get(ops, i);
+            *removed = wb_dst_match(op->entry->destination, dst);
+        }
+    }
+    mutex_unlock(wb_lock);
+
+    return ret;
+}
+
+static void wb_flush(void);
+
+/*
+ * Drop a queued WB_ADD op and the updates queued for it.
+ * Caller must hold wb_lock.
+ */
+static void wb_cancel(wb_op *add)
+{
+    wb_op *op;
+    long i;
+
+    for (i = gwlist_len(wb_queue) - 1; i >= 0; i--) {
+        op = gwlist_get(wb_queue, i);
+        if (op == add || (op->type == WB_UPDATE && 
+                          octstr_compare(op->key, add->key) == 0 &&
+                          wb_dst_match(add->entry->destination, op->entry->destination))) {
+            gwlist_delete(wb_queue, i, 1);
+            if (op != add)
+                wb_op_destroy(op);
+        }
+    }
+    wb_index_remove(wb_added, add);
+    wb_op_destroy(add);
+}
+
+static void wb_put(wb_op *op)
+{
+    long len;
+
+    if (op->type == WB_ADD)
+        wb_index_add(wb_added, op);
+    else if (op->type == WB_REMOVE)
+        wb_index_add(wb_removed, op);
+    gwlist_append(wb_queue, op);
+    len = gwlist_len(wb_queue);
+    mutex_unlock(wb_lock);
+
+    if (len >= wb_size * WB_MAX_BATCHES)
+        wb_flush();     /* the storage does not keep up, slow down */
+    else if (len >= wb_size)
+        gwthread_wakeup(wb_thread);
+}
+
+static void wb_add(struct dlr_entry *entry)
+{
+    mutex_lock(wb_lock);
+    wb_put(wb_op_create(WB_ADD, entry, 0));
+}
+
+static void wb_remove_or_update(int type, const Octstr *smsc, const Octstr *ts,
+                                const Octstr *dst, int status)
+{
+    struct dlr_entry *entry;
+    wb_op *op;
+
+    mutex_lock(wb_lock);
+    if (type == WB_REMOVE && (op = wb_find_added(smsc, ts, dst)) != NULL) {
+        if (!op->in_flight) {
+            /* the storage never needs to know */
+            wb_cancel(op);
+            mutex_unlock(wb_lock);
+            return;
+        }
+        op->removed = 1;
+    }
+
+    entry = dlr_entry_create();
+    entry->smsc = octstr_duplicate(smsc);
+    entry->timestamp = octstr_duplicate(ts);
+    entry->destination = octstr_duplicate(dst);
+    wb_put(wb_op_create(type, entry, status));
+}
+
+/*
+ * Hand a run of adds or removes over to the storage, in one go if it
+ * can take them.
+ */
+static void wb_store(int type, List *entries)
+{
+    struct dlr_entry *entry;
+    List *copies;
+    long i;
+
+    if (type == WB_ADD && handles->dlr_add_batch != NULL && gwlist_len(entries) > 1) {
+        copies = gwlist_create();
+        for (i = 0; i < gwlist_len(entries); i++)
+            gwlist_append(copies, dlr_entry_duplicate(gwlist_get(entries, i)));
+        handles->dlr_add_batch(copies);
+        gwlist_destroy(copies, NULL);
+    } else if (type == WB_REMOVE && handles->dlr_remove_batch != NULL && 
+               gwlist_len(entries) > 1) {
+        handles->dlr_remove_batch(entries);
+    } else {
+        for (i = 0; i < gwlist_len(entries); i++) {
+            entry = gwlist_get(entries, i);
+            if (type == WB_ADD)
+                handles->dlr_add(dlr_entry_duplicate(entry));
+            else
+                handles->dlr_remove(entry->smsc, entry->timestamp, entry->destination);
+        }
+    }
+}
+
+/*
+ * Hand everything queued so far over to the storage. All adds go first,
+ * then updates, then removes, so that the adds can be batched. Operations
+ * on different entries do not mind their order, and a remove queued while
+ * the add of its entry was still queued has cancelled that add instead.
+ * Only a remove followed by a new add with the same smsc and timestamp
+ * would change, and storages cannot tell these entries apart anyway.
+ */
+static void wb_flush(void)
+{
+    static const int types[] = { WB_ADD, WB_UPDATE, WB_REMOVE };
+    List *ops, *entries;
+    wb_op *op;
+    long i, len;
+    int t;
+
+    mutex_lock(wb_flush_lock);
+
+    mutex_lock(wb_lock);
+    ops = wb_queue;
+    wb_queue = gwlist_create();
+    len = gwlist_len(ops);
+    for (i = 0; i < len; i++)
+        ((wb_op *) gwlist_get(ops, i))->in_flight = 1;
+    mutex_unlock(wb_lock);
+
+    entries = gwlist_create();
+    for (t = 0; t < 3; t++) {
+        for (i = 0; i < len; i++) {
+            op = gwlist_get(ops, i);
+            if (op->type != types[t])
+                continue;
+            if (op->type == WB_UPDATE) {
+                if (handles->dlr_update != NULL)
+                    handles->dlr_update(op->entry->smsc, op->entry->timestamp, 
+                                        op->entry->destination, op->status);
+                continue;
+            }
+            gwlist_append(entries, op->entry);
+            if (gwlist_len(entries) == WB_MAX_ROWS) {
+                wb_store(types[t], entries);
+                gwlist_delete(entries, 0, WB_MAX_ROWS);
+            }
+        }
+        if (gwlist_len(entries) > 0) {
+            wb_store(types[t], entries);
+            gwlist_delete(entries, 0, gwlist_len(entries));
+        }
+    }
+    gwlist_destroy(entries, NULL);
+
+    mutex_lock(wb_lock);
+    for (i = 0; i < len; i++) {
+        op = gwlist_get(ops, i);
+        if (op->type == WB_ADD)
+            wb_index_remove(wb_added, op);
+        else if (op->type == WB_REMOVE)
+            wb_index_remove(wb_removed, op);
+    }
+    mutex_unlock(wb_lock);
+    gwlist_destroy(ops, (gwlist_item_destructor_t *) wb_op_destroy);
+
+    mutex_unlock(wb_flush_lock);
+}
+
+static void wb_run(void *arg)
+{
+    while (wb_running) {
+        gwthread_sleep(wb_delay / 1000.0);
+        wb_flush();
+    }
+}
+
+static void wb_start(void)
+{
+    wb_lock = mutex_create();
+    wb_flush_lock = mutex_create();
+    wb_queue = gwlist_create();
+    wb_added = dict_create(wb_size * 2, wb_index_destroy);
+    wb_removed = dict_create(wb_size * 2, wb_index_destroy);
+    wb_running = 1;
+    if ((wb_thread = gwthread_create(wb_run, NULL)) == -1)
+        panic(0, "DLR: cannot start write-behind thread");
+    info(0, "DLR: writing to storage every %ld ms or %ld operations.",
+         wb_delay, wb_size);
+}
+
+static void wb_stop(void)
+{
+    wb_running = 0;
+    gwthread_wakeup(wb_thread);
+    gwthread_join(wb_thread);
+    wb_flush();
+
+    gwlist_destroy(wb_queue, NULL);
+    dict_destroy(wb_added);
+    dict_destroy(wb_removed);
+    mutex_destroy(wb_flush_lock);
+    mutex_destroy(wb_lock);
+    wb_lock = NULL;
+}
+
+static long wb_messages(void)
+{
+    long i, n;
+    wb_op *op;
+
+    n = 0;
+    mutex_lock(wb_lock);
+    for (i = 0; i < gwlist_len(wb_queue); i++) {
+        op = gwlist_get(wb_queue, i);
+        if (op->type == WB_ADD)
+            n++;
+    }
+    mutex_unlock(wb_lock);
+
+    return n;
+}
+
+
 /*
  * Initialize specifically dlr storage. If defined storage is unknown
  * then panic.
@@ -262,6 +659,8 @@ void dlr_init(Cfg* cfg)
         handles = dlr_init_mssql(cfg);
     } else if (octstr_compare(dlr_type, octstr_imm("sqlite3")) == 0) {
         handles = dlr_init_sqlite3(cfg);
+    } else if (octstr_compare(dlr_type, octstr_imm("kv")) == 0) {
+        handles = dlr_init_kv(cfg);
     }
 
     /*
@@ -279,6 +678,21 @@ void dlr_init(Cfg* cfg)
     /* get info from storage */
     info(0, "DLR using storage type: %s", handles->type);
 
+    if (cfg_get_integer(&wb_delay, grp, octstr_imm("dlr-batch-delay")) == -1)
+        wb_delay = 0;
+    if (cfg_get_integer(&wb_size, grp, octstr_imm("dlr-batch-size")) == -1 || 
+        wb_size < 1)
+        wb_size = WB_MAX_ROWS;
+    if (wb_delay > 0)
+        wb_start();
+
+    added_metric = gw_metrics_counter("kannel_dlr_added_total",
+        "Entries added to the DLR storage.", NULL);
+    found_metric = gw_metrics_counter("kannel_dlr_found_total",
+        "Delivery reports matched to a DLR storage entry.", NULL);
+    not_found_metric = gw_metrics_counter("kannel_dlr_not_found_total",
+        "Delivery reports without a DLR storage entry.", NULL);
+
     /* cleanup */
     octstr_destroy(dlr_type);
 }
@@ -288,8 +702,16 @@ void dlr_init(Cfg* cfg)
  */
 void dlr_shutdown()
 {
+    if (wb_lock != NULL)
+        wb_stop();
+
     if (handles != NULL && handles->dlr_shutdown != NULL)
         handles->dlr_shutdown();
+
+    gw_metrics_unregister(added_metric);
+    gw_metrics_unregister(found_metric);
+    gw_metrics_unregister(not_found_metric);
+    added_metric = found_metric = not_found_metric = NULL;
 }
 
 /* 
@@ -297,8 +719,14 @@ void dlr_shutdown()
  */
 long dlr_messages(void)
 {
-    if (handles != NULL && handles->dlr_messages != NULL)
-        return handles->dlr_messages();
+    long msgs;
+
+    if (handles != NULL && handles->dlr_messages != NULL) {
+        msgs = handles->dlr_messages();
+        if (msgs != -1 && wb_lock != NULL)
+            msgs += wb_messages();
+        return msgs;
+    }
 
     return -1;
 }
@@ -359,13 +787,18 @@ void dlr_add(const Octstr *smsc, const Octstr *ts, Msg *msg)
     dlr->url = (msg->sms.dlr_url ? octstr_duplicate(msg->sms.dlr_url) : octstr_create(""));
     dlr->boxc_id = (msg->sms.boxc_id ? octstr_duplicate(msg->sms.boxc_id) : octstr_create(""));
     dlr->mask = msg->sms.dlr_mask;
+    dlr->acked = date_monotonic_usec();
 
     debug("dlr.dlr", 0, "DLR[%s]: Adding DLR smsc=%s, ts=%s, src=%s, dst=%s, mask=%d, boxc=%s",
           dlr_type(), octstr_get_cstr(dlr->smsc), octstr_get_cstr(dlr->timestamp),
           octstr_get_cstr(dlr->source), octstr_get_cstr(dlr->destination), dlr->mask, octstr_get_cstr(dlr->boxc_id));
 	
     /* call registered function */
-    handles->dlr_add(dlr);
+    if (wb_lock != NULL)
+        wb_add(dlr);
+    else
+        handles->dlr_add(dlr);
+    gw_metric_increase(added_metric);
 }
 
 /*
@@ -378,6 +811,7 @@ Msg *dlr_find(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int typ,
     Msg	*msg = NULL;
     struct dlr_entry *dlr = NULL;
     Octstr *dst_min = NULL;
+    int removed = 0;
     
     if(octstr_len(smsc) == 0) {
 	warning(0, "DLR[%s]: Can't find a dlr without smsc-id", dlr_type());
@@ -398,12 +832,17 @@ Msg *dlr_find(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int typ,
     debug("dlr.dlr", 0, "DLR[%s]: Looking for DLR smsc=%s, ts=%s, dst=%s, type=%d",
                                  dlr_type(), octstr_get_cstr(smsc), octstr_get_cstr(ts), octstr_get_cstr(dst), typ);
 
-    dlr = handles->dlr_get(smsc, ts, dst_min);
+    if (wb_lock != NULL)
+        dlr = wb_get(smsc, ts, dst_min, &removed);
+    if (dlr == NULL && !removed)
+        dlr = handles->dlr_get(smsc, ts, dst_min);
     if (dlr == NULL)  {
         warning(0, "DLR[%s]: DLR from SMSC<%s> for DST<%s> not found.",
                 dlr_type(), octstr_get_cstr(smsc), octstr_get_cstr(dst));         
+        gw_metric_increase(not_found_metric);
         return NULL;
     }
+    gw_metric_increase(found_metric);
 
 #define O_SET(x, val) if (octstr_len(val) > 0) { x = val; val = NULL; }
 
@@ -432,6 +871,7 @@ Msg *dlr_find(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int typ,
         O_SET(msg->sms.boxc_id, dlr->boxc_id);
 
         time(&msg->sms.time);
+        msg->stamp.acked = dlr->acked;
         debug("dlr.dlr", 0, "DLR[%s]: created DLR message for URL <%s>",
                       dlr_type(), (msg->sms.dlr_url?octstr_get_cstr(msg->sms.dlr_url):""));
     } else {
@@ -447,12 +887,18 @@ Msg *dlr_find(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int typ,
         debug("dlr.dlr", 0, "DLR[%s]: DLR not destroyed, still waiting for other delivery report", dlr_type());
         /* update dlr entry status if function defined */
         if (handles != NULL && handles->dlr_update != NULL){
-            handles->dlr_update(smsc, ts, dst_min, typ);
+            if (wb_lock != NULL)
+                wb_remove_or_update(WB_UPDATE, smsc, ts, dst_min, typ);
+            else
+                handles->dlr_update(smsc, ts, dst_min, typ);
         }
     } else {
         if (handles != NULL && handles->dlr_remove != NULL){
             /* it's not good for internal storage, but better for all others */
-            handles->dlr_remove(smsc, ts, dst_min);
+            if (wb_lock != NULL)
+                wb_remove_or_update(WB_REMOVE, smsc, ts, dst_min, 0);
+            else
+                handles->dlr_remove(smsc, ts, dst_min);
         } else {
             warning(0, "DLR[%s]: Storage don't have remove operation defined", dlr_type());
         }
@@ -469,6 +915,10 @@ void dlr_flush(void)
 {
     info(0, "Flushing all %ld queued DLR messages in %s storage", dlr_messages(), 
             dlr_type());
+
+    /* what is queued must not turn up in the storage afterwards */
+    if (wb_lock != NULL)
+        wb_flush();
  
     if (handles != NULL && handles->dlr_flush != NULL)
         handles->dlr_flush();
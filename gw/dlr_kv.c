@@ -0,0 +1,756 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw/dlr_kv.c
+ *
+ * Implementation of handling delivery reports (DLRs)
+ * in memory, backed by an append-only log file.
+ *
+ * Every add, remove and status update is appended to the log and the
+ * log is replayed on startup. Entries are indexed by smsc and
+ * timestamp, the destination is matched within the bucket as the
+ * other storages do. Once the log holds more dead records than live
+ * entries it is rewritten with only the live entries, the same way
+ * the store-file is dumped.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "gwlib/gwlib.h"
+#include "dlr_p.h"
+
+/* record types in the log */
+#define KV_ADD 'a'
+#define KV_REMOVE 'r'
+#define KV_UPDATE 'u'
+
+/* how often the log is synced and looked at for compaction, seconds */
+#define KV_COMPACT_FREQ 10
+
+/* dead records needed before the log is compacted */
+#define KV_MIN_GARBAGE 1024
+
+/* write rewritten log in chunks of about this size */
+#define KV_CHUNK 65536
+
+/* initial size hint of the index, it doubles as the keys outgrow it */
+#define KV_INDEX_SIZE 1024
+
+struct kv_entry {
+    struct dlr_entry *dlr;
+    int status;
+};
+
+/* smsc and timestamp to List of struct kv_entry */
+static Dict *kv_index = NULL;
+static long kv_index_size = 0;
+static Mutex *kv_lock = NULL;
+static FILE *file = NULL;
+static Octstr *filename = NULL;
+static Octstr *newfile = NULL;
+static Octstr *bakfile = NULL;
+/* entries in index and records in the log not needed any more */
+static long live = 0;
+static long garbage = 0;
+static int active = 0;
+static long compact_thread = -1;
+
+
+static void kv_entry_destroy(struct kv_entry *e)
+{
+    dlr_entry_destroy(e->dlr);
+    gw_free(e);
+}
+
+static void kv_bucket_destroy(void *bucket)
+{
+    gwlist_destroy(bucket, (gwlist_item_destructor_t *) kv_entry_destroy);
+}
+
+static Octstr *kv_key(const Octstr *smsc, const Octstr *ts)
+{
+    Octstr *key;
+
+    key = octstr_duplicate(smsc);
+    octstr_append_char(key, '\0');
+    octstr_append(key, ts);
+
+    return key;
+}
+
+
+/*------------------------------------------------------------------
+ * Log records. Each record is a 4 byte length followed by the type
+ * and the fields, octet strings are prefixed with their length + 1
+ * as uintvar, 0 standing for NULL.
+ */
+
+static void pack_octstr(Octstr *body, const Octstr *os)
+{
+    if (os == NULL) {
+        octstr_append_uintvar(body, 0);
+        return;
+    }
+    octstr_append_uintvar(body, octstr_len(os) + 1);
+    octstr_append(body, os);
+}
+
+static long unpack_octstr(Octstr *body, Octstr **os, long pos)
+{
+    unsigned long len;
+
+    *os = NULL;
+    if (pos < 0 || (pos = octstr_extract_uintvar(body, &len, pos)) == -1)
+        return -1;
+    if (len-- == 0)
+        return pos;
+    if (pos + (long) len > octstr_len(body))
+        return -1;
+    *os = octstr_copy(body, pos, len);
+
+    return pos + len;
+}
+
+static void append_record(Octstr *records, Octstr *body)
+{
+    unsigned char buf[4];
+
+    encode_network_long(buf, octstr_len(body));
+    octstr_append_data(records, (char*) buf, 4);
+    octstr_append(records, body);
+    octstr_destroy(body);
+}
+
+static void record_add(Octstr *records, const struct dlr_entry *dlr, int status)
+{
+    Octstr *body;
+
+    body = octstr_create("");
+    octstr_append_char(body, KV_ADD);
+    pack_octstr(body, dlr->smsc);
+    pack_octstr(body, dlr->timestamp);
+    pack_octstr(body, dlr->source);
+    pack_octstr(body, dlr->destination);
+    pack_octstr(body, dlr->service);
+    pack_octstr(body, dlr->url);
+    pack_octstr(body, dlr->boxc_id);
+    octstr_append_uintvar(body, dlr->mask);
+    octstr_append_uintvar(body, status);
+    append_record(records, body);
+}
+
+static void record_key(Octstr *records, int type, const Octstr *smsc,
+                       const Octstr *ts, const Octstr *dst, int status)
+{
+    Octstr *body;
+
+    body = octstr_create("");
+    octstr_append_char(body, type);
+    pack_octstr(body, smsc);
+    pack_octstr(body, ts);
+    pack_octstr(body, dst);
+    octstr_append_uintvar(body, status);
+    append_record(records, body);
+}
+
+/* append records to the log, called with kv_lock held */
+static void kv_write(Octstr *records)
+{
+    if (file == NULL || octstr_len(records) == 0)
+        return;
+
+    if (octstr_print(file, records) == -1 || fflush(file) != 0)
+        error(errno, "DLR[kv]: Failed to write to `%s'", octstr_get_cstr(filename));
+}
+
+
+/*------------------------------------------------------------------
+ * Index, all called with kv_lock held.
+ */
+
+static void kv_index_create(void)
+{
+    kv_index_size = KV_INDEX_SIZE;
+    kv_index = dict_create(kv_index_size, kv_bucket_destroy);
+}
+
+/*
+ * Dict does not resize, so move the buckets to one twice as large once
+ * there are more keys than the size hint, keeping the chains short.
+ */
+static void kv_index_grow(void)
+{
+    Dict *index;
+    List *keys;
+    Octstr *key;
+
+    if (dict_key_count(kv_index) <= kv_index_size)
+        return;
+
+    kv_index_size *= 2;
+    index = dict_create(kv_index_size, kv_bucket_destroy);
+    keys = dict_keys(kv_index);
+    while ((key = gwlist_extract_first(keys)) != NULL) {
+        dict_put(index, key, dict_remove(kv_index, key));
+        octstr_destroy(key);
+    }
+    gwlist_destroy(keys, NULL);
+    dict_destroy(kv_index);
+    kv_index = index;
+    debug("dlr.kv", 0, "DLR[kv]: Index grown to a size hint of %ld.", kv_index_size);
+}
+
+static void kv_insert(struct dlr_entry *dlr, int status)
+{
+    struct kv_entry *e;
+    Octstr *key;
+    List *bucket;
+
+    e = gw_malloc(sizeof(*e));
+    e->dlr = dlr;
+    e->status = status;
+
+    key = kv_key(dlr->smsc, dlr->timestamp);
+    if ((bucket = dict_get(kv_index, key)) == NULL) {
+        bucket = gwlist_create();
+        dict_put(kv_index, key, bucket);
+        kv_index_grow();
+    }
+    gwlist_append(bucket, e);
+    octstr_destroy(key);
+    live++;
+}
+
+/*
+ * Return 1 if entry matches. The destination is matched at the end,
+ * as it may be cut to MIN_DST_LEN digits by dlr_find().
+ */
+static int kv_match(struct dlr_entry *dlr, const Octstr *dst)
+{
+    long pos;
+
+    if (dst == NULL)
+        return 1;
+
+    pos = octstr_len(dlr->destination) - octstr_len(dst);
+    if (pos < 0)
+        return 0;
+
+    return octstr_search(dlr->destination, dst, pos) != -1;
+}
+
+static struct kv_entry *kv_find(const Octstr *smsc, const Octstr *ts, const Octstr *dst,
+                                List **bucket, long *pos)
+{
+    struct kv_entry *e;
+    Octstr *key;
+    long i;
+
+    key = kv_key(smsc, ts);
+    *bucket = dict_get(kv_index, key);
+    octstr_destroy(key);
+
+    for (i = 0; i < gwlist_len(*bucket); i++) {
+        e = gwlist_get(*bucket, i);
+        if (kv_match(e->dlr, dst)) {
+            *pos = i;
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+static int kv_delete(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
+{
+    struct kv_entry *e;
+    List *bucket;
+    Octstr *key;
+    long pos;
+
+    if ((e = kv_find(smsc, ts, dst, &bucket, &pos)) == NULL)
+        return 0;
+
+    gwlist_delete(bucket, pos, 1);
+    kv_entry_destroy(e);
+    if (gwlist_len(bucket) == 0) {
+        key = kv_key(smsc, ts);
+        kv_bucket_destroy(dict_remove(kv_index, key));
+        octstr_destroy(key);
+    }
+    live--;
+    /* both the add and the remove record */
+    garbage += 2;
+
+    return 1;
+}
+
+static int kv_set_status(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int status)
+{
+    struct kv_entry *e;
+    List *bucket;
+    long pos;
+
+    if ((e = kv_find(smsc, ts, dst, &bucket, &pos)) == NULL)
+        return 0;
+
+    e->status = status;
+    garbage++;
+
+    return 1;
+}
+
+
+/*------------------------------------------------------------------
+ * Log file handling, all called with kv_lock held.
+ */
+
+static int rename_log(void)
+{
+    if (rename(octstr_get_cstr(filename), octstr_get_cstr(bakfile)) == -1) {
+        if (errno != ENOENT) {
+            error(errno, "DLR[kv]: Failed to rename old log '%s' as '%s'",
+                  octstr_get_cstr(filename), octstr_get_cstr(bakfile));
+            return -1;
+        }
+    }
+    if (rename(octstr_get_cstr(newfile), octstr_get_cstr(filename)) == -1) {
+        error(errno, "DLR[kv]: Failed to rename new log '%s' as '%s'",
+              octstr_get_cstr(newfile), octstr_get_cstr(filename));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Write live entries to a new log and make it the current one. The old
+ * log is kept as it is if that fails.
+ */
+static int kv_dump(void)
+{
+    FILE *f;
+    List *keys, *bucket;
+    Octstr *key, *records;
+    struct kv_entry *e;
+    long i;
+    int ret = 0;
+
+    if ((f = fopen(octstr_get_cstr(newfile), "w")) == NULL) {
+        error(errno, "DLR[kv]: Failed to open '%s' for writing",
+              octstr_get_cstr(newfile));
+        return -1;
+    }
+
+    records = octstr_create("");
+    keys = dict_keys(kv_index);
+    while (ret == 0 && (key = gwlist_extract_first(keys)) != NULL) {
+        bucket = dict_get(kv_index, key);
+        for (i = 0; i < gwlist_len(bucket); i++) {
+            e = gwlist_get(bucket, i);
+            record_add(records, e->dlr, e->status);
+        }
+        if (octstr_len(records) >= KV_CHUNK || gwlist_len(keys) == 0) {
+            if (octstr_print(f, records) == -1)
+                ret = -1;
+            octstr_truncate(records, 0);
+        }
+        octstr_destroy(key);
+    }
+    gwlist_destroy(keys, octstr_destroy_item);
+    octstr_destroy(records);
+
+    if (fflush(f) != 0 || fsync(fileno(f)) == -1)
+        ret = -1;
+    fclose(f);
+    if (ret == -1) {
+        error(errno, "DLR[kv]: Failed to write '%s'", octstr_get_cstr(newfile));
+        return -1;
+    }
+
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+    ret = rename_log();
+    if ((file = fopen(octstr_get_cstr(filename), "a")) == NULL)
+        panic(errno, "DLR[kv]: Failed to open '%s' for appending",
+              octstr_get_cstr(filename));
+    if (ret == 0)
+        garbage = 0;
+
+    return ret;
+}
+
+/* apply one record of the log to the index */
+static int kv_replay(Octstr *body)
+{
+    struct dlr_entry *dlr;
+    Octstr *smsc, *ts, *dst;
+    unsigned long mask, status;
+    long pos;
+    int type;
+
+    type = octstr_get_char(body, 0);
+    if (type == KV_ADD) {
+        dlr = dlr_entry_create();
+        pos = unpack_octstr(body, &dlr->smsc, 1);
+        pos = unpack_octstr(body, &dlr->timestamp, pos);
+        pos = unpack_octstr(body, &dlr->source, pos);
+        pos = unpack_octstr(body, &dlr->destination, pos);
+        pos = unpack_octstr(body, &dlr->service, pos);
+        pos = unpack_octstr(body, &dlr->url, pos);
+        pos = unpack_octstr(body, &dlr->boxc_id, pos);
+        if (pos != -1)
+            pos = octstr_extract_uintvar(body, &mask, pos);
+        if (pos != -1)
+            pos = octstr_extract_uintvar(body, &status, pos);
+        if (pos == -1 || dlr->smsc == NULL || dlr->timestamp == NULL) {
+            dlr_entry_destroy(dlr);
+            return -1;
+        }
+        dlr->mask = mask;
+        kv_insert(dlr, status);
+        return 0;
+    }
+
+    if (type != KV_REMOVE && type != KV_UPDATE)
+        return -1;
+
+    pos = unpack_octstr(body, &smsc, 1);
+    pos = unpack_octstr(body, &ts, pos);
+    pos = unpack_octstr(body, &dst, pos);
+    if (pos != -1)
+        pos = octstr_extract_uintvar(body, &status, pos);
+    if (pos != -1 && smsc != NULL && ts != NULL) {
+        if (type == KV_REMOVE)
+            kv_delete(smsc, ts, dst);
+        else
+            kv_set_status(smsc, ts, dst, status);
+    }
+    octstr_destroy(smsc);
+    octstr_destroy(ts);
+    octstr_destroy(dst);
+
+    return (pos == -1 ? -1 : 0);
+}
+
+/*
+ * Read the log back into the index. A record cut short at the end is
+ * what a crash in the middle of a write leaves behind, it is dropped.
+ */
+static void kv_load(void)
+{
+    Octstr *log, *name, *body;
+    unsigned char buf[4];
+    long pos, end, len, records, skipped;
+
+    if (access(octstr_get_cstr(filename), F_OK) == 0)
+        name = filename;
+    else if (access(octstr_get_cstr(newfile), F_OK) == 0)
+        name = newfile;
+    else if (access(octstr_get_cstr(bakfile), F_OK) == 0)
+        name = bakfile;
+    else {
+        info(0, "DLR[kv]: Cannot open any log file, starting a new one");
+        return;
+    }
+
+    /* starting empty would overwrite the log */
+    if ((log = octstr_read_file(octstr_get_cstr(name))) == NULL)
+        panic(0, "DLR[kv]: Cannot read log file `%s'", octstr_get_cstr(name));
+
+    info(0, "DLR[kv]: Loading log file `%s', size %ld", 
+         octstr_get_cstr(name), octstr_len(log));
+
+    pos = records = skipped = 0;
+    end = octstr_len(log);
+    while (pos + 4 <= end) {
+        octstr_get_many_chars((char*) buf, log, pos, 4);
+        len = decode_network_long(buf);
+        if (len < 1 || pos + 4 + len > end)
+            break;
+        body = octstr_copy(log, pos + 4, len);
+        if (kv_replay(body) == -1)
+            skipped++;
+        octstr_destroy(body);
+        pos += 4 + len;
+        records++;
+    }
+    if (pos < end)
+        warning(0, "DLR[kv]: Incomplete record at end of log, %ld bytes dropped.",
+                end - pos);
+    if (skipped > 0)
+        error(0, "DLR[kv]: Garbage at log, %ld records skipped.", skipped);
+    octstr_destroy(log);
+
+    info(0, "DLR[kv]: Replayed %ld records, %ld DLRs waiting.", records, live);
+}
+
+
+/*------------------------------------------------------------------
+ * Storage handles.
+ */
+
+static void kv_compactor(void *arg)
+{
+    while (active) {
+        gwthread_sleep(KV_COMPACT_FREQ);
+        mutex_lock(kv_lock);
+        if (garbage >= KV_MIN_GARBAGE && garbage > live)
+            kv_dump();
+        else if (file != NULL && fsync(fileno(file)) == -1)
+            error(errno, "DLR[kv]: Failed to sync `%s'", octstr_get_cstr(filename));
+        mutex_unlock(kv_lock);
+    }
+}
+
+static void dlr_kv_add(struct dlr_entry *dlr)
+{
+    Octstr *records;
+
+    records = octstr_create("");
+    record_add(records, dlr, 0);
+
+    mutex_lock(kv_lock);
+    kv_write(records);
+    kv_insert(dlr, 0);
+    mutex_unlock(kv_lock);
+
+    octstr_destroy(records);
+}
+
+static void dlr_kv_add_batch(List *entries)
+{
+    struct dlr_entry *dlr;
+    Octstr *records;
+    long i;
+
+    records = octstr_create("");
+    for (i = 0; i < gwlist_len(entries); i++)
+        record_add(records, gwlist_get(entries, i), 0);
+
+    mutex_lock(kv_lock);
+    kv_write(records);
+    while ((dlr = gwlist_extract_first(entries)) != NULL)
+        kv_insert(dlr, 0);
+    mutex_unlock(kv_lock);
+
+    octstr_destroy(records);
+}
+
+static struct dlr_entry *dlr_kv_get(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
+{
+    struct kv_entry *e;
+    struct dlr_entry *ret = NULL;
+    List *bucket;
+    long pos;
+
+    mutex_lock(kv_lock);
+    if ((e = kv_find(smsc, ts, dst, &bucket, &pos)) != NULL)
+        ret = dlr_entry_duplicate(e->dlr);
+    mutex_unlock(kv_lock);
+
+    return ret;
+}
+
+static void dlr_kv_remove(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
+{
+    Octstr *records;
+
+    records = octstr_create("");
+    record_key(records, KV_REMOVE, smsc, ts, dst, 0);
+
+    mutex_lock(kv_lock);
+    if (kv_delete(smsc, ts, dst))
+        kv_write(records);
+    mutex_unlock(kv_lock);
+
+    octstr_destroy(records);
+}
+
+static void dlr_kv_remove_batch(List *entries)
+{
+    struct dlr_entry *dlr;
+    Octstr *records;
+    long i;
+
+    records = octstr_create("");
+
+    mutex_lock(kv_lock);
+    for (i = 0; i < gwlist_len(entries); i++) {
+        dlr = gwlist_get(entries, i);
+        if (kv_delete(dlr->smsc, dlr->timestamp, dlr->destination))
+            record_key(records, KV_REMOVE, dlr->smsc, dlr->timestamp, dlr->destination, 0);
+    }
+    kv_write(records);
+    mutex_unlock(kv_lock);
+
+    octstr_destroy(records);
+}
+
+static void dlr_kv_update(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int status)
+{
+    Octstr *records;
+
+    records = octstr_create("");
+    record_key(records, KV_UPDATE, smsc, ts, dst, status);
+
+    mutex_lock(kv_lock);
+    if (kv_set_status(smsc, ts, dst, status))
+        kv_write(records);
+    mutex_unlock(kv_lock);
+
+    octstr_destroy(records);
+}
+
+static long dlr_kv_messages(void)
+{
+    long ret;
+
+    mutex_lock(kv_lock);
+    ret = live;
+    mutex_unlock(kv_lock);
+
+    return ret;
+}
+
+static void dlr_kv_flush(void)
+{
+    mutex_lock(kv_lock);
+    dict_destroy(kv_index);
+    kv_index_create();
+    live = garbage = 0;
+    kv_dump();
+    mutex_unlock(kv_lock);
+}
+
+static void dlr_kv_shutdown(void)
+{
+    active = 0;
+    if (compact_thread != -1) {
+        gwthread_wakeup(compact_thread);
+        gwthread_join(compact_thread);
+    }
+    compact_thread = -1;
+
+    /* leave a compact log behind, it makes the next start faster */
+    mutex_lock(kv_lock);
+    kv_dump();
+    if (file != NULL)
+        fclose(file);
+    file = NULL;
+    mutex_unlock(kv_lock);
+
+    dict_destroy(kv_index);
+    mutex_destroy(kv_lock);
+    octstr_destroy(filename);
+    octstr_destroy(newfile);
+    octstr_destroy(bakfile);
+    kv_index = NULL;
+    kv_lock = NULL;
+    filename = newfile = bakfile = NULL;
+    live = garbage = 0;
+}
+
+static struct dlr_storage handles = {
+    .type = "kv",
+    .dlr_add = dlr_kv_add,
+    .dlr_get = dlr_kv_get,
+    .dlr_remove = dlr_kv_remove,
+    .dlr_update = dlr_kv_update,
+    .dlr_messages = dlr_kv_messages,
+    .dlr_flush = dlr_kv_flush,
+    .dlr_shutdown = dlr_kv_shutdown,
+    .dlr_add_batch = dlr_kv_add_batch,
+    .dlr_remove_batch = dlr_kv_remove_batch
+};
+
+/*
+ * Replay the log and return our storage handles.
+ */
+struct dlr_storage *dlr_init_kv(Cfg *cfg)
+{
+    CfgGroup *grp;
+    Octstr *fname;
+
+    grp = cfg_get_single_group(cfg, octstr_imm("core"));
+    if ((fname = cfg_get(grp, octstr_imm("dlr-kv-file"))) == NULL)
+        panic(0, "DLR: kv: directive 'dlr-kv-file' is not specified!");
+    if (octstr_len(fname) > (FILENAME_MAX-5))
+        panic(0, "DLR: kv: log file name too long: `%s'", octstr_get_cstr(fname));
+
+    filename = fname;
+    newfile = octstr_format("%s.new", octstr_get_cstr(filename));
+    bakfile = octstr_format("%s.bak", octstr_get_cstr(filename));
+    kv_index_create();
+    kv_lock = mutex_create();
+    live = garbage = 0;
+
+    mutex_lock(kv_lock);
+    kv_load();
+    /* start from a compact log, this also drops a cut record */
+    if (kv_dump() == -1)
+        panic(0, "DLR: kv: cannot write log file `%s'", octstr_get_cstr(filename));
+    mutex_unlock(kv_lock);
+
+    active = 1;
+    if ((compact_thread = gwthread_create(kv_compactor, NULL)) == -1)
+        panic(0, "DLR: kv: failed to create compaction thread!");
+
+    return &handles;
+}
@@ -136,6 +136,63 @@ static void dlr_mysql_add(struct dlr_entry *entry)
     dlr_entry_destroy(entry);
 }
 
+static void dlr_mysql_add_batch(List *entries)
+{
+    Octstr *sql;
+    DBPoolConn *pconn;
+    List *binds, *masks;
+    struct dlr_entry *entry;
+    long i, n;
+    int res;
+
+    n = gwlist_len(entries);
+    debug("dlr.mysql", 0, "adding %ld DLR entries into database", n);
+
+    pconn = dbpool_conn_consume(pool);
+    /* just for sure */
+    if (pconn == NULL) {
+        while ((entry = gwlist_extract_first(entries)) != NULL)
+            dlr_entry_destroy(entry);
+        return;
+    }
+
+    sql = octstr_format("INSERT INTO `%S` (`%S`, `%S`, `%S`, `%S`, `%S`, `%S`, `%S`, `%S`, `%S`) VALUES ",
+                        fields->table, fields->field_smsc, fields->field_ts,
+                        fields->field_src, fields->field_dst, fields->field_serv,
+                        fields->field_url, fields->field_mask, fields->field_boxc,
+                        fields->field_status);
+    binds = gwlist_create();
+    masks = gwlist_create();
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s(?, ?, ?, ?, ?, ?, ?, ?, 0)", i > 0 ? ", " : "");
+        gwlist_append(masks, octstr_format("%d", entry->mask));
+        gwlist_append(binds, entry->smsc);
+        gwlist_append(binds, entry->timestamp);
+        gwlist_append(binds, entry->source);
+        gwlist_append(binds, entry->destination);
+        gwlist_append(binds, entry->service);
+        gwlist_append(binds, entry->url);
+        gwlist_append(binds, gwlist_get(masks, i));
+        gwlist_append(binds, entry->boxc_id);
+    }
+
+#if defined(DLR_TRACE)
+    debug("dlr.mysql", 0, "sql: %s", octstr_get_cstr(sql));
+#endif
+    if ((res = dbpool_conn_update(pconn, sql, binds)) == -1)
+        error(0, "DLR: MYSQL: Error while adding %ld dlr entries", n);
+    else if (res < n)
+        warning(0, "DLR: MYSQL: Only %d of %ld dlr entries inserted", res, n);
+
+    dbpool_conn_produce(pconn);
+    octstr_destroy(sql);
+    gwlist_destroy(binds, NULL);
+    gwlist_destroy(masks, octstr_destroy_item);
+    while ((entry = gwlist_extract_first(entries)) != NULL)
+        dlr_entry_destroy(entry);
+}
+
 static struct dlr_entry* dlr_mysql_get(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
 {
     Octstr *sql, *like;
@@ -245,6 +302,53 @@ static void dlr_mysql_remove(const Octstr *smsc, const Octstr *ts, const Octstr
     octstr_destroy(like);
 }
 
+static void dlr_mysql_remove_batch(List *entries)
+{
+    Octstr *sql;
+    DBPoolConn *pconn;
+    List *binds;
+    struct dlr_entry *entry;
+    long i, n;
+    int res;
+
+    n = gwlist_len(entries);
+    debug("dlr.mysql", 0, "removing %ld DLRs from database", n);
+
+    pconn = dbpool_conn_consume(pool);
+    /* just for sure */
+    if (pconn == NULL)
+        return;
+
+    sql = octstr_format("DELETE FROM `%S` WHERE ", fields->table);
+    binds = gwlist_create();
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s(`%S`=? AND `%S`=?", i > 0 ? " OR " : "",
+                             fields->field_smsc, fields->field_ts);
+        gwlist_append(binds, entry->smsc);
+        gwlist_append(binds, entry->timestamp);
+        if (entry->destination) {
+            octstr_format_append(sql, " AND `%S` LIKE CONCAT('%%', ?)", fields->field_dst);
+            gwlist_append(binds, entry->destination);
+        }
+        octstr_append_char(sql, ')');
+    }
+    octstr_format_append(sql, " LIMIT %ld", n);
+
+#if defined(DLR_TRACE)
+    debug("dlr.mysql", 0, "sql: %s", octstr_get_cstr(sql));
+#endif
+
+    if ((res = dbpool_conn_update(pconn, sql, binds)) == -1)
+        error(0, "DLR: MYSQL: Error while removing %ld dlr entries", n);
+    else if (res < n)
+        warning(0, "DLR: MYSQL: Only %d of %ld dlr entries deleted", res, n);
+
+    dbpool_conn_produce(pconn);
+    gwlist_destroy(binds, NULL);
+    octstr_destroy(sql);
+}
+
 static void dlr_mysql_update(const Octstr *smsc, const Octstr *ts, const Octstr *dst, int status)
 {
     Octstr *sql, *os_status, *like;
@@ -357,7 +461,9 @@ static struct dlr_storage handles = {
     .dlr_remove = dlr_mysql_remove,
     .dlr_shutdown = dlr_mysql_shutdown,
     .dlr_messages = dlr_mysql_messages,
-    .dlr_flush = dlr_mysql_flush
+    .dlr_flush = dlr_mysql_flush,
+    .dlr_add_batch = dlr_mysql_add_batch,
+    .dlr_remove_batch = dlr_mysql_remove_batch
 };
 
 struct dlr_storage *dlr_init_mysql(Cfg *cfg)
@@ -84,6 +84,7 @@ struct dlr_entry {
    Octstr *url;
    Octstr *boxc_id;
    int mask;
+   long long acked; /* monotonic time of dlr_add() in usec, not kept by SQL storages */
 };
 
 /*
@@ -139,6 +140,18 @@ struct dlr_storage {
      * Shutdown storage
      */
     void (*dlr_shutdown) (void);
+    /*
+     * Add several dlr entries at once, optional. Used by the write-behind
+     * queue if defined, it calls dlr_add for each entry otherwise.
+     * NOTE: this function is responsible to destroy the entries, not the list
+     */
+    void (*dlr_add_batch) (List *entries);
+    /*
+     * Remove several dlr entries at once, optional. The entries only have
+     * smsc, timestamp and destination set, destination may be NULL.
+     * NOTE: caller destroys the entries
+     */
+    void (*dlr_remove_batch) (List *entries);
 };
 
 /*
@@ -172,6 +185,7 @@ struct dlr_storage *dlr_init_oracle(Cfg *cfg);
 struct dlr_storage *dlr_init_pgsql(Cfg *cfg);
 struct dlr_storage *dlr_init_mssql(Cfg *cfg);
 struct dlr_storage *dlr_init_sqlite3(Cfg *cfg);
+struct dlr_storage *dlr_init_kv(Cfg *cfg);
 
 
 #endif /* DLR_P_H */
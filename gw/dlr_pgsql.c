@@ -218,6 +218,64 @@ static struct dlr_entry *dlr_pgsql_get(const Octstr *smsc, const Octstr *ts, con
 }
 
 
+static void dlr_pgsql_add_batch(List *entries)
+{
+    Octstr *sql;
+    struct dlr_entry *entry;
+    long i, n;
+
+    n = gwlist_len(entries);
+    sql = octstr_format("INSERT INTO \"%S\" (\"%S\", \"%S\", \"%S\", \"%S\", \"%S\", \"%S\", \"%S\", \"%S\", \"%S\") VALUES ",
+                        fields->table, fields->field_smsc, fields->field_ts,
+                        fields->field_src, fields->field_dst,
+                        fields->field_serv, fields->field_url,
+                        fields->field_mask, fields->field_boxc,
+                        fields->field_status);
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s('%S', '%S', '%S', '%S', '%S', '%S', '%d', '%S', '%d')",
+                             i > 0 ? ", " : "",
+                             entry->smsc, entry->timestamp, entry->source,
+                             entry->destination, entry->service, entry->url,
+                             entry->mask, entry->boxc_id, 0);
+    }
+    octstr_append_char(sql, ';');
+
+    if (pgsql_update(sql) < n)
+       warning(0, "DLR: PGSQL: Not all of %ld dlrs inserted", n);
+
+    octstr_destroy(sql);
+    while ((entry = gwlist_extract_first(entries)) != NULL)
+        dlr_entry_destroy(entry);
+}
+
+static void dlr_pgsql_remove_batch(List *entries)
+{
+    Octstr *sql;
+    struct dlr_entry *entry;
+    long i, n;
+
+    n = gwlist_len(entries);
+    debug("dlr.pgsql", 0, "removing %ld DLRs from database", n);
+    sql = octstr_format("DELETE FROM \"%S\" WHERE oid IN (SELECT oid FROM \"%S\" WHERE ",
+                        fields->table, fields->table);
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s(\"%S\"='%S' AND \"%S\"='%S'", i > 0 ? " OR " : "",
+                             fields->field_smsc, entry->smsc,
+                             fields->field_ts, entry->timestamp);
+        if (entry->destination)
+            octstr_format_append(sql, " AND \"%S\" LIKE '%%%S'", 
+                                 fields->field_dst, entry->destination);
+        octstr_append_char(sql, ')');
+    }
+    octstr_format_append(sql, " LIMIT %ld);", n);
+
+    if (pgsql_update(sql) < n)
+       warning(0, "DLR: PGSQL: Not all of %ld dlrs deleted", n);
+    octstr_destroy(sql);
+}
+
 static void dlr_pgsql_remove(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
 {
     Octstr *sql, *like;
@@ -306,7 +364,9 @@ static struct dlr_storage handles = {
     .dlr_remove = dlr_pgsql_remove,
     .dlr_shutdown = dlr_pgsql_shutdown,
     .dlr_messages = dlr_pgsql_messages,
-    .dlr_flush = dlr_pgsql_flush
+    .dlr_flush = dlr_pgsql_flush,
+    .dlr_add_batch = dlr_pgsql_add_batch,
+    .dlr_remove_batch = dlr_pgsql_remove_batch
 };
 
 
@@ -169,6 +169,110 @@ static void dlr_add_sqlite3(struct dlr_entry *entry)
     dlr_entry_destroy(entry);
 }
 
+static void dlr_add_batch_sqlite3(List *entries)
+{
+    Octstr *sql;
+    DBPoolConn *pconn;
+    List *binds, *masks;
+    struct dlr_entry *entry;
+    long i, n;
+    int res;
+
+    n = gwlist_len(entries);
+    debug("dlr.sqlite3", 0, "adding %ld DLR entries into database", n);
+
+    pconn = dbpool_conn_consume(pool);
+    /* just for sure */
+    if (pconn == NULL) {
+        while ((entry = gwlist_extract_first(entries)) != NULL)
+            dlr_entry_destroy(entry);
+        return;
+    }
+
+    sql = octstr_format("INSERT INTO %S (%S, %S, %S, %S, %S, %S, %S, %S, %S) VALUES ",
+                        fields->table, fields->field_smsc, fields->field_ts,
+                        fields->field_src, fields->field_dst, fields->field_serv, 
+                        fields->field_url, fields->field_mask, fields->field_boxc,
+                        fields->field_status);
+    binds = gwlist_create();
+    masks = gwlist_create();
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s(?, ?, ?, ?, ?, ?, ?, ?, 0)", i > 0 ? ", " : "");
+        gwlist_append(masks, octstr_format("%d", entry->mask));
+        gwlist_append(binds, entry->smsc);
+        gwlist_append(binds, entry->timestamp);
+        gwlist_append(binds, entry->source);
+        gwlist_append(binds, entry->destination);
+        gwlist_append(binds, entry->service);
+        gwlist_append(binds, entry->url);
+        gwlist_append(binds, gwlist_get(masks, i));
+        gwlist_append(binds, entry->boxc_id);
+    }
+#if defined(DLR_TRACE)
+    debug("dlr.sqlite3", 0, "sql: %s", octstr_get_cstr(sql));
+#endif
+    if ((res = dbpool_conn_update(pconn, sql, binds)) == -1)
+        error(0, "DLR: SQLite3: Error while adding %ld dlr entries", n);
+    else if (res < n)
+        warning(0, "DLR: SQLite3: Only %d of %ld dlr entries inserted", res, n);
+
+    dbpool_conn_produce(pconn);
+    octstr_destroy(sql);
+    gwlist_destroy(binds, NULL);
+    gwlist_destroy(masks, octstr_destroy_item);
+    while ((entry = gwlist_extract_first(entries)) != NULL)
+        dlr_entry_destroy(entry);
+}
+
+static void dlr_remove_batch_sqlite3(List *entries)
+{
+    Octstr *sql;
+    DBPoolConn *pconn;
+    List *binds;
+    struct dlr_entry *entry;
+    long i, n;
+    int res;
+
+    n = gwlist_len(entries);
+    debug("dlr.sqlite3", 0, "removing %ld DLRs from database", n);
+
+    pconn = dbpool_conn_consume(pool);
+    /* just for sure */
+    if (pconn == NULL)
+        return;
+
+    sql = octstr_format("DELETE FROM %S WHERE ROWID IN (SELECT ROWID FROM %S WHERE ",
+                        fields->table, fields->table);
+    binds = gwlist_create();
+    for (i = 0; i < n; i++) {
+        entry = gwlist_get(entries, i);
+        octstr_format_append(sql, "%s(%S=? AND %S=?", i > 0 ? " OR " : "",
+                             fields->field_smsc, fields->field_ts);
+        gwlist_append(binds, entry->smsc);
+        gwlist_append(binds, entry->timestamp);
+        if (entry->destination) {
+            octstr_format_append(sql, " AND %S LIKE '%%' || ?", fields->field_dst);
+            gwlist_append(binds, entry->destination);
+        }
+        octstr_append_char(sql, ')');
+    }
+    octstr_format_append(sql, " LIMIT %ld)", n);
+
+#if defined(DLR_TRACE)
+    debug("dlr.sqlite3", 0, "sql: %s", octstr_get_cstr(sql));
+#endif
+
+    if ((res = dbpool_conn_update(pconn, sql, binds)) == -1)
+        error(0, "DLR: SQLite3: Error while removing %ld dlr entries", n);
+    else if (res < n)
+        warning(0, "DLR: SQLite3: Only %d of %ld dlr entries deleted", res, n);
+
+    dbpool_conn_produce(pconn);
+    gwlist_destroy(binds, NULL);
+    octstr_destroy(sql);
+}
+
 static void dlr_remove_sqlite3(const Octstr *smsc, const Octstr *ts, const Octstr *dst)
 {
     Octstr *sql, *like;
@@ -183,7 +287,7 @@ static void dlr_remove_sqlite3(const Octstr *smsc, const Octstr *ts, const Octst
         return;
     
     if (dst)
-        like = octstr_format("AND %S LIKE '%?3'", fields->field_dst);
+        like = octstr_format("AND %S LIKE '%%' || ?3", fields->field_dst);
     else
         like = octstr_imm("");
 
@@ -224,7 +328,7 @@ static struct dlr_entry* dlr_get_sqlite3(const Octstr *smsc, const Octstr *ts, c
         return NULL;
 
     if (dst)
-        like = octstr_format("AND %S LIKE '%?3'", fields->field_dst);
+        like = octstr_format("AND %S LIKE '%%' || ?3", fields->field_dst);
     else
         like = octstr_imm("");
 
@@ -290,13 +394,13 @@ static void dlr_update_sqlite3(const Octstr *smsc, const Octstr *ts, const Octst
         return;
 
     if (dst)
-        like = octstr_format("AND %S LIKE '%?4'", fields->field_dst);
+        like = octstr_format("AND %S LIKE '%%' || ?4", fields->field_dst);
     else
         like = octstr_imm("");
 
     sql = octstr_format("UPDATE %S SET %S=?1 WHERE ROWID IN (SELECT ROWID FROM %S WHERE %S=?2 AND %S=?3 %S LIMIT 1)",
                         fields->table, fields->field_status, fields->table,
-                        fields->field_smsc, fields->field_ts, fields->field_dst);
+                        fields->field_smsc, fields->field_ts, like);
 
     os_status = octstr_format("%d", status);
     gwlist_append(binds, (Octstr *)os_status); /* ?1 */
@@ -352,7 +456,9 @@ static struct dlr_storage handles = {
     .dlr_get = dlr_get_sqlite3,
     .dlr_remove = dlr_remove_sqlite3,
     .dlr_update = dlr_update_sqlite3,
-    .dlr_flush = dlr_flush_sqlite3
+    .dlr_flush = dlr_flush_sqlite3,
+    .dlr_add_batch = dlr_add_batch_sqlite3,
+    .dlr_remove_batch = dlr_remove_batch_sqlite3
 };
 
 struct dlr_storage *dlr_init_sqlite3(Cfg *cfg)
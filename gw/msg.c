@@ -105,6 +105,8 @@ Msg *msg_create_real(enum msg_type type, const char *file, long line,
 #define MSG(type, stmt) { struct type *p = &msg->type; stmt }
 #include "msg-decl.h"
 
+    msg->stamp.queued = msg->stamp.submitted = msg->stamp.acked = 0;
+
     return msg;
 }
 
@@ -126,6 +128,8 @@ Msg *msg_duplicate(Msg *msg)
     stmt }
 #include "msg-decl.h"
 
+    new->stamp = msg->stamp;
+
     return new;
 }
 
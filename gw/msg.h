@@ -85,6 +85,17 @@ typedef struct {
 	#define VOID(name) void *name;
 	#define MSG(type, stmt) struct type stmt type;
 	#include "msg-decl.h"
+
+	/*
+	 * Monotonic timestamps in microseconds used for latency statistics.
+	 * They are local to the box, neither packed nor unpacked, but
+	 * copied by msg_duplicate. 0 means not set.
+	 */
+	struct {
+	    long long queued;     /* handed to SMSC connection */
+	    long long submitted;  /* sent to SMSC */
+	    long long acked;      /* acked by SMSC, set for reports from DLR storage */
+	} stamp;
 } Msg;
 
 struct split_parts {
@@ -116,7 +127,14 @@ enum {
     cmd_suspend = 1,
     cmd_resume = 2,
     cmd_identify = 3,
-    cmd_restart = 4
+    cmd_restart = 4,
+    /* 
+     * Shared memory ring between a box and bearerbox, see shared.h.
+     * The offer carries the path of the ring file in boxc_id.
+     */
+    cmd_shm_offer = 5,
+    cmd_shm_accept = 6,
+    cmd_shm_reject = 7
 };
 
 /* ack message status */
@@ -79,6 +79,15 @@ volatile enum program_status program_status = starting_up;
  * established from a foobarbox to bearerbox. */
 static Connection *bb_conn;
 
+/* 
+ * Shared memory ring offered to bearerbox, if any. Messages go through it
+ * once bb_ring_active is set; bb_ring_lock, which exists once a ring has
+ * been offered, keeps writers off TCP while the connection switches over. 
+ */
+static gw_shmring_t *bb_ring;
+static volatile int bb_ring_active;
+static Mutex *bb_ring_lock;
+
 
 Connection *connect_to_bearerbox_real(Octstr *host, int port, int ssl, Octstr *our_host)
 {
@@ -119,8 +128,91 @@ void close_connection_to_bearerbox_real(Connection *conn)
 }
 
 
+void offer_shm_to_bearerbox(Octstr *dir, long size)
+{
+    Msg *msg;
+
+    bb_ring = gw_shmring_create(dir, size);
+    if (bb_ring == NULL) {
+        warning(0, "Could not create shared memory ring, using TCP to bearerbox.");
+        return;
+    }
+    bb_ring_lock = mutex_create();
+
+    msg = msg_create(admin);
+    msg->admin.command = cmd_shm_offer;
+    msg->admin.boxc_id = octstr_duplicate(gw_shmring_path(bb_ring));
+    write_to_bearerbox_real(bb_conn, msg);
+}
+
+
+/* 
+ * Drop the shared memory ring, bearerbox did not take it. 
+ */
+static void shm_rejected(void)
+{
+    warning(0, "Bearerbox did not accept shared memory ring, using TCP.");
+    mutex_lock(bb_ring_lock);
+    gw_shmring_unlink(bb_ring);
+    gw_shmring_destroy(bb_ring);
+    bb_ring = NULL;
+    mutex_unlock(bb_ring_lock);
+}
+
+
+/*
+ * Bearerbox has attached to the ring, and everything it sends after the
+ * accept comes through the ring. Tell it that everything we send from
+ * now on does, too.
+ */
+static void shm_accepted(void)
+{
+    Msg *msg;
+
+    mutex_lock(bb_ring_lock);
+    msg = msg_create(admin);
+    msg->admin.command = cmd_shm_accept;
+    write_to_bearerbox_real(bb_conn, msg);
+    bb_ring_active = 1;
+    mutex_unlock(bb_ring_lock);
+
+    gw_shmring_unlink(bb_ring);
+    info(0, "Using shared memory ring <%s> to bearerbox.",
+         octstr_get_cstr(gw_shmring_path(bb_ring)));
+}
+
+
+/*
+ * Write packed Msg to bearerbox, through the ring once it is in use.
+ */
+static int write_pack_to_bearerbox(Octstr *pack)
+{
+    int ret;
+
+    if (bb_ring_lock == NULL)
+        return conn_write_withlen(bb_conn, pack);
+
+    mutex_lock(bb_ring_lock);
+    if (bb_ring_active)
+        ret = gw_shmring_write(bb_ring, pack);
+    else
+        ret = conn_write_withlen(bb_conn, pack);
+    mutex_unlock(bb_ring_lock);
+    return ret;
+}
+
+
 void close_connection_to_bearerbox(void)
 {
+    if (bb_ring != NULL) {
+        if (!bb_ring_active)
+            gw_shmring_unlink(bb_ring);
+        gw_shmring_destroy(bb_ring);
+        bb_ring = NULL;
+        bb_ring_active = 0;
+    }
+    mutex_destroy(bb_ring_lock);
+    bb_ring_lock = NULL;
     close_connection_to_bearerbox_real(bb_conn);
     bb_conn = NULL;
 }
@@ -141,7 +233,14 @@ void write_to_bearerbox_real(Connection *conn, Msg *pmsg)
 
 void write_to_bearerbox(Msg *pmsg)
 {
-    write_to_bearerbox_real(bb_conn, pmsg);
+    Octstr *pack;
+
+    pack = msg_pack(pmsg);
+    if (write_pack_to_bearerbox(pack) == -1)
+    	error(0, "Couldn't write Msg to bearerbox.");
+
+    msg_destroy(pmsg);
+    octstr_destroy(pack);
 }
 
 
@@ -165,7 +264,18 @@ int deliver_to_bearerbox_real(Connection *conn, Msg *msg)
 
 int deliver_to_bearerbox(Msg *msg)
 {
-    return deliver_to_bearerbox_real(bb_conn, msg);
+    Octstr *pack;
+    
+    pack = msg_pack(msg);
+    if (write_pack_to_bearerbox(pack) == -1) {
+    	error(0, "Couldn't deliver Msg to bearerbox.");
+        octstr_destroy(pack);
+        return -1;
+    }
+                                   
+    octstr_destroy(pack);
+    msg_destroy(msg);
+    return 0;
 }
                                            
 
@@ -217,9 +327,65 @@ int read_from_bearerbox_real(Connection *conn, Msg **msg, double seconds)
 }
 
 
+/*
+ * Like read_from_bearerbox_real, but from the shared memory ring. The
+ * ring is read a second at a time to notice shutting down.
+ */
+static int read_from_bearerbox_ring(Msg **msg, double seconds)
+{
+    int ret;
+    Octstr *pack;
+    double left;
+
+    *msg = NULL;
+    left = seconds;
+    while (program_status != shutting_down) {
+        ret = gw_shmring_read(bb_ring, &pack, 
+                              (left >= 0 && left < 1.0) ? left : 1.0);
+        if (ret == -1) {
+            error(0, "Connection closed by the bearerbox.");
+            return -1;
+        } else if (ret == 0) {
+            *msg = msg_unpack(pack);
+            octstr_destroy(pack);
+            if (*msg == NULL) {
+                error(0, "Failed to unpack data!");
+                return -1;
+            }
+            return 0;
+        }
+        if (left >= 0) {
+            left -= 1.0;
+            if (left <= 0)
+                return 1;
+        }
+    }
+    return -1;
+}
+
+
 int read_from_bearerbox(Msg **msg, double seconds)
 {
-    return read_from_bearerbox_real(bb_conn, msg, seconds);
+    int ret;
+
+    for (;;) {
+        if (bb_ring_active)
+            ret = read_from_bearerbox_ring(msg, seconds);
+        else
+            ret = read_from_bearerbox_real(bb_conn, msg, seconds);
+        if (ret != 0 || bb_ring == NULL || msg_type(*msg) != admin)
+            return ret;
+
+        /* the answer to our offer of a ring is for us only */
+        if ((*msg)->admin.command == cmd_shm_accept && !bb_ring_active)
+            shm_accepted();
+        else if ((*msg)->admin.command == cmd_shm_reject && !bb_ring_active)
+            shm_rejected();
+        else
+            return ret;
+        msg_destroy(*msg);
+        *msg = NULL;
+    }
 }
 
 
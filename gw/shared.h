@@ -72,6 +72,9 @@
 
 #define INFINITE_TIME -1
 
+/* default size of a shared memory ring to bearerbox, in each direction */
+#define BB_DEFAULT_SHM_SIZE (1024 * 1024)
+
 /*
  * Program status. Set this to shutting_down to make read_from_bearerbox
  * return even if the bearerbox hasn't closed the connection yet.
@@ -90,6 +93,17 @@ Connection *connect_to_bearerbox_real(Octstr *host, int port, int ssl, Octstr *o
 void connect_to_bearerbox(Octstr *host, int port, int ssl, Octstr *our_host);
 
 
+/*
+ * Offer bearerbox a shared memory ring of `size' bytes in each direction,
+ * created in directory `dir', for the messages of the connection opened
+ * with connect_to_bearerbox. If bearerbox runs on the same host and
+ * allows rings in `dir', it accepts, and both sides switch over from TCP
+ * to the ring; otherwise the connection stays on TCP. The switch happens
+ * in read_from_bearerbox, which must be called as usual.
+ */
+void offer_shm_to_bearerbox(Octstr *dir, long size);
+
+
 /*
  * Close connection to the bearerbox.
  */
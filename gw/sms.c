@@ -244,58 +244,50 @@ static void prepend_catenation_udh(Msg *sms, int part_no, int num_messages,
 }
 
 
-static Octstr *extract_msgdata_part(Octstr *msgdata, Octstr *split_chars,
-    	    	    	    	    int max_part_len)
-{
-    long i, len;
-    Octstr *part;
-
-    len = max_part_len;
-    if (max_part_len < octstr_len(msgdata) && split_chars != NULL)
-	for (i = max_part_len; i > 0; i--)
-	    if (octstr_search_char(split_chars,
-				   octstr_get_char(msgdata, i - 1), 0) != -1) {
-		len = i;
-		break;
-	    }
-    part = octstr_copy(msgdata, 0, len);
-    octstr_delete(msgdata, 0, len);
-    return part;
-}
-
-
-static Octstr *extract_msgdata_part_by_coding(Msg *msg, Octstr *split_chars,
-        int max_part_len)
+/*
+ * Return the length in octets of the next part of `text', starting at
+ * octet `start', that fits in `max_len' septets for 7 bit text or octets
+ * otherwise. If the rest of the text does not fit, cut it after the last
+ * of `split_chars' in the part, if there is one. GSM escapes and UCS-2
+ * characters, including surrogate pairs, are never cut in half.
+ */
+static long next_part_len(Octstr *text, int coding, long start, long max_len,
+                          Octstr *split_chars)
 {
-    Octstr *temp = NULL, *temp_utf;
-
-    if (msg->sms.coding == DC_8BIT || msg->sms.coding == DC_UCS2) {
-        /* nothing to do here, just call the original extract_msgdata_part */
-        return extract_msgdata_part(msg->sms.msgdata, split_chars, max_part_len);
-    }
-
-    /* convert to and the from gsm, so we drop all non GSM chars */
-    charset_utf8_to_gsm(msg->sms.msgdata);
-    charset_gsm_to_utf8(msg->sms.msgdata);
-
-    /* 
-     * else we need to do something special. I'll just get charset_gsm_truncate to
-     * cut the string to the required length and then count real characters. 
-     */
-     temp = octstr_duplicate(msg->sms.msgdata);
-     charset_utf8_to_gsm(temp);
-     charset_gsm_truncate(temp, max_part_len);
+    long i, len, rest, c;
 
-     /* calculate utf-8 length */
-     temp_utf = octstr_duplicate(temp);
-     charset_gsm_to_utf8(temp_utf);
-     max_part_len = octstr_len(temp_utf);
-
-     octstr_destroy(temp);
-     octstr_destroy(temp_utf);
+    rest = octstr_len(text) - start;
+    if (max_len <= 0)
+        return 0;
 
-     /* now just call the original extract_msgdata_part with the new length */
-     return extract_msgdata_part(msg->sms.msgdata, split_chars, max_part_len);
+    if (coding == DC_8BIT)
+        len = max_len;
+    else if (coding == DC_UCS2) {
+        len = max_len & ~1L;
+        if (len < rest && len >= 2) {
+            c = (octstr_get_char(text, start + len - 2) << 8) |
+                octstr_get_char(text, start + len - 1);
+            /* do not separate a high surrogate from the low one */
+            if (c >= 0xD800 && c <= 0xDBFF)
+                len -= 2;
+        }
+    } else
+        len = charset_utf8_gsm_span(text, start, max_len, NULL);
+
+    if (len >= rest)
+        return rest;
+
+    if (split_chars != NULL)
+        for (i = len; i > 0; i--) {
+            /* UCS-2 split characters are the ones below 256 */
+            if (coding == DC_UCS2 && 
+                (i % 2 != 0 || octstr_get_char(text, start + i - 2) != 0))
+                continue;
+            if (octstr_search_char(split_chars, 
+                                   octstr_get_char(text, start + i - 1), 0) != -1)
+                return i;
+        }
+    return len;
 }
 
 
@@ -305,17 +297,20 @@ List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
                 int max_messages, int max_octets)
 {
     long max_part_len, udh_len, hf_len, nlsuf_len;
+    long start, len, *ends, ends_size;
     unsigned long total_messages, msgno;
-    long last;
+    int coding, last;
     List *list;
-    Msg *part, *temp;
+    Msg *part;
+    Octstr *text, *msgdata;
 
     hf_len = octstr_len(header) + octstr_len(footer);
     nlsuf_len = octstr_len(nonlast_suffix);
     udh_len = octstr_len(orig->sms.udhdata);
+    coding = orig->sms.coding;
 
     /* First check whether the message is under one-part maximum */
-    if (orig->sms.coding == DC_8BIT || orig->sms.coding == DC_UCS2)
+    if (coding == DC_8BIT || coding == DC_UCS2)
         max_part_len = max_octets - udh_len - hf_len;
     else
         max_part_len = (max_octets - udh_len) * 8 / 7 - hf_len;
@@ -325,7 +320,7 @@ List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
         if (udh_len == 0)
             udh_len = 1;  /* Add the udh total length octet */
         udh_len += CATENATE_UDH_LEN;
-        if (orig->sms.coding == DC_8BIT || orig->sms.coding == DC_UCS2)
+        if (coding == DC_8BIT || coding == DC_UCS2)
             max_part_len = max_octets - udh_len - hf_len;
         else
             max_part_len = (max_octets - udh_len) * 8 / 7 - hf_len;
@@ -334,13 +329,52 @@ List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
     /* ensure max_part_len is never negativ */
     max_part_len = max_part_len > 0 ? max_part_len : 0;
 
-    temp = msg_duplicate(orig);
-    msgno = 0;
-    list = gwlist_create();
+    if (orig->sms.msgdata == NULL)
+        text = octstr_create("");
+    else
+        text = octstr_duplicate(orig->sms.msgdata);
+    /* convert to and the from gsm, so we drop all non GSM chars */
+    if (coding != DC_8BIT && coding != DC_UCS2 && !charset_utf8_is_gsm(text)) {
+        charset_utf8_to_gsm(text);
+        charset_gsm_to_utf8(text);
+    }
 
-    last = 0;
+    /* 
+     * Find where every part ends first, in one pass over the text. The
+     * last part has no room for the suffix of the others. 
+     */
+    ends_size = 16;
+    ends = gw_malloc(ends_size * sizeof(ends[0]));
+    total_messages = 0;
+    start = 0;
     do {
-        msgno++;
+        last = next_part_len(text, coding, start, max_part_len, NULL) ==
+               octstr_len(text) - start ||
+               (long) total_messages + 1 == max_messages;
+        if (last)
+            len = next_part_len(text, coding, start, max_part_len, 
+                                split_chars);
+        else
+            len = next_part_len(text, coding, start, 
+                                max_part_len - nlsuf_len, split_chars);
+        /* nothing fits, the rest of the text is lost anyway */
+        if (len == 0)
+            last = 1;
+        if (total_messages == (unsigned long) ends_size) {
+            ends_size *= 2;
+            ends = gw_realloc(ends, ends_size * sizeof(ends[0]));
+        }
+        start += len;
+        ends[total_messages++] = start;
+    } while (!last);
+
+    /* The parts get their own message data, so don't copy it for each. */
+    msgdata = orig->sms.msgdata;
+    orig->sms.msgdata = NULL;
+    list = gwlist_create();
+
+    start = 0;
+    for (msgno = 1; msgno <= total_messages; msgno++) {
         part = msg_duplicate(orig);
 
         /* 
@@ -352,35 +386,29 @@ List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
             part->sms.dlr_url = NULL;
             part->sms.dlr_mask = 0;
         }
-        octstr_destroy(part->sms.msgdata);
-        if (sms_msgdata_len(temp) <= max_part_len || msgno == max_messages)
-            last = 1;
 
-        part->sms.msgdata = 
-            extract_msgdata_part_by_coding(temp, split_chars,
-                                           max_part_len - nlsuf_len);
+        len = ends[msgno - 1] - start;
+        part->sms.msgdata = octstr_create("");
+        octstr_append(part->sms.msgdata, header);
+        octstr_append_data(part->sms.msgdata, 
+                           octstr_get_cstr(text) + start, len);
+        octstr_append(part->sms.msgdata, footer);
+        start += len;
+
         /* create new id for every part, except last */
-        if (!last)
+        if (msgno < total_messages) {
             uuid_generate(part->sms.id);
-
-        if (header)
-            octstr_insert(part->sms.msgdata, header, 0);
-        if (footer)
-            octstr_append(part->sms.msgdata, footer);
-        if (!last && nonlast_suffix)
             octstr_append(part->sms.msgdata, nonlast_suffix);
-        gwlist_append(list, part);
-    } while (!last);
-
-    total_messages = msgno;
-    msg_destroy(temp);
-    if (catenate && total_messages > 1) {
-        for (msgno = 1; msgno <= total_messages; msgno++) {
-            part = gwlist_get(list, msgno - 1);
-            prepend_catenation_udh(part, msgno, total_messages, msg_sequence);
         }
+        if (catenate && total_messages > 1)
+            prepend_catenation_udh(part, msgno, total_messages, msg_sequence);
+        gwlist_append(list, part);
     }
 
+    orig->sms.msgdata = msgdata;
+    octstr_destroy(text);
+    gw_free(ends);
+
     return list;
 }
 
@@ -408,3 +436,23 @@ int sms_priority_compare(const void *a, const void *b)
     return ret;
 }
 
+
+int sms_priority_level(const void *a)
+{
+    Msg *msg = (Msg*) a;
+
+    gw_assert(msg_type(msg) == sms);
+
+    if (msg->sms.priority < 0)
+        return 0;
+    if (msg->sms.priority >= SMS_PRIORITY_LEVELS)
+        return SMS_PRIORITY_LEVELS - 1;
+    return msg->sms.priority;
+}
+
+
+gw_levelqueue_t *sms_send_queue_create(void)
+{
+    return gw_levelqueue_create(SMS_PRIORITY_LEVELS, sms_priority_level);
+}
+
@@ -186,6 +186,10 @@ int sms_swap(Msg *msg);
  *
  * `max_octets' gives the maximum number of octets in on message, including
  * UDH, and after 7 bit characters have been packed into octets.
+ *
+ * Parts are never cut in the middle of a GSM escape sequence or of a UCS-2
+ * character or surrogate pair. The last part has room for all of the text
+ * that is left, since it gets no `nonlast_suffix'.
  */
 List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
                 Octstr *nonlast_suffix, Octstr *split_chars, int catenate,
@@ -197,4 +201,18 @@ List *sms_split(Msg *orig, Octstr *header, Octstr *footer,
  */
 int sms_priority_compare(const void *a, const void *b);
 
+/* count of distinct sms priorities, valid values are 0 .. 3 */
+#define SMS_PRIORITY_LEVELS 4
+
+/**
+ * Return priority of sms as level for gw_levelqueue, undefined
+ * priority maps to the lowest level.
+ */
+int sms_priority_level(const void *msg);
+
+/**
+ * Create priority aware send queue for SMSC drivers.
+ */
+gw_levelqueue_t *sms_send_queue_create(void);
+
 #endif
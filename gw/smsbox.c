@@ -107,12 +107,21 @@ volatile sig_atomic_t restart = 0;
 static Cfg *cfg;
 static long bb_port;
 static int bb_ssl = 0;
+static Octstr *bb_shm_dir = NULL;
+static long bb_shm_size = BB_DEFAULT_SHM_SIZE;
 static long sendsms_port = 0;
 static Octstr *sendsms_interface = NULL;
 static Octstr *smsbox_id = NULL;
 static Octstr *sendsms_url = NULL;
+static Octstr *sendsms_bulk_url = NULL;
+static long sendsms_bulk_threads = 4;
+static long sendsms_bulk_window = 1000;
 static Octstr *sendota_url = NULL;
 static Octstr *xmlrpc_url = NULL;
+static Octstr *metrics_url = NULL;
+static long metrics_interval = 5;
+static List *smsbox_metrics = NULL;
+static gw_metric_t *sendsms_requests_metric = NULL;
 static Octstr *bb_host;
 static Octstr *accepted_chars = NULL;
 static int only_try_http = 0;
@@ -142,14 +151,44 @@ static Semaphore *max_pending_requests;
 int charset_processing (Octstr *charset, Octstr *text, int coding);
 
 /* for delayed HTTP answers.
- * Dict key is uuid, value is HTTPClient pointer
+ * Map key is the uuid of the message, value is HTTPClient pointer
  * of open transaction
  */
 
 static int immediate_sendsms_reply = 0;
-static Dict *client_dict = NULL;
+static gw_uuidmap_t *client_acks = NULL;
 static List *sendsms_reply_hdrs = NULL;
 
+/*
+ * A bulk sendsms request, its lines sent by the bulk threads and
+ * answered in a streamed reply as bearerbox acknowledges them.
+ */
+typedef struct {
+    HTTPClient *client;
+    URLTranslation *trans;
+    Octstr *ip;
+    List *args;         /* variables of the url, defaults for every line */
+    Octstr *body;
+    long pos;           /* start of the next line to send */
+    long lines;         /* lines read so far */
+    long unanswered;    /* lines sent and not answered, plus one while
+                           there are lines left to send */
+    int broken;         /* the client is gone */
+    Mutex *lock;
+} BulkJob;
+
+typedef struct {
+    BulkJob *job;
+    long number;
+} BulkLine;
+
+static List *bulk_jobs = NULL;          /* bulk requests with lines to send */
+static gw_uuidmap_t *bulk_acks = NULL;  /* uuid to BulkLine waiting for an ack */
+static Semaphore *bulk_window = NULL;   /* lines that may wait for an ack */
+static List *bulk_reply_hdrs = NULL;
+
+static void bulk_line_answer(BulkLine *line, int status, Octstr *answer);
+
 /***********************************************************************
  * Communication with the bearerbox.
  */
@@ -175,18 +214,19 @@ static void identify_to_bearerbox(void)
  */
 static void delayed_http_reply(Msg *msg)
 {
-    HTTPClient *client;
-    Octstr *os, *answer;
+    HTTPClient *client = NULL;
+    BulkLine *line;
+    Octstr *answer;
     char id[UUID_STR_LEN + 1];
     int status;
 	  
     uuid_unparse(msg->ack.id, id);
-    os = octstr_create(id);
-    debug("sms.http", 0, "Got ACK (%ld) of %s", msg->ack.nack, octstr_get_cstr(os));
-    client = dict_remove(client_dict, os);
-    if (client == NULL) {
+    debug("sms.http", 0, "Got ACK (%ld) of %s", msg->ack.nack, id);
+    line = gw_uuidmap_remove(bulk_acks, msg->ack.id);
+    if (line == NULL && !immediate_sendsms_reply)
+        client = gw_uuidmap_remove(client_acks, msg->ack.id);
+    if (client == NULL && line == NULL) {
         debug("sms.http", 0, "No client - multi-send or ACK to pull-reply");
-        octstr_destroy(os);
         return;
     }
     /* XXX  this should be fixed so that we really wait for DLR
@@ -218,10 +258,12 @@ static void delayed_http_reply(Msg *msg)
         break;
     }
 
-    http_send_reply(client, status, sendsms_reply_hdrs, answer);
+    if (line != NULL)
+        bulk_line_answer(line, status, answer);
+    else
+        http_send_reply(client, status, sendsms_reply_hdrs, answer);
 
     octstr_destroy(answer);
-    octstr_destroy(os);
 }
 
 
@@ -243,9 +285,12 @@ static void read_messages_from_bearerbox(void)
         /* block infinite for reading messages */
         ret = read_from_bearerbox(&msg, INFINITE_TIME);
         if (ret == -1) {
-            error(0, "Bearerbox is gone, restarting");
-            program_status = shutting_down;
-            restart = 1;
+            /* the read is cut short when we are told to go down */
+            if (program_status != shutting_down) {
+                error(0, "Bearerbox is gone, restarting");
+                program_status = shutting_down;
+                restart = 1;
+            }
             break;
         } else if (ret == 1) /* timeout */
             continue;
@@ -271,7 +316,8 @@ static void read_messages_from_bearerbox(void)
 	    total++;
 	    gwlist_produce(smsbox_requests, msg);
 	} else if (msg_type(msg) == ack) {
-	    if (!immediate_sendsms_reply)
+	    /* bulk requests wait for the acks even with immediate replies */
+	    if (!immediate_sendsms_reply || gw_uuidmap_len(bulk_acks) > 0)
 		delayed_http_reply(msg);
 	    msg_destroy(msg);
 	} else {
@@ -1879,27 +1925,6 @@ static int pam_authorise_user(List *list)
 
 
 
-static Octstr* store_uuid(Msg *msg)
-{
-    char id[UUID_STR_LEN + 1];
-    Octstr *stored_uuid;
-
-    gw_assert(msg != NULL);
-    gw_assert(!immediate_sendsms_reply);
-    
-    uuid_unparse(msg->sms.id, id);
-    stored_uuid = octstr_create(id);
-
-    debug("sms.http", 0, "Stored UUID %s", octstr_get_cstr(stored_uuid));
-
-    /* this octstr is then used to store the HTTP client into 
-     * client_dict, if need to, in sendsms_thread */
-
-    return stored_uuid;
-}
-
-
-
 static Octstr *smsbox_req_handle(URLTranslation *t, Octstr *client_ip,
 				 HTTPClient *client,
 				 Octstr *from, Octstr *to, Octstr *text, 
@@ -1908,13 +1933,13 @@ static Octstr *smsbox_req_handle(URLTranslation *t, Octstr *client_ip,
 				 int validity, int deferred,
 				 int *status, int dlr_mask, Octstr *dlr_url, 
 				 Octstr *account, int pid, int alt_dcs, int rpi,
-				 List *receiver, Octstr *binfo, int priority, Octstr *meta_data)
+				 List *receiver, Octstr *binfo, int priority, Octstr *meta_data,
+				 BulkLine *bulk_line)
 {				     
     Msg *msg = NULL;
     Octstr *newfrom = NULL;
     Octstr *returnerror = NULL;
     Octstr *receiv;
-    Octstr *stored_uuid = NULL;
     List *failed_id = NULL;
     List *allowed = NULL;
     List *denied = NULL;
@@ -2248,10 +2273,11 @@ static Octstr *smsbox_req_handle(URLTranslation *t, Octstr *client_ip,
      */
     failed_id = gwlist_create();
 
-    if (!immediate_sendsms_reply) {
-        stored_uuid = store_uuid(msg);
-        dict_put(client_dict, stored_uuid, client);
-    }
+    /* park the client, or the line of a bulk request, until the ack */
+    if (bulk_line != NULL)
+        gw_uuidmap_put(bulk_acks, msg->sms.id, bulk_line);
+    else if (!immediate_sendsms_reply)
+        gw_uuidmap_put(client_acks, msg->sms.id, client);
 
     while ((receiv = gwlist_extract_first(allowed)) != NULL) {
 
@@ -2300,7 +2326,6 @@ static Octstr *smsbox_req_handle(URLTranslation *t, Octstr *client_ip,
         octstr_format_append(returnerror, " Message splits: %d", ret);
 
 cleanup:
-    octstr_destroy(stored_uuid);
     gwlist_destroy(failed_id, NULL);
     gwlist_destroy(allowed, NULL);
     gwlist_destroy(denied, NULL);
@@ -2323,8 +2348,17 @@ transmit_error:
     *status = HTTP_INTERNAL_SERVER_ERROR;
     returnerror = octstr_create("Sending failed.");
 
-    if (!immediate_sendsms_reply)
-        dict_remove(client_dict, stored_uuid);
+    /*
+     * An ack of the receivers sent may have answered already, then
+     * make it look accepted so no second answer is sent.
+     */
+    if (bulk_line != NULL) {
+        if (gw_uuidmap_remove(bulk_acks, msg->sms.id) == NULL)
+            *status = HTTP_ACCEPTED;
+    } else if (!immediate_sendsms_reply) {
+        if (gw_uuidmap_remove(client_acks, msg->sms.id) == NULL)
+            *status = HTTP_ACCEPTED;
+    }
 
     /* 
      * Append all receivers to the returned body in case this is
@@ -2411,13 +2445,14 @@ static URLTranslation *authorise_user(List *list, Octstr *client_ip)
 
 
 /*
- * Create and send an SMS message from an HTTP request.
- * Args: args contains the CGI parameters
+ * Create and send an SMS message from the CGI parameters in args, for
+ * an already authorised user. A bulk_line is answered when bearerbox
+ * acknowledges the message, instead of the client.
  */
-static Octstr *smsbox_req_sendsms(List *args, Octstr *client_ip, int *status,
-				  HTTPClient *client)
+static Octstr *smsbox_sendsms_args(URLTranslation *t, List *args,
+                                   Octstr *client_ip, int *status,
+                                   HTTPClient *client, BulkLine *bulk_line)
 {
-    URLTranslation *t = NULL;
     Octstr *tmp_string;
     Octstr *from, *to, *charset, *text, *udh, *smsc, *dlr_url, *account;
     Octstr *binfo, *meta_data;
@@ -2428,13 +2463,6 @@ static Octstr *smsbox_req_sendsms(List *args, Octstr *client_ip, int *status,
     mclass = mwi = coding = compress = validity = deferred = dlr_mask = 
         pid = alt_dcs = rpi = priority = SMS_PARAM_UNDEFINED;
  
-    /* check the username and password */
-    t = authorise_user(args, client_ip);
-    if (t == NULL) {
-	*status = HTTP_FORBIDDEN;
-	return octstr_create("Authorization failed for sendsms");
-    }
-    
     udh = http_cgi_variable(args, "udh");
     text = http_cgi_variable(args, "text");
     charset = http_cgi_variable(args, "charset");
@@ -2518,11 +2546,32 @@ static Octstr *smsbox_req_sendsms(List *args, Octstr *client_ip, int *status,
     return smsbox_req_handle(t, client_ip, client, from, to, text, charset, udh,
 			     smsc, mclass, mwi, coding, compress, validity, 
 			     deferred, status, dlr_mask, dlr_url, account,
-			     pid, alt_dcs, rpi, NULL, binfo, priority, meta_data);
+			     pid, alt_dcs, rpi, NULL, binfo, priority, meta_data,
+			     bulk_line);
     
 }
 
 
+/*
+ * Create and send an SMS message from an HTTP request.
+ * Args: args contains the CGI parameters
+ */
+static Octstr *smsbox_req_sendsms(List *args, Octstr *client_ip, int *status,
+				  HTTPClient *client)
+{
+    URLTranslation *t = NULL;
+
+    /* check the username and password */
+    t = authorise_user(args, client_ip);
+    if (t == NULL) {
+	*status = HTTP_FORBIDDEN;
+	return octstr_create("Authorization failed for sendsms");
+    }
+
+    return smsbox_sendsms_args(t, args, client_ip, status, client, NULL);
+}
+
+
 /*
  * Create and send an SMS message from an HTTP request.
  * Args: args contains the CGI parameters
@@ -2623,7 +2672,7 @@ static Octstr *smsbox_sendsms_post(List *headers, Octstr *body,
 				    udh, smsc, mclass, mwi, coding, compress, 
 				    validity, deferred, status, dlr_mask, 
 				    dlr_url, account, pid, alt_dcs, rpi, tolist,
-				    binfo, priority, meta_data);
+				    binfo, priority, meta_data, NULL);
 
     }
 error2:
@@ -2736,7 +2785,6 @@ static Octstr *smsbox_req_sendota(List *list, Octstr *client_ip, int *status,
     Octstr *id, *from, *phonenumber, *smsc, *ota_doc, *doc_type, *account;
     CfgGroup *grp;
     Octstr *returnerror;
-    Octstr *stored_uuid = NULL;
     List *grplist;
     Octstr *p;
     URLTranslation *t;
@@ -2888,10 +2936,8 @@ send:
     info(0, "%s <%s> <%s>", octstr_get_cstr(sendota_url), 
     	 id ? octstr_get_cstr(id) : "<default>", octstr_get_cstr(phonenumber));
 
-    if (!immediate_sendsms_reply) {
-        stored_uuid = store_uuid(msg);
-        dict_put(client_dict, stored_uuid, client);
-    }
+    if (!immediate_sendsms_reply)
+        gw_uuidmap_put(client_acks, msg->sms.id, client);
 
     ret = send_message(t, msg); 
 
@@ -2899,14 +2945,15 @@ send:
         error(0, "sendota_request: failed");
         *status = HTTP_INTERNAL_SERVER_ERROR;
         returnerror = octstr_create("Sending failed.");
-        dict_remove(client_dict, stored_uuid);
+        if (!immediate_sendsms_reply &&
+            gw_uuidmap_remove(client_acks, msg->sms.id) == NULL)
+            *status = HTTP_ACCEPTED;    /* answered by an ack already */
     } else {
         *status = HTTP_ACCEPTED;
         returnerror = octstr_create("Sent.");
     }
 
     msg_destroy(msg);
-    octstr_destroy(stored_uuid);
 
     return returnerror;
 }
@@ -2927,7 +2974,6 @@ static Octstr *smsbox_sendota_post(List *headers, Octstr *body,
     Octstr *name, *val, *ret;
     Octstr *from, *to, *id, *user, *pass, *smsc;
     Octstr *type, *charset, *doc_type, *ota_doc, *sec, *pin;
-    Octstr *stored_uuid = NULL;
     URLTranslation *t;
     Msg *msg;
     long l;
@@ -3077,10 +3123,8 @@ static Octstr *smsbox_sendota_post(List *headers, Octstr *body,
 		 id ? octstr_get_cstr(id) : "XML", octstr_get_cstr(to));
     
 
-        if (!immediate_sendsms_reply) {
-            stored_uuid = store_uuid(msg);
-            dict_put(client_dict, stored_uuid, client);
-        }
+	    if (!immediate_sendsms_reply)
+		gw_uuidmap_put(client_acks, msg->sms.id, client);
 
 	    r = send_message(t, msg); 
 
@@ -3088,15 +3132,15 @@ static Octstr *smsbox_sendota_post(List *headers, Octstr *body,
             error(0, "sendota_request: failed");
             *status = HTTP_INTERNAL_SERVER_ERROR;
             ret = octstr_create("Sending failed.");
-            if (!immediate_sendsms_reply) 
-                dict_remove(client_dict, stored_uuid);
+            if (!immediate_sendsms_reply &&
+                gw_uuidmap_remove(client_acks, msg->sms.id) == NULL)
+                *status = HTTP_ACCEPTED;    /* answered by an ack already */
        } else  {
             *status = HTTP_ACCEPTED;
             ret = octstr_create("Sent.");
 	    }
 
        msg_destroy(msg);
-       octstr_destroy(stored_uuid);
 
 	}
     }    
@@ -3110,6 +3154,255 @@ error:
 }
 
 
+/***********************************************************************
+ * Bulk sendsms. The body of a POST to the bulk url holds one message
+ * per line, as the CGI variables of a sendsms request. The variables
+ * of the url apply to every line and carry the username and password,
+ * checked once for the request. The lines are sent by a pool of bulk
+ * threads, and the reply streams "<line>: <status> <answer>" for each
+ * as bearerbox acknowledges it. No more than sendsms-bulk-window lines
+ * wait for an ack at any time, so a bulk sender goes no faster than
+ * bearerbox takes its messages.
+ */
+
+static void bulk_job_release(BulkJob *job)
+{
+    int done;
+
+    mutex_lock(job->lock);
+    done = (--job->unanswered == 0);
+    mutex_unlock(job->lock);
+    if (!done)
+        return;
+
+    info(0, "%s: %ld lines from <%s> answered",
+         octstr_get_cstr(sendsms_bulk_url), job->lines, octstr_get_cstr(job->ip));
+    http_send_reply_end(job->client);
+    octstr_destroy(job->ip);
+    http_destroy_cgiargs(job->args);
+    octstr_destroy(job->body);
+    mutex_destroy(job->lock);
+    gw_free(job);
+}
+
+
+static void bulk_line_answer(BulkLine *line, int status, Octstr *answer)
+{
+    BulkJob *job = line->job;
+    Octstr *os;
+
+    os = octstr_format("%ld: %d %S\n", line->number, status, answer);
+    mutex_lock(job->lock);
+    if (!job->broken && http_send_reply_chunk(job->client, os) == -1) {
+        warning(0, "%s: client <%s> is gone, dropping the rest of its lines",
+                octstr_get_cstr(sendsms_bulk_url), octstr_get_cstr(job->ip));
+        job->broken = 1;
+    }
+    mutex_unlock(job->lock);
+    octstr_destroy(os);
+
+    gw_free(line);
+    semaphore_up(bulk_window);
+    bulk_job_release(job);
+}
+
+
+/*
+ * Take the next non-empty line of a bulk request, with the job locked.
+ * Return NULL when there is none left.
+ */
+static Octstr *bulk_next_line(BulkJob *job, long *number)
+{
+    Octstr *line;
+    long eol;
+
+    while (!job->broken && job->pos < octstr_len(job->body)) {
+        eol = octstr_search_char(job->body, '\n', job->pos);
+        if (eol == -1)
+            eol = octstr_len(job->body);
+        line = octstr_copy(job->body, job->pos, eol - job->pos);
+        job->pos = eol + 1;
+        job->lines++;
+
+        octstr_strip_blanks(line);
+        if (octstr_len(line) > 0) {
+            *number = job->lines;
+            job->unanswered++;
+            return line;
+        }
+        octstr_destroy(line);
+    }
+    return NULL;
+}
+
+
+static void bulk_send_line(BulkLine *line, Octstr *text)
+{
+    BulkJob *job = line->job;
+    List *args;
+    Octstr *answer;
+    long i, own;
+    int status;
+
+    /* the line's own variables come first, those of the url after them */
+    args = http_parse_cgiargs(text);
+    own = gwlist_len(args);
+    for (i = 0; i < gwlist_len(job->args); i++)
+        gwlist_append(args, gwlist_get(job->args, i));
+
+    answer = smsbox_sendsms_args(job->trans, args, job->ip, &status,
+                                 NULL, line);
+
+    gwlist_delete(args, own, gwlist_len(args) - own);
+    http_destroy_cgiargs(args);
+
+    /* accepted lines are answered by the ack from bearerbox */
+    if (status != HTTP_ACCEPTED)
+        bulk_line_answer(line, status, answer);
+    octstr_destroy(answer);
+}
+
+
+static void sendsms_bulk_thread(void *arg)
+{
+    BulkJob *job;
+    BulkLine *line;
+    Octstr *text;
+    long number;
+
+    while ((job = gwlist_consume(bulk_jobs)) != NULL) {
+        mutex_lock(job->lock);
+        if (program_status == shutting_down)
+            job->pos = octstr_len(job->body);
+        text = bulk_next_line(job, &number);
+        mutex_unlock(job->lock);
+
+        if (text == NULL) {
+            bulk_job_release(job);
+            continue;
+        }
+
+        /* let the other bulk threads send the following lines meanwhile */
+        gwlist_produce(bulk_jobs, job);
+
+        line = gw_malloc(sizeof(*line));
+        line->job = job;
+        line->number = number;
+
+        semaphore_down(bulk_window);
+        if (program_status == shutting_down)
+            bulk_line_answer(line, HTTP_SERVICE_UNAVAILABLE,
+                             octstr_imm("Temporal failure, try again later."));
+        else
+            bulk_send_line(line, text);
+        octstr_destroy(text);
+    }
+}
+
+
+/*
+ * Start a bulk request. Return NULL if its reply is streamed by the bulk
+ * threads, which then own body and args, otherwise an answer to send.
+ */
+static Octstr *smsbox_sendsms_bulk(List *args, Octstr *body, Octstr *client_ip,
+                                   int *status, HTTPClient *client)
+{
+    URLTranslation *t;
+    BulkJob *job;
+
+    if (body == NULL) {
+        *status = HTTP_BAD_REQUEST;
+        return octstr_create("Bulk sendsms needs a POST body.");
+    }
+    if (program_status == shutting_down) {
+        *status = HTTP_SERVICE_UNAVAILABLE;
+        return octstr_create("Temporal failure, try again later.");
+    }
+
+    /* check the username and password */
+    t = authorise_user(args, client_ip);
+    if (t == NULL) {
+        *status = HTTP_FORBIDDEN;
+        return octstr_create("Authorization failed for sendsms");
+    }
+
+    job = gw_malloc(sizeof(*job));
+    job->client = client;
+    job->trans = t;
+    job->ip = octstr_duplicate(client_ip);
+    job->args = args;
+    job->body = body;
+    job->pos = 0;
+    job->lines = 0;
+    job->unanswered = 1;
+    job->broken = 0;
+    job->lock = mutex_create();
+
+    *status = HTTP_OK;
+    http_send_reply_start(client, HTTP_OK, bulk_reply_hdrs);
+    gwlist_produce(bulk_jobs, job);
+
+    return NULL;
+}
+
+
+/*
+ * The bulk threads run only if bulk sendsms is enabled. The ack path
+ * looks up bulk_acks for every ack, so it exists either way.
+ */
+static void start_bulk(void)
+{
+    long i;
+
+    bulk_jobs = gwlist_create();
+    gwlist_add_producer(bulk_jobs);
+    bulk_acks = gw_uuidmap_create(sendsms_bulk_window);
+    bulk_window = semaphore_create(sendsms_bulk_window);
+    bulk_reply_hdrs = http_create_empty_headers();
+    http_header_add(bulk_reply_hdrs, "Content-type", "text/plain");
+    http_header_add(bulk_reply_hdrs, "Pragma", "no-cache");
+    http_header_add(bulk_reply_hdrs, "Cache-Control", "no-cache");
+
+    if (sendsms_bulk_url == NULL)
+        return;
+    for (i = 0; i < sendsms_bulk_threads; i++)
+        gwthread_create(sendsms_bulk_thread, NULL);
+}
+
+
+/*
+ * Answer what is left of the bulk requests, before their clients go
+ * away with the sendsms port.
+ */
+static void stop_bulk(void)
+{
+    List *lines;
+    BulkLine *line;
+    long i;
+
+    gwlist_remove_producer(bulk_jobs);
+    for (i = 0; i < sendsms_bulk_threads; i++)
+        semaphore_up(bulk_window);
+    gwthread_join_every(sendsms_bulk_thread);
+
+    /* no more acks will come for the lines still waiting */
+    lines = gw_uuidmap_remove_all(bulk_acks);
+    while ((line = gwlist_extract_first(lines)) != NULL)
+        bulk_line_answer(line, HTTP_SERVICE_UNAVAILABLE,
+                         octstr_imm("Temporal failure, try again later."));
+    gwlist_destroy(lines, NULL);
+}
+
+
+static void destroy_bulk(void)
+{
+    gwlist_destroy(bulk_jobs, NULL);
+    gw_uuidmap_destroy(bulk_acks);
+    semaphore_destroy(bulk_window);
+    http_destroy_headers(bulk_reply_hdrs);
+}
+
+
 static void sendsms_thread(void *arg)
  {
     HTTPClient *client;
@@ -3130,6 +3423,24 @@ static void sendsms_thread(void *arg)
          * call the necessary routine for it
          */
 
+        /* metrics, pre-rendered by the refresh thread */
+        if (octstr_compare(url, metrics_url) == 0) {
+            List *reply_hdrs = http_create_empty_headers();
+            http_header_add(reply_hdrs, "Content-Type", "text/plain; version=0.0.4");
+            answer = gw_metrics_snapshot();
+            http_send_reply(client, HTTP_OK, reply_hdrs, answer);
+            http_destroy_headers(reply_hdrs);
+            octstr_destroy(answer);
+            octstr_destroy(ip);
+            octstr_destroy(url);
+            http_destroy_headers(hdrs);
+            octstr_destroy(body);
+            http_destroy_cgiargs(args);
+            continue;
+        }
+
+        gw_metric_increase(sendsms_requests_metric);
+
         /* sendsms */
         if (octstr_compare(url, sendsms_url) == 0) {
             /*
@@ -3141,6 +3452,13 @@ static void sendsms_thread(void *arg)
             else
                 answer = smsbox_sendsms_post(hdrs, body, ip, &status, client);
         }
+        /* bulk sendsms */
+        else if (sendsms_bulk_url != NULL &&
+                 octstr_compare(url, sendsms_bulk_url) == 0) {
+            answer = smsbox_sendsms_bulk(args, body, ip, &status, client);
+            if (answer == NULL)
+                body = NULL, args = NULL;
+        }
         /* XML-RPC */
         else if (octstr_compare(url, xmlrpc_url) == 0) {
             /*
@@ -3174,7 +3492,9 @@ static void sendsms_thread(void *arg)
         octstr_destroy(body);
         http_destroy_cgiargs(args);
 
-        if (immediate_sendsms_reply || status != HTTP_ACCEPTED)
+        if (answer == NULL)
+            debug("sms.http", 0, "Bulk reply - streamed by the bulk threads");
+        else if (immediate_sendsms_reply || status != HTTP_ACCEPTED)
             http_send_reply(client, status, sendsms_reply_hdrs, answer);
         else {
             debug("sms.http", 0, "Delayed reply - wait for bearerbox");
@@ -3185,6 +3505,65 @@ static void sendsms_thread(void *arg)
 }
 
 
+/***********************************************************************
+ * Metrics exported at the metrics-url of the sendsms port.
+ */
+
+static double metric_counter(void *arg)
+{
+    return counter_value(arg);
+}
+
+
+static double metric_queue(void *arg)
+{
+    return gwlist_len(arg);
+}
+
+
+static void start_metrics(void)
+{
+    Octstr *label;
+
+    smsbox_metrics = gwlist_create();
+    gwlist_append(smsbox_metrics, gw_metrics_callback("kannel_smsbox_outstanding_requests",
+                  "Messages sent to bearerbox and waiting for an ack.", GW_METRIC_GAUGE,
+                  NULL, metric_counter, num_outstanding_requests));
+    gwlist_append(smsbox_metrics, gw_metrics_callback("kannel_smsbox_concatenated_sms_total",
+                  "Concatenated messages split by smsbox.", GW_METRIC_COUNTER,
+                  NULL, metric_counter, catenated_sms_counter));
+
+    label = gw_metrics_label("queue", octstr_imm("requests"));
+    gwlist_append(smsbox_metrics, gw_metrics_callback("kannel_smsbox_queue_length",
+                  "Messages waiting in the smsbox queues.", GW_METRIC_GAUGE,
+                  label, metric_queue, smsbox_requests));
+    octstr_destroy(label);
+    label = gw_metrics_label("queue", octstr_imm("http"));
+    gwlist_append(smsbox_metrics, gw_metrics_callback("kannel_smsbox_queue_length",
+                  "Messages waiting in the smsbox queues.", GW_METRIC_GAUGE,
+                  label, metric_queue, smsbox_http_requests));
+    octstr_destroy(label);
+
+    sendsms_requests_metric = gw_metrics_counter("kannel_smsbox_sendsms_requests_total",
+        "Requests received at the sendsms port.", NULL);
+    gwlist_append(smsbox_metrics, sendsms_requests_metric);
+
+    gw_metrics_start(metrics_interval);
+}
+
+
+static void stop_metrics(void)
+{
+    gw_metric_t *metric;
+
+    sendsms_requests_metric = NULL;
+    while ((metric = gwlist_extract_first(smsbox_metrics)) != NULL)
+        gw_metrics_unregister(metric);
+    gwlist_destroy(smsbox_metrics, NULL);
+    smsbox_metrics = NULL;
+}
+
+
 /***********************************************************************
  * Main program. Configuration, signal handling, etc.
  */
@@ -3274,6 +3653,8 @@ static Cfg *init_smsbox(Cfg *cfg)
 #ifdef HAVE_LIBSSL
     cfg_get_bool(&bb_ssl, grp, octstr_imm("smsbox-port-ssl"));
 #endif /* HAVE_LIBSSL */
+    bb_shm_dir = cfg_get(grp, octstr_imm("box-shm-directory"));
+    cfg_get_integer(&bb_shm_size, grp, octstr_imm("box-shm-size"));
 
     cfg_get_integer(&http_proxy_port, grp, octstr_imm("http-proxy-port"));
 #ifdef HAVE_LIBSSL
@@ -3380,10 +3761,25 @@ static Cfg *init_smsbox(Cfg *cfg)
      */
     if ((sendsms_url = cfg_get(grp, octstr_imm("sendsms-url"))) == NULL)
         sendsms_url = octstr_imm("/cgi-bin/sendsms");
+    /* bulk sendsms is served only if its url is set */
+    sendsms_bulk_url = cfg_get(grp, octstr_imm("sendsms-bulk-url"));
+    if (cfg_get_integer(&sendsms_bulk_threads, grp, octstr_imm("sendsms-bulk-threads")) == -1)
+        sendsms_bulk_threads = 4;
+    if (sendsms_bulk_threads <= 0) {
+        octstr_destroy(sendsms_bulk_url);
+        sendsms_bulk_url = NULL;
+    }
+    if (cfg_get_integer(&sendsms_bulk_window, grp, octstr_imm("sendsms-bulk-window")) == -1 ||
+        sendsms_bulk_window < 1)
+        sendsms_bulk_window = 1000;
     if ((xmlrpc_url = cfg_get(grp, octstr_imm("xmlrpc-url"))) == NULL)
         xmlrpc_url = octstr_imm("/cgi-bin/xmlrpc");
     if ((sendota_url = cfg_get(grp, octstr_imm("sendota-url"))) == NULL)
         sendota_url = octstr_imm("/cgi-bin/sendota");
+    if ((metrics_url = cfg_get(grp, octstr_imm("metrics-url"))) == NULL)
+        metrics_url = octstr_imm("/metrics");
+    if (cfg_get_integer(&metrics_interval, grp, octstr_imm("metrics-interval")) == -1)
+        metrics_interval = 5;
 
     global_sender = cfg_get(grp, octstr_imm("global-sender"));
     accepted_chars = cfg_get(grp, octstr_imm("sendsms-chars"));
@@ -3443,6 +3839,8 @@ static Cfg *init_smsbox(Cfg *cfg)
     cfg_get_integer(&max_http_retries, grp, octstr_imm("http-request-retry"));
     cfg_get_integer(&http_queue_delay, grp, octstr_imm("http-queue-delay"));
 
+    start_bulk();
+
     if (sendsms_port > 0) {
         if (http_open_port_if(sendsms_port, ssl, sendsms_interface) == -1) {	
             if (only_try_http)
@@ -3537,7 +3935,7 @@ int main(int argc, char **argv)
     if (urltrans_add_cfg(translations, cfg) == -1)
 	panic(0, "urltrans_add_cfg failed");
 
-    client_dict = dict_create(32, NULL);
+    client_acks = gw_uuidmap_create(1024);
     sendsms_reply_hdrs = http_create_empty_headers();
     http_header_add(sendsms_reply_hdrs, "Content-type", "text/html");
     http_header_add(sendsms_reply_hdrs, "Pragma", "no-cache");
@@ -3551,12 +3949,15 @@ int main(int argc, char **argv)
     gwlist_add_producer(smsbox_http_requests);
     num_outstanding_requests = counter_create();
     catenated_sms_counter = counter_create();
+    start_metrics();
     gwthread_create(obey_request_thread, NULL);
     gwthread_create(url_result_thread, NULL);
     gwthread_create(http_queue_thread, NULL);
 
     connect_to_bearerbox(bb_host, bb_port, bb_ssl, NULL /* bb_our_host */);
 	/* XXX add our_host if required */
+    if (bb_shm_dir != NULL)
+        offer_shm_to_bearerbox(bb_shm_dir, bb_shm_size);
 
     if (0 > heartbeat_start(write_to_bearerbox, heartbeat_freq,
 				       outstanding_requests)) {
@@ -3569,6 +3970,7 @@ int main(int argc, char **argv)
     info(0, GW_NAME " smsbox terminating.");
 
     heartbeat_stop(ALL_HEARTBEATS);
+    stop_bulk();
     http_close_all_ports();
     gwthread_join_every(sendsms_thread);
     gwlist_remove_producer(smsbox_requests);
@@ -3586,15 +3988,19 @@ int main(int argc, char **argv)
     gwlist_destroy(smsbox_requests, NULL);
     gwlist_destroy(smsbox_http_requests, NULL);
     http_caller_destroy(caller);
+    stop_metrics();
     counter_destroy(num_outstanding_requests);
     counter_destroy(catenated_sms_counter);
     octstr_destroy(bb_host);
+    octstr_destroy(bb_shm_dir);
     octstr_destroy(global_sender);
     octstr_destroy(accepted_chars);
     octstr_destroy(smsbox_id);
     octstr_destroy(sendsms_url);
+    octstr_destroy(sendsms_bulk_url);
     octstr_destroy(sendota_url);
     octstr_destroy(xmlrpc_url);
+    octstr_destroy(metrics_url);
     octstr_destroy(reply_emptymessage);
     octstr_destroy(reply_requestfailed);
     octstr_destroy(reply_couldnotfetch);
@@ -3608,7 +4014,8 @@ int main(int argc, char **argv)
     semaphore_destroy(max_pending_requests);
     cfg_destroy(cfg);
 
-    dict_destroy(client_dict); 
+    gw_uuidmap_destroy(client_acks);
+    destroy_bulk();
     http_destroy_headers(sendsms_reply_hdrs);
 
     /* 
@@ -1408,7 +1408,7 @@ reconnect:
             memory_poll_timeout = time(NULL);
         }
 
-        if (gw_prioqueue_len(privdata->outgoing_queue) > 0) {
+        if (gw_levelqueue_len(privdata->outgoing_queue) > 0) {
             at2_send_messages(privdata);
             idle_timeout = time(NULL);
         }
@@ -1431,7 +1431,7 @@ reconnect:
     octstr_destroy(privdata->username);
     octstr_destroy(privdata->password);
     octstr_destroy(privdata->rawtcp_host);
-    gw_prioqueue_destroy(privdata->outgoing_queue, NULL);
+    gw_levelqueue_destroy(privdata->outgoing_queue, NULL);
     gwlist_destroy(privdata->pending_incoming_messages, octstr_destroy_item);
     load_destroy(privdata->load);
     gw_free(conn->data);
@@ -1464,7 +1464,7 @@ static int at2_shutdown_cb(SMSCConn *conn, int finish_sending)
      */
     if (finish_sending == 0) {
         Msg *msg;
-        while ((msg = gw_prioqueue_remove(privdata->outgoing_queue)) != NULL) {
+        while ((msg = gw_levelqueue_remove(privdata->outgoing_queue)) != NULL) {
             bb_smscconn_send_failed(conn, msg, SMSCCONN_FAILED_SHUTDOWN, NULL);
         }
     }
@@ -1480,7 +1480,7 @@ static long at2_queued_cb(SMSCConn *conn)
 
     privdata = conn->data;
     conn->load = (privdata ? (conn->status != SMSCCONN_DEAD ?        
-                  gw_prioqueue_len(privdata->outgoing_queue) : 0) : 0);
+                  gw_levelqueue_len(privdata->outgoing_queue) : 0) : 0);
     return conn->load;               
 } 
 
@@ -1503,7 +1503,7 @@ static int at2_add_msg_cb(SMSCConn *conn, Msg *sms)
     PrivAT2data *privdata;
 
     privdata = conn->data;
-    gw_prioqueue_produce(privdata->outgoing_queue, msg_duplicate(sms));
+    gw_levelqueue_produce(privdata->outgoing_queue, msg_duplicate(sms));
     gwthread_wakeup(privdata->device_thread);
     return 0;
 }
@@ -1517,7 +1517,7 @@ int smsc_at2_create(SMSCConn *conn, CfgGroup *cfg)
 
     privdata = gw_malloc(sizeof(PrivAT2data));
     memset(privdata, 0, sizeof(PrivAT2data));
-    privdata->outgoing_queue = gw_prioqueue_create(sms_priority_compare);
+    privdata->outgoing_queue = sms_send_queue_create();
     privdata->pending_incoming_messages = gwlist_create();
 
     privdata->configfile = cfg_get_configfile(cfg);
@@ -1650,7 +1650,7 @@ error:
     error(0, "AT2[%s]: Failed to create at2 smsc connection",
           octstr_len(privdata->name) ? octstr_get_cstr(privdata->name) : "");
     if (privdata != NULL) {
-        gw_prioqueue_destroy(privdata->outgoing_queue, NULL);
+        gw_levelqueue_destroy(privdata->outgoing_queue, NULL);
     }
     gw_free(privdata);
     conn->why_killed = SMSCCONN_KILLED_CANNOT_CONNECT;
@@ -2207,14 +2207,14 @@ static void at2_send_messages(PrivAT2data *privdata)
 {
     Msg *msg;
 
-    if (privdata->modem->enable_mms && gw_prioqueue_len(privdata->outgoing_queue) > 1)                  
+    if (privdata->modem->enable_mms && gw_levelqueue_len(privdata->outgoing_queue) > 1)                  
         at2_send_modem_command(privdata, "AT+CMMS=2", 0, 0);
 
     if (privdata->conn->throughput > 0 && load_get(privdata->load, 0) >= privdata->conn->throughput) {
       debug("bb.sms.at2", 0, "AT2[%s]: throughput limit exceeded (load: %.02f, throughput: %.02f)",
             octstr_get_cstr(privdata->conn->id), load_get(privdata->load, 0), privdata->conn->throughput);
     } else {
-      if ((msg = gw_prioqueue_remove(privdata->outgoing_queue))) {                 
+      if ((msg = gw_levelqueue_remove(privdata->outgoing_queue))) {                 
           load_increase(privdata->load);
           at2_send_one_message(privdata, msg);
       }
@@ -2305,6 +2305,8 @@ static void at2_send_one_message(PrivAT2data *privdata, Msg *msg)
                 }
             }               
 
+            bb_smscconn_submitted(privdata->conn, msg);
+
             /* wait 20 secs for modem command */
             ret = at2_wait_modem_command(privdata, 20, 0, &msg_id);
             debug("bb.smsc.at2", 0, "AT2[%s]: send command status: %d",
@@ -117,7 +117,7 @@ typedef struct ModemDef {
 } ModemDef;
 
 typedef struct PrivAT2data {
-    gw_prioqueue_t *outgoing_queue;
+    gw_levelqueue_t *outgoing_queue;
     ModemDef *modem;
     long device_thread;
     int	shutdown; /* Internal signal to shut down */
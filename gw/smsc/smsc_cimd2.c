@@ -114,7 +114,7 @@ typedef struct privdata {
 
     time_t  next_ping;
 
-    List *outgoing_queue;
+    gw_levelqueue_t *outgoing_queue;
     SMSCConn *conn;
     int io_thread;
     int quitting;
@@ -1946,7 +1946,7 @@ static void cimd2_destroy(PrivData *pdata)
                 discarded);
 
     gwlist_destroy(pdata->received, msg_destroy_item);
-    gwlist_destroy(pdata->outgoing_queue, NULL);
+    gw_levelqueue_destroy(pdata->outgoing_queue, NULL);
     gwlist_destroy(pdata->stopped, NULL);
 
     gw_free(pdata);
@@ -1974,6 +1974,7 @@ static int cimd2_submit_msg(SMSCConn *conn, Msg *msg)
         return -1;
     }
 
+    bb_smscconn_submitted(conn, msg);
     ret = cimd2_request(packet, conn, &ts);
     if((ret == 0) && (ts) && DLR_IS_SUCCESS_OR_FAIL(msg->sms.dlr_mask) && !pdata->no_dlr) {
         dlr_add(conn->name, ts, msg);
@@ -2165,6 +2166,7 @@ static void io_thread (void *arg)
     SMSCConn  *conn = arg;
     PrivData *pdata = conn->data;
     double    sleep = 0.0001;
+    double    throttle;
 
     /* Make sure we log into our own log-file if defined */
     log_thread_to(conn->log_idx);
@@ -2205,15 +2207,26 @@ static void io_thread (void *arg)
         } while (msg);
  
         /* send messages */
+        throttle = 0;
         do {
-            msg = gwlist_extract_first(pdata->outgoing_queue);
+            /* obey throughput speed limit, if any */
+            if (conn->throughput_bucket != NULL && gw_levelqueue_len(pdata->outgoing_queue) > 0 &&
+                !gw_tokenbucket_take(conn->throughput_bucket, 1)) {
+                throttle = gw_tokenbucket_wait_time(conn->throughput_bucket, 1);
+                break;
+            }
+            msg = gw_levelqueue_remove(pdata->outgoing_queue);
             if (msg) {
                 sleep = 0;
                 if (cimd2_submit_msg(conn,msg) != 0) break;
             }
         } while (msg);
  
-        if (sleep > 0) {
+        if (throttle > 0) {
+            /* sleep exactly until next message may be sent */
+            gwthread_sleep(throttle);
+        }
+        else if (sleep > 0) {
 
             /* note that this implementations means that we sleep even
              * when we fail connection.. but time is very short, anyway
@@ -2240,7 +2253,7 @@ static int cimd2_add_msg_cb (SMSCConn *conn, Msg *sms)
     Msg *copy;
 
     copy = msg_duplicate(sms);
-    gwlist_produce(pdata->outgoing_queue, copy);
+    gw_levelqueue_produce(pdata->outgoing_queue, copy);
     gwthread_wakeup(pdata->io_thread);
 
     return 0;
@@ -2263,7 +2276,7 @@ static int cimd2_shutdown_cb (SMSCConn *conn, int finish_sending)
 
     if (finish_sending == 0) {
         Msg *msg;
-        while ((msg = gwlist_extract_first(pdata->outgoing_queue)) != NULL) {
+        while ((msg = gw_levelqueue_remove(pdata->outgoing_queue)) != NULL) {
             bb_smscconn_send_failed(conn, msg, SMSCCONN_FAILED_SHUTDOWN, NULL);
         }
     }
@@ -2312,7 +2325,7 @@ static long cimd2_queued_cb (SMSCConn *conn)
 {
     PrivData *pdata = conn->data;
     conn->load = (pdata ? (conn->status != SMSCCONN_DEAD ? 
-                  gwlist_len(pdata->outgoing_queue) : 0) : 0);
+                  gw_levelqueue_len(pdata->outgoing_queue) : 0) : 0);
     return conn->load; 
 }
 
@@ -2333,9 +2346,9 @@ int smsc_cimd2_create(SMSCConn *conn, CfgGroup *grp)
     pdata->inbuffer = octstr_create("");
     pdata->send_seq = 1;
     pdata->receive_seq = 0;
-    pdata->outgoing_queue = gwlist_create();
+    pdata->outgoing_queue = sms_send_queue_create();
     pdata->stopped = gwlist_create();
-    gwlist_add_producer(pdata->outgoing_queue);
+    gw_levelqueue_add_producer(pdata->outgoing_queue);
 
     if (conn->is_stopped)
       gwlist_add_producer(pdata->stopped);
@@ -94,7 +94,7 @@
 
 typedef struct privdata {
     Octstr	*name;
-    gw_prioqueue_t *outgoing_queue;
+    gw_levelqueue_t *outgoing_queue;
     long	receiver_thread;
     long	sender_thread;
     int		shutdown;	  /* Internal signal to shut down */
@@ -284,7 +284,7 @@ static Connection *open_send_connection(SMSCConn *conn)
 
     while (!privdata->shutdown) {
 
-    while ((msg = gw_prioqueue_remove(privdata->outgoing_queue))) {
+    while ((msg = gw_levelqueue_remove(privdata->outgoing_queue))) {
         bb_smscconn_send_failed(conn, msg,
                          SMSCCONN_FAILED_TEMPORARILY, NULL);
     }
@@ -925,7 +925,7 @@ static void clear_sent(PrivData *privdata)
 	  octstr_get_cstr(privdata->name));
     for (i = 0; i < EMI2_MAX_TRN; i++) {
 	if (privdata->slots[i].sendtime && privdata->slots[i].sendtype == 51)
-	    gw_prioqueue_produce(privdata->outgoing_queue, privdata->slots[i].sendmsg);
+	    gw_levelqueue_insert_head(privdata->outgoing_queue, privdata->slots[i].sendmsg);
 	privdata->slots[i].sendtime = 0;
     }
     privdata->unacked = 0;
@@ -938,19 +938,27 @@ static void clear_sent(PrivData *privdata)
  */
 static EMI2Event emi2_wait (SMSCConn *conn, Connection *server, double seconds)
 {
-    if (emi2_can_send(conn) && gw_prioqueue_len(PRIVDATA(conn)->outgoing_queue)) {
-	return EMI2_SENDREQ;
+    if (emi2_can_send(conn) && gw_levelqueue_len(PRIVDATA(conn)->outgoing_queue)) {
+        double wait = 0;
+
+        if (conn->throughput_bucket != NULL)
+            wait = gw_tokenbucket_wait_time(conn->throughput_bucket, 1);
+        if (wait <= 0)
+            return EMI2_SENDREQ;
+        /* throughput limit reached, wait until next message may be sent */
+        if (wait < seconds)
+            seconds = wait;
     }
     
     if (server != NULL) {
 	switch (conn_wait(server, seconds)) {
-	case 1: return gw_prioqueue_len(PRIVDATA(conn)->outgoing_queue) ? EMI2_SENDREQ : EMI2_TIMEOUT;
+	case 1: return gw_levelqueue_len(PRIVDATA(conn)->outgoing_queue) ? EMI2_SENDREQ : EMI2_TIMEOUT;
 	case 0: return EMI2_SMSCREQ;
 	default: return EMI2_CONNERR;
 	}
     } else {
 	gwthread_sleep(seconds);
-	return gw_prioqueue_len(PRIVDATA(conn)->outgoing_queue) ? EMI2_SENDREQ : EMI2_TIMEOUT;
+	return gw_levelqueue_len(PRIVDATA(conn)->outgoing_queue) ? EMI2_SENDREQ : EMI2_TIMEOUT;
     }
 }
 
@@ -1006,19 +1014,23 @@ static int emi2_do_send(SMSCConn *conn, Connection *server)
 {
     struct emimsg *emimsg;
     Msg *msg;
-    double delay = 0;
 
-    if (conn->throughput > 0) {
-        delay = 1.0 / conn->throughput;
-    }
-    
     /* Send messages if there's room in the sending window */
-    while (emi2_can_send(conn) &&
-           (msg = gw_prioqueue_remove(PRIVDATA(conn)->outgoing_queue)) != NULL) {
-        int nexttrn = emi2_next_trn(conn);
+    while (emi2_can_send(conn)) {
+        int nexttrn;
+
+        /* obey throughput speed limit, if any */
+        if (conn->throughput_bucket != NULL &&
+            !gw_tokenbucket_take(conn->throughput_bucket, 1))
+            break;
+
+        if ((msg = gw_levelqueue_remove(PRIVDATA(conn)->outgoing_queue)) == NULL) {
+            if (conn->throughput_bucket != NULL)
+                gw_tokenbucket_return(conn->throughput_bucket, 1);
+            break;
+        }
 
-        if (conn->throughput > 0)
-            gwthread_sleep(delay);
+        nexttrn = emi2_next_trn(conn);
 
         /* convert the generic Kannel message into an EMI type message */
         emimsg = msg_to_emimsg(msg, nexttrn, PRIVDATA(conn));
@@ -1035,6 +1047,7 @@ static int emi2_do_send(SMSCConn *conn, Connection *server)
         }
 
         /* we just sent a message */
+        bb_smscconn_submitted(conn, msg);
         PRIVDATA(conn)->unacked++;
 
         emimsg_destroy(emimsg);
@@ -1221,7 +1234,7 @@ static void emi2_idleprocessing(SMSCConn *conn, Connection **server)
 		    warning(0, "EMI2[%s]: received neither ACK nor NACK for message %d " 
 			    "in %d seconds, resending message", octstr_get_cstr(privdata->name),
 			    i, PRIVDATA(conn)->waitack);
-		    gw_prioqueue_produce(PRIVDATA(conn)->outgoing_queue,
+		    gw_levelqueue_insert_head(PRIVDATA(conn)->outgoing_queue,
 				 PRIVDATA(conn)->slots[i].sendmsg);
                         PRIVDATA(conn)->slots[i].sendtime = 0;
                         PRIVDATA(conn)->unacked--;
@@ -1379,7 +1392,7 @@ static void emi2_sender(void *arg)
 	}
     }
 
-    while((msg = gw_prioqueue_remove(privdata->outgoing_queue)) != NULL)
+    while((msg = gw_levelqueue_remove(privdata->outgoing_queue)) != NULL)
 	bb_smscconn_send_failed(conn, msg, SMSCCONN_FAILED_SHUTDOWN, NULL);
     if (privdata->rport > 0)
 	gwthread_join(privdata->receiver_thread);
@@ -1390,7 +1403,7 @@ static void emi2_sender(void *arg)
     debug("bb.sms", 0, "EMI2[%s]: connection has completed shutdown.",
 	  octstr_get_cstr(privdata->name));
 
-    gw_prioqueue_destroy(privdata->outgoing_queue, NULL);
+    gw_levelqueue_destroy(privdata->outgoing_queue, NULL);
     octstr_destroy(privdata->name);
     octstr_destroy(privdata->allow_ip);
     octstr_destroy(privdata->deny_ip);
@@ -1549,7 +1562,7 @@ static int add_msg_cb(SMSCConn *conn, Msg *sms)
     Msg *copy;
 
     copy = msg_duplicate(sms);
-    gw_prioqueue_produce(privdata->outgoing_queue, copy);
+    gw_levelqueue_produce(privdata->outgoing_queue, copy);
     gwthread_wakeup(privdata->sender_thread);
 
     return 0;
@@ -1572,7 +1585,7 @@ static int shutdown_cb(SMSCConn *conn, int finish_sending)
 
     if (finish_sending == 0) {
 	Msg *msg;
-	while((msg = gw_prioqueue_remove(privdata->outgoing_queue)) != NULL) {
+	while((msg = gw_levelqueue_remove(privdata->outgoing_queue)) != NULL) {
 	    bb_smscconn_send_failed(conn, msg, SMSCCONN_FAILED_SHUTDOWN, NULL);
 	}
     }
@@ -1600,7 +1613,7 @@ static long queued_cb(SMSCConn *conn)
     PrivData *privdata = conn->data;
     long ret;
 
-    ret = (privdata ? gw_prioqueue_len(privdata->outgoing_queue) : 0);
+    ret = (privdata ? gw_levelqueue_len(privdata->outgoing_queue) : 0);
 
     /* use internal queue as load, maybe something else later */
 
@@ -1622,7 +1635,7 @@ int smsc_emi2_create(SMSCConn *conn, CfgGroup *cfg)
     allow_ip = deny_ip = host = alt_host = NULL; 
 
     privdata = gw_malloc(sizeof(PrivData));
-    privdata->outgoing_queue = gw_prioqueue_create(sms_priority_compare);
+    privdata->outgoing_queue = sms_send_queue_create();
     privdata->listening_socket = -1;
     privdata->can_write = 1;
     privdata->priv_nexttrn = 0;
@@ -1816,7 +1829,7 @@ error:
     error(0, "EMI2[%s]: Failed to create emi2 smsc connection",
             (privdata ? octstr_get_cstr(privdata->name) : "-"));
     if (privdata != NULL) {
-	gw_prioqueue_destroy(privdata->outgoing_queue, NULL);
+	gw_levelqueue_destroy(privdata->outgoing_queue, NULL);
     }
     gw_free(privdata);
     octstr_destroy(allow_ip);
@@ -267,7 +267,10 @@ static void main_connection_loop(SMSCConn *conn, Connection *client)
 
             /* pass msg to fakesmsc daemon */            
             if (sms_to_client(client, msg) == 1) {
-                Msg *copy = msg_duplicate(msg);
+                Msg *copy;
+
+                bb_smscconn_submitted(conn, msg);
+                copy = msg_duplicate(msg);
                 
                 /* 
                  * Actually no quarantee of it having been really sent,
@@ -181,7 +181,7 @@ typedef struct conndata {
     int no_sep;         /* not to mention this */
     Octstr *proxy;      /* proxy a constant string */
     Octstr *alt_charset;    /* alternative charset use */
-    List *msg_to_send; /* our send queue */
+    gw_levelqueue_t *msg_to_send; /* our send queue */
 
     /* The following are compiled regex for the 'generic' type for handling 
      * success, permanent failure and temporary failure. For types that use
@@ -261,7 +261,7 @@ static void conndata_destroy(ConnData *conndata)
     octstr_destroy(conndata->system_id);
     octstr_destroy(conndata->alt_charset);
     counter_destroy(conndata->open_sends);
-    gwlist_destroy(conndata->msg_to_send, NULL);
+    gw_levelqueue_destroy(conndata->msg_to_send, NULL);
     if (conndata->max_pending_sends)
         semaphore_destroy(conndata->max_pending_sends);
 
@@ -356,15 +356,10 @@ static void httpsmsc_sender(void *arg)
     SMSCConn *conn = arg;
     ConnData *conndata = conn->data;
     Msg *msg;
-    double delay = 0;
 
     /* Make sure we log into our own log-file if defined */
     log_thread_to(conn->log_idx);
 
-    if (conn->throughput) {
-        delay = 1.0 / conn->throughput;
-    }
-
     while (conndata->shutdown == 0) {
         /* check if we can send ; otherwise block on semaphore */
         if (conndata->max_pending_sends)
@@ -376,15 +371,18 @@ static void httpsmsc_sender(void *arg)
             break;
         }
 
-        msg = gwlist_consume(conndata->msg_to_send);
+        msg = gw_levelqueue_consume(conndata->msg_to_send);
         if (msg == NULL)
             break;
 
         /* obey throughput speed limit, if any */
-        if (conn->throughput > 0) {
-            gwthread_sleep(delay);
+        if (conn->throughput_bucket != NULL) {
+            while (!gw_tokenbucket_consume(conn->throughput_bucket, 1) &&
+                   conndata->shutdown == 0)
+                ;
         }
         counter_increase(conndata->open_sends);
+        bb_smscconn_submitted(conn, msg);
         conndata->send_sms(conn, msg);
         /* TODO check send_sms return code
          * if (conndata->send_sms(conn, msg) == -1) {
@@ -396,7 +394,7 @@ static void httpsmsc_sender(void *arg)
     }
 
     /* put outstanding sends back into global queue */
-    while((msg = gwlist_extract_first(conndata->msg_to_send)))
+    while((msg = gw_levelqueue_remove(conndata->msg_to_send)))
         bb_smscconn_send_failed(conn, msg, SMSCCONN_FAILED_SHUTDOWN, NULL);
 
     /* if there no receiver shutdown */
@@ -2066,7 +2064,7 @@ static int httpsmsc_send(SMSCConn *conn, Msg *msg)
               DEFAULT_CHARSET, octstr_get_cstr(conndata->alt_charset));
     }
 
-    gwlist_produce(conndata->msg_to_send, sms);
+    gw_levelqueue_produce(conndata->msg_to_send, sms);
 
     return 0;
 }
@@ -2098,7 +2096,7 @@ static int httpsmsc_shutdown(SMSCConn *conn, int finish_sending)
 
     if (conndata->port > 0)
         http_close_port(conndata->port);
-    gwlist_remove_producer(conndata->msg_to_send);
+    gw_levelqueue_remove_producer(conndata->msg_to_send);
     if (conndata->receive_thread != -1)
         gwthread_wakeup(conndata->receive_thread);
     if (conndata->sender_thread != -1)
@@ -2256,8 +2254,8 @@ int smsc_http_create(SMSCConn *conn, CfgGroup *cfg)
         goto error;
     }
     conndata->open_sends = counter_create();
-    conndata->msg_to_send = gwlist_create();
-    gwlist_add_producer(conndata->msg_to_send);
+    conndata->msg_to_send = sms_send_queue_create();
+    gw_levelqueue_add_producer(conndata->msg_to_send);
     conndata->http_ref = http_caller_create();
 
     conn->data = conndata;
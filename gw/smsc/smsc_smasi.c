@@ -135,7 +135,7 @@ static void dump_pdu(const char *msg, Octstr *id, SMASI_PDU *pdu)
 typedef struct {
     SMSCConn * conn;                 /* connection to the bearerbox */
     int thread_handle;               /* handle for the SMASI thread */
-    List *msgs_to_send;
+    gw_levelqueue_t *msgs_to_send;
     Dict *sent_msgs;                 /* hash table for send, but yet not confirmed */
     List *received_msgs;             /* list of received, but yet not processed */
     Counter *message_id_counter;     /* sequence number */
@@ -164,7 +164,7 @@ static SMASI *smasi_create(SMSCConn *conn)
     smasi->conn = conn;
 
     smasi->thread_handle = -1;
-    smasi->msgs_to_send = gwlist_create();
+    smasi->msgs_to_send = sms_send_queue_create();
     smasi->sent_msgs = dict_create(16, NULL);
     smasi->received_msgs = gwlist_create();
     smasi->message_id_counter = counter_create();
@@ -183,7 +183,7 @@ static SMASI *smasi_create(SMSCConn *conn)
     smasi->throttling_err_time = 0;
     smasi->enquire_link_interval = 30;
 
-    gwlist_add_producer(smasi->msgs_to_send);
+    gw_levelqueue_add_producer(smasi->msgs_to_send);
 
     return smasi;
 } 
@@ -193,7 +193,7 @@ static void smasi_destroy(SMASI *smasi)
 {
     if (smasi == NULL) return;
 
-    gwlist_destroy(smasi->msgs_to_send, msg_destroy_item);
+    gw_levelqueue_destroy(smasi->msgs_to_send, msg_destroy_item);
     dict_destroy(smasi->sent_msgs);
     gwlist_destroy(smasi->received_msgs, msg_destroy_item);
     counter_destroy(smasi->message_id_counter);
@@ -868,20 +868,26 @@ static Connection *open_connection(SMASI *smasi)
 static void send_messages(SMASI *smasi, Connection *conn, 
                           long *pending_submits) 
 {
-    double delay = 0;
+    gw_tokenbucket_t *bucket = smasi->conn->throughput_bucket;
 
     if (*pending_submits == -1) return;
 
-    if (smasi->conn->throughput > 0) {
-        delay = 1.0 / smasi->conn->throughput;
-    }
-
     while (*pending_submits < MAX_PENDING_SUBMITS) {
         SMASI_PDU *pdu = NULL;
+        Msg *msg;
+
+        /* obey throughput speed limit, if any */
+        if (bucket != NULL && !gw_tokenbucket_take(bucket, 1))
+            break;
+
         /* Get next message, quit if none to be sent. */
-        Msg *msg = gwlist_extract_first(smasi->msgs_to_send);
+        msg = gw_levelqueue_remove(smasi->msgs_to_send);
 
-        if (msg == NULL) break;
+        if (msg == NULL) {
+            if (bucket != NULL)
+                gw_tokenbucket_return(bucket, 1);
+            break;
+        }
 
         /* Send PDU, record it as waiting for ack from SMSC. */
         pdu = msg_to_pdu(smasi, msg);
@@ -890,13 +896,10 @@ static void send_messages(SMASI *smasi, Connection *conn,
             dict_put(smasi->sent_msgs, pdu->u.SubmitReq.Sequence, msg);
 
         send_pdu(conn, smasi->conn->id, pdu);
+        bb_smscconn_submitted(smasi->conn, msg);
 
         smasi_pdu_destroy(pdu);
 
-        /* obey throughput speed limit, if any */
-        if (smasi->conn->throughput > 0)
-            gwthread_sleep(delay);
-
         ++(*pending_submits);
     }
 }
@@ -946,6 +949,13 @@ static void smasi_thread(void *arg)
             timeout = last_enquire_sent + smasi->enquire_link_interval
                         - date_universal_now(); 
 
+            /* wake up as soon as throughput allows to send next message */
+            if (smasi->conn->throughput_bucket != NULL && pending_submits != -1 &&
+                pending_submits < MAX_PENDING_SUBMITS && gw_levelqueue_len(smasi->msgs_to_send) > 0) {
+                double t = gw_tokenbucket_wait_time(smasi->conn->throughput_bucket, 1);
+                timeout = t < timeout ? t : timeout;
+            }
+
             /* wait for activity */
             if (conn_wait(conn, timeout) == -1) {
                 error(0, "SMASI[%s]: I/O error or other error. Re-connecting.",
@@ -1016,7 +1026,7 @@ static long queued_cb(SMSCConn *conn)
     SMASI *smasi = conn->data;
 
     conn->load = (smasi ? (conn->status != SMSCCONN_DEAD ? 
-                    gwlist_len(smasi->msgs_to_send) : 0) : 0);
+                    gw_levelqueue_len(smasi->msgs_to_send) : 0) : 0);
 
     return conn->load;
 } 
@@ -1026,7 +1036,7 @@ static int send_msg_cb(SMSCConn *conn, Msg *msg)
 {
     SMASI *smasi = conn->data;
 
-    gwlist_produce(smasi->msgs_to_send, msg_duplicate(msg));
+    gw_levelqueue_produce(smasi->msgs_to_send, msg_duplicate(msg));
     gwthread_wakeup(smasi->thread_handle);
 
     return 0;
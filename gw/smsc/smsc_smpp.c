@@ -79,7 +79,6 @@
 #include "dlr.h"
 #include "bearerbox.h"
 #include "meta_data.h"
-#include "load.h"
 
 #define SMPP_DEFAULT_CHARSET "UTF-8"
 
@@ -116,6 +115,7 @@
 #define SMPP_DEFAULT_CONNECTION_TIMEOUT  10 * SMPP_ENQUIRE_LINK_INTERVAL
 #define SMPP_DEFAULT_WAITACK        60
 #define SMPP_DEFAULT_SHUTDOWN_TIMEOUT 30
+#define SMPP_SEND_BATCH             32
 
 
 /*
@@ -131,11 +131,14 @@
  */
 
 
+struct smpp_session;
+
 typedef struct {
-    long transmitter;
-    long receiver;
-    gw_prioqueue_t *msgs_to_send;
-    Dict *sent_msgs;
+    struct smpp_session **sessions; /* all binds, transmitters first */
+    long num_sessions;
+    long num_transmitters;
+    Counter *running;   /* count of I/O threads not yet finished */
+    gw_levelqueue_t *msgs_to_send;
     List *received_msgs;
     Counter *message_id_counter;
     Octstr *host;
@@ -161,7 +164,6 @@ typedef struct {
     int version;
     int priority;       /* set default priority for messages */
     int validityperiod;
-    time_t throttling_err_time;
     int smpp_msg_id_type;  /* msg id in C string, hex or decimal */
     int autodetect_addr;
     Octstr *alt_charset;
@@ -170,11 +172,27 @@ typedef struct {
     long wait_ack;
     int wait_ack_action;
     int esm_class;
-    Load *load;
     SMSCConn *conn;
 } SMPP;
 
 
+/*
+ * One bind to the SMS center. We may open several transmitter (or
+ * transceiver) sessions to the same account, all of them taking messages
+ * from the shared msgs_to_send queue, plus one optional receiver session.
+ */
+struct smpp_session {
+    SMPP *smpp;
+    long id;                /* index into smpp->sessions */
+    int transmitter;        /* 0 - receiver, 1 - transmitter, 2 - transceiver */
+    long thread;            /* I/O thread of this session */
+    volatile int status;    /* SMSCCONN_* status of this bind */
+    Dict *sent_msgs;        /* submits waiting for response */
+    volatile long pending_submits;
+    time_t throttling_err_time;
+};
+
+
 struct smpp_msg {
     time_t sent_time;
     Msg *msg;
@@ -212,6 +230,34 @@ static inline void smpp_msg_destroy(struct smpp_msg *msg, int destroy_msg)
 }
 
 
+static struct smpp_session *smpp_session_create(SMPP *smpp, long id, int transmitter)
+{
+    struct smpp_session *session;
+
+    session = gw_malloc(sizeof(*session));
+    session->smpp = smpp;
+    session->id = id;
+    session->transmitter = transmitter;
+    session->thread = -1;
+    session->status = SMSCCONN_CONNECTING;
+    session->sent_msgs = dict_create(smpp->max_pending_submits, NULL);
+    session->pending_submits = -1;
+    session->throttling_err_time = 0;
+
+    return session;
+}
+
+
+static void smpp_session_destroy(struct smpp_session *session)
+{
+    if (session == NULL)
+        return;
+
+    dict_destroy(session->sent_msgs);
+    gw_free(session);
+}
+
+
 static SMPP *smpp_create(SMSCConn *conn, Octstr *host, int transmit_port,
                          int receive_port, Octstr *system_type,
                          Octstr *username, Octstr *password,
@@ -228,11 +274,12 @@ static SMPP *smpp_create(SMSCConn *conn, Octstr *host, int transmit_port,
     SMPP *smpp;
 
     smpp = gw_malloc(sizeof(*smpp));
-    smpp->transmitter = -1;
-    smpp->receiver = -1;
-    smpp->msgs_to_send = gw_prioqueue_create(sms_priority_compare);
-    smpp->sent_msgs = dict_create(max_pending_submits, NULL);
-    gw_prioqueue_add_producer(smpp->msgs_to_send);
+    smpp->sessions = NULL;
+    smpp->num_sessions = 0;
+    smpp->num_transmitters = 0;
+    smpp->running = counter_create();
+    smpp->msgs_to_send = sms_send_queue_create();
+    gw_levelqueue_add_producer(smpp->msgs_to_send);
     smpp->received_msgs = gwlist_create();
     smpp->message_id_counter = counter_create();
     counter_increase(smpp->message_id_counter);
@@ -256,7 +303,6 @@ static SMPP *smpp_create(SMSCConn *conn, Octstr *host, int transmit_port,
     smpp->priority = priority;
     smpp->validityperiod = validity;
     smpp->conn = conn;
-    smpp->throttling_err_time = 0;
     smpp->smpp_msg_id_type = smpp_msg_id_type;
     smpp->autodetect_addr = autodetect_addr;
     smpp->alt_charset = octstr_duplicate(alt_charset);
@@ -268,8 +314,6 @@ static SMPP *smpp_create(SMSCConn *conn, Octstr *host, int transmit_port,
     smpp->bind_addr_npi = 0;
     smpp->use_ssl = 0;
     smpp->ssl_client_certkey_file = NULL;
-    smpp->load = load_create_real(0);
-    load_add_interval(smpp->load, 1);
     smpp->esm_class = esm_class;
 
     return smpp;
@@ -278,9 +322,14 @@ static SMPP *smpp_create(SMSCConn *conn, Octstr *host, int transmit_port,
 
 static void smpp_destroy(SMPP *smpp)
 {
+    long i;
+
     if (smpp != NULL) {
-        gw_prioqueue_destroy(smpp->msgs_to_send, msg_destroy_item);
-        dict_destroy(smpp->sent_msgs);
+        for (i = 0; i < smpp->num_sessions; i++)
+            smpp_session_destroy(smpp->sessions[i]);
+        gw_free(smpp->sessions);
+        counter_destroy(smpp->running);
+        gw_levelqueue_destroy(smpp->msgs_to_send, msg_destroy_item);
         gwlist_destroy(smpp->received_msgs, msg_destroy_item);
         counter_destroy(smpp->message_id_counter);
         octstr_destroy(smpp->host);
@@ -293,12 +342,66 @@ static void smpp_destroy(SMPP *smpp)
         octstr_destroy(smpp->alt_charset);
         octstr_destroy(smpp->alt_addr_charset);
         octstr_destroy(smpp->ssl_client_certkey_file);
-        load_destroy(smpp->load);
         gw_free(smpp);
     }
 }
 
 
+/*
+ * Set status of one session and derive the status of the whole SMSCConn
+ * from all its sessions: active as long as one transmitter is bound,
+ * active receive-only if only receivers are bound. Caller must hold
+ * conn->flow_mutex.
+ */
+static void smpp_session_set_status(struct smpp_session *session, int status)
+{
+    SMPP *smpp = session->smpp;
+    int old = smpp->conn->status;
+    int aggregate = status;
+    long i;
+
+    session->status = status;
+    for (i = 0; i < smpp->num_sessions; i++) {
+        if (smpp->sessions[i]->status == SMSCCONN_ACTIVE) {
+            aggregate = SMSCCONN_ACTIVE;
+            break;
+        }
+        if (smpp->sessions[i]->status == SMSCCONN_ACTIVE_RECV)
+            aggregate = SMSCCONN_ACTIVE_RECV;
+    }
+    smpp->conn->status = aggregate;
+
+    if ((aggregate == SMSCCONN_ACTIVE || aggregate == SMSCCONN_ACTIVE_RECV) &&
+        old != SMSCCONN_ACTIVE && old != SMSCCONN_ACTIVE_RECV)
+        time(&smpp->conn->connect_time);
+}
+
+
+/*
+ * Return the bound transmitter session with most free window slots,
+ * or NULL if no transmitter is bound.
+ */
+static struct smpp_session *smpp_session_select(SMPP *smpp)
+{
+    struct smpp_session *best = NULL;
+    long i, free, best_free = -1;
+
+    for (i = 0; i < smpp->num_transmitters; i++) {
+        struct smpp_session *session = smpp->sessions[i];
+
+        if (session->status != SMSCCONN_ACTIVE || session->pending_submits < 0)
+            continue;
+        free = smpp->max_pending_submits - session->pending_submits;
+        if (free > best_free) {
+            best = session;
+            best_free = free;
+        }
+    }
+
+    return best;
+}
+
+
 /*
  * Try to read an SMPP PDU from a Connection. Return -1 for error (caller
  * should close the connection), -2 for malformed PDU , 0 for no PDU to
@@ -1059,50 +1162,73 @@ static int send_pdu(Connection *conn, Octstr *id, SMPP_PDU *pdu)
 }
 
 
-static int send_messages(SMPP *smpp, Connection *conn, long *pending_submits)
+static int send_messages(SMPP *smpp, struct smpp_session *session, Connection *conn)
 {
-    Msg *msg;
+    Msg *msgs[SMPP_SEND_BATCH];
     SMPP_PDU *pdu;
     Octstr *os;
+    long i, n, max;
 
-    if (*pending_submits == -1)
+    if (session->pending_submits == -1)
         return 0;
 
-    while (*pending_submits < smpp->max_pending_submits) {
+    while (session->pending_submits < smpp->max_pending_submits) {
+        max = smpp->max_pending_submits - session->pending_submits;
+        if (max > SMPP_SEND_BATCH)
+            max = SMPP_SEND_BATCH;
+
         /* check our throughput */
-        if (smpp->conn->throughput > 0 && load_get(smpp->load, 0) >= smpp->conn->throughput) {
-            debug("bb.sms.smpp", 0, "SMPP[%s]: throughput limit exceeded (%.02f,%.02f)",
-                  octstr_get_cstr(smpp->conn->id), load_get(smpp->load, 0), smpp->conn->throughput);
-            break;
+        if (smpp->conn->throughput_bucket != NULL) {
+            for (n = 0; n < max && gw_tokenbucket_take(smpp->conn->throughput_bucket, 1); n++)
+                ;
+            if (n == 0) {
+                debug("bb.sms.smpp", 0, "SMPP[%s]: throughput limit exceeded (%.02f)",
+                      octstr_get_cstr(smpp->conn->id), smpp->conn->throughput);
+                break;
+            }
+            max = n;
         }
-        debug("bb.sms.smpp", 0, "SMPP[%s]: throughput (%.02f,%.02f)",
-              octstr_get_cstr(smpp->conn->id), load_get(smpp->load, 0), smpp->conn->throughput);
 
-        /* Get next message, quit if none to be sent */
-        msg = gw_prioqueue_remove(smpp->msgs_to_send);
-        if (msg == NULL)
+        /* Get next messages in priority order, quit if none to be sent */
+        n = gw_levelqueue_remove_batch(smpp->msgs_to_send, (void**) msgs, max);
+        if (n < max && smpp->conn->throughput_bucket != NULL)
+            gw_tokenbucket_return(smpp->conn->throughput_bucket, max - n);
+        if (n == 0)
             break;
 
-        /* Send PDU, record it as waiting for ack from SMS center */
-        pdu = msg_to_pdu(smpp, msg);
-        if (pdu == NULL) {
-            bb_smscconn_send_failed(smpp->conn, msg, SMSCCONN_FAILED_MALFORMED, octstr_create("MALFORMED SMS"));
-            continue;
-        }
-        /* check for write errors */
-        if (send_pdu(conn, smpp->conn->id, pdu) == 0) {
-            struct smpp_msg *smpp_msg = smpp_msg_create(msg);
-            os = octstr_format("%ld", pdu->u.submit_sm.sequence_number);
-            dict_put(smpp->sent_msgs, os, smpp_msg);
-            smpp_pdu_destroy(pdu);
-            octstr_destroy(os);
-            ++(*pending_submits);
-            load_increase(smpp->load);
-        }
-        else { /* write error occurs */
-            smpp_pdu_destroy(pdu);
-            bb_smscconn_send_failed(smpp->conn, msg, SMSCCONN_FAILED_TEMPORARILY, NULL);
-            return -1;
+        for (i = 0; i < n; i++) {
+            /* Send PDU, record it as waiting for ack from SMS center */
+            pdu = msg_to_pdu(smpp, msgs[i]);
+            if (pdu == NULL) {
+                bb_smscconn_send_failed(smpp->conn, msgs[i], SMSCCONN_FAILED_MALFORMED, octstr_create("MALFORMED SMS"));
+                /* nothing was sent for its token */
+                if (smpp->conn->throughput_bucket != NULL)
+                    gw_tokenbucket_return(smpp->conn->throughput_bucket, 1);
+                continue;
+            }
+            /* check for write errors */
+            if (send_pdu(conn, smpp->conn->id, pdu) == 0) {
+                struct smpp_msg *smpp_msg = smpp_msg_create(msgs[i]);
+                bb_smscconn_submitted(smpp->conn, msgs[i]);
+                os = octstr_format("%ld", pdu->u.submit_sm.sequence_number);
+                dict_put(session->sent_msgs, os, smpp_msg);
+                smpp_pdu_destroy(pdu);
+                octstr_destroy(os);
+                ++session->pending_submits;
+            }
+            else { /* write error occurs */
+                smpp_pdu_destroy(pdu);
+                /* 
+                 * put this and the not yet sent messages back, keeping
+                 * their order, and give back their tokens. The failing
+                 * session hands them to another one or fails them.
+                 */
+                if (smpp->conn->throughput_bucket != NULL)
+                    gw_tokenbucket_return(smpp->conn->throughput_bucket, n - i);
+                while (n-- > i)
+                    gw_levelqueue_insert_head(smpp->msgs_to_send, msgs[n]);
+                return -1;
+            }
         }
     }
 
@@ -1503,8 +1629,8 @@ static long smscconn_failure_reason_to_smpp_status(long reason)
 }
 
 
-static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
-                       long *pending_submits)
+static int handle_pdu(SMPP *smpp, struct smpp_session *session, Connection *conn,
+                      SMPP_PDU *pdu)
 {
     SMPP_PDU *resp = NULL;
     Octstr *os;
@@ -1644,7 +1770,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
 
         case submit_sm_resp:
             os = octstr_format("%ld", pdu->u.submit_sm_resp.sequence_number);
-            smpp_msg = dict_remove(smpp->sent_msgs, os);
+            smpp_msg = dict_remove(session->sent_msgs, os);
             octstr_destroy(os);
             if (smpp_msg == NULL) {
                 warning(0, "SMPP[%s]: SMSC sent submit_sm_resp "
@@ -1669,13 +1795,13 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                  * sleep for a while
                  */
                 if (pdu->u.submit_sm_resp.command_status == SMPP_ESME_RTHROTTLED)
-                    time(&(smpp->throttling_err_time));
+                    time(&(session->throttling_err_time));
                 else
-                    smpp->throttling_err_time = 0;
+                    session->throttling_err_time = 0;
 
                 bb_smscconn_send_failed(smpp->conn, msg, reason, octstr_format("0x%08lx/%s", pdu->u.submit_sm_resp.command_status,
                                         smpp_error_to_string(pdu->u.submit_sm_resp.command_status)));
-                --(*pending_submits);
+                --session->pending_submits;
             } else {
                 Octstr *tmp;
 
@@ -1701,7 +1827,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
 
                 octstr_destroy(tmp);
                 bb_smscconn_sent(smpp->conn, msg, NULL);
-                --(*pending_submits);
+                --session->pending_submits;
             } /* end if for SMSC ACK */
             break;
 
@@ -1713,7 +1839,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                       pdu->u.bind_transmitter_resp.command_status,
                 smpp_error_to_string(pdu->u.bind_transmitter_resp.command_status));
                 mutex_lock(smpp->conn->flow_mutex);
-                smpp->conn->status = SMSCCONN_DISCONNECTED;
+                smpp_session_set_status(session, SMSCCONN_DISCONNECTED);
                 mutex_unlock(smpp->conn->flow_mutex);
                 if (pdu->u.bind_transmitter_resp.command_status == SMPP_ESME_RINVSYSID ||
                     pdu->u.bind_transmitter_resp.command_status == SMPP_ESME_RINVPASWD ||
@@ -1721,10 +1847,9 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                     smpp->quitting = 1;
                 }
             } else {
-                *pending_submits = 0;
+                session->pending_submits = 0;
                 mutex_lock(smpp->conn->flow_mutex);
-                smpp->conn->status = SMSCCONN_ACTIVE;
-                time(&smpp->conn->connect_time);
+                smpp_session_set_status(session, SMSCCONN_ACTIVE);
                 mutex_unlock(smpp->conn->flow_mutex);
                 bb_smscconn_connected(smpp->conn);
             }
@@ -1738,7 +1863,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                       pdu->u.bind_transceiver_resp.command_status,
                  smpp_error_to_string(pdu->u.bind_transceiver_resp.command_status));
                  mutex_lock(smpp->conn->flow_mutex);
-                 smpp->conn->status = SMSCCONN_DISCONNECTED;
+                 smpp_session_set_status(session, SMSCCONN_DISCONNECTED);
                  mutex_unlock(smpp->conn->flow_mutex);
                  if (pdu->u.bind_transceiver_resp.command_status == SMPP_ESME_RINVSYSID ||
                      pdu->u.bind_transceiver_resp.command_status == SMPP_ESME_RINVPASWD ||
@@ -1746,10 +1871,9 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                      smpp->quitting = 1;
                  }
             } else {
-                *pending_submits = 0;
+                session->pending_submits = 0;
                 mutex_lock(smpp->conn->flow_mutex);
-                smpp->conn->status = SMSCCONN_ACTIVE;
-                time(&smpp->conn->connect_time);
+                smpp_session_set_status(session, SMSCCONN_ACTIVE);
                 mutex_unlock(smpp->conn->flow_mutex);
                 bb_smscconn_connected(smpp->conn);
             }
@@ -1763,7 +1887,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                       pdu->u.bind_receiver_resp.command_status,
                  smpp_error_to_string(pdu->u.bind_receiver_resp.command_status));
                  mutex_lock(smpp->conn->flow_mutex);
-                 smpp->conn->status = SMSCCONN_DISCONNECTED;
+                 smpp_session_set_status(session, SMSCCONN_DISCONNECTED);
                  mutex_unlock(smpp->conn->flow_mutex);
                  if (pdu->u.bind_receiver_resp.command_status == SMPP_ESME_RINVSYSID ||
                      pdu->u.bind_receiver_resp.command_status == SMPP_ESME_RINVPASWD ||
@@ -1771,12 +1895,9 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                      smpp->quitting = 1;
                  }
             } else {
-                /* set only receive status if no transmitt is bind */
+                /* connection is only active receive if no transmitter is bound */
                 mutex_lock(smpp->conn->flow_mutex);
-                if (smpp->conn->status != SMSCCONN_ACTIVE) {
-                    smpp->conn->status = SMSCCONN_ACTIVE_RECV;
-                    time(&smpp->conn->connect_time);
-                }
+                smpp_session_set_status(session, SMSCCONN_ACTIVE_RECV);
                 mutex_unlock(smpp->conn->flow_mutex);
             }
             break;
@@ -1784,14 +1905,14 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
         case unbind:
             resp = smpp_pdu_create(unbind_resp, pdu->u.unbind.sequence_number);
             mutex_lock(smpp->conn->flow_mutex);
-            smpp->conn->status = SMSCCONN_DISCONNECTED;
+            smpp_session_set_status(session, SMSCCONN_DISCONNECTED);
             mutex_unlock(smpp->conn->flow_mutex);
-            *pending_submits = -1;
+            session->pending_submits = -1;
             break;
 
         case unbind_resp:
             mutex_lock(smpp->conn->flow_mutex);
-            smpp->conn->status = SMSCCONN_DISCONNECTED;
+            smpp_session_set_status(session, SMSCCONN_DISCONNECTED);
             mutex_unlock(smpp->conn->flow_mutex);
             break;
 
@@ -1799,7 +1920,7 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
             cmd_stat  = pdu->u.generic_nack.command_status;
 
             os = octstr_format("%ld", pdu->u.generic_nack.sequence_number);
-            smpp_msg = dict_remove(smpp->sent_msgs, os);
+            smpp_msg = dict_remove(session->sent_msgs, os);
             octstr_destroy(os);
 
             if (smpp_msg == NULL) {
@@ -1821,14 +1942,14 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
                  * sleep for a while
                  */
                 if (cmd_stat == SMPP_ESME_RTHROTTLED)
-                    time(&(smpp->throttling_err_time));
+                    time(&(session->throttling_err_time));
                 else
-                    smpp->throttling_err_time = 0;
+                    session->throttling_err_time = 0;
 
                 reason = smpp_status_to_smscconn_failure_reason(cmd_stat);
                 bb_smscconn_send_failed(smpp->conn, msg, reason,
                                         octstr_format("0x%08lx/%s", cmd_stat, smpp_error_to_string(cmd_stat)));
-                --(*pending_submits);
+                --session->pending_submits;
             }
             break;
         
@@ -1852,47 +1973,30 @@ static int handle_pdu(SMPP *smpp, Connection *conn, SMPP_PDU *pdu,
 }
 
 
-struct io_arg {
-    SMPP *smpp;
-    int transmitter;
-};
-
-
-static struct io_arg *io_arg_create(SMPP *smpp, int transmitter)
-{
-    struct io_arg *io_arg;
-
-    io_arg = gw_malloc(sizeof(*io_arg));
-    io_arg->smpp = smpp;
-    io_arg->transmitter = transmitter;
-    return io_arg;
-}
-
-
 /*
  * sent queue cleanup.
  * @return 1 if io_thread should reconnect; 0 if not
  */
-static int do_queue_cleanup(SMPP *smpp, long *pending_submits)
+static int do_queue_cleanup(SMPP *smpp, struct smpp_session *session)
 {
     List *keys;
     Octstr *key;
     struct smpp_msg *smpp_msg;
     time_t now = time(NULL);
 
-    if (*pending_submits <= 0)
+    if (session->pending_submits <= 0)
         return 0;
 
     /* check if action set to wait ack for ever */
     if (smpp->wait_ack_action == SMPP_WAITACK_NEVER_EXPIRE)
         return 0;
 
-    keys = dict_keys(smpp->sent_msgs);
+    keys = dict_keys(session->sent_msgs);
     if (keys == NULL)
         return 0;
 
     while ((key = gwlist_extract_first(keys)) != NULL) {
-        smpp_msg = dict_get(smpp->sent_msgs, key);
+        smpp_msg = dict_get(session->sent_msgs, key);
         if (smpp_msg != NULL && difftime(now, smpp_msg->sent_time) > smpp->wait_ack) {
             switch(smpp->wait_ack_action) {
                 case SMPP_WAITACK_RECONNECT: /* reconnect */
@@ -1903,7 +2007,7 @@ static int do_queue_cleanup(SMPP *smpp, long *pending_submits)
                     gwlist_destroy(keys, octstr_destroy_item);
                     return 1; /* io_thread will reconnect */
                 case SMPP_WAITACK_REQUEUE: /* requeue */
-                    smpp_msg = dict_remove(smpp->sent_msgs, key);
+                    smpp_msg = dict_remove(session->sent_msgs, key);
                     if (smpp_msg != NULL) {
                         warning(0, "SMPP[%s]: Not ACKED message found, will retransmit."
                                    " SENT<%ld>sec. ago, SEQ<%s>, DST<%s>",
@@ -1913,7 +2017,7 @@ static int do_queue_cleanup(SMPP *smpp, long *pending_submits)
                                    octstr_get_cstr(smpp_msg->msg->sms.receiver));
                         bb_smscconn_send_failed(smpp->conn, smpp_msg->msg, SMSCCONN_FAILED_TEMPORARILY,NULL);
                         smpp_msg_destroy(smpp_msg, 0);
-                        (*pending_submits)--;
+                        session->pending_submits--;
                     }
                     break;
                 default:
@@ -1941,25 +2045,24 @@ static int do_queue_cleanup(SMPP *smpp, long *pending_submits)
 static void io_thread(void *arg)
 {
     SMPP *smpp;
-    struct io_arg *io_arg;
+    struct smpp_session *session;
     int transmitter;
     Connection *conn;
     int ret;
-    long pending_submits;
     long len;
     SMPP_PDU *pdu;
     double timeout;
     time_t last_cleanup, last_enquire_sent, last_response, now;
+    long i;
 
-    io_arg = arg;
-    smpp = io_arg->smpp;
-    transmitter = io_arg->transmitter;
-    gw_free(io_arg);
+    session = arg;
+    smpp = session->smpp;
+    transmitter = session->transmitter;
 
     /* Make sure we log into our own log-file if defined */
     log_thread_to(smpp->conn->log_idx);
 
-#define IS_ACTIVE (smpp->conn->status == SMSCCONN_ACTIVE || smpp->conn->status == SMSCCONN_ACTIVE_RECV)
+#define IS_ACTIVE (session->status == SMSCCONN_ACTIVE || session->status == SMSCCONN_ACTIVE_RECV)
 
     conn = NULL;
     while (!smpp->quitting) {
@@ -1970,7 +2073,7 @@ static void io_thread(void *arg)
         else
             conn = open_receiver(smpp);
         
-        pending_submits = -1;
+        session->pending_submits = -1;
         len = 0;
         last_response = last_cleanup = last_enquire_sent = time(NULL);
         while(conn != NULL) {
@@ -1990,7 +2093,7 @@ static void io_thread(void *arg)
             } else if (ret == 1) { /* data available */
                 /* Deal with the PDU we just got */
                 dump_pdu("Got PDU:", smpp->conn->id, pdu);
-                ret = handle_pdu(smpp, conn, pdu, &pending_submits);
+                ret = handle_pdu(smpp, session, conn, pdu);
                 smpp_pdu_destroy(pdu);
                 if (ret == -1) {
                     error(0, "SMPP[%s]: I/O error or other error. Re-connecting.",
@@ -2003,7 +2106,7 @@ static void io_thread(void *arg)
                  * Note: Function handle_pdu will set status to SMSCCONN_DISCONNECTED
                  * when unbind was received.
                  */
-                if (smpp->conn->status == SMSCCONN_DISCONNECTED)
+                if (session->status == SMSCCONN_DISCONNECTED)
                     break;
                 
                 /*
@@ -2036,13 +2139,15 @@ static void io_thread(void *arg)
                 timeout = last_enquire_sent + smpp->enquire_link_interval - now;
                 if (!IS_ACTIVE && timeout <= 0)
                     timeout = smpp->enquire_link_interval;
-                if (transmitter && gw_prioqueue_len(smpp->msgs_to_send) > 0 &&
-                    smpp->throttling_err_time > 0 && pending_submits < smpp->max_pending_submits) {
-                    time_t tr_timeout = smpp->throttling_err_time + SMPP_THROTTLING_SLEEP_TIME - now;
+                if (transmitter && gw_levelqueue_len(smpp->msgs_to_send) > 0 &&
+                    session->throttling_err_time > 0 && session->pending_submits < smpp->max_pending_submits) {
+                    time_t tr_timeout = session->throttling_err_time + SMPP_THROTTLING_SLEEP_TIME - now;
                     timeout = timeout > tr_timeout ? tr_timeout : timeout;
-                } else if (transmitter && gw_prioqueue_len(smpp->msgs_to_send) > 0 && smpp->conn->throughput > 0 &&
-                           smpp->max_pending_submits > pending_submits) {
-                    double t = 1.0 / smpp->conn->throughput;
+                } else if (transmitter && gw_levelqueue_len(smpp->msgs_to_send) > 0 &&
+                           smpp->conn->throughput_bucket != NULL &&
+                           smpp->max_pending_submits > session->pending_submits) {
+                    /* sleep exactly until next message may be sent */
+                    double t = gw_tokenbucket_wait_time(smpp->conn->throughput_bucket, 1);
                     timeout = t < timeout ? t : timeout;
                 }
                 /* sleep a while */
@@ -2056,15 +2161,15 @@ static void io_thread(void *arg)
             
             /* cleanup sent queue */
             if (transmitter && difftime(time(NULL), last_cleanup) > smpp->wait_ack) {
-                if (do_queue_cleanup(smpp, &pending_submits))
+                if (do_queue_cleanup(smpp, session))
                     break; /* reconnect */
                 time(&last_cleanup);
             }
             
             /* make sure we send */
-            if (transmitter && difftime(time(NULL), smpp->throttling_err_time) > SMPP_THROTTLING_SLEEP_TIME) {
-                smpp->throttling_err_time = 0;
-                if (send_messages(smpp, conn, &pending_submits) == -1)
+            if (transmitter && difftime(time(NULL), session->throttling_err_time) > SMPP_THROTTLING_SLEEP_TIME) {
+                session->throttling_err_time = 0;
+                if (send_messages(smpp, session, conn) == -1)
                     break;
             }
             
@@ -2080,7 +2185,7 @@ static void io_thread(void *arg)
                       difftime(time(NULL), last_response) < SMPP_DEFAULT_SHUTDOWN_TIMEOUT) {
                     if (read_pdu(smpp, conn, &len, &pdu) == 1) {
                         dump_pdu("Got PDU:", smpp->conn->id, pdu);
-                        handle_pdu(smpp, conn, pdu, &pending_submits);
+                        handle_pdu(smpp, session, conn, pdu);
                         smpp_pdu_destroy(pdu);
                     }
                 }
@@ -2095,56 +2200,72 @@ static void io_thread(void *arg)
             conn_destroy(conn);
             conn = NULL;
         }
+        session->pending_submits = -1;
         /* set reconnecting status first so that core don't put msgs into our queue */
         if (!smpp->quitting) {
             error(0, "SMPP[%s]: Couldn't connect to SMS center (retrying in %ld seconds).",
                   octstr_get_cstr(smpp->conn->id), smpp->conn->reconnect_delay);
             mutex_lock(smpp->conn->flow_mutex);
-            smpp->conn->status = SMSCCONN_RECONNECTING;
+            smpp_session_set_status(session, SMSCCONN_RECONNECTING);
             mutex_unlock(smpp->conn->flow_mutex);
-            gwthread_sleep(smpp->conn->reconnect_delay);
         }
         /*
          * put all queued messages back into global queue,so if
          * we have another link running than messages will be delivered
-         * quickly
+         * quickly. If other sessions of this connection are still bound,
+         * just hand our unacked messages over to them.
          */
         if (transmitter) {
             Msg *msg;
             struct smpp_msg *smpp_msg;
+            struct smpp_session *other;
             List *noresp;
             Octstr *key;
 
             long reason = (smpp->quitting?SMSCCONN_FAILED_SHUTDOWN:SMSCCONN_FAILED_TEMPORARILY);
 
-            while((msg = gw_prioqueue_remove(smpp->msgs_to_send)) != NULL)
-                bb_smscconn_send_failed(smpp->conn, msg, reason, NULL);
+            other = (smpp->quitting ? NULL : smpp_session_select(smpp));
+            if (other == NULL) {
+                while((msg = gw_levelqueue_remove(smpp->msgs_to_send)) != NULL)
+                    bb_smscconn_send_failed(smpp->conn, msg, reason, NULL);
+            }
 
-            noresp = dict_keys(smpp->sent_msgs);
+            noresp = dict_keys(session->sent_msgs);
             while((key = gwlist_extract_first(noresp)) != NULL) {
-                smpp_msg = dict_remove(smpp->sent_msgs, key);
+                smpp_msg = dict_remove(session->sent_msgs, key);
                 if (smpp_msg != NULL) {
-                    bb_smscconn_send_failed(smpp->conn, smpp_msg->msg, reason, NULL);
+                    if (other != NULL)
+                        gw_levelqueue_insert_head(smpp->msgs_to_send, smpp_msg->msg);
+                    else
+                        bb_smscconn_send_failed(smpp->conn, smpp_msg->msg, reason, NULL);
                     smpp_msg_destroy(smpp_msg, 0);
                 }
                 octstr_destroy(key);
             }
             gwlist_destroy(noresp, NULL);
+
+            if (other != NULL) {
+                debug("bb.sms.smpp", 0, "SMPP[%s]: session %ld failed, session %ld takes over.",
+                      octstr_get_cstr(smpp->conn->id), session->id, other->id);
+                gwthread_wakeup(other->thread);
+            }
         }
+        if (!smpp->quitting)
+            gwthread_sleep(smpp->conn->reconnect_delay);
     }
     
 #undef IS_ACTIVE
     
     /*
-     * Shutdown sequence as follow:
-     *    1) if this is TX session so join receiver and free SMPP
-     *    2) if RX session available but no TX session so nothing to join then free SMPP
+     * Shutdown sequence: wake up all other sessions, they may still sleep
+     * if quitting was set by us (e.g. login rejected). The last session
+     * to finish frees SMPP.
      */
-    if (transmitter && smpp->receiver != -1) {
-        gwthread_wakeup(smpp->receiver);
-        gwthread_join(smpp->receiver);
+    for (i = 0; i < smpp->num_sessions; i++) {
+        if (smpp->sessions[i] != session && smpp->sessions[i]->thread != -1)
+            gwthread_wakeup(smpp->sessions[i]->thread);
     }
-    if (transmitter || smpp->transmitter == -1) {
+    if (counter_decrease(smpp->running) == 1) {
         debug("bb.smpp", 0, "SMSCConn %s shut down.",
               octstr_get_cstr(smpp->conn->name));
         
@@ -2170,7 +2291,7 @@ static long queued_cb(SMSCConn *conn)
 
     smpp = conn->data;
     conn->load = (smpp ? (conn->status != SMSCCONN_DEAD ?
-                  gw_prioqueue_len(smpp->msgs_to_send) : 0) : 0);
+                  gw_levelqueue_len(smpp->msgs_to_send) : 0) : 0);
     return conn->load;
 }
 
@@ -2178,10 +2299,18 @@ static long queued_cb(SMSCConn *conn)
 static int send_msg_cb(SMSCConn *conn, Msg *msg)
 {
     SMPP *smpp;
+    struct smpp_session *session;
 
     smpp = conn->data;
-    gw_prioqueue_produce(smpp->msgs_to_send, msg_duplicate(msg));
-    gwthread_wakeup(smpp->transmitter);
+    gw_levelqueue_produce(smpp->msgs_to_send, msg_duplicate(msg));
+
+    /* wake up the session with most free window slots */
+    session = smpp_session_select(smpp);
+    if (session == NULL && smpp->num_transmitters > 0)
+        session = smpp->sessions[0];
+    if (session != NULL)
+        gwthread_wakeup(session->thread);
+
     return 0;
 }
 
@@ -2189,6 +2318,7 @@ static int send_msg_cb(SMSCConn *conn, Msg *msg)
 static int shutdown_cb(SMSCConn *conn, int finish_sending)
 {
     SMPP *smpp;
+    long i;
 
     if (conn == NULL)
         return -1;
@@ -2208,11 +2338,10 @@ static int shutdown_cb(SMSCConn *conn, int finish_sending)
     }
 
     smpp->quitting = 1;
-    if  (smpp->transmitter != -1)
-        gwthread_wakeup(smpp->transmitter);
-
-    if (smpp->receiver != -1)
-        gwthread_wakeup(smpp->receiver);
+    for (i = 0; i < smpp->num_sessions; i++) {
+        if (smpp->sessions[i]->thread != -1)
+            gwthread_wakeup(smpp->sessions[i]->thread);
+    }
 
     mutex_unlock(conn->flow_mutex);
 
@@ -2257,6 +2386,7 @@ int smsc_smpp_create(SMSCConn *conn, CfgGroup *grp)
     Octstr *alt_addr_charset;
     long connection_timeout, wait_ack, wait_ack_action;
     long esm_class;
+    long sessions, i;
 
     my_number = alt_addr_charset = alt_charset = NULL;
     transceiver_mode = 0;
@@ -2323,6 +2453,12 @@ int smsc_smpp_create(SMSCConn *conn, CfgGroup *grp)
         warning(0, "SMPP: receive-port for transceiver mode defined, ignoring.");
         receive_port = 0;
     } 
+    if (cfg_get_integer(&sessions, grp, octstr_imm("sessions")) == -1)
+        sessions = 1;
+    else if (sessions < 1) {
+        error(0, "SMPP: Invalid value for sessions, must be at least 1.");
+        ok = 0;
+    }
 
     if (!ok)
         return -1;
@@ -2448,30 +2584,41 @@ int smsc_smpp_create(SMSCConn *conn, CfgGroup *grp)
      * I/O threads are only started if the corresponding ports
      * have been configured with positive numbers. Use 0 to
      * disable the creation of the corresponding thread.
+     * All transmitter sessions share one send queue.
      */
-    if (port != 0)
-        smpp->transmitter = gwthread_create(io_thread, io_arg_create(smpp,
-                                           (transceiver_mode ? 2 : 1)));
+    smpp->num_transmitters = (port != 0 ? sessions : 0);
+    smpp->num_sessions = smpp->num_transmitters + (receive_port != 0 ? 1 : 0);
+    smpp->sessions = gw_malloc(sizeof(*smpp->sessions) * (smpp->num_sessions + 1));
+    for (i = 0; i < smpp->num_transmitters; i++)
+        smpp->sessions[i] = smpp_session_create(smpp, i, (transceiver_mode ? 2 : 1));
     if (receive_port != 0)
-        smpp->receiver = gwthread_create(io_thread, io_arg_create(smpp, 0));
+        smpp->sessions[i] = smpp_session_create(smpp, i, 0);
 
-    if ((port != 0 && smpp->transmitter == -1) ||
-        (receive_port != 0 && smpp->receiver == -1)) {
+    /* threads may only free SMPP once all of them have been started */
+    counter_set(smpp->running, smpp->num_sessions);
+    for (i = 0; i < smpp->num_sessions; i++) {
+        smpp->sessions[i]->thread = gwthread_create(io_thread, smpp->sessions[i]);
+        if (smpp->sessions[i]->thread == -1)
+            break;
+    }
+
+    if (i < smpp->num_sessions) {
         error(0, "SMPP[%s]: Couldn't start I/O threads.",
               octstr_get_cstr(smpp->conn->id));
         smpp->quitting = 1;
-        if (smpp->transmitter != -1) {
-            gwthread_wakeup(smpp->transmitter);
-            gwthread_join(smpp->transmitter);
-        }
-        if (smpp->receiver != -1) {
-            gwthread_wakeup(smpp->receiver);
-            gwthread_join(smpp->receiver);
+        for (i = 0; i < smpp->num_sessions; i++) {
+            if (smpp->sessions[i]->thread != -1) {
+                gwthread_wakeup(smpp->sessions[i]->thread);
+                gwthread_join(smpp->sessions[i]->thread);
+            }
         }
         smpp_destroy(conn->data);
         conn->data = NULL;
         return -1;
     }
+    if (sessions > 1)
+        info(0, "SMPP[%s]: Using %ld sessions sharing one send queue.",
+             octstr_get_cstr(conn->id), sessions);
 
     conn->shutdown = shutdown_cb;
     conn->queued = queued_cb;
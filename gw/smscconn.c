@@ -146,6 +146,59 @@ static void init_reroute(SMSCConn *conn, CfgGroup *grp)
 }
 
 
+static double metric_counter(void *arg)
+{
+    return counter_value(arg);
+}
+
+
+static double metric_up(void *arg)
+{
+    return ((SMSCConn*) arg)->status == SMSCCONN_ACTIVE;
+}
+
+
+static void register_metrics(SMSCConn *conn)
+{
+    Octstr *label;
+
+    label = gw_metrics_label("smsc", conn->id ? conn->id : conn->name);
+    conn->metrics = gwlist_create();
+
+#define COUNTER(name, help, counter) \
+    gwlist_append(conn->metrics, gw_metrics_callback(name, help, \
+                  GW_METRIC_COUNTER, label, metric_counter, counter))
+#define LATENCY(name, help, hist) \
+    gwlist_append(conn->metrics, gw_metrics_histogram(name, help, \
+                  label, hist, 0.000001))
+
+    COUNTER("kannel_smsc_sms_received_total", "SMS messages received per SMSC.",
+            conn->received);
+    COUNTER("kannel_smsc_sms_sent_total", "SMS messages sent per SMSC.",
+            conn->sent);
+    COUNTER("kannel_smsc_sms_failed_total", "SMS messages failed per SMSC.",
+            conn->failed);
+    COUNTER("kannel_smsc_dlr_received_total", "Delivery reports received per SMSC.",
+            conn->received_dlr);
+    COUNTER("kannel_smsc_dlr_sent_total", "Delivery reports sent per SMSC.",
+            conn->sent_dlr);
+    gwlist_append(conn->metrics, gw_metrics_callback("kannel_smsc_up",
+                  "Whether the SMSC connection is online.", GW_METRIC_GAUGE,
+                  label, metric_up, conn));
+    LATENCY("kannel_smsc_queue_latency_seconds",
+            "Time from queueing until submit to the SMSC.", conn->queue_latency);
+    LATENCY("kannel_smsc_submit_latency_seconds",
+            "Time from submit until the SMSC acknowledged.", conn->submit_latency);
+    LATENCY("kannel_smsc_dlr_latency_seconds",
+            "Time from SMSC ack until the final delivery report.", conn->dlr_latency);
+
+#undef COUNTER
+#undef LATENCY
+
+    octstr_destroy(label);
+}
+
+
 SMSCConn *smscconn_create(CfgGroup *grp, int start_as_stopped)
 {
     SMSCConn *conn;
@@ -200,6 +253,9 @@ SMSCConn *smscconn_create(CfgGroup *grp, int start_as_stopped)
     load_add_interval(conn->outgoing_dlr_load, 300);
     load_add_interval(conn->outgoing_dlr_load, -1);
 
+    conn->queue_latency = gw_histogram_create();
+    conn->submit_latency = gw_histogram_create();
+    conn->dlr_latency = gw_histogram_create();
 
 #define GET_OPTIONAL_VAL(x, n) x = cfg_get(grp, octstr_imm(n))
 #define SPLIT_OPTIONAL_VAL(x, n) \
@@ -249,6 +305,16 @@ SMSCConn *smscconn_create(CfgGroup *grp, int start_as_stopped)
         octstr_destroy(tmp);
         info(0, "Set throughput to %.3f for smsc id <%s>", conn->throughput, octstr_get_cstr(conn->id));
     }
+    if (conn->throughput > 0) {
+        double burst = 1;
+
+        if ((tmp = cfg_get(grp, octstr_imm("throughput-burst"))) != NULL) {
+            if (octstr_parse_double(&burst, tmp, 0) == -1 || burst < 1)
+                burst = 1;
+            octstr_destroy(tmp);
+        }
+        conn->throughput_bucket = gw_tokenbucket_create(conn->throughput, burst);
+    }
     /* Sets the admin_id. Equals to connection id if empty */
     GET_OPTIONAL_VAL(conn->admin_id, "smsc-admin-id");
     if (conn->admin_id == NULL)
@@ -319,6 +385,7 @@ SMSCConn *smscconn_create(CfgGroup *grp, int start_as_stopped)
     }
     gw_assert(conn->send_msg != NULL);
 
+    register_metrics(conn);
     bb_smscconn_ready(conn);
 
     return conn;
@@ -360,6 +427,13 @@ int smscconn_destroy(SMSCConn *conn)
 	return -1;
     mutex_lock(conn->flow_mutex);
 
+    if (conn->metrics != NULL) {
+        gw_metric_t *metric;
+        while ((metric = gwlist_extract_first(conn->metrics)) != NULL)
+            gw_metrics_unregister(metric);
+        gwlist_destroy(conn->metrics, NULL);
+    }
+
     counter_destroy(conn->received);
     counter_destroy(conn->received_dlr);
     counter_destroy(conn->sent);
@@ -370,6 +444,10 @@ int smscconn_destroy(SMSCConn *conn)
     load_destroy(conn->incoming_dlr_load);
     load_destroy(conn->outgoing_sms_load);
     load_destroy(conn->outgoing_dlr_load);
+    gw_histogram_destroy(conn->queue_latency);
+    gw_histogram_destroy(conn->submit_latency);
+    gw_histogram_destroy(conn->dlr_latency);
+    gw_tokenbucket_destroy(conn->throughput_bucket);
 
     octstr_destroy(conn->name);
     octstr_destroy(conn->id);
@@ -555,6 +633,10 @@ int smscconn_send(SMSCConn *conn, Msg *msg)
         return -1;
     }
 
+    /* start latency measurement, parts inherit it */
+    msg->stamp.queued = date_monotonic_usec();
+    msg->stamp.submitted = msg->stamp.acked = 0;
+
     /* if this a retry of splitted message, don't unify prefix and don't try to split */
     if (msg->sms.split_parts == NULL) {    
         /* normalize the destination number for this smsc */
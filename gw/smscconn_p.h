@@ -199,6 +199,7 @@ struct smscconn {
     int alt_dcs; /* use alternate DCS 0xFX */
 
     double throughput;     /* message thoughput per sec. to be delivered to SMSC */
+    gw_tokenbucket_t *throughput_bucket; /* shapes sending to throughput, NULL if unlimited */
 
     /* Stores rerouting information for this specific smsc-id */
     int reroute;                /* simply turn MO into MT and process internally */
@@ -213,6 +214,13 @@ struct smscconn {
     Load *incoming_dlr_load;
     Load *outgoing_dlr_load;
 
+    /* latencies in microseconds */
+    gw_histogram_t *queue_latency;   /* smscconn_send until submit to SMSC */
+    gw_histogram_t *submit_latency;  /* submit until ack from SMSC */
+    gw_histogram_t *dlr_latency;     /* ack until final DLR */
+
+    List *metrics;     /* registered gw_metric_t's of this connection */
+
     /* XXX: move rest global data from Smsc here
      */
 
@@ -101,6 +101,7 @@
 #include "radius/radius_acct.h"
 #include "wap-error.h"
 #include "wap-maps.h"
+#include "wap-http-cache.h"
 
 #define ENABLE_NOT_ACCEPTED 
 
@@ -140,6 +141,20 @@ static Counter *fetches = NULL;
  */
 static List *charsets = NULL;
 
+/*
+ * Cache of compiled WML and WMLScript content, NULL if disabled. The size
+ * limit in bytes is configured in wapbox.c.
+ */
+extern long content_cache_size;
+static gw_lru_t *content_cache = NULL;
+static List *content_cache_metrics = NULL;
+
+/*
+ * Size limit of the HTTP response cache, 0 if disabled. Configured in
+ * wapbox.c.
+ */
+extern long http_cache_size;
+
 struct content {
     Octstr *body;
     Octstr *type;
@@ -161,6 +176,7 @@ struct request_data {
     long x_wap_tod;
     List *request_headers;
     Octstr *msisdn;
+    int cache_fetch;    /* response goes to the HTTP cache */
 };
 
 
@@ -182,6 +198,8 @@ static int have_ppg = 0;
 static void main_thread(void *);
 static void start_fetch(WAPEvent *);
 static void return_replies_thread(void *);
+static void return_request_reply(struct request_data *p, int status,
+                                 List *headers, Octstr *body);
 
 static void dev_null(const char *data, size_t len, void *context);
 
@@ -191,6 +209,11 @@ static Octstr *convert_wmlscript_to_wmlscriptc(struct content *content);
 static Octstr *deconvert_multipart_formdata(struct content *content);
 /* DAVI: To-Do static Octstr *deconvert_mms_message(struct content *content); */
 static List *negotiate_capabilities(List *req_caps);
+static void *content_cache_duplicate(void *body);
+static Octstr *content_cache_key(struct content *content, List *headers);
+static void content_cache_put(Octstr *key, Octstr *body, List *headers);
+static void content_cache_register_metrics(void);
+static void content_cache_unregister_metrics(void);
 
 static struct {
     char *type;
@@ -254,6 +277,12 @@ void wap_appl_init(Cfg *cfg)
     gwlist_add_producer(queue);
     run_status = running;
     charsets = wml_charsets();
+    if (content_cache_size > 0) {
+        content_cache = gw_lru_create(content_cache_size, 
+                                      content_cache_duplicate, octstr_destroy_item);
+        content_cache_register_metrics();
+    }
+    wap_http_cache_init(http_cache_size);
     caller = http_caller_create();
     gwthread_create(main_thread, NULL);
     gwthread_create(return_replies_thread, NULL);
@@ -267,6 +296,8 @@ void wap_appl_init(Cfg *cfg)
 
 void wap_appl_shutdown(void) 
 {
+    gw_lru_stats_t stats;
+
     gw_assert(run_status == running);
     run_status = terminating;
     
@@ -282,6 +313,19 @@ void wap_appl_shutdown(void)
     gwlist_destroy(queue, wap_event_destroy_item);
     gwlist_destroy(charsets, octstr_destroy_item);
     counter_destroy(fetches);
+    wap_http_cache_shutdown();
+
+    if (content_cache != NULL) {
+        content_cache_unregister_metrics();
+        gw_lru_stats(content_cache, &stats);
+        info(0, "Compiled content cache: %lld hits, %lld misses (%.1f%% hits), "
+             "%lld evictions, %ld entries with %ld bytes.",
+             stats.hits, stats.misses, stats.hits + stats.misses > 0 ?
+             100.0 * stats.hits / (stats.hits + stats.misses) : 0.0,
+             stats.evictions, stats.entries, stats.size);
+        gw_lru_destroy(content_cache);
+        content_cache = NULL;
+    }
 }
 
 
@@ -414,14 +458,16 @@ static void main_thread(void *arg)
  * Tries to convert or compile a specific content-type to
  * it's complementing one. It does not convert if the client has explicitely
  * told us via Accept: header that a specific type is supported.
+ * If the response headers of the origin server are given, compiled content
+ * is looked up in and stored to the content cache.
  * Returns 1 if an convertion has been successfull,
  * -1 if an convertion failed and 0 if no convertion routine
  * was maching this content-type
  */
 static int convert_content(struct content *content, List *request_headers, 
-                           int allow_empty) 
+                           List *response_headers, int allow_empty) 
 {
-    Octstr *new_body;
+    Octstr *new_body, *key;
     int failed = 0;
     int i;
 
@@ -437,7 +483,16 @@ static int convert_content(struct content *content, List *request_headers,
             if (allow_empty && octstr_len(content->body) == 0) 
                 return 1;
 
-            new_body = converters[i].convert(content);
+            key = content_cache_key(content, response_headers);
+            new_body = (key != NULL) ? gw_lru_get(content_cache, key) : NULL;
+            if (new_body != NULL) {
+                debug("wap.convert",0,"WSP: Using cached compiled content");
+            } else {
+                new_body = converters[i].convert(content);
+                if (new_body != NULL && key != NULL)
+                    content_cache_put(key, new_body, response_headers);
+            }
+            octstr_destroy(key);
             if (new_body != NULL) {
                 long s = octstr_len(content->body);
                 octstr_destroy(content->body);
@@ -863,7 +918,7 @@ static void return_reply(int status, Octstr *content_body, List *headers,
             if (headers == NULL)
                 headers = http_create_empty_headers();
 
-            converted = convert_content(&content, device_headers, 0);
+            converted = convert_content(&content, device_headers, NULL, 0);
             if (converted == 1)
                 http_header_mark_transformation(headers, content.body, content.type);
 
@@ -912,7 +967,7 @@ static void return_reply(int status, Octstr *content_body, List *headers,
         }
 
         /* convert content-type by our own converter table */
-        converted = convert_content(&content, device_headers, 
+        converted = convert_content(&content, device_headers, headers,
                                     octstr_compare(method, octstr_imm("HEAD")) == 0);
         if (converted < 0) {
             warning(0, "WSP: All converters for `%s' at `%s' failed.",
@@ -931,7 +986,7 @@ static void return_reply(int status, Octstr *content_body, List *headers,
                 
                 debug("wap.wsp",0,"WSP: returning smart error WML deck for failed converters");
 
-                converted = convert_content(&content, device_headers, 0);
+                converted = convert_content(&content, device_headers, NULL, 0);
                 if (converted == 1)
                     http_header_mark_transformation(headers, content.body, content.type);
 
@@ -1069,27 +1124,57 @@ static void return_replies_thread(void *arg)
     struct request_data *p;
     int status;
     Octstr *final_url;
-    List *headers;
+    List *headers, *waiters;
 
     while (run_status == running) {
 
         p = http_receive_result(caller, &status, &final_url, &headers, &body);
         if (p == NULL)
             break;
+        octstr_destroy(final_url);
 
-        return_reply(status, body, headers, p->client_SDU_size,
-                     p->event, p->session_id, p->method, p->url, p->x_wap_tod,
-                     p->request_headers, p->msisdn);
+        waiters = NULL;
+        if (p->cache_fetch)
+            waiters = wap_http_cache_response(p->url, p->request_headers,
+                                              &status, &headers, &body);
+        return_request_reply(p, status, headers, body);
 
-        wap_event_destroy(p->event);
-        http_destroy_headers(p->request_headers);
-        octstr_destroy(p->msisdn);
-        gw_free(p);
-        octstr_destroy(final_url);
+        /* 
+         * Requests that waited for this fetch get the response from the
+         * cache, or go to the HTTP server themselves if it was not stored.
+         */
+        while (waiters != NULL &&
+               (p = gwlist_extract_first(waiters)) != NULL) {
+            if (wap_http_cache_get(p->url, p->request_headers,
+                                   &status, &headers, &body))
+                return_request_reply(p, status, headers, body);
+            else
+                http_start_request(caller, http_name2method(p->method), p->url,
+                                   p->request_headers, NULL, 0, p, NULL);
+        }
+        gwlist_destroy(waiters, NULL);
     }
 }
 
 
+/*
+ * Return the reply to a request back to the phone and destroy the
+ * request data.
+ */
+static void return_request_reply(struct request_data *p, int status,
+                                 List *headers, Octstr *body)
+{
+    return_reply(status, body, headers, p->client_SDU_size,
+                 p->event, p->session_id, p->method, p->url, p->x_wap_tod,
+                 p->request_headers, p->msisdn);
+
+    wap_event_destroy(p->event);
+    http_destroy_headers(p->request_headers);
+    octstr_destroy(p->msisdn);
+    gw_free(p);
+}
+
+
 /*
  * This WML deck is returned when the user asks for the magic 
  * URL "kannel:alive".
@@ -1282,10 +1367,24 @@ static void start_fetch(WAPEvent *event)
         p->x_wap_tod = x_wap_tod;
         p->request_headers = actual_headers;
         p->msisdn = msisdn;
+        p->cache_fetch = 0;
 
-        /* issue the request to the HTTP server */
-        http_start_request(caller, http_name2method(method), url, actual_headers, 
-                           request_body, 0, p, NULL);
+        switch (wap_http_cache_request(method, url, actual_headers, p, 
+                                       &ret, &resp_headers, &content_body)) {
+        case WAP_HTTP_CACHE_HIT:
+            return_request_reply(p, ret, resp_headers, content_body);
+            break;
+        case WAP_HTTP_CACHE_WAIT:
+            /* answered when the pending fetch of the URL is done */
+            break;
+        case WAP_HTTP_CACHE_FETCH:
+            p->cache_fetch = 1;
+            /* fall through */
+        default:
+            /* issue the request to the HTTP server */
+            http_start_request(caller, http_name2method(method), url, actual_headers, 
+                               request_body, 0, p, NULL);
+        }
 
         octstr_destroy(request_body);
     } 
@@ -1306,6 +1405,142 @@ static void start_fetch(WAPEvent *event)
 }
                 
 
+/*
+ * Compiled content is cached with the validators of the origin server's
+ * response in the key, so a hit always belongs to the very body we have
+ * just received. Responses without a Last-Modified date or a strong ETag
+ * are not cached. The cache headers decide whether a response may be
+ * stored at all, and for how long.
+ */
+static void *content_cache_duplicate(void *body)
+{
+    return octstr_duplicate(body);
+}
+
+
+static Octstr *content_cache_key(struct content *content, List *headers)
+{
+    Octstr *etag, *modified, *key;
+
+    if (content_cache == NULL || headers == NULL)
+        return NULL;
+
+    etag = http_header_value(headers, octstr_imm("ETag"));
+    if (etag != NULL && octstr_ncompare(etag, octstr_imm("W/"), 2) == 0) {
+        /* weak validators do not guarantee the same bytes */
+        octstr_destroy(etag);
+        etag = NULL;
+    }
+    modified = http_header_value(headers, octstr_imm("Last-Modified"));
+    if (etag == NULL && modified == NULL)
+        return NULL;
+
+    key = octstr_format("%S\n%S\n%S\n%S\n%ld\n%S\n%S", content->type,
+                        content->charset, content->version, content->url,
+                        octstr_len(content->body), etag, modified);
+    octstr_destroy(etag);
+    octstr_destroy(modified);
+
+    return key;
+}
+
+
+static void content_cache_put(Octstr *key, Octstr *body, List *headers)
+{
+    List *directives, *values;
+    Octstr *name, *value, *s;
+    time_t expires = 0;
+    long i, max_age;
+
+    directives = http_header_find_all(headers, "Cache-Control");
+    for (i = 0; i < gwlist_len(directives); i++) {
+        http_header_get(directives, i, &name, &value);
+        values = http_header_split_value(value);
+        while ((s = gwlist_extract_first(values)) != NULL) {
+            if (octstr_case_compare(s, octstr_imm("no-store")) == 0 ||
+                octstr_case_compare(s, octstr_imm("private")) == 0)
+                expires = -1;
+            else if (expires >= 0 &&
+                     octstr_case_search(s, octstr_imm("max-age="), 0) == 0 &&
+                     octstr_parse_long(&max_age, s, 8, 10) != -1)
+                expires = (max_age > 0) ? time(NULL) + max_age : -1;
+            octstr_destroy(s);
+        }
+        gwlist_destroy(values, NULL);
+        octstr_destroy(name);
+        octstr_destroy(value);
+    }
+    http_destroy_headers(directives);
+
+    if (expires == 0 &&
+        (s = http_header_value(headers, octstr_imm("Expires"))) != NULL) {
+        expires = date_parse_http(s);
+        if (expires <= time(NULL))
+            expires = -1;
+        octstr_destroy(s);
+    }
+
+    if (expires >= 0)
+        gw_lru_put(content_cache, key, octstr_duplicate(body),
+                   octstr_len(body) + octstr_len(key), expires);
+}
+
+
+/*
+ * Statistics of the content cache, exported as metrics. The argument of
+ * the callback selects the field of the statistics.
+ */
+enum { CACHE_HITS, CACHE_MISSES, CACHE_EVICTIONS, CACHE_ENTRIES, CACHE_BYTES };
+
+static double content_cache_stat(void *arg)
+{
+    gw_lru_stats_t stats;
+
+    gw_lru_stats(content_cache, &stats);
+    switch ((long) arg) {
+        case CACHE_HITS: return stats.hits;
+        case CACHE_MISSES: return stats.misses;
+        case CACHE_EVICTIONS: return stats.evictions;
+        case CACHE_ENTRIES: return stats.entries;
+        default: return stats.size;
+    }
+}
+
+
+static void content_cache_register_metrics(void)
+{
+#define STAT(name, help, type, field) \
+    gwlist_append(content_cache_metrics, gw_metrics_callback(name, help, \
+                  type, NULL, content_cache_stat, (void *) (long) field))
+
+    content_cache_metrics = gwlist_create();
+    STAT("kannel_wapbox_content_cache_hits_total",
+         "Compiled content found in the cache.", GW_METRIC_COUNTER, CACHE_HITS);
+    STAT("kannel_wapbox_content_cache_misses_total",
+         "Compiled content not found in the cache.", GW_METRIC_COUNTER, CACHE_MISSES);
+    STAT("kannel_wapbox_content_cache_evictions_total",
+         "Compiled content dropped from the full cache.", GW_METRIC_COUNTER,
+         CACHE_EVICTIONS);
+    STAT("kannel_wapbox_content_cache_entries",
+         "Compiled content in the cache.", GW_METRIC_GAUGE, CACHE_ENTRIES);
+    STAT("kannel_wapbox_content_cache_bytes",
+         "Size of the compiled content in the cache.", GW_METRIC_GAUGE, CACHE_BYTES);
+
+#undef STAT
+}
+
+
+static void content_cache_unregister_metrics(void)
+{
+    gw_metric_t *metric;
+
+    while ((metric = gwlist_extract_first(content_cache_metrics)) != NULL)
+        gw_metrics_unregister(metric);
+    gwlist_destroy(content_cache_metrics, NULL);
+    content_cache_metrics = NULL;
+}
+
+
 /* Shut up WMLScript compiler status/trace messages. */
 static void dev_null(const char *data, size_t len, void *context) 
 {
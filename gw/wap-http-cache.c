@@ -0,0 +1,704 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw/wap-http-cache.c - HTTP response cache of the WAP application layer
+ *
+ * Responses are kept in an LRU cache keyed by URL, one variant per URL.
+ * A response with a Vary header is stored together with the values the
+ * listed request headers had, and only requests with the same values
+ * get it. Responses whose freshness lifetime is over are kept as long as
+ * they have validators, so they can be revalidated instead of fetched
+ * again.
+ *
+ * Requests that miss the cache while the same URL is being fetched are
+ * queued behind that fetch. They are answered from the cache when the
+ * response arrives, or fetched on their own if it was not stored.
+ */
+
+#include <time.h>
+
+#include "gwlib/gwlib.h"
+#include "wap-http-cache.h"
+
+/* Without explicit lifetime, a response with Last-Modified is fresh for a
+ * tenth of its age at the time it was received, up to one day. */
+#define HEURISTIC_FRACTION 10
+#define HEURISTIC_MAX (24 * 60 * 60)
+
+typedef struct {
+    int status;
+    List *headers;
+    Octstr *body;
+    Octstr *vary;          /* Vary header of the response, or NULL */
+    Octstr *vary_values;   /* values of those headers in the request */
+    time_t received;       /* when the response was received */
+    long age;              /* age of the response when received */
+    long lifetime;         /* freshness lifetime in seconds */
+} Response;
+
+typedef struct {
+    List *waiters;         /* ids of queued requests */
+    Response *stale;       /* response being revalidated, or NULL */
+} Pending;
+
+static gw_lru_t *responses = NULL;
+static Dict *pending = NULL;
+static Mutex *pending_lock = NULL;
+
+static Counter *hits = NULL;
+static Counter *misses = NULL;
+static Counter *revalidations = NULL;
+static Counter *collapsed = NULL;
+
+static List *metrics = NULL;
+
+
+/***********************************************************************
+ * Cached responses.
+ */
+
+static void response_destroy(void *item)
+{
+    Response *r = item;
+
+    if (r == NULL)
+        return;
+    http_destroy_headers(r->headers);
+    octstr_destroy(r->body);
+    octstr_destroy(r->vary);
+    octstr_destroy(r->vary_values);
+    gw_free(r);
+}
+
+
+static Response *response_create(int status, List *headers, Octstr *body)
+{
+    Response *r;
+
+    r = gw_malloc(sizeof(*r));
+    r->status = status;
+    r->headers = headers;
+    r->body = body;
+    r->vary = r->vary_values = NULL;
+    r->received = time(NULL);
+    r->age = r->lifetime = 0;
+    return r;
+}
+
+
+static void *response_duplicate(void *item)
+{
+    Response *r = item, *copy;
+
+    copy = response_create(r->status, http_header_duplicate(r->headers),
+                           octstr_duplicate(r->body));
+    copy->vary = octstr_duplicate(r->vary);
+    copy->vary_values = octstr_duplicate(r->vary_values);
+    copy->received = r->received;
+    copy->age = r->age;
+    copy->lifetime = r->lifetime;
+    return copy;
+}
+
+
+static long response_size(Response *r)
+{
+    Octstr *name, *value;
+    long i, size;
+
+    size = sizeof(*r) + octstr_len(r->body) + octstr_len(r->vary) +
+           octstr_len(r->vary_values);
+    for (i = 0; i < gwlist_len(r->headers); i++) {
+        http_header_get(r->headers, i, &name, &value);
+        size += octstr_len(name) + octstr_len(value) + 4;
+        octstr_destroy(name);
+        octstr_destroy(value);
+    }
+    return size;
+}
+
+
+static long response_current_age(Response *r)
+{
+    long age;
+
+    age = r->age + (time(NULL) - r->received);
+    return age > 0 ? age : 0;
+}
+
+
+/*
+ * Hand the response over to the caller, with an Age header telling how
+ * long it has been in the cache.
+ */
+static void response_give(Response *r, int *status, List **headers,
+                          Octstr **body)
+{
+    Octstr *age;
+
+    http_header_remove_all(r->headers, "Age");
+    age = octstr_format("%ld", response_current_age(r));
+    http_header_add(r->headers, "Age", octstr_get_cstr(age));
+    octstr_destroy(age);
+
+    *status = r->status;
+    *headers = r->headers;
+    *body = r->body;
+    r->headers = NULL;
+    r->body = NULL;
+    response_destroy(r);
+}
+
+
+/***********************************************************************
+ * Header parsing.
+ */
+
+/*
+ * Return 1 if the Cache-Control headers have the directive, 0 if not.
+ * If value is not NULL, the numeric argument of the directive is put
+ * there, -1 if it has none.
+ */
+static int cache_directive(List *headers, char *directive, long *value)
+{
+    List *list, *elements;
+    Octstr *name, *header, *element, *s;
+    long i, eq;
+    int found;
+
+    found = 0;
+    if (value != NULL)
+        *value = -1;
+    list = http_header_find_all(headers, "Cache-Control");
+    for (i = 0; i < gwlist_len(list); i++) {
+        http_header_get(list, i, &name, &header);
+        elements = http_header_split_value(header);
+        while ((element = gwlist_extract_first(elements)) != NULL) {
+            eq = octstr_search_char(element, '=', 0);
+            s = (eq < 0) ? octstr_duplicate(element) :
+                           octstr_copy(element, 0, eq);
+            octstr_strip_blanks(s);
+            if (octstr_str_case_compare(s, directive) == 0) {
+                found = 1;
+                if (value != NULL && eq >= 0 &&
+                    octstr_parse_long(value, element, eq + 1, 10) == -1)
+                    *value = -1;
+            }
+            octstr_destroy(s);
+            octstr_destroy(element);
+        }
+        gwlist_destroy(elements, NULL);
+        octstr_destroy(name);
+        octstr_destroy(header);
+    }
+    http_destroy_headers(list);
+
+    return found;
+}
+
+
+/*
+ * Return the time of a date header, -1 if missing and -2 if invalid.
+ */
+static long header_time(List *headers, char *name)
+{
+    Octstr *value;
+    long t;
+
+    value = http_header_value(headers, octstr_imm(name));
+    if (value == NULL)
+        return -1;
+    t = date_parse_http(value);
+    octstr_destroy(value);
+    return t < 0 ? -2 : t;
+}
+
+
+static int has_header(List *headers, char *name)
+{
+    Octstr *value;
+
+    value = http_header_value(headers, octstr_imm(name));
+    octstr_destroy(value);
+    return value != NULL;
+}
+
+
+static int has_validators(List *headers)
+{
+    return has_header(headers, "ETag") || has_header(headers, "Last-Modified");
+}
+
+
+/*
+ * Values of the request headers named in a Vary header, one per line.
+ * Return NULL for a NULL Vary header.
+ */
+static Octstr *vary_values(Octstr *vary, List *request_headers)
+{
+    List *names;
+    Octstr *name, *value, *values;
+
+    if (vary == NULL)
+        return NULL;
+
+    values = octstr_create("");
+    names = http_header_split_value(vary);
+    while ((name = gwlist_extract_first(names)) != NULL) {
+        value = http_header_value(request_headers, name);
+        if (value != NULL)
+            octstr_append(values, value);
+        octstr_append_char(values, '\n');
+        octstr_destroy(value);
+        octstr_destroy(name);
+    }
+    gwlist_destroy(names, NULL);
+
+    return values;
+}
+
+
+static int vary_matches(Response *r, List *request_headers)
+{
+    Octstr *values;
+    int match;
+
+    if (r->vary == NULL)
+        return 1;
+    values = vary_values(r->vary, request_headers);
+    match = (octstr_compare(values, r->vary_values) == 0);
+    octstr_destroy(values);
+    return match;
+}
+
+
+/*
+ * Set the age and the freshness lifetime of a response from its headers,
+ * as in RFC 2616, sections 13.2.3 and 13.2.4.
+ */
+static void response_freshness(Response *r)
+{
+    Octstr *s;
+    long date, expires, modified, base, max_age, age;
+
+    date = header_time(r->headers, "Date");
+    base = (date >= 0) ? date : r->received;
+
+    r->age = (date >= 0 && date < r->received) ? r->received - date : 0;
+    s = http_header_value(r->headers, octstr_imm("Age"));
+    if (s != NULL && octstr_parse_long(&age, s, 0, 10) != -1 && age > r->age)
+        r->age = age;
+    octstr_destroy(s);
+
+    if (cache_directive(r->headers, "no-cache", NULL))
+        r->lifetime = 0;
+    else if (cache_directive(r->headers, "s-maxage", &max_age) && max_age >= 0)
+        r->lifetime = max_age;
+    else if (cache_directive(r->headers, "max-age", &max_age) && max_age >= 0)
+        r->lifetime = max_age;
+    else if ((expires = header_time(r->headers, "Expires")) != -1)
+        /* an invalid date means already expired */
+        r->lifetime = (expires > base) ? expires - base : 0;
+    else if ((modified = header_time(r->headers, "Last-Modified")) >= 0 &&
+             modified < base) {
+        r->lifetime = (base - modified) / HEURISTIC_FRACTION;
+        if (r->lifetime > HEURISTIC_MAX)
+            r->lifetime = HEURISTIC_MAX;
+    } else
+        r->lifetime = 0;
+}
+
+
+/*
+ * A shared cache may not answer requests with credentials, partial or
+ * conditional requests of the client. Those go to the origin server.
+ */
+static int cacheable_request(List *request_headers)
+{
+    return !has_header(request_headers, "Authorization") &&
+           !has_header(request_headers, "Range") &&
+           !has_header(request_headers, "If-Match") &&
+           !has_header(request_headers, "If-None-Match") &&
+           !has_header(request_headers, "If-Modified-Since") &&
+           !has_header(request_headers, "If-Unmodified-Since") &&
+           !has_header(request_headers, "If-Range") &&
+           !cache_directive(request_headers, "no-store", NULL);
+}
+
+
+static int no_cache_request(List *request_headers)
+{
+    Octstr *pragma;
+    int no_cache;
+
+    if (cache_directive(request_headers, "no-cache", NULL))
+        return 1;
+    pragma = http_header_value(request_headers, octstr_imm("Pragma"));
+    no_cache = (pragma != NULL &&
+                octstr_case_search(pragma, octstr_imm("no-cache"), 0) >= 0);
+    octstr_destroy(pragma);
+    return no_cache;
+}
+
+
+/*
+ * Store a response to a GET request, or drop the stored one if the new
+ * response may not be stored. Takes over the response.
+ */
+static void store(Octstr *url, List *request_headers, Response *r)
+{
+    int validators;
+    time_t expires;
+
+    validators = has_validators(r->headers);
+    octstr_destroy(r->vary);
+    octstr_destroy(r->vary_values);
+    r->vary_values = NULL;
+    r->vary = http_header_value(r->headers, octstr_imm("Vary"));
+    if (r->vary != NULL)
+        octstr_strip_blanks(r->vary);
+    response_freshness(r);
+
+    if (r->status != HTTP_OK ||
+        cache_directive(r->headers, "no-store", NULL) ||
+        cache_directive(r->headers, "private", NULL) ||
+        has_header(r->headers, "Set-Cookie") ||
+        has_header(r->headers, "Set-Cookie2") ||
+        (r->vary != NULL && octstr_search_char(r->vary, '*', 0) >= 0) ||
+        (r->lifetime <= r->age && !validators)) {
+        gw_lru_remove(responses, url);
+        response_destroy(r);
+        return;
+    }
+
+    r->vary_values = vary_values(r->vary, request_headers);
+    /* keep stale responses with validators for revalidation */
+    expires = validators ? 0 : r->received + r->lifetime - r->age;
+    gw_lru_put(responses, url, r, response_size(r), expires);
+}
+
+
+/***********************************************************************
+ * Statistics exported as metrics.
+ */
+
+static double metric_counter(void *arg)
+{
+    return counter_value(arg);
+}
+
+
+enum { CACHE_EVICTIONS, CACHE_ENTRIES, CACHE_BYTES };
+
+static double metric_cache(void *arg)
+{
+    gw_lru_stats_t stats;
+
+    gw_lru_stats(responses, &stats);
+    switch ((long) arg) {
+        case CACHE_EVICTIONS: return stats.evictions;
+        case CACHE_ENTRIES: return stats.entries;
+        default: return stats.size;
+    }
+}
+
+
+static void register_metrics(void)
+{
+#define METRIC(name, help, type, value, arg) \
+    gwlist_append(metrics, gw_metrics_callback(name, help, type, NULL, \
+                  value, (void *) (arg)))
+
+    metrics = gwlist_create();
+    METRIC("kannel_wapbox_http_cache_hits_total",
+           "Requests answered from the HTTP cache.", GW_METRIC_COUNTER,
+           metric_counter, hits);
+    METRIC("kannel_wapbox_http_cache_misses_total",
+           "Requests fetched from the origin server.", GW_METRIC_COUNTER,
+           metric_counter, misses);
+    METRIC("kannel_wapbox_http_cache_revalidations_total",
+           "Stale responses revalidated with the origin server.",
+           GW_METRIC_COUNTER, metric_counter, revalidations);
+    METRIC("kannel_wapbox_http_cache_collapsed_total",
+           "Requests that waited for a fetch of the same URL.",
+           GW_METRIC_COUNTER, metric_counter, collapsed);
+    METRIC("kannel_wapbox_http_cache_evictions_total",
+           "Responses dropped from the full cache.", GW_METRIC_COUNTER,
+           metric_cache, (long) CACHE_EVICTIONS);
+    METRIC("kannel_wapbox_http_cache_entries",
+           "Responses in the cache.", GW_METRIC_GAUGE,
+           metric_cache, (long) CACHE_ENTRIES);
+    METRIC("kannel_wapbox_http_cache_bytes",
+           "Size of the responses in the cache.", GW_METRIC_GAUGE,
+           metric_cache, (long) CACHE_BYTES);
+
+#undef METRIC
+}
+
+
+static void unregister_metrics(void)
+{
+    gw_metric_t *metric;
+
+    while ((metric = gwlist_extract_first(metrics)) != NULL)
+        gw_metrics_unregister(metric);
+    gwlist_destroy(metrics, NULL);
+    metrics = NULL;
+}
+
+
+/***********************************************************************
+ * The public interface.
+ */
+
+void wap_http_cache_init(long max_size)
+{
+    if (max_size <= 0)
+        return;
+
+    responses = gw_lru_create(max_size, response_duplicate, response_destroy);
+    pending = dict_create(64, NULL);
+    pending_lock = mutex_create();
+    hits = counter_create();
+    misses = counter_create();
+    revalidations = counter_create();
+    collapsed = counter_create();
+    register_metrics();
+}
+
+
+void wap_http_cache_shutdown(void)
+{
+    gw_lru_stats_t stats;
+    List *keys;
+    Octstr *key;
+    Pending *p;
+    unsigned long h, m;
+
+    if (responses == NULL)
+        return;
+
+    unregister_metrics();
+    gw_lru_stats(responses, &stats);
+    h = counter_value(hits);
+    m = counter_value(misses);
+    info(0, "HTTP cache: %lu hits, %lu misses (%.1f%% hits), %lu revalidated, "
+         "%lu collapsed, %lld evictions, %ld entries with %ld bytes.",
+         h, m, h + m > 0 ? 100.0 * h / (h + m) : 0.0,
+         counter_value(revalidations), counter_value(collapsed),
+         stats.evictions, stats.entries, stats.size);
+
+    keys = dict_keys(pending);
+    while ((key = gwlist_extract_first(keys)) != NULL) {
+        p = dict_remove(pending, key);
+        gwlist_destroy(p->waiters, NULL);
+        response_destroy(p->stale);
+        gw_free(p);
+        octstr_destroy(key);
+    }
+    gwlist_destroy(keys, NULL);
+    dict_destroy(pending);
+    mutex_destroy(pending_lock);
+    gw_lru_destroy(responses);
+    counter_destroy(hits);
+    counter_destroy(misses);
+    counter_destroy(revalidations);
+    counter_destroy(collapsed);
+    responses = NULL;
+    pending = NULL;
+}
+
+
+int wap_http_cache_request(Octstr *method, Octstr *url, List *request_headers,
+                           void *id, int *status, List **headers, Octstr **body)
+{
+    Response *r;
+    Pending *p;
+    Octstr *value;
+    long max_age;
+
+    if (responses == NULL)
+        return WAP_HTTP_CACHE_BYPASS;
+
+    if (octstr_str_compare(method, "GET") != 0) {
+        /* other methods than GET and HEAD invalidate the URL */
+        if (octstr_str_compare(method, "HEAD") != 0)
+            gw_lru_remove(responses, url);
+        return WAP_HTTP_CACHE_BYPASS;
+    }
+    if (!cacheable_request(request_headers))
+        return WAP_HTTP_CACHE_BYPASS;
+
+    r = no_cache_request(request_headers) ? NULL : gw_lru_get(responses, url);
+    if (r != NULL && !vary_matches(r, request_headers)) {
+        response_destroy(r);
+        r = NULL;
+    }
+    if (r != NULL && response_current_age(r) < r->lifetime &&
+        (!cache_directive(request_headers, "max-age", &max_age) ||
+         max_age < 0 || response_current_age(r) <= max_age)) {
+        counter_increase(hits);
+        response_give(r, status, headers, body);
+        return WAP_HTTP_CACHE_HIT;
+    }
+
+    mutex_lock(pending_lock);
+    p = dict_get(pending, url);
+    if (p != NULL) {
+        gwlist_append(p->waiters, id);
+        mutex_unlock(pending_lock);
+        counter_increase(collapsed);
+        response_destroy(r);
+        return WAP_HTTP_CACHE_WAIT;
+    }
+    p = gw_malloc(sizeof(*p));
+    p->waiters = gwlist_create();
+    p->stale = NULL;
+    if (r != NULL && has_validators(r->headers)) {
+        if ((value = http_header_value(r->headers, octstr_imm("ETag"))) != NULL)
+            http_header_add(request_headers, "If-None-Match",
+                            octstr_get_cstr(value));
+        octstr_destroy(value);
+        value = http_header_value(r->headers, octstr_imm("Last-Modified"));
+        if (value != NULL)
+            http_header_add(request_headers, "If-Modified-Since",
+                            octstr_get_cstr(value));
+        octstr_destroy(value);
+        p->stale = r;
+        r = NULL;
+    }
+    dict_put(pending, url, p);
+    mutex_unlock(pending_lock);
+
+    response_destroy(r);
+    counter_increase(misses);
+    return WAP_HTTP_CACHE_FETCH;
+}
+
+
+List *wap_http_cache_response(Octstr *url, List *request_headers,
+                              int *status, List **headers, Octstr **body)
+{
+    Pending *p;
+    Response *r;
+    List *waiters;
+
+    if (responses == NULL)
+        return NULL;
+
+    mutex_lock(pending_lock);
+    p = dict_remove(pending, url);
+    mutex_unlock(pending_lock);
+    if (p == NULL)
+        return NULL;
+    waiters = p->waiters;
+    r = p->stale;
+    gw_free(p);
+
+    if (*status == HTTP_NOT_MODIFIED && r != NULL) {
+        /* still valid, update it with the headers of the 304 response */
+        http_header_remove_all(*headers, "Content-Length");
+        http_header_remove_all(*headers, "Content-Type");
+        http_header_remove_all(*headers, "Transfer-Encoding");
+        http_header_combine(r->headers, *headers);
+        http_destroy_headers(*headers);
+        octstr_destroy(*body);
+        r->received = time(NULL);
+        counter_increase(revalidations);
+    } else {
+        response_destroy(r);
+        r = response_create(*status, http_header_duplicate(*headers),
+                            octstr_duplicate(*body));
+    }
+
+    if (r->status == HTTP_OK) {
+        store(url, request_headers, response_duplicate(r));
+        if (*status == HTTP_NOT_MODIFIED) {
+            response_give(r, status, headers, body);
+            r = NULL;
+        }
+    }
+    response_destroy(r);
+
+    if (gwlist_len(waiters) == 0) {
+        gwlist_destroy(waiters, NULL);
+        waiters = NULL;
+    }
+    return waiters;
+}
+
+
+int wap_http_cache_get(Octstr *url, List *request_headers,
+                       int *status, List **headers, Octstr **body)
+{
+    Response *r;
+
+    if (responses == NULL)
+        return 0;
+
+    r = gw_lru_get(responses, url);
+    if (r == NULL)
+        return 0;
+    if (!vary_matches(r, request_headers) ||
+        response_current_age(r) >= r->lifetime) {
+        response_destroy(r);
+        return 0;
+    }
+    counter_increase(hits);
+    response_give(r, status, headers, body);
+    return 1;
+}
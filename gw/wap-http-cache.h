@@ -0,0 +1,123 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw/wap-http-cache.h - HTTP response cache of the WAP application layer
+ *
+ * Keeps the responses of origin servers to GET requests, following the
+ * HTTP/1.1 rules for a shared cache. The Cache-Control, Expires and Vary
+ * headers of a response decide whether it is stored and for how long.
+ * Stale responses with validators are revalidated with a conditional
+ * request, and requests for a URL that is already being fetched wait for
+ * that fetch instead of going to the origin server themselves.
+ *
+ * The cache holds responses as the origin server sent them, before the
+ * content conversions of the application layer.
+ */
+
+#ifndef WAP_HTTP_CACHE_H
+#define WAP_HTTP_CACHE_H
+
+/* Results of wap_http_cache_request */
+enum {
+    WAP_HTTP_CACHE_BYPASS,  /* fetch it, the cache is not interested */
+    WAP_HTTP_CACHE_FETCH,   /* fetch it, then call wap_http_cache_response */
+    WAP_HTTP_CACHE_HIT,     /* response was found in the cache */
+    WAP_HTTP_CACHE_WAIT     /* URL already being fetched, request queued */
+};
+
+/*
+ * Create the cache, holding responses up to max_size bytes in total.
+ * With max_size 0 the cache is disabled and every request bypasses it.
+ */
+void wap_http_cache_init(long max_size);
+
+/*
+ * Log the statistics of the cache and destroy it. Queued requests are
+ * not destroyed, they belong to the caller.
+ */
+void wap_http_cache_shutdown(void);
+
+/*
+ * Look up the response to a request. On a hit, a copy of the response is
+ * put to status, headers and body. When a stale response needs to be
+ * revalidated, conditional headers are added to request_headers before
+ * FETCH is returned. On WAIT the id is queued and handed back by
+ * wap_http_cache_response when the response of the pending fetch has
+ * arrived.
+ */
+int wap_http_cache_request(Octstr *method, Octstr *url, List *request_headers,
+                           void *id, int *status, List **headers, Octstr **body);
+
+/*
+ * Handle the response of a fetch for which wap_http_cache_request returned
+ * FETCH. Stores the response if allowed; a 304 Not Modified response to a
+ * revalidation is replaced by the cached response. Returns the list of ids
+ * of queued requests, for which the caller should first try
+ * wap_http_cache_get and fetch the URL itself if that fails. The list is
+ * NULL if no requests were queued.
+ */
+List *wap_http_cache_response(Octstr *url, List *request_headers,
+                              int *status, List **headers, Octstr **body);
+
+/*
+ * Look up a fresh response for a request, without revalidation or
+ * queueing. Return 1 and a copy of the response if found, 0 if not.
+ */
+int wap_http_cache_get(Octstr *url, List *request_headers,
+                       int *status, List **headers, Octstr **body);
+
+#endif
@@ -100,8 +100,11 @@ enum { DEFAULT_TIMER_FREQ = 1};
 static Octstr *bearerbox_host;
 static long bearerbox_port = BB_DEFAULT_WAPBOX_PORT;
 static int bearerbox_ssl = 0;
+static Octstr *bearerbox_shm_dir = NULL;
+static long bearerbox_shm_size = BB_DEFAULT_SHM_SIZE;
 static Counter *sequence_counter = NULL;
 static long timer_freq = DEFAULT_TIMER_FREQ;
+static long wtp_threads = 1;
 static Octstr *config_filename;
 
 /* use strict XML parsing or relaxed */
@@ -111,6 +114,16 @@ static int wml_xml_strict = 1;
 int wsp_smart_errors = 0;
 Octstr *device_home = NULL;
 
+/* size limit in bytes of the compiled content cache, 0 disables it */
+long content_cache_size = 0;
+
+/* size limit in bytes of the HTTP response cache, 0 disables it */
+long http_cache_size = 0;
+
+/* HTTP port serving the metrics, -1 if none */
+static long metrics_port = -1;
+static long metrics_interval = 5;
+
 /* Controlling segmentation of sms messages sent by wapbox (push related).*/
 int concatenation = 1;
 long max_messages = 10;
@@ -145,6 +158,8 @@ static Cfg *init_wapbox(Cfg *cfg)
 #ifdef HAVE_LIBSSL
     cfg_get_bool(&bearerbox_ssl, grp, octstr_imm("wapbox-port-ssl"));
 #endif /* HAVE_LIBSSL */
+    bearerbox_shm_dir = cfg_get(grp, octstr_imm("box-shm-directory"));
+    cfg_get_integer(&bearerbox_shm_size, grp, octstr_imm("box-shm-size"));
     
     /* load parameters that could be later reloaded */
     config_reload(0);
@@ -161,6 +176,9 @@ static Cfg *init_wapbox(Cfg *cfg)
     bearerbox_host = cfg_get(grp, octstr_imm("bearerbox-host"));
     if (cfg_get_integer(&timer_freq, grp, octstr_imm("timer-freq")) == -1)
         timer_freq = DEFAULT_TIMER_FREQ;
+    if (cfg_get_integer(&wtp_threads, grp, octstr_imm("wtp-threads")) == -1 ||
+        wtp_threads < 1)
+        wtp_threads = 1;
 
     logfile = cfg_get(grp, octstr_imm("log-file"));
     if (logfile != NULL) {
@@ -209,6 +227,20 @@ static Cfg *init_wapbox(Cfg *cfg)
     if (cfg_get_integer(&value, grp, octstr_imm("http-timeout")) == 0)
        http_set_client_timeout(value);
 
+    if (cfg_get_integer(&content_cache_size, grp, 
+                        octstr_imm("content-cache-size")) == -1 ||
+        content_cache_size < 0)
+        content_cache_size = 0;
+
+    if (cfg_get_integer(&http_cache_size, grp, 
+                        octstr_imm("http-cache-size")) == -1 ||
+        http_cache_size < 0)
+        http_cache_size = 0;
+
+    cfg_get_integer(&metrics_port, grp, octstr_imm("metrics-port"));
+    if (cfg_get_integer(&metrics_interval, grp, octstr_imm("metrics-interval")) == -1)
+        metrics_interval = 5;
+
     /* configure the 'wtls' group */
 #if (HAVE_WTLS_OPENSSL)
     /* Load up the necessary keys */
@@ -271,6 +303,64 @@ static Cfg *init_wapbox(Cfg *cfg)
 }
 
 
+/*
+ * Serve the metrics, rendered by the gwlib refresh thread, at /metrics
+ * of the metrics port.
+ */
+static void metrics_thread(void *arg)
+{
+    HTTPClient *client;
+    Octstr *ip, *url, *body, *answer;
+    List *hdrs, *args, *reply_hdrs;
+    int status;
+
+    reply_hdrs = http_create_empty_headers();
+    http_header_add(reply_hdrs, "Content-Type", "text/plain; version=0.0.4");
+
+    while ((client = http_accept_request(metrics_port, &ip, &url, &hdrs,
+                                         &body, &args)) != NULL) {
+        if (octstr_compare(url, octstr_imm("/metrics")) == 0) {
+            status = HTTP_OK;
+            answer = gw_metrics_snapshot();
+        } else {
+            status = HTTP_NOT_FOUND;
+            answer = octstr_create("Unknown request.");
+        }
+        http_send_reply(client, status, reply_hdrs, answer);
+        octstr_destroy(answer);
+        octstr_destroy(ip);
+        octstr_destroy(url);
+        http_destroy_headers(hdrs);
+        octstr_destroy(body);
+        http_destroy_cgiargs(args);
+    }
+
+    http_destroy_headers(reply_hdrs);
+}
+
+
+static void start_metrics(void)
+{
+    if (metrics_port < 0)
+        return;
+
+    if (http_open_port(metrics_port, 0) == -1)
+        panic(0, "Cannot open metrics port %ld", metrics_port);
+    gw_metrics_start(metrics_interval);
+    gwthread_create(metrics_thread, NULL);
+}
+
+
+static void stop_metrics(void)
+{
+    if (metrics_port < 0)
+        return;
+
+    http_close_port(metrics_port);
+    gwthread_join_every(metrics_thread);
+}
+
+
 static void signal_handler(int signum) 
 {
     /* 
@@ -738,8 +828,9 @@ int main(int argc, char **argv)
                            timer_freq);
 
     wtp_resp_init(&dispatch_datagram, &wsp_session_dispatch_event,
-                  &wsp_push_client_dispatch_event, timer_freq);
+                  &wsp_push_client_dispatch_event, timer_freq, wtp_threads);
     wap_appl_init(cfg);
+    start_metrics();
 
 #if (HAVE_WTLS_OPENSSL)
     wtls_secmgr_init();
@@ -759,6 +850,8 @@ int main(int argc, char **argv)
     	bearerbox_host = octstr_create(BB_DEFAULT_HOST);
     connect_to_bearerbox(bearerbox_host, bearerbox_port, bearerbox_ssl, NULL
 		    /* bearerbox_our_port */);
+    if (bearerbox_shm_dir != NULL)
+        offer_shm_to_bearerbox(bearerbox_shm_dir, bearerbox_shm_size);
 
     if (cfg)
         wap_push_ota_bb_address_set(bearerbox_host);
@@ -776,9 +869,12 @@ int main(int argc, char **argv)
         /* block infinite for reading messages */
         ret = read_from_bearerbox(&msg, INFINITE_TIME);
         if (ret == -1) {
-            error(0, "Bearerbox is gone, restarting");
-            program_status = shutting_down;
-            restart = 1;
+            /* the read is cut short when we are told to go down */
+            if (program_status != shutting_down) {
+                error(0, "Bearerbox is gone, restarting");
+                program_status = shutting_down;
+                restart = 1;
+            }
             break;
         } else if (ret == 1) /* timeout */
             continue;
@@ -842,6 +938,7 @@ int main(int argc, char **argv)
     wsp_push_client_shutdown();
     wsp_unit_shutdown();
     wsp_session_shutdown();
+    stop_metrics();
     wap_appl_shutdown();
     radius_acct_shutdown();
 
@@ -857,6 +954,7 @@ int main(int argc, char **argv)
     wap_map_user_destroy();
     octstr_destroy(device_home);
     octstr_destroy(bearerbox_host);
+    octstr_destroy(bearerbox_shm_dir);
     octstr_destroy(config_filename);
 
     /*
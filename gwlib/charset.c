@@ -62,6 +62,13 @@
  * Richard Braakman
  */
 
+/* SSE2 is part of every x86-64 CPU; elsewhere the plain loops are used.
+ * The header comes before gwlib.h, which hides malloc and free. */
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define CHARSET_SSE2 1
+#endif
+
 #include "gwlib/gwlib.h"
 
 #if HAVE_ICONV
@@ -169,6 +176,40 @@ static const int gsm_to_unicode[128] = {
       'x',   'y',   'z',  0xE4,  0xF6,  0xF1,  0xFC,  0xE0    /* 120 - 127 */
 };
 
+/* gsm_esctouni as a table indexed by the escaped character, -1 if none.
+ * Filled in by charset_init. */
+static int gsm_esc_to_unicode[128];
+
+/* The same for gsm_esctolatin1. */
+static int gsm_esc_to_latin1[128];
+
+/* Whether a Latin-1 character survives the trip to GSM and back. */
+static unsigned char latin1_is_gsm[256];
+
+/*
+ * Characters that are the same in ASCII, ISO-8859-1 and GSM 03.38:
+ * space, letters, digits and most punctuation. Runs of them are copied
+ * as they are by the conversions below.
+ */
+#define GSM_IDENTITY(c) ((c) >= 0x20 && (c) <= 0x7A && (c) != 0x24 && \
+                         (c) != 0x40 && ((c) < 0x5B || (c) > 0x60))
+
+/*
+ * Opening an iconv conversion descriptor is expensive, so charset_convert
+ * keeps the descriptors in a pool, keyed by the pair of character sets,
+ * and reuses them. A descriptor is taken out of the pool for the time of
+ * one conversion. At most ICONV_POOL_MAX idle descriptors are kept for
+ * each pair.
+ */
+#if HAVE_ICONV
+#define ICONV_POOL_MAX 8
+
+static Dict *iconv_pool = NULL;
+static Mutex *iconv_pool_lock = NULL;
+
+static void iconv_pool_destroy_item(void *list);
+#endif
+
 /*
  * Register alises for Windows character sets that the libxml/libiconv can
  * recoqnise them.
@@ -205,11 +246,186 @@ void charset_init()
       xmlAddEncodingAlias(chars_aliases[i].real,chars_aliases[i].alias);
       /*debug("encoding",0,"Add encoding for %s",chars_aliases[i].alias);*/
     }
+
+    for (i = 0; i < 128; i++)
+        gsm_esc_to_unicode[i] = -1;
+    for (i = 0; gsm_esctouni[i].gsmesc >= 0; i++)
+        gsm_esc_to_unicode[gsm_esctouni[i].gsmesc] = gsm_esctouni[i].unichar;
+    for (i = 0; i < 128; i++)
+        gsm_esc_to_latin1[i] = -1;
+    for (i = 0; gsm_esctolatin1[i].gsmesc >= 0; i++)
+        gsm_esc_to_latin1[gsm_esctolatin1[i].gsmesc] = gsm_esctolatin1[i].latin1;
+    for (i = 0; i < 256; i++) {
+        int gsm = latin1_to_gsm[i];
+        latin1_is_gsm[i] = (gsm < 0) ? gsm_esc_to_unicode[-gsm] == i :
+                                        gsm_to_unicode[gsm] == i;
+    }
+
+#if HAVE_ICONV
+    iconv_pool = dict_create(32, iconv_pool_destroy_item);
+    iconv_pool_lock = mutex_create();
+#endif
 }
 
 void charset_shutdown()
 {
     xmlCleanupEncodingAliases();
+
+#if HAVE_ICONV
+    dict_destroy(iconv_pool);
+    mutex_destroy(iconv_pool_lock);
+    iconv_pool = NULL;
+    iconv_pool_lock = NULL;
+#endif
+}
+
+
+/*
+ * Write the UTF-8 encoding of unicode character c to buf, return the
+ * number of bytes written.
+ */
+static int utf8_encode(unsigned char *buf, long c)
+{
+    if (c < 0x80) {
+        buf[0] = c;
+        return 1;
+    } else if (c < 0x800) {
+        buf[0] = 0xC0 | (c >> 6);
+        buf[1] = 0x80 | (c & 0x3F);
+        return 2;
+    } else if (c < 0x10000) {
+        buf[0] = 0xE0 | (c >> 12);
+        buf[1] = 0x80 | ((c >> 6) & 0x3F);
+        buf[2] = 0x80 | (c & 0x3F);
+        return 3;
+    }
+    buf[0] = 0xF0 | (c >> 18);
+    buf[1] = 0x80 | ((c >> 12) & 0x3F);
+    buf[2] = 0x80 | ((c >> 6) & 0x3F);
+    buf[3] = 0x80 | (c & 0x3F);
+    return 4;
+}
+
+
+/*
+ * Decode the UTF-8 character at data[*pos] and move *pos past it. Return
+ * the unicode character, or -1 if the sequence is invalid, incomplete,
+ * overlong or encodes a surrogate.
+ */
+static long utf8_decode(const unsigned char *data, long len, long *pos)
+{
+    long c, min;
+    int i, n;
+
+    c = data[*pos];
+    if (c < 0x80) {
+        (*pos)++;
+        return c;
+    } else if ((c & 0xE0) == 0xC0) {
+        n = 1; c &= 0x1F; min = 0x80;
+    } else if ((c & 0xF0) == 0xE0) {
+        n = 2; c &= 0x0F; min = 0x800;
+    } else if ((c & 0xF8) == 0xF0) {
+        n = 3; c &= 0x07; min = 0x10000;
+    } else
+        return -1;
+
+    if (*pos + n >= len)
+        return -1;
+    for (i = 1; i <= n; i++) {
+        if ((data[*pos + i] & 0xC0) != 0x80)
+            return -1;
+        c = (c << 6) | (data[*pos + i] & 0x3F);
+    }
+    if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF))
+        return -1;
+
+    *pos += n + 1;
+    return c;
+}
+
+
+/*
+ * Map a unicode character above Latin-1 to GSM 03.38. Return the GSM
+ * code, negated if it is an escaped one, or NRP if there is none.
+ */
+static int unicode_to_gsm(long c)
+{
+    switch (c) {
+    case 0x394: return 0x10; /* GREEK CAPITAL LETTER DELTA */
+    case 0x3A6: return 0x12; /* GREEK CAPITAL LETTER PHI */
+    case 0x393: return 0x13; /* GREEK CAPITAL LETTER GAMMA */
+    case 0x39B: return 0x14; /* GREEK CAPITAL LETTER LAMBDA */
+    case 0x3A9: return 0x15; /* GREEK CAPITAL LETTER OMEGA */
+    case 0x3A0: return 0x16; /* GREEK CAPITAL LETTER PI */
+    case 0x3A8: return 0x17; /* GREEK CAPITAL LETTER PSI */
+    case 0x3A3: return 0x18; /* GREEK CAPITAL LETTER SIGMA */
+    case 0x398: return 0x19; /* GREEK CAPITAL LETTER THETA */
+    case 0x39E: return 0x1A; /* GREEK CAPITAL LETTER XI */
+    case 0x20AC: return -'e'; /* EURO SIGN */
+    default: return NRP; /* character cannot be represented in GSM 03.38 */
+    }
+}
+
+
+/*
+ * Return the length of the run of GSM_IDENTITY characters at the start
+ * of data. With SSE2, 16 bytes are checked at a time.
+ */
+static long identity_span(const unsigned char *data, long len)
+{
+    long pos = 0;
+#ifdef CHARSET_SSE2
+    const __m128i below = _mm_set1_epi8(0x20 - 1), above = _mm_set1_epi8(0x7A + 1);
+    const __m128i dollar = _mm_set1_epi8(0x24), at = _mm_set1_epi8(0x40);
+    const __m128i gap_below = _mm_set1_epi8(0x5B - 1);
+    const __m128i gap_above = _mm_set1_epi8(0x60 + 1);
+    __m128i v, in, out;
+    int mask;
+
+    /* bytes above 0x7F are negative in the signed compares */
+    for (; pos + 16 <= len; pos += 16) {
+        v = _mm_loadu_si128((const __m128i *) (data + pos));
+        in = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+        out = _mm_or_si128(_mm_cmpeq_epi8(v, dollar), _mm_cmpeq_epi8(v, at));
+        out = _mm_or_si128(out, _mm_and_si128(_mm_cmpgt_epi8(v, gap_below),
+                                              _mm_cmplt_epi8(v, gap_above)));
+        mask = _mm_movemask_epi8(_mm_andnot_si128(out, in));
+        if (mask != 0xFFFF)
+            return pos + __builtin_ctz(~mask);
+    }
+#endif
+    while (pos < len && GSM_IDENTITY(data[pos]))
+        pos++;
+    return pos;
+}
+
+
+/*
+ * Return the length of the run of printable ASCII characters, except
+ * the grave accent, at the start of data. All of them can be written in
+ * GSM 03.38, some as escapes.
+ */
+static long gsm_printable_span(const unsigned char *data, long len)
+{
+    long pos = 0;
+#ifdef CHARSET_SSE2
+    const __m128i below = _mm_set1_epi8(0x20 - 1), above = _mm_set1_epi8(0x7E + 1);
+    const __m128i grave = _mm_set1_epi8(0x60);
+    __m128i v, in;
+    int mask;
+
+    for (; pos + 16 <= len; pos += 16) {
+        v = _mm_loadu_si128((const __m128i *) (data + pos));
+        in = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+        mask = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, grave), in));
+        if (mask != 0xFFFF)
+            return pos + __builtin_ctz(~mask);
+    }
+#endif
+    while (pos < len && data[pos] >= 0x20 && data[pos] <= 0x7E && data[pos] != 0x60)
+        pos++;
+    return pos;
 }
 
 /**
@@ -219,65 +435,94 @@ void charset_shutdown()
  */
 void charset_gsm_to_utf8(Octstr *ostr)
 {
-    long pos, len;
-    Octstr *newostr;
+    long pos, len, n, span;
+    unsigned char *data, *buf;
+    int c;
 
     if (ostr == NULL)
         return;
 
-    newostr = octstr_create("");
+    data = (unsigned char *) octstr_get_cstr(ostr);
     len = octstr_len(ostr);
-    
+    /* no GSM character takes more than 3 bytes in UTF-8 */
+    buf = gw_malloc(len * 3 + 1);
+    n = 0;
+
     for (pos = 0; pos < len; pos++) {
-        int c, i;
-        
-        c = octstr_get_char(ostr, pos);
+        span = identity_span(data + pos, len - pos);
+        memcpy(buf + n, data + pos, span);
+        n += span;
+        pos += span;
+        if (pos == len)
+            break;
+
+        c = data[pos];
         if (c > 127) {
             warning(0, "Could not convert GSM (0x%02x) to Unicode.", c);
             continue;
         }
         
-        if(c == 27 && pos + 1 < len) {
-            c = octstr_get_char(ostr, ++pos);
-            for (i = 0; gsm_esctouni[i].gsmesc >= 0; i++) {
-                if (gsm_esctouni[i].gsmesc == c)
-                    break;
-            }   
-            if (gsm_esctouni[i].gsmesc == c) {
+        if (c == 27 && pos + 1 < len) {
+            c = data[++pos];
+            if (c < 128 && gsm_esc_to_unicode[c] >= 0) {
                 /* found a value for escaped char */
-                c = gsm_esctouni[i].unichar;
+                c = gsm_esc_to_unicode[c];
             } else {
-	        /* nothing found, look esc in our table */
-		c = gsm_to_unicode[27];
+                /* nothing found, look esc in our table */
+                c = gsm_to_unicode[27];
                 pos--;
-	    }
-        } else if (c < 128) {
-            c = gsm_to_unicode[c];
-        }
-        /* unicode to utf-8 */
-        if(c < 128) {
-            /* 0-127 are ASCII chars that need no conversion */
-            octstr_append_char(newostr, c);
-        } else { 
-            /* test if it can be converterd into a two byte char */
-            if(c < 0x0800) {
-                octstr_append_char(newostr, ((c >> 6) | 0xC0) & 0xFF); /* add 110xxxxx */
-                octstr_append_char(newostr, (c & 0x3F) | 0x80); /* add 10xxxxxx */
-            } else {
-                /* else we encode with 3 bytes. This only happens in case of euro symbol */
-                octstr_append_char(newostr, ((c >> 12) | 0xE0) & 0xFF); /* add 1110xxxx */
-                octstr_append_char(newostr, (((c >> 6) & 0x3F) | 0x80) & 0xFF); /* add 10xxxxxx */
-                octstr_append_char(newostr, ((c  & 0x3F) | 0x80) & 0xFF); /* add 10xxxxxx */
             }
-            /* There are no 4 bytes encoded characters in GSM charset */
+        } else {
+            c = gsm_to_unicode[c];
         }
+        n += utf8_encode(buf + n, c);
     }
 
     octstr_truncate(ostr, 0);
-    octstr_append(ostr, newostr);
-    octstr_destroy(newostr);
+    octstr_append_data(ostr, (char *) buf, n);
+    gw_free(buf);
 }
 
+/*
+ * Convert the UTF-8 character at data[*pos] to GSM 03.38 and move *pos
+ * past it. Return the GSM code, negated if it must be escaped, or
+ * INCOMPLETE_UTF8 if the text ends in the middle of the character.
+ */
+#define INCOMPLETE_UTF8 256
+static int utf8_char_to_gsm(const unsigned char *data, long len, long *pos)
+{
+    long val1, val2;
+
+    val1 = data[*pos];
+        
+    /* Convert UTF-8 to unicode code */
+        
+    /* test if two byte utf8 char */
+    if ((val1 & 0xE0) == 0xC0) {
+        /* test if incomplete utf char */
+        if (*pos + 1 >= len) {
+            *pos = len;
+            return INCOMPLETE_UTF8;
+        }
+        val2 = data[++(*pos)];
+        val1 = (((val1 & ~0xC0) << 6) | (val2 & 0x3F));
+    } else if ((val1 & 0xF0) == 0xE0) { /* test for three byte utf8 char */
+        if (*pos + 2 >= len) {
+            *pos = len;
+            return INCOMPLETE_UTF8;
+        }
+        val2 = data[++(*pos)];
+        val1 = (((val1 & ~0xE0) << 6) | (val2 & 0x3F));
+        val2 = data[++(*pos)];
+        val1 = (val1 << 6) | (val2 & 0x3F);
+    }
+    (*pos)++;
+
+    /* test Latin code page 1 char, else for allowed GSM chars */
+    return (val1 <= 255) ? latin1_to_gsm[val1] : unicode_to_gsm(val1);
+}
+
+
 /**
  * Convert octet string in UTF-8 format to GSM 03.38.
  * Because not all UTF-8 charater can be converted to GSM 03.38 non
@@ -287,168 +532,177 @@ void charset_gsm_to_utf8(Octstr *ostr)
  */
 void charset_utf8_to_gsm(Octstr *ostr)
 {
-    long pos, len;
-    int val1, val2;
-    Octstr *newostr;
+    long pos, len, n, span;
+    int c;
+    unsigned char *data, *buf;
 
     if (ostr == NULL)
         return;
     
-    newostr = octstr_create("");
+    data = (unsigned char *) octstr_get_cstr(ostr);
     len = octstr_len(ostr);
+    /* every input byte gives at most an escape and a character */
+    buf = gw_malloc(len * 2 + 1);
+    n = 0;
     
-    for (pos = 0; pos < len; pos++) {
-        val1 = octstr_get_char(ostr, pos);
-        
-        /* check range */
-        if (val1 < 0 || val1 > 255) {
-            warning(0, "Char (0x%02x) in UTF-8 string not in the range (0, 255). Skipped.", val1);
+    for (pos = 0; pos < len; ) {
+        span = identity_span(data + pos, len - pos);
+        memcpy(buf + n, data + pos, span);
+        n += span;
+        pos += span;
+        if (pos == len)
+            break;
+
+        c = utf8_char_to_gsm(data, len, &pos);
+        if (c == INCOMPLETE_UTF8) {
+            /* incomplete, ignore it */
+            warning(0, "Incomplete UTF-8 char discovered, skipped.");
             continue;
         }
-        
-        /* Convert UTF-8 to unicode code */
-        
-        /* test if two byte utf8 char */
-        if ((val1 & 0xE0) == 0xC0) {
-            /* test if incomplete utf char */
-            if(pos + 1 < len) {
-                val2 = octstr_get_char(ostr, ++pos);
-                val1 = (((val1 & ~0xC0) << 6) | (val2 & 0x3F));
-            } else {
-                /* incomplete, ignore it */
-                warning(0, "Incomplete UTF-8 char discovered, skipped. 1");
-                pos += 1;
-                continue;
-            }
-        } else if ((val1 & 0xF0) == 0xE0) { /* test for three byte utf8 char */
-            if(pos + 2 < len) {
-                val2 = octstr_get_char(ostr, ++pos);
-                val1 = (((val1 & ~0xE0) << 6) | (val2 & 0x3F));
-                val2 = octstr_get_char(ostr, ++pos);
-                val1 = (val1 << 6) | (val2 & 0x3F);
-            } else {
-                /* incomplete, ignore it */
-                warning(0, "Incomplete UTF-8 char discovered, skipped. 2");
-                pos += 2;
-                continue;
-            }
+        /* needs to be escaped ? */
+        if (c < 0) {
+            buf[n++] = 27;
+            c *= -1;
         }
-
-        /* test Latin code page 1 char */
-        if(val1 <= 255) {
-            val1 = latin1_to_gsm[val1];
-            /* needs to be escaped ? */
-            if(val1 < 0) {
-                octstr_append_char(newostr, 27);
-                val1 *= -1;
-            }
-        } else {
-            /* Its not a Latin1 char, test for allowed GSM chars */
-            switch(val1) {
-            case 0x394:
-                val1 = 0x10; /* GREEK CAPITAL LETTER DELTA */
-                break;
-            case 0x3A6:
-                val1 = 0x12; /* GREEK CAPITAL LETTER PHI */
-                break;
-            case 0x393:
-                val1 = 0x13; /* GREEK CAPITAL LETTER GAMMA */
-                break;
-            case 0x39B:
-                val1 = 0x14; /* GREEK CAPITAL LETTER LAMBDA */
-                break;
-            case 0x3A9:
-                val1 = 0x15; /* GREEK CAPITAL LETTER OMEGA */
-                break;
-            case 0x3A0:
-                val1 = 0x16; /* GREEK CAPITAL LETTER PI */
-                break;
-            case 0x3A8:
-                val1 = 0x17; /* GREEK CAPITAL LETTER PSI */
-                break;
-            case 0x3A3:
-                val1 = 0x18; /* GREEK CAPITAL LETTER SIGMA */
-                break;
-            case 0x398:
-                val1 = 0x19; /* GREEK CAPITAL LETTER THETA */
-                break;
-            case 0x39E:
-                val1 = 0x1A; /* GREEK CAPITAL LETTER XI */
-                break;
-            case 0x20AC:
-                val1 = 'e'; /* EURO SIGN */
-                octstr_append_char(newostr, 27);
-                break;
-            default: val1 = NRP; /* character cannot be represented in GSM 03.38 */
-            }
-        }
-        octstr_append_char(newostr, val1);
+        buf[n++] = c;
     }
 
     octstr_truncate(ostr, 0);
-    octstr_append(ostr, newostr);
-    octstr_destroy(newostr);
+    octstr_append_data(ostr, (char *) buf, n);
+    gw_free(buf);
+}
+
+
+int charset_utf8_is_gsm(Octstr *ostr)
+{
+    long pos, len, c;
+    unsigned char *data;
+
+    data = (unsigned char *) octstr_get_cstr(ostr);
+    len = octstr_len(ostr);
+
+    for (pos = 0; pos < len; ) {
+        pos += gsm_printable_span(data + pos, len - pos);
+        if (pos == len)
+            break;
+        c = utf8_decode(data, len, &pos);
+        if (c < 0)
+            return 0;
+        if (c <= 255 ? !latin1_is_gsm[c] : unicode_to_gsm(c) == NRP)
+            return 0;
+    }
+    return 1;
+}
+
+
+long charset_utf8_gsm_span(Octstr *ostr, long start, long max_septets,
+                           long *septets)
+{
+    long pos, len, n, span, next;
+    int c;
+    unsigned char *data;
+
+    data = (unsigned char *) octstr_get_cstr(ostr);
+    len = octstr_len(ostr);
+    n = 0;
+
+    for (pos = start; pos < len && n < max_septets; pos = next) {
+        span = identity_span(data + pos, len - pos);
+        if (span > max_septets - n)
+            span = max_septets - n;
+        n += span;
+        pos += span;
+        if (pos == len || n == max_septets)
+            break;
+
+        next = pos;
+        c = utf8_char_to_gsm(data, len, &next);
+        if (c == INCOMPLETE_UTF8)
+            continue;
+        if (n + (c < 0 ? 2 : 1) > max_septets)
+            break;
+        n += (c < 0 ? 2 : 1);
+    }
+
+    if (septets != NULL)
+        *septets = n;
+    return pos - start;
 }
 
 
 void charset_gsm_to_latin1(Octstr *ostr)
 {
-    long pos, len;
+    long pos, len, n, span;
+    unsigned char *data, *buf;
+    int c;
 
+    data = (unsigned char *) octstr_get_cstr(ostr);
     len = octstr_len(ostr);
+    buf = gw_malloc(len + 1);
+    n = 0;
+
     for (pos = 0; pos < len; pos++) {
-    int c, new, i;
+        span = identity_span(data + pos, len - pos);
+        memcpy(buf + n, data + pos, span);
+        n += span;
+        pos += span;
+        if (pos == len)
+            break;
 
-    c = octstr_get_char(ostr, pos);
-    if (c == 27 && pos + 1 < len) {
-        /* GSM escape code.  Delete it, then process the next
+        c = data[pos];
+        if (c == 27 && pos + 1 < len) {
+            /* GSM escape code.  Drop it, then process the next
              * character specially. */
-        octstr_delete(ostr, pos, 1);
-        len--;
-        c = octstr_get_char(ostr, pos);
-        for (i = 0; gsm_esctolatin1[i].gsmesc >= 0; i++) {
-        if (gsm_esctolatin1[i].gsmesc == c)
-            break;
+            c = data[++pos];
+            if (c < 128 && gsm_esc_to_latin1[c] >= 0)
+                c = gsm_esc_to_latin1[c];
+            else if (c < 128)
+                c = gsm_to_latin1[c];
+        } else if (c < 128) {
+            c = gsm_to_latin1[c];
         }
-        if (gsm_esctolatin1[i].gsmesc == c)
-        new = gsm_esctolatin1[i].latin1;
-        else if (c < 128)
-        new = gsm_to_latin1[c];
-        else
-        continue;
-    } else if (c < 128) {
-            new = gsm_to_latin1[c];
-    } else {
-        continue;
-    }
-    if (new != c)
-        octstr_set_char(ostr, pos, new);
+        /* characters with the 8th bit set are left unchanged */
+        buf[n++] = c;
     }
+
+    octstr_truncate(ostr, 0);
+    octstr_append_data(ostr, (char *) buf, n);
+    gw_free(buf);
 }
 
 
 void charset_latin1_to_gsm(Octstr *ostr)
 {
-    long pos, len;
-    int c, new;
-    unsigned char esc = 27;
+    long pos, len, n, span;
+    unsigned char *data, *buf;
+    int c;
 
+    data = (unsigned char *) octstr_get_cstr(ostr);
     len = octstr_len(ostr);
+    /* every character gives at most an escape and a character */
+    buf = gw_malloc(len * 2 + 1);
+    n = 0;
+
     for (pos = 0; pos < len; pos++) {
-    c = octstr_get_char(ostr, pos);
-    gw_assert(c >= 0);
-    gw_assert(c <= 256);
-    new = latin1_to_gsm[c];
-    if (new < 0) {
-         /* Escaped GSM code */
-        octstr_insert_data(ostr, pos, (char*) &esc, 1);
-        pos++;
-        len++;
-        new = -new;
-    }
-    if (new != c)
-        octstr_set_char(ostr, pos, new);
+        span = identity_span(data + pos, len - pos);
+        memcpy(buf + n, data + pos, span);
+        n += span;
+        pos += span;
+        if (pos == len)
+            break;
+
+        c = latin1_to_gsm[data[pos]];
+        if (c < 0) {
+            /* Escaped GSM code */
+            buf[n++] = 27;
+            c = -c;
+        }
+        buf[n++] = c;
     }
+
+    octstr_truncate(ostr, 0);
+    octstr_append_data(ostr, (char *) buf, n);
+    gw_free(buf);
 }
 
 
@@ -586,20 +840,221 @@ int charset_from_utf8(Octstr *utf8, Octstr **to, Octstr *charset_to)
     return ret;
 }
 
+/*
+ * Character sets that charset_convert handles itself, without iconv.
+ */
+enum { CS_OTHER, CS_UTF8, CS_LATIN1, CS_UCS2BE, CS_UTF16BE };
+
+static const struct {
+    char *name;
+    int id;
+} fast_charsets[] = {
+    { "UTF-8", CS_UTF8 },
+    { "UTF8", CS_UTF8 },
+    { "ISO-8859-1", CS_LATIN1 },
+    { "ISO8859-1", CS_LATIN1 },
+    { "ISO_8859-1", CS_LATIN1 },
+    { "LATIN1", CS_LATIN1 },
+    { "UCS-2BE", CS_UCS2BE },
+    { "UTF-16BE", CS_UTF16BE },
+    { NULL, CS_OTHER }
+};
+
+static int fast_charset(char *name)
+{
+    int i;
+
+    for (i = 0; fast_charsets[i].name != NULL; i++)
+        if (strcasecmp(name, fast_charsets[i].name) == 0)
+            return fast_charsets[i].id;
+    return CS_OTHER;
+}
+
+
+/*
+ * Convert between the character sets above. Return 1 if done, 0 if the
+ * input is not valid in charset_from or has characters that charset_to
+ * cannot represent; those are left to iconv, which decides what to do
+ * with them.
+ */
+static int convert_fast(Octstr *string, char *charset_from, char *charset_to)
+{
+    int from, to;
+    unsigned char *data, *buf;
+    long len, pos, n, c, c2;
+
+    from = fast_charset(charset_from);
+    to = fast_charset(charset_to);
+    if (from == CS_OTHER || to == CS_OTHER)
+        return 0;
+
+    data = (unsigned char *) octstr_get_cstr(string);
+    len = octstr_len(string);
+    /* no character grows to more than twice its input size */
+    buf = gw_malloc(len * 2 + 4);
+    pos = n = 0;
+
+    while (pos < len) {
+        switch (from) {
+        case CS_LATIN1:
+            c = data[pos++];
+            break;
+        case CS_UTF8:
+            c = utf8_decode(data, len, &pos);
+            break;
+        default:
+            if (pos + 1 >= len) {
+                c = -1;
+                break;
+            }
+            c = (data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if (c < 0xD800 || c > 0xDFFF)
+                break;
+            /* surrogates: a pair in UTF-16, invalid in UCS-2 */
+            if (from == CS_UCS2BE || c > 0xDBFF || pos + 1 >= len) {
+                c = -1;
+                break;
+            }
+            c2 = (data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if (c2 < 0xDC00 || c2 > 0xDFFF)
+                c = -1;
+            else
+                c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+        }
+        if (c < 0)
+            goto not_done;
+
+        switch (to) {
+        case CS_LATIN1:
+            if (c > 0xFF)
+                goto not_done;
+            buf[n++] = c;
+            break;
+        case CS_UTF8:
+            n += utf8_encode(buf + n, c);
+            break;
+        default:
+            if (c > 0xFFFF) {
+                if (to == CS_UCS2BE)
+                    goto not_done;
+                c -= 0x10000;
+                c2 = 0xDC00 | (c & 0x3FF);
+                c = 0xD800 | (c >> 10);
+                buf[n++] = c >> 8;
+                buf[n++] = c & 0xFF;
+                c = c2;
+            }
+            buf[n++] = c >> 8;
+            buf[n++] = c & 0xFF;
+        }
+    }
+
+    octstr_truncate(string, 0);
+    octstr_append_data(string, (char *) buf, n);
+    gw_free(buf);
+    return 1;
+
+not_done:
+    gw_free(buf);
+    return 0;
+}
+
+
+#if HAVE_ICONV
+static iconv_t iconv_take(char *charset_from, char *charset_to)
+{
+    Octstr *key;
+    List *list;
+    iconv_t *item, cd;
+
+    if (iconv_pool == NULL)
+        return iconv_open(charset_to, charset_from);
+
+    key = octstr_format("%s\n%s", charset_from, charset_to);
+    mutex_lock(iconv_pool_lock);
+    list = dict_get(iconv_pool, key);
+    item = (list != NULL) ? gwlist_extract_first(list) : NULL;
+    mutex_unlock(iconv_pool_lock);
+    octstr_destroy(key);
+
+    if (item == NULL)
+        return iconv_open(charset_to, charset_from);
+    cd = *item;
+    gw_free(item);
+    return cd;
+}
+
+
+static void iconv_give_back(char *charset_from, char *charset_to, iconv_t cd)
+{
+    Octstr *key;
+    List *list;
+    iconv_t *item;
+
+    if (iconv_pool == NULL) {
+        iconv_close(cd);
+        return;
+    }
+
+    /* back to the initial shift state for the next user */
+    iconv(cd, NULL, NULL, NULL, NULL);
+
+    item = NULL;
+    key = octstr_format("%s\n%s", charset_from, charset_to);
+    mutex_lock(iconv_pool_lock);
+    list = dict_get(iconv_pool, key);
+    if (list == NULL) {
+        list = gwlist_create();
+        dict_put(iconv_pool, key, list);
+    }
+    if (gwlist_len(list) < ICONV_POOL_MAX) {
+        item = gw_malloc(sizeof(*item));
+        *item = cd;
+        gwlist_append(list, item);
+    }
+    mutex_unlock(iconv_pool_lock);
+    octstr_destroy(key);
+
+    if (item == NULL)
+        iconv_close(cd);
+}
+
+
+static void iconv_pool_destroy_item(void *list)
+{
+    iconv_t *item;
+
+    while ((item = gwlist_extract_first(list)) != NULL) {
+        iconv_close(*item);
+        gw_free(item);
+    }
+    gwlist_destroy(list, NULL);
+}
+#endif
+
+
 int charset_convert(Octstr* string, char* charset_from, char* charset_to)
 {
 #if HAVE_ICONV
     char *from_buf, *to_buf, *pointer;
     size_t inbytesleft, outbytesleft, ret;
     iconv_t cd;
+#endif
      
     if (!charset_from || !charset_to || !string) /* sanity check */
         return -1;
 
     if (octstr_len(string) < 1)
         return 0; /* we are done, nothing to convert */
-        
-    cd = iconv_open(charset_to, charset_from);
+
+    /* the common character sets need no iconv */
+    if (convert_fast(string, charset_from, charset_to))
+        return 0;
+
+#if HAVE_ICONV
+    cd = iconv_take(charset_from, charset_to);
     /* Did I succeed in getting a conversion descriptor ? */
     if (cd == (iconv_t)(-1)) {
         /* I guess not */
@@ -651,7 +1106,7 @@ int charset_convert(Octstr* string, char* charset_from, char* charset_to)
         }
     } while(inbytesleft && ret == 0); /* stop if error occurs and not handled above */
     
-    iconv_close(cd);
+    iconv_give_back(charset_from, charset_to, cd);
     
     if (ret != -1) {
         /* conversion succeeded */
@@ -105,6 +105,22 @@ void charset_gsm_to_utf8(Octstr *ostr);
  */
 void charset_utf8_to_gsm(Octstr *ostr);
 
+/**
+ * Return 1 if every character of the UTF-8 string can be written in
+ * GSM 03.38, so that charset_utf8_to_gsm loses nothing, 0 if not, in
+ * which case the text needs UCS-2.
+ */
+int charset_utf8_is_gsm(Octstr *ostr);
+
+/**
+ * Return the number of octets of UTF-8 text, from octet `start' on, that
+ * fit in `max_septets' septets when converted to GSM 03.38. Characters
+ * and escape sequences are never cut in half. If `septets' is not NULL,
+ * the number of septets used is stored there.
+ */
+long charset_utf8_gsm_span(Octstr *ostr, long start, long max_septets,
+                           long *septets);
+
 /*
  * Convert from GSM default character set to NRC ISO 21 (German)
  * and vise versa.
@@ -152,7 +168,8 @@ int charset_to_utf8(Octstr *from, Octstr **to, Octstr *charset_from);
 int charset_from_utf8(Octstr *utf8, Octstr **to, Octstr *charset_to);
 
 /* use iconv library to convert an Octstr in place, from source character set to
- * destination character set
+ * destination character set. Conversions between UTF-8, ISO-8859-1, UCS-2BE
+ * and UTF-16BE of valid text are done without iconv.
  */
 int charset_convert(Octstr* string, char* charset_from, char* charset_to);
 
@@ -820,7 +820,10 @@ int conn_register_real(Connection *conn, FDSet *fdset,
         if (conn->connected == yes) {
             if (conn->read_eof == 0 && conn->io_error == 0)
                 events |= POLLIN;
-            if (unlocked_outbuf_len(conn) > 0)
+            /* Input that was read but not used yet, such as a pipelined
+             * request, would not wake us up. POLLOUT calls the callback
+             * at once, and is turned off again by unlocked_write. */
+            if (unlocked_outbuf_len(conn) > 0 || unlocked_inbuf_len(conn) > 0)
                 events |= POLLOUT;
         } else {
           events |= POLLIN | POLLOUT;
@@ -1231,6 +1234,30 @@ Octstr *conn_read_packet(Connection *conn, int startmark, int endmark)
     return result;
 }
 
+long conn_read_parse(Connection *conn, conn_parse_func *parse, void *context)
+{
+    long len, ret = 0;
+
+    lock_in(conn);
+    len = unlocked_inbuf_len(conn);
+    if (len > 0)
+        ret = parse(context, (unsigned char *) octstr_get_cstr(conn->inbuf) +
+                    conn->inbufpos, len);
+    if (ret == 0) {
+        unlocked_read(conn);
+        if (unlocked_inbuf_len(conn) > len)
+            ret = parse(context, (unsigned char *) octstr_get_cstr(conn->inbuf) +
+                        conn->inbufpos, unlocked_inbuf_len(conn));
+    }
+    if (ret > 0) {
+        gw_assert(ret <= unlocked_inbuf_len(conn));
+        conn->inbufpos += ret;
+    }
+    unlock_in(conn);
+
+    return ret;
+}
+
 #ifdef HAVE_LIBSSL
 X509 *conn_get_peer_certificate(Connection *conn) 
 {
@@ -286,6 +286,17 @@ Octstr *conn_read_withlen(Connection *conn);
   */
 Octstr *conn_read_packet(Connection *conn, int startmark, int endmark);
 
+/* Call "parse" with the data in the input buffer, without copying it,
+ * after trying to read in more data if there is none or if "parse"
+ * needs more. "parse" returns the number of octets it used, which are
+ * removed from the input buffer, 0 if it needs more data, or -1 for an
+ * error. It must remember what it has already looked at itself and
+ * must not call other functions on the connection. Return what "parse"
+ * returned, or 0 if no data was available.
+ */
+typedef long conn_parse_func(void *context, const unsigned char *data, long len);
+long conn_read_parse(Connection *conn, conn_parse_func *parse, void *context);
+
 #ifdef HAVE_LIBSSL
 
 #include <openssl/x509.h>
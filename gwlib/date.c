@@ -62,6 +62,8 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "gwlib.h"
 
@@ -305,3 +307,17 @@ long date_universal_now(void)
 {
     return (long) time(NULL);
 }
+
+
+long long date_monotonic_usec(void)
+{
+    struct timeval tv;
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    gettimeofday(&tv, NULL);
+    return (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+}
@@ -121,3 +121,9 @@ Octstr* date_create_iso(time_t unixtime);
  * Return the current date and time as a unix time value.
  */
 long date_universal_now(void);
+
+/*
+ * Return time of a monotonic clock in microseconds, for measuring
+ * intervals. Falls back to the wall clock if no monotonic one exists.
+ */
+long long date_monotonic_usec(void);
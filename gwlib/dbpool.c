@@ -81,11 +81,19 @@
 #include "dbpool_pgsql.c"
 #include "dbpool_mssql.c"
 
+/* connections idle for this many seconds are checked before use */
+#define DBPOOL_CHECK_IDLE 30
+
+/* prepared statements kept per connection */
+#define DBPOOL_MAX_STATEMENTS 256
+
 
 static void dbpool_conn_destroy(DBPoolConn *conn)
 {
     gw_assert(conn != NULL);
 
+    /* statements first, some databases refuse to close otherwise */
+    dict_destroy(conn->statements);
     if (conn->conn != NULL)
         conn->pool->db_ops->close(conn->conn);
 
@@ -93,6 +101,65 @@ static void dbpool_conn_destroy(DBPoolConn *conn)
 }
 
 
+/*
+ * Is connection usable? It is only asked after a failed query or when
+ * it has been idle for a while, a round-trip per checkout is too much.
+ */
+static int dbpool_conn_alive(DBPoolConn *pc)
+{
+    struct db_ops *ops = pc->pool->db_ops;
+
+    if (pc->conn == NULL)
+        return 0;
+    if (ops->check == NULL || 
+        (!pc->failed && difftime(time(NULL), pc->last_used) < DBPOOL_CHECK_IDLE))
+        return 1;
+    if (ops->check(pc->conn) != 0)
+        return 0;
+    pc->failed = 0;
+    return 1;
+}
+
+
+/*
+ * Return prepared statement for sql from the cache of the connection,
+ * prepare it if it is not there yet.
+ */
+static void *dbpool_conn_statement(DBPoolConn *pc, const Octstr *sql)
+{
+    struct db_ops *ops = pc->pool->db_ops;
+    void *stmt;
+
+    if ((stmt = dict_get(pc->statements, (Octstr *) sql)) != NULL)
+        return stmt;
+
+    if ((stmt = ops->prepare(pc->conn, sql)) == NULL)
+        return NULL;
+    if (dict_key_count(pc->statements) >= DBPOOL_MAX_STATEMENTS) {
+        dict_destroy(pc->statements);
+        pc->statements = dict_create(DBPOOL_MAX_STATEMENTS, ops->finalize);
+    }
+    dict_put(pc->statements, (Octstr *) sql, stmt);
+
+    return stmt;
+}
+
+
+/*
+ * Query on connection failed. Check the connection before its next use
+ * and prepare the statement again, in case it was the culprit.
+ */
+static void dbpool_conn_failed(DBPoolConn *pc, const Octstr *sql)
+{
+    void *stmt;
+
+    pc->failed = 1;
+    if (pc->statements != NULL && 
+        (stmt = dict_remove(pc->statements, (Octstr *) sql)) != NULL)
+        pc->pool->db_ops->finalize(stmt);
+}
+
+
 /*************************************************************************
  * public functions
  */
@@ -100,6 +167,8 @@ static void dbpool_conn_destroy(DBPoolConn *conn)
 DBPool *dbpool_create(enum db_type db_type, DBConf *conf, unsigned int connections)
 {
     DBPool *p;
+    const char *name = NULL;
+    Octstr *labels;
 
     if (conf == NULL)
         return NULL;
@@ -117,42 +186,56 @@ DBPool *dbpool_create(enum db_type db_type, DBConf *conf, unsigned int connectio
 #ifdef HAVE_MSSQL
         case DBPOOL_MSSQL:
             p->db_ops = &mssql_ops;
+            name = "mssql";
             break;
 #endif
 #ifdef HAVE_MYSQL
         case DBPOOL_MYSQL:
             p->db_ops = &mysql_ops;
+            name = "mysql";
             break;
 #endif
 #ifdef HAVE_ORACLE
         case DBPOOL_ORACLE:
             p->db_ops = &oracle_ops;
+            name = "oracle";
             break;
 #endif
 #ifdef HAVE_SQLITE
         case DBPOOL_SQLITE:
             p->db_ops = &sqlite_ops;
+            name = "sqlite";
             break;
 #endif
 #ifdef HAVE_SQLITE3
         case DBPOOL_SQLITE3:
             p->db_ops = &sqlite3_ops;
+            name = "sqlite3";
             break;
 #endif
 #ifdef HAVE_SDB
         case DBPOOL_SDB:
             p->db_ops = &sdb_ops;
+            name = "sdb";
             break;
 #endif
 #ifdef HAVE_PGSQL
        case DBPOOL_PGSQL:
            p->db_ops = &pgsql_ops;
+           name = "pgsql";
            break;
 #endif
         default:
             panic(0, "Unknown dbpool type defined.");
     }
 
+    p->wait_time = gw_histogram_create();
+    labels = gw_metrics_label("db", octstr_imm(name));
+    p->wait_metric = gw_metrics_histogram("kannel_dbpool_wait_seconds",
+        "Time spent waiting for a database connection from the pool.",
+        labels, p->wait_time, 0.000001);
+    octstr_destroy(labels);
+
     /*
      * XXX what is todo here if not all connections
      * where established ???
@@ -174,6 +257,9 @@ void dbpool_destroy(DBPool *p)
     gwlist_remove_producer(p->pool);
     gwlist_destroy(p->pool, (void*) dbpool_conn_destroy);
 
+    gw_metrics_unregister(p->wait_metric);
+    gw_histogram_destroy(p->wait_time);
+
     p->db_ops->conf_destroy(p->conf);
     gw_free(p);
 }
@@ -198,6 +284,10 @@ unsigned int dbpool_increase(DBPool *p, unsigned int count)
 
             pc->conn = conn;
             pc->pool = p;
+            pc->statements = (p->db_ops->prepare != NULL) ?
+                dict_create(DBPOOL_MAX_STATEMENTS, p->db_ops->finalize) : NULL;
+            pc->last_used = time(NULL);
+            pc->failed = 0;
 
             p->curr_size++;
             opened++;
@@ -257,6 +347,7 @@ long dbpool_conn_count(DBPool *p)
 DBPoolConn *dbpool_conn_consume(DBPool *p)
 {
     DBPoolConn *pc;
+    long long start;
 
     gw_assert(p != NULL && p->pool != NULL);
     
@@ -273,14 +364,12 @@ DBPoolConn *dbpool_conn_consume(DBPool *p)
             gwthread_sleep(0.1);
     }
 
+    start = date_monotonic_usec();
+
     /* garantee that you deliver a valid connection to the caller */
     while ((pc = gwlist_consume(p->pool)) != NULL) {
 
-        /* 
-         * XXX check that the connection is still existing.
-         * Is this a performance bottle-neck?!
-         */
-        if (!pc->conn || (p->db_ops->check && p->db_ops->check(pc->conn) != 0)) {
+        if (!dbpool_conn_alive(pc)) {
             /* something was wrong, reinitialize the connection */
             /* lock dbpool for update */
             gwlist_lock(p->pool);
@@ -306,6 +395,8 @@ DBPoolConn *dbpool_conn_consume(DBPool *p)
         }
     }
 
+    gw_histogram_record(p->wait_time, date_monotonic_usec() - start);
+
     return (pc->conn != NULL ? pc : NULL);
 }
 
@@ -314,6 +405,8 @@ void dbpool_conn_produce(DBPoolConn *pc)
 {
     gw_assert(pc != NULL && pc->conn != NULL && pc->pool != NULL && pc->pool->pool != NULL);
 
+    pc->last_used = time(NULL);
+
     gwlist_produce(pc->pool->pool, pc);
 }
 
@@ -363,25 +456,51 @@ unsigned int dbpool_check(DBPool *p)
 
 int dbpool_conn_select(DBPoolConn *conn, const Octstr *sql, List *binds, List **result)
 {
+    struct db_ops *ops;
+    void *stmt;
+    int ret;
+
     if (sql == NULL || conn == NULL)
         return -1;
 
-    if (conn->pool->db_ops->select == NULL)
+    ops = conn->pool->db_ops;
+    if (ops->prepare != NULL) {
+        stmt = dbpool_conn_statement(conn, sql);
+        ret = (stmt != NULL) ? ops->select_prepared(conn->conn, stmt, binds, result) : -1;
+    } else if (ops->select != NULL)
+        ret = ops->select(conn->conn, sql, binds, result);
+    else
         return -1; /* may be panic here ??? */
 
-    return conn->pool->db_ops->select(conn->conn, sql, binds, result);
+    if (ret == -1)
+        dbpool_conn_failed(conn, sql);
+
+    return ret;
 }
 
 
 int dbpool_conn_update(DBPoolConn *conn, const Octstr *sql, List *binds)
 {
+    struct db_ops *ops;
+    void *stmt;
+    int ret;
+
     if (sql == NULL || conn == NULL)
         return -1;
 
-    if (conn->pool->db_ops->update == NULL)
+    ops = conn->pool->db_ops;
+    if (ops->prepare != NULL) {
+        stmt = dbpool_conn_statement(conn, sql);
+        ret = (stmt != NULL) ? ops->update_prepared(conn->conn, stmt, binds) : -1;
+    } else if (ops->update != NULL)
+        ret = ops->update(conn->conn, sql, binds);
+    else
         return -1; /* may be panic here ??? */
 
-    return conn->pool->db_ops->update(conn->conn, sql, binds);
+    if (ret == -1)
+        dbpool_conn_failed(conn, sql);
+
+    return ret;
 }
 
 #endif /* HAVE_DBPOOL */
@@ -93,6 +93,9 @@ typedef struct DBPool DBPool;
  typedef struct {
     void *conn; /* the pointer holding the database specific connection */
     DBPool *pool; /* pointer of the pool where this connection belongs to */
+    Dict *statements; /* prepared statements by SQL text, if supported */
+    time_t last_used; /* when the connection was last given back */
+    int failed; /* last query failed, check connection before next use */
 }  DBPoolConn;
 
 typedef struct {
@@ -135,28 +135,40 @@ static int mysql_check_conn(void *conn)
 }
 
 
-static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
+static void *mysql_prepare(void *conn, const Octstr *sql)
 {
     MYSQL_STMT *stmt;
-    MYSQL_RES *result;
-    MYSQL_BIND *bind = NULL;
-    long i, binds_len;
-    int ret;
-
-    *res = NULL;
 
     /* allocate statement handle */
     stmt = mysql_stmt_init((MYSQL*) conn);
     if (stmt == NULL) {
         error(0, "MYSQL: mysql_stmt_init(), out of memory.");
-        return -1;
+        return NULL;
     }
     if (mysql_stmt_prepare(stmt, octstr_get_cstr(sql), octstr_len(sql))) {
         error(0, "MYSQL: Unable to prepare statement: %s", mysql_stmt_error(stmt));
         mysql_stmt_close(stmt);
-        return -1;
+        return NULL;
     }
-    /* bind params if any */
+
+    return stmt;
+}
+
+
+static void mysql_finalize(void *stmt)
+{
+    mysql_stmt_close(stmt);
+}
+
+
+/*
+ * Bind the params if any and execute prepared statement.
+ */
+static int mysql_execute(MYSQL_STMT *stmt, List *binds)
+{
+    MYSQL_BIND *bind = NULL;
+    long i, binds_len;
+
     binds_len = gwlist_len(binds);
     if (binds_len > 0) {
         bind = gw_malloc(sizeof(MYSQL_BIND) * binds_len);
@@ -172,7 +184,6 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
         if (mysql_stmt_bind_param(stmt, bind)) {
           error(0, "MYSQL: mysql_stmt_bind_param() failed: `%s'", mysql_stmt_error(stmt));
           gw_free(bind);
-          mysql_stmt_close(stmt);
           return -1;
         }
     }
@@ -181,11 +192,27 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
     if (mysql_stmt_execute(stmt)) {
         error(0, "MYSQL: mysql_stmt_execute() failed: `%s'", mysql_stmt_error(stmt));
         gw_free(bind);
-        mysql_stmt_close(stmt);
         return -1;
     }
     gw_free(bind);
 
+    return 0;
+}
+
+
+static int mysql_select_prepared(void *conn, void *thestmt, List *binds, List **res)
+{
+    MYSQL_STMT *stmt = thestmt;
+    MYSQL_RES *result;
+    MYSQL_BIND *bind = NULL;
+    long i, binds_len;
+    int ret;
+
+    *res = NULL;
+
+    if (mysql_execute(stmt, binds) == -1)
+        return -1;
+
 #define DESTROY_BIND(bind, binds_len)           \
     do {                                        \
         long i;                                 \
@@ -199,9 +226,9 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
 
     /* Fetch result set meta information */
     result = mysql_stmt_result_metadata(stmt);
-    if (res == NULL) {
+    if (result == NULL) {
         error(0, "MYSQL: mysql_stmt_result_metadata() failed: `%s'", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
+        mysql_stmt_free_result(stmt);
         return -1;
     }
     /* Get total columns in the query */
@@ -238,7 +265,7 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
     if (mysql_stmt_bind_result(stmt, bind)) {
         error(0, "MYSQL: mysql_stmt_bind_result() failed: `%s'", mysql_stmt_error(stmt));
         DESTROY_BIND(bind, binds_len);
-        mysql_stmt_close(stmt);
+        mysql_stmt_free_result(stmt);
         return -1;
     }
 
@@ -279,11 +306,13 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
     DESTROY_BIND(bind, binds_len);
 #undef DESTROY_BIND
 
+    /* statement is kept, release the result set it holds */
+    mysql_stmt_free_result(stmt);
+
     /* any errors by fetch? */
     if (ret != MYSQL_NO_DATA) {
         List *row;
         error(0, "MYSQL: mysql_stmt_bind_result() failed: `%s'", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
         while((row = gwlist_extract_first(*res)) != NULL)
             gwlist_destroy(row, octstr_destroy_item);
         gwlist_destroy(*res, NULL);
@@ -291,61 +320,44 @@ static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
         return -1;
     }
 
-    mysql_stmt_close(stmt);
-
     return 0;
 }
 
 
-static int mysql_update(void *conn, const Octstr *sql, List *binds)
+static int mysql_update_prepared(void *conn, void *thestmt, List *binds)
 {
-    MYSQL_STMT *stmt;
-    MYSQL_BIND *bind = NULL;
-    long i, binds_len;
-    int ret;
+    MYSQL_STMT *stmt = thestmt;
 
-    /* allocate statement handle */
-    stmt = mysql_stmt_init((MYSQL*) conn);
-    if (stmt == NULL) {
-        error(0, "MYSQL: mysql_stmt_init(), out of memory.");
+    if (mysql_execute(stmt, binds) == -1)
         return -1;
-    }
-    if (mysql_stmt_prepare(stmt, octstr_get_cstr(sql), octstr_len(sql))) {
-        error(0, "MYSQL: Unable to prepare statement: %s", mysql_stmt_error(stmt));
-        mysql_stmt_close(stmt);
-        return -1;
-    }
-    /* bind params if any */
-    binds_len = gwlist_len(binds);
-    if (binds_len > 0) {
-        bind = gw_malloc(sizeof(MYSQL_BIND) * binds_len);
-        memset(bind, 0, sizeof(MYSQL_BIND) * binds_len);
-        for (i = 0; i < binds_len; i++) {
-            Octstr *str = gwlist_get(binds, i);
 
-            bind[i].buffer_type = MYSQL_TYPE_STRING;
-            bind[i].buffer = octstr_get_cstr(str);
-            bind[i].buffer_length = octstr_len(str);
-        }
-        /* Bind the buffers */
-        if (mysql_stmt_bind_param(stmt, bind)) {
-          error(0, "MYSQL: mysql_stmt_bind_param() failed: `%s'", mysql_stmt_error(stmt));
-          gw_free(bind);
-          mysql_stmt_close(stmt);
-          return -1;
-        }
-    }
+    return mysql_stmt_affected_rows(stmt);
+}
 
-    /* execute statement */
-    if (mysql_stmt_execute(stmt)) {
-        error(0, "MYSQL: mysql_stmt_execute() failed: `%s'", mysql_stmt_error(stmt));
-        gw_free(bind);
-        mysql_stmt_close(stmt);
+
+static int mysql_select(void *conn, const Octstr *sql, List *binds, List **res)
+{
+    void *stmt;
+    int ret;
+
+    *res = NULL;
+    if ((stmt = mysql_prepare(conn, sql)) == NULL)
         return -1;
-    }
-    gw_free(bind);
+    ret = mysql_select_prepared(conn, stmt, binds, res);
+    mysql_stmt_close(stmt);
+
+    return ret;
+}
 
-    ret = mysql_stmt_affected_rows(stmt);
+
+static int mysql_update(void *conn, const Octstr *sql, List *binds)
+{
+    void *stmt;
+    int ret;
+
+    if ((stmt = mysql_prepare(conn, sql)) == NULL)
+        return -1;
+    ret = mysql_update_prepared(conn, stmt, binds);
     mysql_stmt_close(stmt);
 
     return ret;
@@ -372,7 +384,11 @@ static struct db_ops mysql_ops = {
     .check = mysql_check_conn,
     .select = mysql_select,
     .update = mysql_update,
-    .conf_destroy = mysql_conf_destroy
+    .conf_destroy = mysql_conf_destroy,
+    .prepare = mysql_prepare,
+    .finalize = mysql_finalize,
+    .select_prepared = mysql_select_prepared,
+    .update_prepared = mysql_update_prepared
 };
 
 #endif /* HAVE_MYSQL */
@@ -104,6 +104,23 @@ struct db_ops {
      * @return #rows processed ; -1 if a error occurs
      */
     int (*update) (void *conn, const Octstr *sql, List *binds);
+    /*
+     * Prepare sql for repeated use on given connection.
+     * @return statement handle ; NULL if a error occurs
+     * NOTE: this function is optional, if it is there, dbpool keeps the
+     *       statements per connection and uses the *_prepared functions
+     *       below instead of select and update.
+     */
+    void* (*prepare) (void *conn, const Octstr *sql);
+    /*
+     * Release prepared statement.
+     */
+    void (*finalize) (void *stmt);
+    /*
+     * Same as select and update, for prepared statement.
+     */
+    int (*select_prepared) (void *conn, void *stmt, List *binds, List **result);
+    int (*update_prepared) (void *conn, void *stmt, List *binds);
 };
 
 struct DBPool
@@ -114,6 +131,8 @@ struct DBPool
     DBConf *conf; /* the database type specific configuration block */
     struct db_ops *db_ops; /* the database operations callbacks */
     enum db_type db_type; /* the type of database */
+    gw_histogram_t *wait_time; /* usec waited in dbpool_conn_consume */
+    gw_metric_t *wait_metric;
 };
 
 
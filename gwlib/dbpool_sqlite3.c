@@ -133,20 +133,13 @@ static void sqlite3_conf_destroy(DBConf *db_conf)
     gw_free(db_conf);
 }
 
-static int sqlite3_select(void *theconn, const Octstr *sql, List *binds, List **res)
+static void *sqlite3_prepare_stmt(void *theconn, const Octstr *sql)
 {
     sqlite3 *db = theconn;
     sqlite3_stmt *stmt;
     const char *rem;
-    List *row;
     int status;
-    int columns;
-    int i;
-    int binds_len = (binds ? gwlist_len(binds) : 0);
 
-    *res = NULL;
-
-    /* prepare statement */
 #if SQLITE_VERSION_NUMBER >= 3003009    
     status = sqlite3_prepare_v2(db, octstr_get_cstr(sql), octstr_len(sql) + 1, &stmt, &rem);
 #else    
@@ -154,20 +147,65 @@ static int sqlite3_select(void *theconn, const Octstr *sql, List *binds, List **
 #endif
     if (SQLITE_OK != status) {
         error(0, "SQLite3: %s", sqlite3_errmsg(db));
-        return -1;
+        return NULL;
     }
 
-    /* bind variables */
+    return stmt;
+}
+
+
+static void sqlite3_finalize_stmt(void *stmt)
+{
+    sqlite3_finalize(stmt);
+}
+
+
+/*
+ * Make statement ready for next use. Reset also releases the locks
+ * a cached statement would otherwise keep on the database.
+ */
+static void sqlite3_release_stmt(sqlite3_stmt *stmt)
+{
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+
+static int sqlite3_bind_stmt(sqlite3 *db, sqlite3_stmt *stmt, List *binds)
+{
+    int i, status;
+    int binds_len = (binds ? gwlist_len(binds) : 0);
+
     for (i = 0; i < binds_len; i++) {
         Octstr *bind = gwlist_get(binds, i);
         status = sqlite3_bind_text(stmt, i + 1, octstr_get_cstr(bind), octstr_len(bind), SQLITE_STATIC);
         if (SQLITE_OK != status) {
             error(0, "SQLite3: %s", sqlite3_errmsg(db));
-            sqlite3_finalize(stmt);
             return -1;
         }
     }
 
+    return 0;
+}
+
+
+static int sqlite3_select_prepared(void *theconn, void *thestmt, List *binds, List **res)
+{
+    sqlite3 *db = theconn;
+    sqlite3_stmt *stmt = thestmt;
+    List *row;
+    int status;
+    int columns;
+    int i;
+
+    *res = NULL;
+
+    /* bind variables */
+    if (sqlite3_bind_stmt(db, stmt, binds) == -1) {
+        sqlite3_release_stmt(stmt);
+        return -1;
+    }
+
     /* execute our statement */
     *res = gwlist_create();
     while ((status = sqlite3_step(stmt)) == SQLITE_ROW) {
@@ -192,53 +230,32 @@ static int sqlite3_select(void *theconn, const Octstr *sql, List *binds, List **
             gwlist_destroy(row, octstr_destroy_item);
         gwlist_destroy(*res, NULL);
         *res = NULL;
-        sqlite3_finalize(stmt);
+        sqlite3_release_stmt(stmt);
         return -1;
     }
 
-    sqlite3_finalize(stmt);
+    sqlite3_release_stmt(stmt);
 
     return 0;
 }
 
 
-static int sqlite3_update(void *theconn, const Octstr *sql, List *binds)
+static int sqlite3_update_prepared(void *theconn, void *thestmt, List *binds)
 {
     sqlite3 *db = theconn;
-    sqlite3_stmt *stmt;
-    const char *rem;
-    int status;
+    sqlite3_stmt *stmt = thestmt;
     int rows;
-    int i;
-    int binds_len = (binds ? gwlist_len(binds) : 0);
-
-    /* prepare statement */
-#if SQLITE_VERSION_NUMBER >= 3003009    
-    status = sqlite3_prepare_v2(db, octstr_get_cstr(sql), octstr_len(sql) + 1, &stmt, &rem);
-#else
-    status = sqlite3_prepare(db, octstr_get_cstr(sql), octstr_len(sql) + 1, &stmt, &rem);
-#endif    
-    if (SQLITE_OK != status) {
-        error(0, "SQLite3: %s", sqlite3_errmsg(db));
-        return -1;
-    }
-    debug("dbpool.sqlite3",0,"sqlite3_prepare done");
 
     /* bind variables */
-    for (i = 0; i < binds_len; i++) {
-        Octstr *bind = gwlist_get(binds, i);
-        status = sqlite3_bind_text(stmt, i + 1, octstr_get_cstr(bind), octstr_len(bind), SQLITE_STATIC);
-        if (SQLITE_OK != status) {
-            error(0, "SQLite3: %s", sqlite3_errmsg(db));
-            sqlite3_finalize(stmt);
-            return -1;
-        }
+    if (sqlite3_bind_stmt(db, stmt, binds) == -1) {
+        sqlite3_release_stmt(stmt);
+        return -1;
     }
 
     /* execute our statement */
-    if ((status = sqlite3_step(stmt)) != SQLITE_DONE) {
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
         error(0, "SQLite3: %s", sqlite3_errmsg(db));
-        sqlite3_finalize(stmt);
+        sqlite3_release_stmt(stmt);
         return -1;
     }
     debug("dbpool.sqlite3",0,"sqlite3_step done");
@@ -246,18 +263,51 @@ static int sqlite3_update(void *theconn, const Octstr *sql, List *binds)
     rows = sqlite3_changes(db);
     debug("dbpool.sqlite3",0,"rows processed = %d", rows);
 
-    sqlite3_finalize(stmt);
+    sqlite3_release_stmt(stmt);
 
     return rows;
 }
 
+
+static int sqlite3_select(void *theconn, const Octstr *sql, List *binds, List **res)
+{
+    void *stmt;
+    int ret;
+
+    *res = NULL;
+    if ((stmt = sqlite3_prepare_stmt(theconn, sql)) == NULL)
+        return -1;
+    ret = sqlite3_select_prepared(theconn, stmt, binds, res);
+    sqlite3_finalize(stmt);
+
+    return ret;
+}
+
+
+static int sqlite3_update(void *theconn, const Octstr *sql, List *binds)
+{
+    void *stmt;
+    int ret;
+
+    if ((stmt = sqlite3_prepare_stmt(theconn, sql)) == NULL)
+        return -1;
+    ret = sqlite3_update_prepared(theconn, stmt, binds);
+    sqlite3_finalize(stmt);
+
+    return ret;
+}
+
 static struct db_ops sqlite3_ops = {
     .open = sqlite3_open_conn,
     .close = sqlite3_close_conn,
     .check = sqlite3_check_conn,
     .conf_destroy = sqlite3_conf_destroy,
     .select = sqlite3_select,
-    .update = sqlite3_update
+    .update = sqlite3_update,
+    .prepare = sqlite3_prepare_stmt,
+    .finalize = sqlite3_finalize_stmt,
+    .select_prepared = sqlite3_select_prepared,
+    .update_prepared = sqlite3_update_prepared
 };
 
 #endif /* HAVE_SQLITE3 */
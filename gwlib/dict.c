@@ -134,9 +134,22 @@ static void unlock(Dict *dict)
 }
 
 
+/*
+ * FNV-1a over the octets of the key. octstr_hash_key only sums them,
+ * so keys that differ in a few digits crowd into a few buckets. It stays
+ * as it is, the spool store keeps its values on disk.
+ */
 static long key_to_index(Dict *dict, Octstr *key)
 {
-    return octstr_hash_key(key) % dict->size;
+    unsigned long h = 2166136261UL;
+    long i, len;
+
+    len = octstr_len(key);
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char) octstr_get_char(key, i);
+        h *= 16777619UL;
+    }
+    return h % dict->size;
 }
 
 static int handle_null_value(Dict *dict, Octstr *key, void *value)
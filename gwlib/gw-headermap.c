@@ -0,0 +1,423 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-headermap.c - HTTP headers indexed by name.
+ *
+ * Headers are kept in an array in the order they were added. A hash
+ * table of the case folded names chains the headers of each bucket in
+ * the same order, so the first header found is the first one added.
+ * Removing headers compacts the array and rebuilds the hash table;
+ * headers are looked up far more often than removed.
+ */
+
+#include "gw-config.h"
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "gwlib.h"
+#include "gw-headermap.h"
+
+/* smallest hash table, a power of two */
+#define MIN_BUCKETS 16
+
+/* size of the table of common names, a power of two */
+#define COMMON_SIZE 128
+
+typedef struct {
+    Octstr *name;
+    Octstr *value;
+    unsigned long hash;
+    long next;          /* next header in the same bucket, -1 if none */
+    int common;         /* name is from the common names, not our own */
+} header;
+
+struct gw_headermap {
+    header *headers;
+    long len;
+    long size;
+    long *buckets;
+    long num_buckets;
+};
+
+/*
+ * Names of the headers gwlib and the boxes use the most. Headers added
+ * with one of these names, in the same case, share its Octstr.
+ */
+static char *common_names[] = {
+    "Accept", "Accept-Charset", "Accept-Encoding", "Accept-Language",
+    "Authorization", "Cache-Control", "Connection", "Content-Encoding",
+    "Content-Language", "Content-Length", "Content-Location",
+    "Content-Type", "Cookie", "Date", "ETag", "Expires", "Host",
+    "If-Modified-Since", "Keep-Alive", "Last-Modified", "Location",
+    "Pragma", "Proxy-Authorization", "Server", "Set-Cookie",
+    "Transfer-Encoding", "User-Agent", "Via", "WWW-Authenticate",
+    "X-WAP-Profile", "X-Wap-Application-Id", "X-Kannel-From",
+    "X-Kannel-To", "X-Kannel-Username", "X-Kannel-Password",
+    "X-Kannel-UDH", "X-Kannel-SMSC", "X-Kannel-Flash",
+    "X-Kannel-Coding", "X-Kannel-Charset", "X-Kannel-Validity",
+    "X-Kannel-Deferred", "X-Kannel-DLR-Mask", "X-Kannel-DLR-Url",
+    "X-Kannel-Account", "X-Kannel-PID", "X-Kannel-Alt-DCS",
+    "X-Kannel-RPI", "X-Kannel-Binfo", "X-Kannel-Priority",
+    "X-Kannel-Meta-Data", "X-Kannel-MClass", "X-Kannel-MWI",
+    "X-Kannel-Compress", "X-Kannel-Service",
+};
+#define NUM_COMMON_NAMES ((long) (sizeof(common_names) / sizeof(common_names[0])))
+
+static Octstr *common[COMMON_SIZE];
+static unsigned long common_hash[COMMON_SIZE];
+
+
+static unsigned long name_hash(const unsigned char *name, long len)
+{
+    unsigned long hash = 2166136261UL;
+    long i;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ tolower(name[i])) * 16777619UL;
+    return hash;
+}
+
+
+static int name_equals(Octstr *os, const char *name, long len)
+{
+    return octstr_len(os) == len &&
+           strncasecmp(octstr_get_cstr(os), name, len) == 0;
+}
+
+
+void gw_headermap_init(void)
+{
+    long i, j;
+
+    for (i = 0; i < NUM_COMMON_NAMES; i++) {
+        j = name_hash((unsigned char *) common_names[i],
+                      strlen(common_names[i])) & (COMMON_SIZE - 1);
+        while (common[j] != NULL)
+            j = (j + 1) & (COMMON_SIZE - 1);
+        common[j] = octstr_imm(common_names[i]);
+        common_hash[j] = name_hash((unsigned char *) common_names[i],
+                                   strlen(common_names[i]));
+    }
+}
+
+
+/* Return the common name that is exactly name, NULL if none. */
+static Octstr *common_name(Octstr *name, unsigned long hash)
+{
+    long i;
+
+    for (i = hash & (COMMON_SIZE - 1); common[i] != NULL;
+         i = (i + 1) & (COMMON_SIZE - 1)) {
+        if (common_hash[i] == hash && octstr_compare(common[i], name) == 0)
+            return common[i];
+    }
+    return NULL;
+}
+
+
+/* Chain header i after the last header of its bucket. */
+static void index_insert(gw_headermap_t *map, long i)
+{
+    long *link;
+
+    map->headers[i].next = -1;
+    link = &map->buckets[map->headers[i].hash & (map->num_buckets - 1)];
+    while (*link != -1)
+        link = &map->headers[*link].next;
+    *link = i;
+}
+
+
+static void index_rebuild(gw_headermap_t *map)
+{
+    long i;
+
+    if (map->num_buckets < 2 * map->len) {
+        while (map->num_buckets < 2 * map->len)
+            map->num_buckets *= 2;
+        map->buckets = gw_realloc(map->buckets,
+                                  map->num_buckets * sizeof(*map->buckets));
+    }
+    for (i = 0; i < map->num_buckets; i++)
+        map->buckets[i] = -1;
+    for (i = 0; i < map->len; i++)
+        index_insert(map, i);
+}
+
+
+/* Index of the first header called name, -1 if none. */
+static long find_first(gw_headermap_t *map, char *name, long len,
+                       unsigned long hash)
+{
+    long i;
+
+    for (i = map->buckets[hash & (map->num_buckets - 1)]; i != -1;
+         i = map->headers[i].next) {
+        if (map->headers[i].hash == hash &&
+            name_equals(map->headers[i].name, name, len))
+            return i;
+    }
+    return -1;
+}
+
+
+/* Add header, taking over name and value. */
+static void add_header(gw_headermap_t *map, Octstr *name, Octstr *value)
+{
+    header *h;
+    Octstr *shared;
+
+    if (map->len == map->size) {
+        map->size = (map->size == 0) ? 8 : 2 * map->size;
+        map->headers = gw_realloc(map->headers,
+                                  map->size * sizeof(*map->headers));
+    }
+
+    h = &map->headers[map->len++];
+    h->hash = name_hash((unsigned char *) octstr_get_cstr(name),
+                        octstr_len(name));
+    h->value = value;
+    if ((shared = common_name(name, h->hash)) != NULL) {
+        octstr_destroy(name);
+        h->name = shared;
+        h->common = 1;
+    } else {
+        h->name = name;
+        h->common = 0;
+    }
+
+    if (map->len > map->num_buckets / 2)
+        index_rebuild(map);
+    else
+        index_insert(map, map->len - 1);
+}
+
+
+gw_headermap_t *gw_headermap_create(void)
+{
+    gw_headermap_t *map;
+    long i;
+
+    map = gw_malloc(sizeof(*map));
+    map->headers = NULL;
+    map->len = map->size = 0;
+    map->num_buckets = MIN_BUCKETS;
+    map->buckets = gw_malloc(map->num_buckets * sizeof(*map->buckets));
+    for (i = 0; i < map->num_buckets; i++)
+        map->buckets[i] = -1;
+    return map;
+}
+
+
+void gw_headermap_destroy(gw_headermap_t *map)
+{
+    long i;
+
+    if (map == NULL)
+        return;
+
+    for (i = 0; i < map->len; i++) {
+        if (!map->headers[i].common)
+            octstr_destroy(map->headers[i].name);
+        octstr_destroy(map->headers[i].value);
+    }
+    gw_free(map->headers);
+    gw_free(map->buckets);
+    gw_free(map);
+}
+
+
+long gw_headermap_len(gw_headermap_t *map)
+{
+    gw_assert(map != NULL);
+
+    return map->len;
+}
+
+
+void gw_headermap_add(gw_headermap_t *map, Octstr *name, Octstr *value)
+{
+    gw_assert(map != NULL);
+    gw_assert(name != NULL);
+    gw_assert(value != NULL);
+
+    add_header(map, octstr_duplicate(name), octstr_duplicate(value));
+}
+
+
+void gw_headermap_set(gw_headermap_t *map, Octstr *name, Octstr *value)
+{
+    gw_assert(map != NULL);
+    gw_assert(name != NULL);
+    gw_assert(value != NULL);
+
+    /* copy first, name or value may be from this map */
+    name = octstr_duplicate(name);
+    value = octstr_duplicate(value);
+    gw_headermap_remove_all(map, octstr_get_cstr(name));
+    add_header(map, name, value);
+}
+
+
+Octstr *gw_headermap_get(gw_headermap_t *map, char *name)
+{
+    long i, len;
+
+    gw_assert(map != NULL);
+    gw_assert(name != NULL);
+
+    len = strlen(name);
+    i = find_first(map, name, len, name_hash((unsigned char *) name, len));
+    return (i == -1) ? NULL : map->headers[i].value;
+}
+
+
+List *gw_headermap_get_all(gw_headermap_t *map, char *name)
+{
+    List *values;
+    unsigned long hash;
+    long i, len;
+
+    gw_assert(map != NULL);
+    gw_assert(name != NULL);
+
+    values = gwlist_create();
+    len = strlen(name);
+    hash = name_hash((unsigned char *) name, len);
+    for (i = find_first(map, name, len, hash); i != -1; i = map->headers[i].next) {
+        if (map->headers[i].hash == hash &&
+            name_equals(map->headers[i].name, name, len))
+            gwlist_append(values, octstr_duplicate(map->headers[i].value));
+    }
+    return values;
+}
+
+
+long gw_headermap_remove_all(gw_headermap_t *map, char *name)
+{
+    header *h;
+    unsigned long hash;
+    long i, j, len;
+
+    gw_assert(map != NULL);
+    gw_assert(name != NULL);
+
+    len = strlen(name);
+    hash = name_hash((unsigned char *) name, len);
+    if (find_first(map, name, len, hash) == -1)
+        return 0;
+
+    for (i = j = 0; i < map->len; i++) {
+        h = &map->headers[i];
+        if (h->hash == hash && name_equals(h->name, name, len)) {
+            if (!h->common)
+                octstr_destroy(h->name);
+            octstr_destroy(h->value);
+        } else
+            map->headers[j++] = *h;
+    }
+    i = map->len - j;
+    map->len = j;
+    index_rebuild(map);
+    return i;
+}
+
+
+void gw_headermap_get_index(gw_headermap_t *map, long i, Octstr **name,
+                            Octstr **value)
+{
+    gw_assert(map != NULL);
+    gw_assert(i >= 0 && i < map->len);
+
+    *name = map->headers[i].name;
+    *value = map->headers[i].value;
+}
+
+
+gw_headermap_t *gw_headermap_from_list(List *headers)
+{
+    gw_headermap_t *map;
+    Octstr *name, *value;
+    long i;
+
+    map = gw_headermap_create();
+    for (i = 0; headers != NULL && i < gwlist_len(headers); i++) {
+        http_header_get(headers, i, &name, &value);
+        add_header(map, name, value);
+    }
+    return map;
+}
+
+
+List *gw_headermap_to_list(gw_headermap_t *map)
+{
+    List *headers;
+    Octstr *h;
+    long i;
+
+    gw_assert(map != NULL);
+
+    headers = http_create_empty_headers();
+    for (i = 0; i < map->len; i++) {
+        h = octstr_duplicate(map->headers[i].name);
+        octstr_append(h, octstr_imm(": "));
+        octstr_append(h, map->headers[i].value);
+        gwlist_append(headers, h);
+    }
+    return headers;
+}
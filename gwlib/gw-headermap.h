@@ -0,0 +1,148 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-headermap.h - HTTP headers indexed by name.
+ *
+ * Keeps headers in the order they were added, like the header lists
+ * of http.h, but finds them by name through a hash table instead of
+ * comparing the name of every header. Names are compared ignoring
+ * case. The names of common headers are shared by all maps instead of
+ * being copied for each header.
+ *
+ * gw_headermap_from_list and gw_headermap_to_list convert from and to
+ * the header lists of http.h, for code that still uses those.
+ *
+ * A map is not thread safe, it is meant to be used by one thread at a
+ * time, as header lists are.
+ */
+
+#ifndef GW_HEADERMAP_H
+#define GW_HEADERMAP_H 1
+
+typedef struct gw_headermap gw_headermap_t;
+
+/**
+ * Set up the table of common header names, called by gwlib_init
+ */
+void gw_headermap_init(void);
+
+/**
+ * Create an empty map
+ */
+gw_headermap_t *gw_headermap_create(void);
+
+/**
+ * Destroy map and all headers in it
+ * @map - map, may be NULL
+ */
+void gw_headermap_destroy(gw_headermap_t *map);
+
+/**
+ * Number of headers in map
+ */
+long gw_headermap_len(gw_headermap_t *map);
+
+/**
+ * Add header after all others
+ * @name - header name, copied
+ * @value - header value, copied
+ */
+void gw_headermap_add(gw_headermap_t *map, Octstr *name, Octstr *value);
+
+/**
+ * Replace all headers called name with one header
+ */
+void gw_headermap_set(gw_headermap_t *map, Octstr *name, Octstr *value);
+
+/**
+ * Find the first header called name
+ * @return its value, owned by the map and valid until the map is
+ *         changed, NULL if there is no such header
+ */
+Octstr *gw_headermap_get(gw_headermap_t *map, char *name);
+
+/**
+ * Find all headers called name
+ * @return list of copies of their values, possibly empty
+ */
+List *gw_headermap_get_all(gw_headermap_t *map, char *name);
+
+/**
+ * Remove all headers called name
+ * @return number of headers removed
+ */
+long gw_headermap_remove_all(gw_headermap_t *map, char *name);
+
+/**
+ * Get the i'th header in the order they were added. Name and value
+ * are owned by the map and valid until the map is changed.
+ */
+void gw_headermap_get_index(gw_headermap_t *map, long i, Octstr **name,
+                            Octstr **value);
+
+/**
+ * Create map of the headers of a header list of http.h. Headers
+ * without a colon are called X-Unknown, as with http_header_get.
+ */
+gw_headermap_t *gw_headermap_from_list(List *headers);
+
+/**
+ * Create header list of http.h of the headers of map, in order
+ */
+List *gw_headermap_to_list(gw_headermap_t *map);
+
+#endif
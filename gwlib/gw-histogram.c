@@ -0,0 +1,273 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-histogram.c - log-linear histogram for latency recording.
+ *
+ * Bucket index of value v >= SUB_BUCKETS with highest bit k is
+ * SUB_BUCKETS * (k - SUB_BITS + 1) + the next SUB_BITS bits below k,
+ * which continues the linear buckets 0 .. SUB_BUCKETS - 1 seamlessly.
+ */
+
+#include "gw-config.h"
+
+#include "gwlib.h"
+#include "gw-histogram.h"
+
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_BITS 40
+#define BUCKETS (SUB_BUCKETS * (MAX_BITS - SUB_BITS + 1))
+
+struct gw_histogram {
+    volatile unsigned long buckets[BUCKETS];
+    volatile unsigned long count;
+    volatile unsigned long long sum;
+    volatile long long max;
+#ifndef __GNUC__
+    Mutex *lock;
+#endif
+};
+
+
+static inline int bucket_index(long long value)
+{
+    int k;
+
+    if (value < SUB_BUCKETS)
+        return value;
+    if (value >= (1LL << MAX_BITS))
+        return BUCKETS - 1;
+#ifdef __GNUC__
+    k = 63 - __builtin_clzll((unsigned long long) value);
+#else
+    for (k = SUB_BITS; (value >> (k + 1)) != 0; k++)
+        ;
+#endif
+    return SUB_BUCKETS * (k - SUB_BITS + 1) +
+           (int) ((value >> (k - SUB_BITS)) - SUB_BUCKETS);
+}
+
+
+/* Return highest value that falls into bucket. */
+static long long bucket_upper(int index)
+{
+    int shift;
+
+    if (index < SUB_BUCKETS)
+        return index;
+    shift = index / SUB_BUCKETS - 1;
+    return ((long long) (SUB_BUCKETS + index % SUB_BUCKETS + 1) << shift) - 1;
+}
+
+
+gw_histogram_t *gw_histogram_create(void)
+{
+    gw_histogram_t *hist;
+
+    hist = gw_malloc(sizeof(*hist));
+    memset((void*) hist->buckets, 0, sizeof(hist->buckets));
+    hist->count = 0;
+    hist->sum = 0;
+    hist->max = 0;
+#ifndef __GNUC__
+    hist->lock = mutex_create();
+#endif
+
+    return hist;
+}
+
+
+void gw_histogram_destroy(gw_histogram_t *hist)
+{
+    if (hist == NULL)
+        return;
+
+#ifndef __GNUC__
+    mutex_destroy(hist->lock);
+#endif
+    gw_free(hist);
+}
+
+
+void gw_histogram_record(gw_histogram_t *hist, long long value)
+{
+    int index;
+
+    gw_assert(hist != NULL);
+
+    if (value < 0)
+        value = 0;
+    index = bucket_index(value);
+
+#ifdef __GNUC__
+    __sync_fetch_and_add(&hist->buckets[index], 1);
+    __sync_fetch_and_add(&hist->count, 1);
+    __sync_fetch_and_add(&hist->sum, (unsigned long long) value);
+    {
+        long long max = hist->max;
+        while (value > max) {
+            long long prev = __sync_val_compare_and_swap(&hist->max, max, value);
+            if (prev == max)
+                break;
+            max = prev;
+        }
+    }
+#else
+    mutex_lock(hist->lock);
+    hist->buckets[index]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max)
+        hist->max = value;
+    mutex_unlock(hist->lock);
+#endif
+}
+
+
+unsigned long gw_histogram_count(gw_histogram_t *hist)
+{
+    gw_assert(hist != NULL);
+    return hist->count;
+}
+
+
+unsigned long long gw_histogram_sum(gw_histogram_t *hist)
+{
+    gw_assert(hist != NULL);
+    return hist->sum;
+}
+
+
+long long gw_histogram_max(gw_histogram_t *hist)
+{
+    gw_assert(hist != NULL);
+    return hist->max;
+}
+
+
+long long gw_histogram_percentile(gw_histogram_t *hist, double percentile)
+{
+    unsigned long total, wanted, seen;
+    int i;
+
+    gw_assert(hist != NULL);
+
+    /* sum up buckets, count may be ahead of them while recording */
+    for (total = 0, i = 0; i < BUCKETS; i++)
+        total += hist->buckets[i];
+    if (total == 0)
+        return 0;
+
+    if (percentile < 0)
+        percentile = 0;
+    if (percentile > 100)
+        percentile = 100;
+    wanted = (unsigned long) (total * percentile / 100.0 + 0.5);
+    if (wanted < 1)
+        wanted = 1;
+
+    for (seen = 0, i = 0; i < BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= wanted)
+            break;
+    }
+    if (i >= BUCKETS)
+        i = BUCKETS - 1;
+
+    /* don't report more than we have seen */
+    if (bucket_upper(i) > hist->max && hist->max > 0)
+        return hist->max;
+    return bucket_upper(i);
+}
+
+
+unsigned long gw_histogram_count_le(gw_histogram_t *hist, long long value)
+{
+    unsigned long ret = 0;
+    int i, last;
+
+    gw_assert(hist != NULL);
+
+    if (value < 0)
+        return 0;
+
+    last = bucket_index(value);
+    for (i = 0; i <= last; i++)
+        ret += hist->buckets[i];
+
+    return ret;
+}
+
+
+void gw_histogram_reset(gw_histogram_t *hist)
+{
+    int i;
+
+    gw_assert(hist != NULL);
+
+#ifndef __GNUC__
+    mutex_lock(hist->lock);
+#endif
+    for (i = 0; i < BUCKETS; i++)
+        hist->buckets[i] = 0;
+    hist->count = 0;
+    hist->sum = 0;
+    hist->max = 0;
+#ifndef __GNUC__
+    mutex_unlock(hist->lock);
+#endif
+}
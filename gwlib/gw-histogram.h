@@ -0,0 +1,126 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-histogram.h - log-linear histogram for latency recording.
+ *
+ * Values are counted in buckets of constant relative width, like HDR
+ * histograms: values below 16 get a bucket each, every following power
+ * of two range is split into 16 linear buckets, so any value is reported
+ * with an error below 6.25%. Values up to 2^40 (about 12 days in
+ * microseconds) are distinguished, bigger ones go to the last bucket.
+ *
+ * Recording is a few atomic increments, so it is cheap enough to be done
+ * for every message. Readers may see a histogram while it is updated,
+ * the figures then may be off by the values recorded meanwhile.
+ */
+
+#ifndef GW_HISTOGRAM_H
+#define GW_HISTOGRAM_H 1
+
+typedef struct gw_histogram gw_histogram_t;
+
+/**
+ * Create empty histogram
+ */
+gw_histogram_t *gw_histogram_create(void);
+
+/**
+ * Destroy histogram
+ * @hist - histogram to destroy, may be NULL
+ */
+void gw_histogram_destroy(gw_histogram_t *hist);
+
+/**
+ * Record one value, negative values are counted as 0
+ */
+void gw_histogram_record(gw_histogram_t *hist, long long value);
+
+/**
+ * Return count of recorded values
+ */
+unsigned long gw_histogram_count(gw_histogram_t *hist);
+
+/**
+ * Return sum of recorded values
+ */
+unsigned long long gw_histogram_sum(gw_histogram_t *hist);
+
+/**
+ * Return biggest recorded value or 0 if empty
+ */
+long long gw_histogram_max(gw_histogram_t *hist);
+
+/**
+ * Return value below or at which the given percentage of all recorded
+ * values lie, i.e. the upper bound of the matching bucket.
+ * @percentile - 0 .. 100
+ * @return value or 0 if empty
+ */
+long long gw_histogram_percentile(gw_histogram_t *hist, double percentile);
+
+/**
+ * Return count of recorded values less or equal the given value. Buckets
+ * containing the value are counted completely.
+ */
+unsigned long gw_histogram_count_le(gw_histogram_t *hist, long long value);
+
+/**
+ * Reset histogram to empty state
+ */
+void gw_histogram_reset(gw_histogram_t *hist);
+
+#endif
@@ -0,0 +1,447 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-levelqueue.c - multi-level priority queue.
+ *
+ * Every level is a growing ring buffer protected by its own spinlock
+ * (or mutex if spinlocks are not available). The bitmap of non-empty
+ * levels and the total length are updated with atomic operations while
+ * holding the level lock, so readers may look at them without locking.
+ * The queue mutex and condition are only used to park blocking consumers;
+ * producers touch them only if somebody is actually waiting.
+ */
+
+#include "gw-config.h"
+
+#include <limits.h>
+#include <pthread.h>
+
+#include "gwlib.h"
+#include "gw-levelqueue.h"
+
+
+struct level {
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+    pthread_spinlock_t lock;
+#else
+    Mutex *lock;
+#endif
+    void **tab;
+    long start;
+    long len;
+    long size;
+};
+
+struct gw_levelqueue {
+    struct level *levels;
+    int num_levels;
+    int (*level)(const void *);
+    volatile unsigned long bitmap;  /* bit N set if level N not empty */
+    volatile long len;
+    volatile long waiters;
+    long producers;
+    Mutex *mutex;
+    pthread_cond_t nonempty;
+};
+
+#define MAX_LEVELS ((int) (sizeof(unsigned long) * CHAR_BIT))
+
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+#define level_lock(l) pthread_spin_lock(&(l)->lock)
+#define level_unlock(l) pthread_spin_unlock(&(l)->lock)
+#else
+#define level_lock(l) mutex_lock((l)->lock)
+#define level_unlock(l) mutex_unlock((l)->lock)
+#endif
+
+#ifdef __GNUC__
+#define atomic_add(p, v) __sync_add_and_fetch((p), (v))
+#define atomic_or(p, v) __sync_fetch_and_or((p), (v))
+#define atomic_and(p, v) __sync_fetch_and_and((p), (v))
+#define memory_barrier() __sync_synchronize()
+#else
+/* no atomic builtins, serialize them with one global mutex */
+static Mutex *atomic_mutex = NULL;
+static long atomic_add_l(volatile long *p, long v)
+{
+    long ret;
+    mutex_lock(atomic_mutex); ret = (*p += v); mutex_unlock(atomic_mutex);
+    return ret;
+}
+static unsigned long atomic_or_ul(volatile unsigned long *p, unsigned long v)
+{
+    unsigned long ret;
+    mutex_lock(atomic_mutex); ret = *p; *p |= v; mutex_unlock(atomic_mutex);
+    return ret;
+}
+static unsigned long atomic_and_ul(volatile unsigned long *p, unsigned long v)
+{
+    unsigned long ret;
+    mutex_lock(atomic_mutex); ret = *p; *p &= v; mutex_unlock(atomic_mutex);
+    return ret;
+}
+#define atomic_add(p, v) atomic_add_l((p), (v))
+#define atomic_or(p, v) atomic_or_ul((p), (v))
+#define atomic_and(p, v) atomic_and_ul((p), (v))
+#define memory_barrier() do { mutex_lock(atomic_mutex); mutex_unlock(atomic_mutex); } while(0)
+#endif
+
+
+static inline int highest_level(unsigned long bitmap)
+{
+#ifdef __GNUC__
+    return MAX_LEVELS - 1 - __builtin_clzl(bitmap);
+#else
+    int i = MAX_LEVELS - 1;
+    while (!(bitmap & (1UL << i)))
+        i--;
+    return i;
+#endif
+}
+
+
+static int item_level(gw_levelqueue_t *queue, void *item)
+{
+    int i = queue->level(item);
+
+    if (i < 0)
+        return 0;
+    if (i >= queue->num_levels)
+        return queue->num_levels - 1;
+    return i;
+}
+
+
+/* Make room for one more item. Caller must hold the level lock. */
+static void make_bigger(struct level *l)
+{
+    long i, new_size;
+    void **new_tab;
+
+    if (l->len < l->size)
+        return;
+
+    new_size = (l->size == 0 ? 16 : l->size * 2);
+    new_tab = gw_malloc(sizeof(*new_tab) * new_size);
+    for (i = 0; i < l->len; i++)
+        new_tab[i] = l->tab[(l->start + i) % l->size];
+    gw_free(l->tab);
+    l->tab = new_tab;
+    l->start = 0;
+    l->size = new_size;
+}
+
+
+static void wakeup(gw_levelqueue_t *queue)
+{
+    /*
+     * The length was updated with a full barrier, a consumer registers
+     * itself as waiter before checking the length once more. So either
+     * it sees our item or we see it waiting.
+     */
+    if (queue->waiters > 0) {
+        mutex_lock(queue->mutex);
+        pthread_cond_signal(&queue->nonempty);
+        mutex_unlock(queue->mutex);
+    }
+}
+
+
+static void insert(gw_levelqueue_t *queue, void *item, int head)
+{
+    struct level *l;
+    int i;
+
+    gw_assert(queue != NULL);
+    gw_assert(item != NULL);
+
+    i = item_level(queue, item);
+    l = &queue->levels[i];
+
+    level_lock(l);
+    make_bigger(l);
+    if (head) {
+        l->start = (l->start + l->size - 1) % l->size;
+        l->tab[l->start] = item;
+    } else {
+        l->tab[(l->start + l->len) % l->size] = item;
+    }
+    if (l->len++ == 0)
+        atomic_or(&queue->bitmap, 1UL << i);
+    atomic_add(&queue->len, 1);
+    level_unlock(l);
+
+    wakeup(queue);
+}
+
+
+gw_levelqueue_t *gw_levelqueue_create(int levels, int(*level)(const void *))
+{
+    gw_levelqueue_t *ret;
+    int i;
+
+    gw_assert(levels > 0 && levels <= MAX_LEVELS);
+    gw_assert(level != NULL);
+
+#ifndef __GNUC__
+    if (atomic_mutex == NULL)
+        atomic_mutex = mutex_create();
+#endif
+
+    ret = gw_malloc(sizeof(*ret));
+    ret->levels = gw_malloc(sizeof(*ret->levels) * levels);
+    for (i = 0; i < levels; i++) {
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+        pthread_spin_init(&ret->levels[i].lock, 0);
+#else
+        ret->levels[i].lock = mutex_create();
+#endif
+        ret->levels[i].tab = NULL;
+        ret->levels[i].start = 0;
+        ret->levels[i].len = 0;
+        ret->levels[i].size = 0;
+    }
+    ret->num_levels = levels;
+    ret->level = level;
+    ret->bitmap = 0;
+    ret->len = 0;
+    ret->waiters = 0;
+    ret->producers = 0;
+    ret->mutex = mutex_create();
+    pthread_cond_init(&ret->nonempty, NULL);
+
+    return ret;
+}
+
+
+void gw_levelqueue_destroy(gw_levelqueue_t *queue, void(*item_destroy)(void*))
+{
+    struct level *l;
+    long j;
+    int i;
+
+    if (queue == NULL)
+        return;
+
+    for (i = 0; i < queue->num_levels; i++) {
+        l = &queue->levels[i];
+        if (item_destroy != NULL) {
+            for (j = 0; j < l->len; j++)
+                item_destroy(l->tab[(l->start + j) % l->size]);
+        }
+        gw_free(l->tab);
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+        pthread_spin_destroy(&l->lock);
+#else
+        mutex_destroy(l->lock);
+#endif
+    }
+    gw_free(queue->levels);
+    mutex_destroy(queue->mutex);
+    pthread_cond_destroy(&queue->nonempty);
+    gw_free(queue);
+}
+
+
+long gw_levelqueue_len(gw_levelqueue_t *queue)
+{
+    if (queue == NULL)
+        return 0;
+
+    return queue->len;
+}
+
+
+void gw_levelqueue_insert(gw_levelqueue_t *queue, void *item)
+{
+    insert(queue, item, 0);
+}
+
+
+void gw_levelqueue_insert_head(gw_levelqueue_t *queue, void *item)
+{
+    insert(queue, item, 1);
+}
+
+
+void *gw_levelqueue_remove(gw_levelqueue_t *queue)
+{
+    unsigned long bitmap;
+    struct level *l;
+    void *ret;
+    int i;
+
+    gw_assert(queue != NULL);
+
+    while ((bitmap = queue->bitmap) != 0) {
+        i = highest_level(bitmap);
+        l = &queue->levels[i];
+        level_lock(l);
+        if (l->len == 0) {
+            /* somebody was faster, look again */
+            level_unlock(l);
+            continue;
+        }
+        ret = l->tab[l->start];
+        l->start = (l->start + 1) % l->size;
+        if (--l->len == 0)
+            atomic_and(&queue->bitmap, ~(1UL << i));
+        atomic_add(&queue->len, -1);
+        level_unlock(l);
+        return ret;
+    }
+
+    return NULL;
+}
+
+
+long gw_levelqueue_remove_batch(gw_levelqueue_t *queue, void **items, long max)
+{
+    unsigned long bitmap;
+    struct level *l;
+    long n = 0, taken;
+    int i;
+
+    gw_assert(queue != NULL);
+    gw_assert(items != NULL || max <= 0);
+
+    while (n < max && (bitmap = queue->bitmap) != 0) {
+        i = highest_level(bitmap);
+        l = &queue->levels[i];
+        level_lock(l);
+        if (l->len == 0) {
+            level_unlock(l);
+            continue;
+        }
+        /* take as much as we can from this level with one lock */
+        for (taken = 0; n < max && l->len > 0; taken++) {
+            items[n++] = l->tab[l->start];
+            l->start = (l->start + 1) % l->size;
+            l->len--;
+        }
+        atomic_add(&queue->len, -taken);
+        if (l->len == 0)
+            atomic_and(&queue->bitmap, ~(1UL << i));
+        level_unlock(l);
+    }
+
+    return n;
+}
+
+
+void *gw_levelqueue_consume(gw_levelqueue_t *queue)
+{
+    void *ret;
+
+    gw_assert(queue != NULL);
+
+    for (;;) {
+        if ((ret = gw_levelqueue_remove(queue)) != NULL)
+            return ret;
+
+        mutex_lock(queue->mutex);
+        queue->waiters++;
+        memory_barrier();
+        if (queue->len == 0 && queue->producers > 0) {
+            queue->mutex->owner = -1;
+            pthread_cond_wait(&queue->nonempty, &queue->mutex->mutex);
+            queue->mutex->owner = gwthread_self();
+        }
+        queue->waiters--;
+        if (queue->len == 0 && queue->producers == 0) {
+            mutex_unlock(queue->mutex);
+            return NULL;
+        }
+        mutex_unlock(queue->mutex);
+    }
+}
+
+
+void gw_levelqueue_add_producer(gw_levelqueue_t *queue)
+{
+    gw_assert(queue != NULL);
+
+    mutex_lock(queue->mutex);
+    queue->producers++;
+    mutex_unlock(queue->mutex);
+}
+
+
+void gw_levelqueue_remove_producer(gw_levelqueue_t *queue)
+{
+    gw_assert(queue != NULL);
+
+    mutex_lock(queue->mutex);
+    gw_assert(queue->producers > 0);
+    queue->producers--;
+    pthread_cond_broadcast(&queue->nonempty);
+    mutex_unlock(queue->mutex);
+}
+
+
+long gw_levelqueue_producer_count(gw_levelqueue_t *queue)
+{
+    long ret;
+
+    gw_assert(queue != NULL);
+
+    mutex_lock(queue->mutex);
+    ret = queue->producers;
+    mutex_unlock(queue->mutex);
+
+    return ret;
+}
@@ -0,0 +1,145 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-levelqueue.h - multi-level priority queue.
+ *
+ * Items are put into one of a small, fixed number of priority levels
+ * (at most the number of bits in a long). Each level is a FIFO with its
+ * own lock, and a bitmap of non-empty levels is maintained with atomic
+ * operations, so the highest non-empty level is found without taking
+ * any lock, and producers and consumers of different levels do not
+ * contend with each other. Items of the same level keep their order.
+ *
+ * Compared to gw-prioqueue.h (a single heap under one mutex) insertion
+ * and removal are O(1), several items may be removed at once, and items
+ * may be put back at the head of their level, e.g. after a temporary
+ * sending failure.
+ *
+ * Like List, the queue counts producers and supports blocking consumers.
+ */
+
+#ifndef GW_LEVELQUEUE_H
+#define GW_LEVELQUEUE_H 1
+
+typedef struct gw_levelqueue gw_levelqueue_t;
+
+/**
+ * Create multi-level queue
+ * @levels - count of priority levels, higher levels are served first
+ * @level - function returning the level of an item, values out of
+ *          range are clamped to the lowest resp. highest level
+ * @return newly created queue
+ */
+gw_levelqueue_t *gw_levelqueue_create(int levels, int(*level)(const void *));
+
+/**
+ * Destroy queue
+ * @queue - queue to destroy
+ * @item_destroy - item destructor, may be NULL
+ */
+void gw_levelqueue_destroy(gw_levelqueue_t *queue, void(*item_destroy)(void*));
+
+/**
+ * Return count of items in all levels
+ */
+long gw_levelqueue_len(gw_levelqueue_t *queue);
+
+/**
+ * Append item at the tail of its level
+ */
+void gw_levelqueue_insert(gw_levelqueue_t *queue, void *item);
+
+#define gw_levelqueue_produce(queue, item) gw_levelqueue_insert(queue, item)
+
+/**
+ * Put item back at the head of its level, so that it is the next one
+ * removed from this level. Use for requeueing after temporary failures.
+ */
+void gw_levelqueue_insert_head(gw_levelqueue_t *queue, void *item);
+
+/**
+ * Remove first item of the highest non-empty level, don't block
+ * @return item or NULL if queue is empty
+ */
+void *gw_levelqueue_remove(gw_levelqueue_t *queue);
+
+/**
+ * Remove up to max items in priority order, don't block
+ * @items - array to store the items, must hold at least max items
+ * @return count of removed items
+ */
+long gw_levelqueue_remove_batch(gw_levelqueue_t *queue, void **items, long max);
+
+/**
+ * Same as gw_levelqueue_remove, but block while the queue is empty and
+ * there are producers.
+ * @return item or NULL if queue is empty and no producers left
+ */
+void *gw_levelqueue_consume(gw_levelqueue_t *queue);
+
+/**
+ * Add/remove producer to/from the queue
+ */
+void gw_levelqueue_add_producer(gw_levelqueue_t *queue);
+void gw_levelqueue_remove_producer(gw_levelqueue_t *queue);
+
+/**
+ * Return producer count of the queue
+ */
+long gw_levelqueue_producer_count(gw_levelqueue_t *queue);
+
+#endif
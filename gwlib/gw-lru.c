@@ -0,0 +1,251 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-lru.c - size bounded cache with least recently used eviction.
+ *
+ * Items are kept in a Dict for lookup and in a doubly linked list in
+ * order of use, most recently used first, so that lookups, stores and
+ * evictions are constant time. One mutex protects both.
+ */
+
+#include "gw-config.h"
+
+#include <time.h>
+
+#include "gwlib.h"
+#include "gw-lru.h"
+
+/* hash table size hint of the index */
+#define LRU_DICT_SIZE 1024
+
+typedef struct lru_entry lru_entry;
+
+struct lru_entry {
+    Octstr *key;
+    void *item;
+    long size;
+    time_t expires;
+    lru_entry *prev;
+    lru_entry *next;
+};
+
+struct gw_lru {
+    Mutex *lock;
+    Dict *index;
+    lru_entry *head;    /* most recently used */
+    lru_entry *tail;    /* least recently used */
+    long max_size;
+    gw_lru_stats_t stats;
+    void *(*duplicate)(void *);
+    void (*destroy)(void *);
+};
+
+
+static void entry_unlink(gw_lru_t *lru, lru_entry *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        lru->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        lru->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+
+static void entry_link_head(gw_lru_t *lru, lru_entry *e)
+{
+    e->prev = NULL;
+    e->next = lru->head;
+    if (lru->head != NULL)
+        lru->head->prev = e;
+    else
+        lru->tail = e;
+    lru->head = e;
+}
+
+
+/* Drop entry from index and list and destroy it. Called with lock held. */
+static void entry_drop(gw_lru_t *lru, lru_entry *e)
+{
+    entry_unlink(lru, e);
+    dict_remove(lru->index, e->key);
+    lru->stats.entries--;
+    lru->stats.size -= e->size;
+    lru->destroy(e->item);
+    octstr_destroy(e->key);
+    gw_free(e);
+}
+
+
+gw_lru_t *gw_lru_create(long max_size, void *(*duplicate)(void *),
+                        void (*destroy)(void *))
+{
+    gw_lru_t *lru;
+
+    gw_assert(duplicate != NULL && destroy != NULL);
+
+    lru = gw_malloc(sizeof(*lru));
+    lru->lock = mutex_create();
+    lru->index = dict_create(LRU_DICT_SIZE, NULL);
+    lru->head = lru->tail = NULL;
+    lru->max_size = max_size;
+    memset(&lru->stats, 0, sizeof(lru->stats));
+    lru->duplicate = duplicate;
+    lru->destroy = destroy;
+
+    return lru;
+}
+
+
+void gw_lru_destroy(gw_lru_t *lru)
+{
+    if (lru == NULL)
+        return;
+
+    while (lru->head != NULL)
+        entry_drop(lru, lru->head);
+    dict_destroy(lru->index);
+    mutex_destroy(lru->lock);
+    gw_free(lru);
+}
+
+
+int gw_lru_put(gw_lru_t *lru, Octstr *key, void *item, long size, time_t expires)
+{
+    lru_entry *e;
+
+    gw_assert(lru != NULL && key != NULL);
+
+    if (size > lru->max_size) {
+        lru->destroy(item);
+        return 0;
+    }
+
+    mutex_lock(lru->lock);
+    if ((e = dict_get(lru->index, key)) != NULL)
+        entry_drop(lru, e);
+    while (lru->tail != NULL && lru->stats.size + size > lru->max_size) {
+        entry_drop(lru, lru->tail);
+        lru->stats.evictions++;
+    }
+
+    e = gw_malloc(sizeof(*e));
+    e->key = octstr_duplicate(key);
+    e->item = item;
+    e->size = size;
+    e->expires = expires;
+    entry_link_head(lru, e);
+    dict_put(lru->index, e->key, e);
+    lru->stats.entries++;
+    lru->stats.size += size;
+    mutex_unlock(lru->lock);
+
+    return 1;
+}
+
+
+void *gw_lru_get(gw_lru_t *lru, Octstr *key)
+{
+    lru_entry *e;
+    void *item = NULL;
+
+    gw_assert(lru != NULL && key != NULL);
+
+    mutex_lock(lru->lock);
+    e = dict_get(lru->index, key);
+    if (e != NULL && e->expires != 0 && e->expires <= time(NULL)) {
+        entry_drop(lru, e);
+        e = NULL;
+    }
+    if (e != NULL) {
+        entry_unlink(lru, e);
+        entry_link_head(lru, e);
+        item = lru->duplicate(e->item);
+        lru->stats.hits++;
+    } else {
+        lru->stats.misses++;
+    }
+    mutex_unlock(lru->lock);
+
+    return item;
+}
+
+
+void gw_lru_remove(gw_lru_t *lru, Octstr *key)
+{
+    lru_entry *e;
+
+    gw_assert(lru != NULL && key != NULL);
+
+    mutex_lock(lru->lock);
+    if ((e = dict_get(lru->index, key)) != NULL)
+        entry_drop(lru, e);
+    mutex_unlock(lru->lock);
+}
+
+
+void gw_lru_stats(gw_lru_t *lru, gw_lru_stats_t *stats)
+{
+    gw_assert(lru != NULL && stats != NULL);
+
+    mutex_lock(lru->lock);
+    *stats = lru->stats;
+    mutex_unlock(lru->lock);
+}
@@ -0,0 +1,127 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-lru.h - size bounded cache with least recently used eviction.
+ *
+ * Maps Octstr keys to items. Each item is stored with its size, in
+ * whatever unit the caller chooses (usually bytes), and the cache drops
+ * the least recently used items when the sum of sizes exceeds the limit.
+ * Items may have an expiry time, expired items are dropped when looked up.
+ *
+ * Lookups return a duplicate of the item, made with the duplicate
+ * function given at creation, so the cache may evict the original at
+ * any time. All functions are thread safe.
+ */
+
+#ifndef GW_LRU_H
+#define GW_LRU_H 1
+
+typedef struct gw_lru gw_lru_t;
+
+typedef struct {
+    long entries;
+    long size;
+    long long hits;
+    long long misses;
+    long long evictions;
+} gw_lru_stats_t;
+
+/**
+ * Create cache
+ * @max_size - limit of the sum of item sizes
+ * @duplicate - function copying an item, for lookups
+ * @destroy - function destroying an item
+ * @return newly created cache
+ */
+gw_lru_t *gw_lru_create(long max_size, void *(*duplicate)(void *),
+                        void (*destroy)(void *));
+
+/**
+ * Destroy cache and all items in it
+ * @lru - cache, may be NULL
+ */
+void gw_lru_destroy(gw_lru_t *lru);
+
+/**
+ * Store item, replacing an item of the same key. The cache takes over
+ * the item, if it is bigger than the limit it is destroyed at once.
+ * @key - key, copied
+ * @item - item
+ * @size - size of item, counted against the limit
+ * @expires - absolute time (as of time(NULL)) when the item expires,
+ *            0 if never
+ * @return 1 if stored, 0 if not
+ */
+int gw_lru_put(gw_lru_t *lru, Octstr *key, void *item, long size, time_t expires);
+
+/**
+ * Look up item and mark it used
+ * @return duplicate of item, NULL if not found or expired
+ */
+void *gw_lru_get(gw_lru_t *lru, Octstr *key);
+
+/**
+ * Drop item of key, if any
+ */
+void gw_lru_remove(gw_lru_t *lru, Octstr *key);
+
+/**
+ * Fill in statistics of the cache
+ */
+void gw_lru_stats(gw_lru_t *lru, gw_lru_stats_t *stats);
+
+#endif
@@ -0,0 +1,447 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-metrics.c - registry of metrics exported in Prometheus text format.
+ *
+ * Metrics are grouped into families by name, rendered in order of
+ * registration. The registry mutex is only taken when registering,
+ * unregistering and rendering, never when updating a value.
+ */
+
+#include "gw-config.h"
+
+#include "gwlib.h"
+#include "gw-metrics.h"
+
+/* histogram buckets, in exported units (usually seconds) */
+static const double histogram_bounds[] = {
+    0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300, 1800, 3600, 86400
+};
+
+struct family {
+    const char *name;
+    const char *help;
+    int type;
+    List *metrics;
+};
+
+struct gw_metric {
+    struct family *family;
+    Octstr *labels;
+    volatile long long value;
+    double (*callback)(void *arg);
+    void *arg;
+    gw_histogram_t *hist;
+    double scale;
+};
+
+static Mutex *registry_lock = NULL;
+static List *families = NULL;
+
+static Mutex *snapshot_lock = NULL;
+static Octstr *snapshot = NULL;
+
+static volatile int refresh_running = 0;
+static long refresh_thread = -1;
+static double refresh_interval = 5;
+
+#ifdef __GNUC__
+#define atomic_add(p, v) __sync_add_and_fetch((p), (v))
+#define atomic_set(p, v) __sync_lock_test_and_set((p), (v))
+#else
+static Mutex *atomic_lock = NULL;
+static void atomic_add(volatile long long *p, long long v)
+{
+    mutex_lock(atomic_lock); *p += v; mutex_unlock(atomic_lock);
+}
+static void atomic_set(volatile long long *p, long long v)
+{
+    mutex_lock(atomic_lock); *p = v; mutex_unlock(atomic_lock);
+}
+#endif
+
+
+void gw_metrics_init(void)
+{
+    registry_lock = mutex_create();
+    snapshot_lock = mutex_create();
+    families = gwlist_create();
+#ifndef __GNUC__
+    atomic_lock = mutex_create();
+#endif
+}
+
+
+static void family_destroy(void *p)
+{
+    struct family *family = p;
+
+    /* metrics still registered are leaked by their owner, free them */
+    while (gwlist_len(family->metrics) > 0) {
+        gw_metric_t *metric = gwlist_extract_first(family->metrics);
+        octstr_destroy(metric->labels);
+        gw_free(metric);
+    }
+    gwlist_destroy(family->metrics, NULL);
+    gw_free(family);
+}
+
+
+void gw_metrics_shutdown(void)
+{
+    if (refresh_running) {
+        refresh_running = 0;
+        gwthread_wakeup(refresh_thread);
+        gwthread_join(refresh_thread);
+    }
+
+    gwlist_destroy(families, family_destroy);
+    families = NULL;
+    octstr_destroy(snapshot);
+    snapshot = NULL;
+    mutex_destroy(registry_lock);
+    mutex_destroy(snapshot_lock);
+#ifndef __GNUC__
+    mutex_destroy(atomic_lock);
+#endif
+}
+
+
+Octstr *gw_metrics_label(const char *name, const Octstr *value)
+{
+    Octstr *ret;
+    long i;
+    int c;
+
+    ret = octstr_format("%s=\"", name);
+    for (i = 0; i < octstr_len(value); i++) {
+        c = octstr_get_char(value, i);
+        if (c == '\\' || c == '"')
+            octstr_append_char(ret, '\\');
+        if (c == '\n')
+            octstr_append_cstr(ret, "\\n");
+        else
+            octstr_append_char(ret, c);
+    }
+    octstr_append_char(ret, '"');
+
+    return ret;
+}
+
+
+static gw_metric_t *metric_create(const Octstr *labels)
+{
+    gw_metric_t *metric;
+
+    metric = gw_malloc(sizeof(*metric));
+    metric->family = NULL;
+    metric->labels = (octstr_len(labels) > 0 ? octstr_duplicate(labels) : NULL);
+    metric->value = 0;
+    metric->callback = NULL;
+    metric->arg = NULL;
+    metric->hist = NULL;
+    metric->scale = 1;
+
+    return metric;
+}
+
+
+static gw_metric_t *metric_register(gw_metric_t *metric, const char *name,
+                                    const char *help, int type)
+{
+    struct family *family = NULL;
+    long i;
+
+    gw_assert(name != NULL && help != NULL);
+
+    mutex_lock(registry_lock);
+    for (i = 0; i < gwlist_len(families); i++) {
+        family = gwlist_get(families, i);
+        if (strcmp(family->name, name) == 0)
+            break;
+        family = NULL;
+    }
+    if (family == NULL) {
+        family = gw_malloc(sizeof(*family));
+        family->name = name;
+        family->help = help;
+        family->type = type;
+        family->metrics = gwlist_create();
+        gwlist_append(families, family);
+    } else if (family->type != type) {
+        panic(0, "Metric <%s> registered with different types.", name);
+    }
+    metric->family = family;
+    gwlist_append(family->metrics, metric);
+    mutex_unlock(registry_lock);
+
+    return metric;
+}
+
+
+gw_metric_t *gw_metrics_counter(const char *name, const char *help, const Octstr *labels)
+{
+    return metric_register(metric_create(labels), name, help, GW_METRIC_COUNTER);
+}
+
+
+gw_metric_t *gw_metrics_gauge(const char *name, const char *help, const Octstr *labels)
+{
+    return metric_register(metric_create(labels), name, help, GW_METRIC_GAUGE);
+}
+
+
+gw_metric_t *gw_metrics_callback(const char *name, const char *help, int type,
+                                 const Octstr *labels, double (*value)(void *arg),
+                                 void *arg)
+{
+    gw_metric_t *metric;
+
+    gw_assert(type == GW_METRIC_COUNTER || type == GW_METRIC_GAUGE);
+    gw_assert(value != NULL);
+
+    metric = metric_create(labels);
+    metric->callback = value;
+    metric->arg = arg;
+
+    return metric_register(metric, name, help, type);
+}
+
+
+gw_metric_t *gw_metrics_histogram(const char *name, const char *help,
+                                  const Octstr *labels, gw_histogram_t *hist,
+                                  double scale)
+{
+    gw_metric_t *metric;
+
+    gw_assert(hist != NULL && scale > 0);
+
+    metric = metric_create(labels);
+    metric->hist = hist;
+    metric->scale = scale;
+
+    return metric_register(metric, name, help, GW_METRIC_HISTOGRAM);
+}
+
+
+void gw_metrics_unregister(gw_metric_t *metric)
+{
+    if (metric == NULL)
+        return;
+
+    mutex_lock(registry_lock);
+    gwlist_delete_equal(metric->family->metrics, metric);
+    mutex_unlock(registry_lock);
+
+    octstr_destroy(metric->labels);
+    gw_free(metric);
+}
+
+
+void gw_metric_add(gw_metric_t *metric, long long value)
+{
+    if (metric != NULL)
+        atomic_add(&metric->value, value);
+}
+
+
+void gw_metric_set(gw_metric_t *metric, long long value)
+{
+    if (metric != NULL)
+        atomic_set(&metric->value, value);
+}
+
+
+long long gw_metric_value(gw_metric_t *metric)
+{
+    gw_assert(metric != NULL);
+    return metric->value;
+}
+
+
+static void render_labels(Octstr *out, gw_metric_t *metric, const char *extra)
+{
+    if (metric->labels == NULL && extra == NULL)
+        return;
+
+    octstr_append_char(out, '{');
+    if (metric->labels != NULL)
+        octstr_append(out, metric->labels);
+    if (metric->labels != NULL && extra != NULL)
+        octstr_append_char(out, ',');
+    if (extra != NULL)
+        octstr_append_cstr(out, extra);
+    octstr_append_char(out, '}');
+}
+
+
+static void render_histogram(Octstr *out, struct family *family, gw_metric_t *metric)
+{
+    char le[64];
+    unsigned long count;
+    long i;
+
+    for (i = 0; i < sizeof(histogram_bounds) / sizeof(histogram_bounds[0]); i++) {
+        sprintf(le, "le=\"%g\"", histogram_bounds[i]);
+        octstr_format_append(out, "%s_bucket", family->name);
+        render_labels(out, metric, le);
+        octstr_format_append(out, " %lu\n", gw_histogram_count_le(metric->hist,
+                             (long long) (histogram_bounds[i] / metric->scale)));
+    }
+    /* all buckets, count may be ahead of them while recording */
+    count = gw_histogram_count_le(metric->hist, LLONG_MAX);
+    octstr_format_append(out, "%s_bucket", family->name);
+    render_labels(out, metric, "le=\"+Inf\"");
+    octstr_format_append(out, " %lu\n%s_sum", count, family->name);
+    render_labels(out, metric, NULL);
+    octstr_format_append(out, " %.6f\n%s_count", gw_histogram_sum(metric->hist) * metric->scale,
+                         family->name);
+    render_labels(out, metric, NULL);
+    octstr_format_append(out, " %lu\n", count);
+}
+
+
+Octstr *gw_metrics_render(void)
+{
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+    struct family *family;
+    gw_metric_t *metric;
+    Octstr *out;
+    double value;
+    long i, j;
+
+    out = octstr_create("");
+
+    mutex_lock(registry_lock);
+    for (i = 0; i < gwlist_len(families); i++) {
+        family = gwlist_get(families, i);
+        if (gwlist_len(family->metrics) == 0)
+            continue;
+        octstr_format_append(out, "# HELP %s %s\n# TYPE %s %s\n", family->name,
+                             family->help, family->name, type_names[family->type]);
+        for (j = 0; j < gwlist_len(family->metrics); j++) {
+            metric = gwlist_get(family->metrics, j);
+            if (metric->hist != NULL) {
+                render_histogram(out, family, metric);
+                continue;
+            }
+            if (metric->callback != NULL)
+                value = metric->callback(metric->arg);
+            else
+                value = metric->value;
+            octstr_append_cstr(out, family->name);
+            render_labels(out, metric, NULL);
+            octstr_format_append(out, " %.15g\n", value);
+        }
+    }
+    mutex_unlock(registry_lock);
+
+    return out;
+}
+
+
+static void refresh(void)
+{
+    Octstr *new, *old;
+
+    new = gw_metrics_render();
+    mutex_lock(snapshot_lock);
+    old = snapshot;
+    snapshot = new;
+    mutex_unlock(snapshot_lock);
+    octstr_destroy(old);
+}
+
+
+static void refresh_thread_run(void *arg)
+{
+    while (refresh_running) {
+        refresh();
+        gwthread_sleep(refresh_interval);
+    }
+}
+
+
+void gw_metrics_start(double interval)
+{
+    if (refresh_running)
+        return;
+
+    if (interval > 0)
+        refresh_interval = interval;
+    refresh();
+    refresh_running = 1;
+    if ((refresh_thread = gwthread_create(refresh_thread_run, NULL)) == -1) {
+        refresh_running = 0;
+        error(0, "Could not start metrics refresh thread.");
+    }
+}
+
+
+Octstr *gw_metrics_snapshot(void)
+{
+    Octstr *ret;
+
+    if (!refresh_running)
+        refresh();
+
+    mutex_lock(snapshot_lock);
+    ret = octstr_duplicate(snapshot);
+    mutex_unlock(snapshot_lock);
+
+    return ret;
+}
@@ -0,0 +1,172 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-metrics.h - registry of metrics exported in Prometheus text format.
+ *
+ * Subsystems register typed metrics once, when the object they describe
+ * is created, and unregister them before it is destroyed:
+ *
+ *  - counters and gauges owned by the registry, updated with atomic
+ *    operations by the subsystem,
+ *  - counters and gauges read by a callback, for values the subsystem
+ *    keeps anyway (Counter objects, list lengths, ...),
+ *  - gw_histogram histograms.
+ *
+ * The exposition text is not built when it is requested, but by a
+ * background thread every few seconds (see gw_metrics_start). Requests
+ * get a copy of the last rendered snapshot, so scraping never touches
+ * the structures the metrics describe. Callbacks therefore must be cheap,
+ * must not block for long and must not take locks which are held while
+ * calling gw_metrics_unregister.
+ *
+ * Metric names and help texts are expected to be string constants.
+ */
+
+#ifndef GW_METRICS_H
+#define GW_METRICS_H 1
+
+typedef struct gw_metric gw_metric_t;
+
+enum {
+    GW_METRIC_COUNTER = 0,
+    GW_METRIC_GAUGE = 1,
+    GW_METRIC_HISTOGRAM = 2
+};
+
+/*
+ * Initialize and shutdown the registry, called by gwlib_init and
+ * gwlib_shutdown.
+ */
+void gw_metrics_init(void);
+void gw_metrics_shutdown(void);
+
+/**
+ * Start thread refreshing the snapshot
+ * @interval - seconds between refreshes
+ */
+void gw_metrics_start(double interval);
+
+/**
+ * Return copy of the last rendered snapshot, render one if the refresh
+ * thread is not running.
+ */
+Octstr *gw_metrics_snapshot(void);
+
+/**
+ * Render all metrics now, mainly for tests.
+ */
+Octstr *gw_metrics_render(void);
+
+/**
+ * Return label pair name="value" with value escaped as needed, to be
+ * used as labels argument of the registration functions. Several pairs
+ * are joined by ','.
+ */
+Octstr *gw_metrics_label(const char *name, const Octstr *value);
+
+/**
+ * Register counter resp. gauge owned by the registry
+ * @name - metric name, all metrics of a name must have same type and help
+ * @help - help text
+ * @labels - label pairs or NULL, copied
+ * @return metric handle
+ */
+gw_metric_t *gw_metrics_counter(const char *name, const char *help, const Octstr *labels);
+gw_metric_t *gw_metrics_gauge(const char *name, const char *help, const Octstr *labels);
+
+/**
+ * Register counter or gauge whose value is read by callback when the
+ * snapshot is rendered
+ * @type - GW_METRIC_COUNTER or GW_METRIC_GAUGE
+ * @value - callback returning the value
+ * @arg - argument passed to callback
+ */
+gw_metric_t *gw_metrics_callback(const char *name, const char *help, int type,
+                                 const Octstr *labels, double (*value)(void *arg),
+                                 void *arg);
+
+/**
+ * Register histogram
+ * @hist - histogram, stays owned by the caller
+ * @scale - factor converting recorded values to exported unit, e.g.
+ *          0.000001 for values in microseconds exported as seconds
+ */
+gw_metric_t *gw_metrics_histogram(const char *name, const char *help,
+                                  const Octstr *labels, gw_histogram_t *hist,
+                                  double scale);
+
+/**
+ * Unregister and destroy metric. After return no callback for it is
+ * running or will be called anymore.
+ * @metric - metric, may be NULL
+ */
+void gw_metrics_unregister(gw_metric_t *metric);
+
+/**
+ * Update value of counter or gauge owned by the registry. A NULL metric,
+ * i.e. one not registered yet or already unregistered, is ignored.
+ */
+void gw_metric_add(gw_metric_t *metric, long long value);
+void gw_metric_set(gw_metric_t *metric, long long value);
+#define gw_metric_increase(metric) gw_metric_add((metric), 1)
+
+/**
+ * Return current value of counter or gauge owned by the registry
+ */
+long long gw_metric_value(gw_metric_t *metric);
+
+#endif
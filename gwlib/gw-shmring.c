@@ -0,0 +1,525 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-shmring.c - shared memory message rings between processes
+ *
+ * The ring file starts with a header, followed by the data of the ring
+ * to side 0 and the data of the ring to side 1. Each ring has a count of
+ * bytes ever written and read; only the writer moves the first and only
+ * the reader the second, with memory barriers between copying data and
+ * moving the counts. A frame is a four octet length in network byte
+ * order followed by the data, and may wrap around the end of the ring.
+ *
+ * A reader that finds its ring empty says so in the ring and sleeps on
+ * its FIFO, "path.0" or "path.1", and a writer that sees it writes one
+ * byte to that FIFO after a frame. Both ends of both FIFOs are opened
+ * non-blocking. A writer that finds the ring full yields the processor
+ * for a while and then sleeps a little between looks, since a full ring
+ * is rare and the reader is busy emptying it.
+ */
+
+#include "gw-config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "gwlib.h"
+#include "gw-shmring.h"
+
+#define SHMRING_MAGIC 0x4b52494eL    /* "KRIN" */
+#define SHMRING_MIN_SIZE 4096
+#define SHMRING_MAX_SIZE (256L * 1024 * 1024)
+/* a writer finding the ring full yields this many times, then sleeps */
+#define FULL_SPINS 100
+#define FULL_SLEEP 0.001
+
+typedef struct {
+    volatile unsigned long head;    /* bytes written */
+    volatile unsigned long tail;    /* bytes read */
+    volatile int reader_waiting;
+} ring_state;
+
+typedef struct {
+    long magic;
+    long size;
+    volatile long pid[2];
+    volatile int closed[2];
+    ring_state ring[2];             /* ring[i] carries data to side i */
+} ring_header;
+
+/* data starts at a cache line boundary */
+#define HEADER_SIZE ((sizeof(ring_header) + 63) & ~63UL)
+
+struct gw_shmring {
+    Octstr *path;
+    int side;
+    ring_header *shm;
+    size_t map_size;
+    int bell;           /* our FIFO, read end */
+    int bell_keep;      /* our FIFO, write end, so it never hangs up */
+    int peer_bell;      /* FIFO of the other side, write end */
+    int peer_keep;      /* side 0: FIFO of side 1, read end, or -1 */
+    Mutex *write_lock;
+    time_t peer_checked;
+};
+
+
+static unsigned char *ring_data(gw_shmring_t *ring, int side)
+{
+    return (unsigned char *) ring->shm + HEADER_SIZE + side * ring->shm->size;
+}
+
+
+static Octstr *bell_path(Octstr *path, int side)
+{
+    return octstr_format("%S.%d", path, side);
+}
+
+
+/* Open the FIFOs of both sides. Return -1 on error. */
+static int open_bells(gw_shmring_t *ring)
+{
+    Octstr *own, *peer;
+    int ret = 0;
+
+    own = bell_path(ring->path, ring->side);
+    peer = bell_path(ring->path, 1 - ring->side);
+    ring->bell = open(octstr_get_cstr(own), O_RDONLY | O_NONBLOCK);
+    ring->bell_keep = open(octstr_get_cstr(own), O_WRONLY | O_NONBLOCK);
+    /* a FIFO can only be opened for writing when it has a reader */
+    if (ring->side == 0)
+        ring->peer_keep = open(octstr_get_cstr(peer), O_RDONLY | O_NONBLOCK);
+    ring->peer_bell = open(octstr_get_cstr(peer), O_WRONLY | O_NONBLOCK);
+    if (ring->bell == -1 || ring->bell_keep == -1 || ring->peer_bell == -1) {
+        error(errno, "shmring: Could not open FIFOs of <%s>", 
+              octstr_get_cstr(ring->path));
+        ret = -1;
+    }
+    octstr_destroy(own);
+    octstr_destroy(peer);
+    return ret;
+}
+
+
+static gw_shmring_t *ring_alloc(Octstr *path, int side)
+{
+    gw_shmring_t *ring;
+
+    ring = gw_malloc(sizeof(*ring));
+    ring->path = octstr_duplicate(path);
+    ring->side = side;
+    ring->shm = NULL;
+    ring->map_size = 0;
+    ring->bell = ring->bell_keep = ring->peer_bell = ring->peer_keep = -1;
+    ring->write_lock = mutex_create();
+    ring->peer_checked = 0;
+    return ring;
+}
+
+
+static void ring_free(gw_shmring_t *ring)
+{
+    if (ring->shm != NULL)
+        munmap((void *) ring->shm, ring->map_size);
+    if (ring->bell != -1)
+        close(ring->bell);
+    if (ring->bell_keep != -1)
+        close(ring->bell_keep);
+    if (ring->peer_bell != -1)
+        close(ring->peer_bell);
+    if (ring->peer_keep != -1)
+        close(ring->peer_keep);
+    mutex_destroy(ring->write_lock);
+    octstr_destroy(ring->path);
+    gw_free(ring);
+}
+
+
+gw_shmring_t *gw_shmring_create(Octstr *dir, long size)
+{
+    gw_shmring_t *ring;
+    Octstr *path, *bell;
+    void *map;
+    long ring_size;
+    int fd, i, side;
+
+    ring_size = SHMRING_MIN_SIZE;
+    while (ring_size < size && ring_size < SHMRING_MAX_SIZE)
+        ring_size *= 2;
+
+    fd = -1;
+    path = NULL;
+    for (i = 0; i < 10 && fd == -1; i++) {
+        octstr_destroy(path);
+        path = octstr_format("%S/kannel-%ld-%08lx.ring", dir, (long) getpid(),
+                             (unsigned long) gw_rand());
+        fd = open(octstr_get_cstr(path), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd == -1) {
+        error(errno, "shmring: Could not create ring file in <%s>", 
+              octstr_get_cstr(dir));
+        octstr_destroy(path);
+        return NULL;
+    }
+
+    ring = ring_alloc(path, 0);
+    octstr_destroy(path);
+    ring->map_size = HEADER_SIZE + 2 * ring_size;
+    if (ftruncate(fd, ring->map_size) == -1 ||
+        (map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0)) == MAP_FAILED) {
+        error(errno, "shmring: Could not map <%s>", octstr_get_cstr(ring->path));
+        close(fd);
+        unlink(octstr_get_cstr(ring->path));
+        ring_free(ring);
+        return NULL;
+    }
+    close(fd);
+    ring->shm = map;
+    memset(ring->shm, 0, HEADER_SIZE);
+    ring->shm->size = ring_size;
+    ring->shm->pid[0] = getpid();
+
+    for (side = 0; side < 2; side++) {
+        bell = bell_path(ring->path, side);
+        if (mkfifo(octstr_get_cstr(bell), 0600) == -1) {
+            error(errno, "shmring: Could not create FIFO <%s>", 
+                  octstr_get_cstr(bell));
+            octstr_destroy(bell);
+            gw_shmring_unlink(ring);
+            ring_free(ring);
+            return NULL;
+        }
+        octstr_destroy(bell);
+    }
+    if (open_bells(ring) == -1) {
+        gw_shmring_unlink(ring);
+        ring_free(ring);
+        return NULL;
+    }
+
+    /* publish the header last, attaching checks it */
+    __sync_synchronize();
+    ring->shm->magic = SHMRING_MAGIC;
+    return ring;
+}
+
+
+gw_shmring_t *gw_shmring_attach(Octstr *path)
+{
+    gw_shmring_t *ring;
+    ring_header header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(octstr_get_cstr(path), O_RDWR);
+    if (fd == -1) {
+        error(errno, "shmring: Could not open <%s>", octstr_get_cstr(path));
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size < (off_t) HEADER_SIZE ||
+        read(fd, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != SHMRING_MAGIC || header.size < SHMRING_MIN_SIZE ||
+        header.size > SHMRING_MAX_SIZE ||
+        st.st_size != (off_t) (HEADER_SIZE + 2 * header.size)) {
+        error(0, "shmring: <%s> is not a ring file", octstr_get_cstr(path));
+        close(fd);
+        return NULL;
+    }
+
+    ring = ring_alloc(path, 1);
+    ring->map_size = st.st_size;
+    map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error(errno, "shmring: Could not map <%s>", octstr_get_cstr(path));
+        ring_free(ring);
+        return NULL;
+    }
+    ring->shm = map;
+
+    if (!__sync_bool_compare_and_swap(&ring->shm->pid[1], 0, (long) getpid())) {
+        error(0, "shmring: <%s> is already in use", octstr_get_cstr(path));
+        ring_free(ring);
+        return NULL;
+    }
+    if (open_bells(ring) == -1) {
+        ring->shm->closed[1] = 1;
+        ring_free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+
+Octstr *gw_shmring_path(gw_shmring_t *ring)
+{
+    return ring->path;
+}
+
+
+void gw_shmring_unlink(gw_shmring_t *ring)
+{
+    Octstr *bell;
+    int side;
+
+    unlink(octstr_get_cstr(ring->path));
+    for (side = 0; side < 2; side++) {
+        bell = bell_path(ring->path, side);
+        unlink(octstr_get_cstr(bell));
+        octstr_destroy(bell);
+    }
+}
+
+
+static void ring_bell(int fd)
+{
+    char c = 0;
+
+    /* a full FIFO has a wakeup pending already */
+    if (write(fd, &c, 1) == -1 && errno != EAGAIN)
+        debug("gwlib.shmring", errno, "shmring: Could not write to FIFO");
+}
+
+
+void gw_shmring_destroy(gw_shmring_t *ring)
+{
+    if (ring == NULL)
+        return;
+
+    ring->shm->closed[ring->side] = 1;
+    __sync_synchronize();
+    if (!ring->shm->closed[1 - ring->side])
+        ring_bell(ring->peer_bell);
+    ring_free(ring);
+}
+
+
+/* Return 1 if the other side has closed, or its process has died. */
+static int peer_gone(gw_shmring_t *ring)
+{
+    long pid;
+    time_t now;
+
+    if (ring->shm->closed[1 - ring->side])
+        return 1;
+    /* a process that has died cannot close */
+    now = time(NULL);
+    if (now == ring->peer_checked)
+        return 0;
+    ring->peer_checked = now;
+    pid = ring->shm->pid[1 - ring->side];
+    return pid != 0 && kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+
+/* Copy len octets from buf into ring data at byte count pos. */
+static void copy_in(unsigned char *data, long size, unsigned long pos,
+                    const unsigned char *buf, long len)
+{
+    long off, first;
+
+    off = pos & (size - 1);
+    first = (len < size - off) ? len : size - off;
+    memcpy(data + off, buf, first);
+    memcpy(data, buf + first, len - first);
+}
+
+
+/* Copy len octets at byte count pos out of ring data into buf. */
+static void copy_out(const unsigned char *data, long size, unsigned long pos,
+                     unsigned char *buf, long len)
+{
+    long off, first;
+
+    off = pos & (size - 1);
+    first = (len < size - off) ? len : size - off;
+    memcpy(buf, data + off, first);
+    memcpy(buf + first, data, len - first);
+}
+
+
+/* Return the len octets at byte count pos of ring data as an Octstr. */
+static Octstr *ring_frame(const unsigned char *data, long size, 
+                          unsigned long pos, long len)
+{
+    Octstr *os;
+    long off, first;
+
+    off = pos & (size - 1);
+    first = (len < size - off) ? len : size - off;
+    os = octstr_create_from_data((char *) data + off, first);
+    if (first < len)
+        octstr_append_data(os, (char *) data, len - first);
+    return os;
+}
+
+
+int gw_shmring_write(gw_shmring_t *ring, Octstr *data)
+{
+    ring_state *r;
+    unsigned char *ring_buf, len_buf[4];
+    long size, len, spins;
+
+    r = &ring->shm->ring[1 - ring->side];
+    ring_buf = ring_data(ring, 1 - ring->side);
+    size = ring->shm->size;
+    len = octstr_len(data);
+    if (len + 4 > size) {
+        error(0, "shmring: Frame of %ld octets does not fit in ring of %ld.",
+              len, size);
+        return -1;
+    }
+
+    mutex_lock(ring->write_lock);
+    for (spins = 0; size - (long) (r->head - r->tail) < len + 4; spins++) {
+        if (peer_gone(ring)) {
+            mutex_unlock(ring->write_lock);
+            return -1;
+        }
+        /* the reader is usually busy emptying the ring right now */
+        if (spins < FULL_SPINS)
+            sched_yield();
+        else
+            gwthread_sleep(FULL_SLEEP);
+    }
+    if (peer_gone(ring)) {
+        mutex_unlock(ring->write_lock);
+        return -1;
+    }
+
+    encode_network_long(len_buf, len);
+    copy_in(ring_buf, size, r->head, len_buf, 4);
+    copy_in(ring_buf, size, r->head + 4, 
+            (unsigned char *) octstr_get_cstr(data), len);
+    /* the data must be in place before the reader sees the new head */
+    __sync_synchronize();
+    r->head += len + 4;
+    __sync_synchronize();
+    if (r->reader_waiting)
+        ring_bell(ring->peer_bell);
+    mutex_unlock(ring->write_lock);
+
+    return 0;
+}
+
+
+int gw_shmring_read(gw_shmring_t *ring, Octstr **data, double seconds)
+{
+    ring_state *r;
+    unsigned char *ring_buf, len_buf[4];
+    long size, len;
+    long long deadline, left;
+    char drain[64];
+
+    r = &ring->shm->ring[ring->side];
+    ring_buf = ring_data(ring, ring->side);
+    size = ring->shm->size;
+    deadline = (seconds < 0) ? -1 : date_monotonic_usec() + seconds * 1e6;
+    *data = NULL;
+
+    for (;;) {
+        if (r->head != r->tail) {
+            /* the frame is complete once head has moved past it */
+            __sync_synchronize();
+            copy_out(ring_buf, size, r->tail, len_buf, 4);
+            len = decode_network_long(len_buf);
+            if (len < 0 || len + 4 > (long) (r->head - r->tail)) {
+                error(0, "shmring: Corrupt frame in <%s>", 
+                      octstr_get_cstr(ring->path));
+                return -1;
+            }
+            *data = ring_frame(ring_buf, size, r->tail + 4, len);
+            /* done with the data before the writer may overwrite it */
+            __sync_synchronize();
+            r->tail += len + 4;
+            return 0;
+        }
+        if (peer_gone(ring)) {
+            /* the last frames may have come in just before it went */
+            __sync_synchronize();
+            if (r->head != r->tail)
+                continue;
+            return -1;
+        }
+
+        left = 1000000;
+        if (deadline >= 0) {
+            left = deadline - date_monotonic_usec();
+            if (left <= 0)
+                return 1;
+            if (left > 1000000)
+                left = 1000000;
+        }
+
+        r->reader_waiting = 1;
+        __sync_synchronize();
+        if (r->head == r->tail)
+            gwthread_pollfd(ring->bell, POLLIN, left / 1e6);
+        r->reader_waiting = 0;
+        while (read(ring->bell, drain, sizeof(drain)) > 0)
+            ;
+    }
+}
@@ -0,0 +1,126 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-shmring.h - shared memory message rings between processes
+ *
+ * A ring pair is a memory mapped file holding two single producer,
+ * single consumer byte rings, one in each direction, for two processes
+ * on the same host. Data is written and read in frames, one Octstr at a
+ * time, so a ring pair can carry the same packed messages as a TCP
+ * connection with conn_write_withlen.
+ *
+ * The process that creates the pair is side 0 and the one attaching to
+ * it side 1. A reader waiting for data sleeps on a FIFO next to the ring
+ * file, which the writer pokes, so waiting needs no polling. Writing is
+ * thread safe; only one thread may read a ring pair.
+ */
+
+#ifndef GW_SHMRING_H
+#define GW_SHMRING_H 1
+
+typedef struct gw_shmring gw_shmring_t;
+
+/**
+ * Create ring pair in a new file in directory
+ * @dir - directory for the ring file and its FIFOs
+ * @size - bytes in each direction, rounded up to a power of two
+ * @return ring pair, side 0, or NULL if the files could not be created
+ */
+gw_shmring_t *gw_shmring_create(Octstr *dir, long size);
+
+/**
+ * Attach to ring pair created by another process
+ * @path - ring file, as given by gw_shmring_path in the other process
+ * @return ring pair, side 1, or NULL if path is no free ring pair
+ */
+gw_shmring_t *gw_shmring_attach(Octstr *path);
+
+/**
+ * Return the path of the ring file. The caller must not destroy it.
+ */
+Octstr *gw_shmring_path(gw_shmring_t *ring);
+
+/**
+ * Remove the ring file and its FIFOs. Processes that have the ring pair
+ * open keep using it.
+ */
+void gw_shmring_unlink(gw_shmring_t *ring);
+
+/**
+ * Close our side and free ring pair. The other side reads what is left
+ * and then gets an end of file. Does not remove the files.
+ * @ring - ring pair, may be NULL
+ */
+void gw_shmring_destroy(gw_shmring_t *ring);
+
+/**
+ * Write one frame, waiting while the ring is full
+ * @return 0 if written, -1 if the other side has gone or the frame is
+ *         larger than the ring
+ */
+int gw_shmring_write(gw_shmring_t *ring, Octstr *data);
+
+/**
+ * Read one frame
+ * @data - gets the frame
+ * @seconds - how long to wait for one, negative is forever
+ * @return 0 if a frame was read, 1 on timeout, -1 if the other side has
+ *         gone and everything it wrote has been read
+ */
+int gw_shmring_read(gw_shmring_t *ring, Octstr **data, double seconds);
+
+#endif
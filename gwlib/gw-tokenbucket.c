@@ -0,0 +1,232 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-tokenbucket.c - token bucket rate limiter.
+ *
+ * The bucket is refilled lazily: every access computes the tokens earned
+ * since the last access from a monotonic clock with nanosecond resolution,
+ * so no timer thread is involved.
+ */
+
+#include "gw-config.h"
+
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "gwlib.h"
+#include "gw-tokenbucket.h"
+
+
+struct gw_tokenbucket {
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+    pthread_spinlock_t lock;
+#else
+    Mutex *lock;
+#endif
+    double rate;        /* tokens per second */
+    double burst;       /* max. tokens in the bucket */
+    double tokens;      /* currently available tokens */
+    long long last;     /* time of last refill in nanoseconds */
+};
+
+
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+#define lock(b) pthread_spin_lock(&(b)->lock)
+#define unlock(b) pthread_spin_unlock(&(b)->lock)
+#else
+#define lock(b) mutex_lock((b)->lock)
+#define unlock(b) mutex_unlock((b)->lock)
+#endif
+
+#define NSEC_PER_SEC 1000000000LL
+
+
+static long long now_nsec(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (long long) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+    {
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+        return (long long) tv.tv_sec * NSEC_PER_SEC + (long long) tv.tv_usec * 1000;
+    }
+}
+
+
+/* Add tokens earned since last refill. Caller must hold the lock. */
+static void refill(gw_tokenbucket_t *bucket)
+{
+    long long now = now_nsec();
+
+    if (now > bucket->last) {
+        bucket->tokens += (double) (now - bucket->last) * bucket->rate / NSEC_PER_SEC;
+        if (bucket->tokens > bucket->burst)
+            bucket->tokens = bucket->burst;
+    }
+    bucket->last = now;
+}
+
+
+gw_tokenbucket_t *gw_tokenbucket_create(double rate, double burst)
+{
+    gw_tokenbucket_t *bucket;
+
+    gw_assert(rate > 0);
+
+    bucket = gw_malloc(sizeof(*bucket));
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+    pthread_spin_init(&bucket->lock, 0);
+#else
+    bucket->lock = mutex_create();
+#endif
+    bucket->rate = rate;
+    bucket->burst = (burst < 1 ? 1 : burst);
+    bucket->tokens = bucket->burst;
+    bucket->last = now_nsec();
+
+    return bucket;
+}
+
+
+void gw_tokenbucket_destroy(gw_tokenbucket_t *bucket)
+{
+    if (bucket == NULL)
+        return;
+
+#ifdef HAVE_PTHREAD_SPINLOCK_T
+    pthread_spin_destroy(&bucket->lock);
+#else
+    mutex_destroy(bucket->lock);
+#endif
+    gw_free(bucket);
+}
+
+
+int gw_tokenbucket_take(gw_tokenbucket_t *bucket, long tokens)
+{
+    int ret = 0;
+
+    gw_assert(bucket != NULL);
+
+    lock(bucket);
+    refill(bucket);
+    if (bucket->tokens >= tokens) {
+        bucket->tokens -= tokens;
+        ret = 1;
+    }
+    unlock(bucket);
+
+    return ret;
+}
+
+
+double gw_tokenbucket_wait_time(gw_tokenbucket_t *bucket, long tokens)
+{
+    double ret = 0;
+
+    gw_assert(bucket != NULL);
+
+    lock(bucket);
+    refill(bucket);
+    if (bucket->tokens < tokens)
+        ret = (tokens - bucket->tokens) / bucket->rate;
+    unlock(bucket);
+
+    return ret;
+}
+
+
+int gw_tokenbucket_consume(gw_tokenbucket_t *bucket, long tokens)
+{
+    double wait;
+
+    if (gw_tokenbucket_take(bucket, tokens))
+        return 1;
+
+    wait = gw_tokenbucket_wait_time(bucket, tokens);
+    if (wait > 0)
+        gwthread_sleep_micro(wait);
+
+    return gw_tokenbucket_take(bucket, tokens);
+}
+
+
+void gw_tokenbucket_return(gw_tokenbucket_t *bucket, long tokens)
+{
+    gw_assert(bucket != NULL);
+
+    lock(bucket);
+    refill(bucket);
+    bucket->tokens += tokens;
+    if (bucket->tokens > bucket->burst)
+        bucket->tokens = bucket->burst;
+    unlock(bucket);
+}
+
+
+double gw_tokenbucket_rate(gw_tokenbucket_t *bucket)
+{
+    gw_assert(bucket != NULL);
+
+    return bucket->rate;
+}
@@ -0,0 +1,127 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-tokenbucket.h - token bucket rate limiter.
+ *
+ * A token bucket holds up to 'burst' tokens and is refilled continuously
+ * with 'rate' tokens per second, using a monotonic nanosecond clock.
+ * Senders take one token per message; if the bucket is empty they may ask
+ * how long it takes until the next token is available and sleep exactly
+ * that long instead of polling.
+ *
+ * All functions are thread safe.
+ */
+
+#ifndef GW_TOKENBUCKET_H
+#define GW_TOKENBUCKET_H 1
+
+typedef struct gw_tokenbucket gw_tokenbucket_t;
+
+/**
+ * Create token bucket
+ * @rate - tokens per second, must be > 0
+ * @burst - maximum tokens in the bucket, values below 1 are treated as 1
+ * @return newly created token bucket, initially full
+ */
+gw_tokenbucket_t *gw_tokenbucket_create(double rate, double burst);
+
+/**
+ * Destroy token bucket
+ * @bucket - token bucket to destroy, may be NULL
+ */
+void gw_tokenbucket_destroy(gw_tokenbucket_t *bucket);
+
+/**
+ * Try to take tokens from the bucket without blocking
+ * @bucket - token bucket
+ * @tokens - count of tokens to take
+ * @return 1 if tokens were taken, 0 if not enough tokens available
+ */
+int gw_tokenbucket_take(gw_tokenbucket_t *bucket, long tokens);
+
+/**
+ * Return time until the given count of tokens will be available
+ * @bucket - token bucket
+ * @tokens - count of tokens wanted
+ * @return seconds to wait, 0 if tokens are available right now
+ */
+double gw_tokenbucket_wait_time(gw_tokenbucket_t *bucket, long tokens);
+
+/**
+ * Take tokens from the bucket, sleeping with gwthread_sleep_micro for the time
+ * needed to refill them if the bucket is empty. The sleep may be cut
+ * short with gwthread_wakeup, in that case (or if another thread was
+ * faster) no tokens are taken.
+ * @bucket - token bucket
+ * @tokens - count of tokens to take
+ * @return 1 if tokens were taken, 0 otherwise
+ */
+int gw_tokenbucket_consume(gw_tokenbucket_t *bucket, long tokens);
+
+/**
+ * Put tokens back into the bucket, e.g. if taken but not used
+ * @bucket - token bucket
+ * @tokens - count of tokens to return
+ */
+void gw_tokenbucket_return(gw_tokenbucket_t *bucket, long tokens);
+
+/**
+ * Return rate of the bucket in tokens per second
+ */
+double gw_tokenbucket_rate(gw_tokenbucket_t *bucket);
+
+#endif
@@ -0,0 +1,263 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-uuidmap.c - items indexed by message uuid.
+ *
+ * An open addressing hash table with linear probing, the uuid stored
+ * in the slot itself. Removing an item shifts the following items of
+ * its run back, so there are no deleted markers to skip. The table is
+ * kept at most half full and doubled when it would be fuller; it does
+ * not shrink, a map sized for a burst keeps its size.
+ */
+
+#include "gw-config.h"
+
+#include <string.h>
+
+#include "gwlib.h"
+#include "gw-uuidmap.h"
+
+/* smallest table, a power of two */
+#define MIN_SLOTS 16
+
+typedef struct {
+    uuid_t key;
+    void *item;         /* NULL if the slot is free */
+} slot;
+
+struct gw_uuidmap {
+    slot *slots;
+    long size;          /* a power of two */
+    long len;
+    Mutex *lock;
+};
+
+
+/*
+ * Uuids are random or made of a time stamp and a random clock sequence
+ * and node, mix all of it so neither kind ends up in a few runs.
+ */
+static unsigned long key_hash(const unsigned char *key)
+{
+    unsigned long long a, b;
+
+    memcpy(&a, key, sizeof(a));
+    memcpy(&b, key + sizeof(a), sizeof(b));
+    a = (a ^ (b * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL;
+    return (unsigned long) (a ^ (a >> 31));
+}
+
+
+/*
+ * Slot of key, or the free slot where it would go.
+ */
+static long find_slot(gw_uuidmap_t *map, const unsigned char *key)
+{
+    long i, mask = map->size - 1;
+
+    i = key_hash(key) & mask;
+    while (map->slots[i].item != NULL &&
+           memcmp(map->slots[i].key, key, sizeof(uuid_t)) != 0)
+        i = (i + 1) & mask;
+    return i;
+}
+
+
+static void resize(gw_uuidmap_t *map, long size)
+{
+    slot *old = map->slots;
+    long i, j, old_size = map->size;
+
+    map->slots = gw_malloc(size * sizeof(*map->slots));
+    memset(map->slots, 0, size * sizeof(*map->slots));
+    map->size = size;
+    for (i = 0; i < old_size; i++) {
+        if (old[i].item == NULL)
+            continue;
+        j = find_slot(map, old[i].key);
+        map->slots[j] = old[i];
+    }
+    gw_free(old);
+}
+
+
+gw_uuidmap_t *gw_uuidmap_create(long size_hint)
+{
+    gw_uuidmap_t *map;
+    long size;
+
+    for (size = MIN_SLOTS; size < size_hint * 2; size *= 2)
+        ;
+
+    map = gw_malloc(sizeof(*map));
+    map->slots = gw_malloc(size * sizeof(*map->slots));
+    memset(map->slots, 0, size * sizeof(*map->slots));
+    map->size = size;
+    map->len = 0;
+    map->lock = mutex_create();
+
+    return map;
+}
+
+
+void gw_uuidmap_destroy(gw_uuidmap_t *map)
+{
+    if (map == NULL)
+        return;
+
+    mutex_destroy(map->lock);
+    gw_free(map->slots);
+    gw_free(map);
+}
+
+
+long gw_uuidmap_len(gw_uuidmap_t *map)
+{
+    long len;
+
+    mutex_lock(map->lock);
+    len = map->len;
+    mutex_unlock(map->lock);
+
+    return len;
+}
+
+
+void *gw_uuidmap_put(gw_uuidmap_t *map, const uuid_t key, void *item)
+{
+    void *old;
+    long i;
+
+    gw_assert(item != NULL);
+
+    mutex_lock(map->lock);
+    if ((map->len + 1) * 2 > map->size)
+        resize(map, map->size * 2);
+    i = find_slot(map, key);
+    old = map->slots[i].item;
+    if (old == NULL) {
+        memcpy(map->slots[i].key, key, sizeof(uuid_t));
+        map->len++;
+    }
+    map->slots[i].item = item;
+    mutex_unlock(map->lock);
+
+    return old;
+}
+
+
+void *gw_uuidmap_get(gw_uuidmap_t *map, const uuid_t key)
+{
+    void *item;
+
+    mutex_lock(map->lock);
+    item = map->slots[find_slot(map, key)].item;
+    mutex_unlock(map->lock);
+
+    return item;
+}
+
+
+void *gw_uuidmap_remove(gw_uuidmap_t *map, const uuid_t key)
+{
+    void *item;
+    long i, j, home, mask;
+
+    mutex_lock(map->lock);
+    i = find_slot(map, key);
+    item = map->slots[i].item;
+    if (item != NULL) {
+        /*
+         * Move back each following item of the run that may go in the
+         * hole, that is whose home slot is not between the hole and
+         * the item, cyclically.
+         */
+        mask = map->size - 1;
+        for (j = (i + 1) & mask; map->slots[j].item != NULL; j = (j + 1) & mask) {
+            home = key_hash(map->slots[j].key) & mask;
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+                map->slots[i] = map->slots[j];
+                i = j;
+            }
+        }
+        map->slots[i].item = NULL;
+        map->len--;
+    }
+    mutex_unlock(map->lock);
+
+    return item;
+}
+
+
+List *gw_uuidmap_remove_all(gw_uuidmap_t *map)
+{
+    List *items;
+    long i;
+
+    items = gwlist_create();
+    mutex_lock(map->lock);
+    for (i = 0; i < map->size; i++) {
+        if (map->slots[i].item != NULL) {
+            gwlist_append(items, map->slots[i].item);
+            map->slots[i].item = NULL;
+        }
+    }
+    map->len = 0;
+    mutex_unlock(map->lock);
+
+    return items;
+}
@@ -0,0 +1,117 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * gw-uuidmap.h - items indexed by message uuid.
+ *
+ * Maps the binary uuid of a message to an item, for the boxes to find
+ * what waits for an acknowledgement of the message when the ack comes
+ * in. Unlike a Dict keyed by the uuid as text, nothing is allocated to
+ * add, find or remove an item, and the table grows with the number of
+ * items so lookups stay constant time with thousands of them.
+ *
+ * Items are not owned by the map. NULL can not be stored. All
+ * functions are thread safe.
+ */
+
+#ifndef GW_UUIDMAP_H
+#define GW_UUIDMAP_H 1
+
+typedef struct gw_uuidmap gw_uuidmap_t;
+
+/**
+ * Create an empty map
+ * @size_hint - number of items expected, the table grows past it
+ */
+gw_uuidmap_t *gw_uuidmap_create(long size_hint);
+
+/**
+ * Destroy map, the items left in it are not touched
+ * @map - map, may be NULL
+ */
+void gw_uuidmap_destroy(gw_uuidmap_t *map);
+
+/**
+ * Number of items in map
+ */
+long gw_uuidmap_len(gw_uuidmap_t *map);
+
+/**
+ * Store item under key
+ * @item - item, not NULL
+ * @return the item stored under key before, NULL if there was none
+ */
+void *gw_uuidmap_put(gw_uuidmap_t *map, const uuid_t key, void *item);
+
+/**
+ * Find the item stored under key
+ * @return the item, NULL if there is none
+ */
+void *gw_uuidmap_get(gw_uuidmap_t *map, const uuid_t key);
+
+/**
+ * Remove the item stored under key
+ * @return the item removed, NULL if there was none
+ */
+void *gw_uuidmap_remove(gw_uuidmap_t *map, const uuid_t key);
+
+/**
+ * Remove all items
+ * @return list of the items removed, in no particular order
+ */
+List *gw_uuidmap_remove_all(gw_uuidmap_t *map);
+
+#endif
@@ -84,6 +84,8 @@ void gwlib_init(void)
     gwlib_protected_init();
     gwthread_init();
     log_init();
+    gw_headermap_init();
+    gw_metrics_init();
     http_init();
     socket_init();
     charset_init();
@@ -97,6 +99,7 @@ void gwlib_shutdown(void)
     charset_shutdown();
     http_shutdown();
     socket_shutdown();
+    gw_metrics_shutdown();
     gwthread_shutdown();
     octstr_shutdown();
     gwlib_protected_shutdown();
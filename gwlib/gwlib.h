@@ -103,6 +103,14 @@
 #include "gw_uuid.h"
 #include "gw-rwlock.h"
 #include "gw-prioqueue.h"
+#include "gw-tokenbucket.h"
+#include "gw-levelqueue.h"
+#include "gw-histogram.h"
+#include "gw-metrics.h"
+#include "gw-lru.h"
+#include "gw-shmring.h"
+#include "gw-headermap.h"
+#include "gw-uuidmap.h"
 
 void gwlib_assert_init(void);
 void gwlib_init(void);
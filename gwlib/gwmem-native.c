@@ -75,6 +75,17 @@
 #undef realloc
 #undef free
 
+/*
+ * Allocations made by each thread, for the benchmarks. Counted per
+ * thread so that threads do not contend for the counter.
+ */
+#ifdef __GNUC__
+static __thread long allocations = 0;
+#define count_allocation() (allocations++)
+#else
+#define count_allocation()
+#endif
+
 void *gw_native_noop(void *ptr) { return ptr; }
 
 void *gw_native_malloc(size_t size)
@@ -87,6 +98,7 @@ void *gw_native_malloc(size_t size)
     ptr = malloc(size);
     if (ptr == NULL)
         panic(errno, "Memory allocation failed");
+    count_allocation();
 
     return ptr;
 }
@@ -102,6 +114,7 @@ void *gw_native_calloc(int nmemb, size_t size)
     ptr = calloc(nmemb, size);
     if (ptr == NULL)
         panic(errno, "Memory allocation failed");
+    count_allocation();
 
     return ptr;
 }
@@ -115,6 +128,7 @@ void *gw_native_realloc(void *ptr, size_t size)
     new_ptr = realloc(ptr, size);
     if (new_ptr == NULL)
         panic(errno, "Memory re-allocation failed");
+    count_allocation();
 
     return new_ptr;
 }
@@ -138,3 +152,13 @@ char *gw_native_strdup(const char *str)
     memcpy(copy, str, size);
     return copy;
 }
+
+
+long gw_native_allocations(void)
+{
+#ifdef __GNUC__
+    return allocations;
+#else
+    return -1;
+#endif
+}
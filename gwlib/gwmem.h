@@ -64,6 +64,9 @@
  * panics if they happen and one that tries to find allocation problems,
  * such as using an area after it has been freed.
  *
+ * gwmem_allocations() returns the number of allocations the calling
+ * thread has made so far, or -1 if the wrapper does not count them.
+ *
  * Kalle Marjola
  * Lars Wirzenius
  */
@@ -81,6 +84,7 @@ void *gw_native_realloc(void *ptr, size_t size);
 void gw_native_free(void *ptr);
 char *gw_native_strdup(const char *str);
 void gw_native_shutdown(void);
+long gw_native_allocations(void);
 
 
 void gw_check_init_mem(int slow_flag);
@@ -130,6 +134,7 @@ void gw_check_shutdown(void);
 #define gw_claim_area_for(ptr, file, line, func) (gw_native_noop(ptr))
 #define gwmem_shutdown()
 #define gwmem_type() (octstr_imm("native"))
+#define gwmem_allocations() (gw_native_allocations())
 
 #elif USE_GWMEM_CHECK
 
@@ -165,6 +170,7 @@ void gw_check_shutdown(void);
 #define gw_claim_area_for(ptr, file, line, func) \
 	(gw_check_claim_area(ptr, file, line, func))
 #define gwmem_shutdown() (gw_check_shutdown())
+#define gwmem_allocations() (-1L)
 
 #else
 
@@ -75,6 +75,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
@@ -124,41 +125,10 @@ static Octstr *http_interface = NULL;
 
 
 /*
- * Read some headers, i.e., until the first empty line (read and discard
- * the empty line as well). Return -1 for error, 0 for all headers read,
- * 1 for more headers to follow.
+ * Request counters exported through the metrics registry.
  */
-static int read_some_headers(Connection *conn, List *headers)
-{
-    Octstr *line, *prev;
-
-    if (gwlist_len(headers) == 0)
-        prev = NULL;
-    else
-    	prev = gwlist_get(headers, gwlist_len(headers) - 1);
-
-    for (;;) {
-	line = conn_read_line(conn);
-	if (line == NULL) {
-            if (conn_eof(conn) || conn_error(conn))
-	    	return -1;
-	    return 1;
-	}
-        if (octstr_len(line) == 0) {
-            octstr_destroy(line);
-            break;
-        }
-        if (isspace(octstr_get_char(line, 0)) && prev != NULL) {
-            octstr_append(prev, line);
-            octstr_destroy(line);
-        } else {
-            gwlist_append(headers, line);
-            prev = line;
-        }
-    }
-
-    return 0;
-}
+static gw_metric_t *server_requests_metric = NULL;
+static gw_metric_t *client_requests_metric = NULL;
 
 
 /*
@@ -365,9 +335,128 @@ typedef struct {
     enum entity_state state;
     long chunked_body_chunk_len;
     long expected_body_len;
+    long scanned;       /* octets of input looked at by parse_headers */
 } HTTPEntity;
 
 
+/*
+ * Parse headers in place in the input buffer of a connection, see
+ * conn_read_parse. Nothing is copied until the empty line ending the
+ * headers is in, then each header is copied once into ent->headers.
+ * Lines already looked at are not looked at again when more input
+ * arrives. Lines starting with white space continue the previous
+ * header.
+ */
+static long parse_headers(void *context, const unsigned char *data, long len)
+{
+    HTTPEntity *ent = context;
+    const unsigned char *lf;
+    Octstr *prev;
+    long start, end, line_len, used;
+
+    for (;;) {
+        lf = memchr(data + ent->scanned, '\n', len - ent->scanned);
+        if (lf == NULL)
+            return 0;
+        end = lf - data;
+        if (end == ent->scanned ||
+            (end == ent->scanned + 1 && data[ent->scanned] == '\r'))
+            break;
+        ent->scanned = end + 1;
+    }
+    used = end + 1;
+
+    if (gwlist_len(ent->headers) == 0)
+        prev = NULL;
+    else
+        prev = gwlist_get(ent->headers, gwlist_len(ent->headers) - 1);
+
+    for (start = 0; start < ent->scanned; start = end + 1) {
+        end = (const unsigned char *) memchr(data + start, '\n',
+                                             ent->scanned - start) - data;
+        line_len = end - start;
+        if (line_len > 0 && data[end - 1] == '\r')
+            line_len--;
+        if (line_len > 0 && isspace(data[start]) && prev != NULL)
+            octstr_append_data(prev, (char *) data + start, line_len);
+        else {
+            prev = octstr_create_from_data((char *) data + start, line_len);
+            gwlist_append(ent->headers, prev);
+        }
+    }
+
+    ent->scanned = 0;
+    return used;
+}
+
+
+/*
+ * Parse as much of a chunked body as there is in the input buffer,
+ * in place, see conn_read_parse. The chunks are appended to ent->body
+ * as they come in, without waiting for the whole chunk. Stops at the
+ * trailer.
+ */
+static long parse_chunked_body(void *context, const unsigned char *data, long len)
+{
+    HTTPEntity *ent = context;
+    const unsigned char *lf;
+    long pos = 0, n, digits;
+    int c;
+
+    while (pos < len && ent->state != reading_chunked_body_trailer) {
+        switch (ent->state) {
+        case reading_chunked_body_len:
+            lf = memchr(data + pos, '\n', len - pos);
+            if (lf == NULL)
+                return pos;
+            /* hex digits, then possibly chunk extensions */
+            n = pos;
+            while (data[n] == ' ' || data[n] == '\t')
+                n++;
+            ent->chunked_body_chunk_len = 0;
+            for (digits = 0; isxdigit(c = data[n]); n++, digits++) {
+                if (ent->chunked_body_chunk_len > LONG_MAX / 16)
+                    return -1;
+                ent->chunked_body_chunk_len = ent->chunked_body_chunk_len * 16 +
+                    (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+            }
+            if (digits == 0)
+                return -1;
+            pos = lf - data + 1;
+            if (ent->chunked_body_chunk_len == 0)
+                ent->state = reading_chunked_body_trailer;
+            else
+                ent->state = reading_chunked_body_data;
+            break;
+
+        case reading_chunked_body_data:
+            n = len - pos;
+            if (n > ent->chunked_body_chunk_len)
+                n = ent->chunked_body_chunk_len;
+            octstr_append_data(ent->body, (char *) data + pos, n);
+            pos += n;
+            ent->chunked_body_chunk_len -= n;
+            if (ent->chunked_body_chunk_len == 0)
+                ent->state = reading_chunked_body_crlf;
+            break;
+
+        case reading_chunked_body_crlf:
+            lf = memchr(data + pos, '\n', len - pos);
+            if (lf == NULL)
+                return pos;
+            pos = lf - data + 1;
+            ent->state = reading_chunked_body_len;
+            break;
+
+        default:
+            panic(0, "Internal error: Invalid chunked body state.");
+        }
+    }
+
+    return pos;
+}
+
+
 /*
  * The rules for message bodies (length and presence) are defined
  * in RFC2616 paragraph 4.3 and 4.4.
@@ -435,6 +524,7 @@ static HTTPEntity *entity_create(enum body_expectation exp)
     ent->body = octstr_create("");
     ent->chunked_body_chunk_len = -1;
     ent->expected_body_len = -1;
+    ent->scanned = 0;
     ent->state = reading_headers;
     ent->expect_state = exp;
 
@@ -453,60 +543,32 @@ static void entity_destroy(HTTPEntity *ent)
 }
 
 
-static void read_chunked_body_len(HTTPEntity *ent, Connection *conn)
-{
-    Octstr *os;
-    long len;
-    
-    os = conn_read_line(conn);
-    if (os == NULL) {
-        if (conn_error(conn) || conn_eof(conn))
-	    ent->state = body_error;
-        return;
-    }
-    if (octstr_parse_long(&len, os, 0, 16) == -1) {
-        octstr_destroy(os);
-	ent->state = body_error;
-        return;
-    }
-    octstr_destroy(os);
-    if (len == 0)
-        ent->state = reading_chunked_body_trailer;
-    else {
-        ent->state = reading_chunked_body_data;
-        ent->chunked_body_chunk_len = len;
-    }
-}
-
-
-static void read_chunked_body_data(HTTPEntity *ent, Connection *conn)
+/*
+ * Read headers, or the trailer of a chunked body. Return -1 for error,
+ * 0 for all headers read, 1 for more headers to follow.
+ */
+static int read_headers(HTTPEntity *ent, Connection *conn)
 {
-    Octstr *os;
+    long ret;
 
-    os = conn_read_fixed(conn, ent->chunked_body_chunk_len);
-    if (os == NULL) {
-        if (conn_error(conn) || conn_eof(conn))
-	    ent->state = body_error;
-    } else {
-        octstr_append(ent->body, os);
-        octstr_destroy(os);
-        ent->state = reading_chunked_body_crlf;
-    }
+    ret = conn_read_parse(conn, parse_headers, ent);
+    if (ret > 0)
+        return 0;
+    if (ret < 0 || conn_eof(conn) || conn_error(conn))
+        return -1;
+    return 1;
 }
 
 
-static void read_chunked_body_crlf(HTTPEntity *ent, Connection *conn)
+static void read_chunked_body(HTTPEntity *ent, Connection *conn)
 {
-    Octstr *os;
+    long ret;
 
-    os = conn_read_line(conn);
-    if (os == NULL) {
-        if (conn_error(conn) || conn_eof(conn))
-	    ent->state = body_error;
-    } else {
-        octstr_destroy(os);
-        ent->state = reading_chunked_body_len;
-    }
+    while ((ret = conn_read_parse(conn, parse_chunked_body, ent)) > 0 &&
+           ent->state != reading_chunked_body_trailer)
+        ;
+    if (ret < 0 || (ret == 0 && (conn_eof(conn) || conn_error(conn))))
+        ent->state = body_error;
 }
 
 
@@ -514,7 +576,7 @@ static void read_chunked_body_trailer(HTTPEntity *ent, Connection *conn)
 {
     int ret;
 
-    ret = read_some_headers(conn, ent->headers);
+    ret = read_headers(ent, conn);
     if (ret == -1)
 	ent->state = body_error;
     if (ret == 0)
@@ -572,23 +634,17 @@ static int entity_read(HTTPEntity *ent, Connection *conn)
         old_state = ent->state;
         switch (ent->state) {
         case reading_headers:
-            ret = read_some_headers(conn, ent->headers);
-                if (ret == 0)
+            ret = read_headers(ent, conn);
+            if (ret == 0)
                 deduce_body_state(ent);
             if (ret < 0)
-            return -1;
+                return -1;
             break;
 
         case reading_chunked_body_len:
-            read_chunked_body_len(ent, conn);
-            break;
-
         case reading_chunked_body_data:
-            read_chunked_body_data(ent, conn);
-            break;
-
         case reading_chunked_body_crlf:
-            read_chunked_body_crlf(ent, conn);
+            read_chunked_body(ent, conn);
             break;
 
         case reading_chunked_body_trailer:
@@ -1749,6 +1805,7 @@ void http_start_request(HTTPCaller *caller, int method, Octstr *url, List *heade
     else
         trans->request_id = id;
         
+    gw_metric_increase(client_requests_metric);
     gwlist_produce(pending_requests, trans);
     start_client_threads();
 }
@@ -2177,57 +2234,63 @@ static FDSet *port_get_fdset(int port)
 }
 
 
-static int parse_request_line(int *method, Octstr **url,
-                              int *use_version_1_0, Octstr *line)
+/*
+ * Parse the request line in place in the input buffer of the client's
+ * connection, see conn_read_parse. Only the URL is copied.
+ */
+static long parse_request_line(void *context, const unsigned char *data, long len)
 {
-    List *words;
-    Octstr *version;
-    Octstr *method_str;
-    int ret;
+    HTTPClient *client = context;
+    const unsigned char *lf, *word[3];
+    long end, i, n, word_len[3];
 
-    words = octstr_split_words(line);
-    if (gwlist_len(words) != 3) {
-        gwlist_destroy(words, octstr_destroy_item);
-        return -1;
-    }
+    lf = memchr(data, '\n', len);
+    if (lf == NULL)
+        return 0;
+    end = lf - data;
+    if (end > 0 && data[end - 1] == '\r')
+        end--;
 
-    method_str = gwlist_get(words, 0);
-    *url = gwlist_get(words, 1);
-    version = gwlist_get(words, 2);
-    gwlist_destroy(words, NULL);
+    /* exactly three words separated by white space */
+    for (i = n = 0; i < end; n++) {
+        while (i < end && isspace(data[i]))
+            i++;
+        if (i == end)
+            break;
+        if (n == 3)
+            return -1;
+        word[n] = data + i;
+        while (i < end && !isspace(data[i]))
+            i++;
+        word_len[n] = data + i - word[n];
+    }
+    if (n != 3)
+        return -1;
 
-    if (octstr_compare(method_str, octstr_imm("GET")) == 0)
-        *method = HTTP_METHOD_GET;
-    else if (octstr_compare(method_str, octstr_imm("POST")) == 0)
-        *method = HTTP_METHOD_POST;
-    else if (octstr_compare(method_str, octstr_imm("HEAD")) == 0)
-        *method = HTTP_METHOD_HEAD;
+    if (word_len[0] == 3 && memcmp(word[0], "GET", 3) == 0)
+        client->method = HTTP_METHOD_GET;
+    else if (word_len[0] == 4 && memcmp(word[0], "POST", 4) == 0)
+        client->method = HTTP_METHOD_POST;
+    else if (word_len[0] == 4 && memcmp(word[0], "HEAD", 4) == 0)
+        client->method = HTTP_METHOD_HEAD;
     else
-        goto error;
-
-    ret = parse_http_version(version);
-    if (ret < 0)
-        goto error;
-    *use_version_1_0 = !ret;
+        return -1;
 
-    octstr_destroy(method_str);
-    octstr_destroy(version);
-    return 0;
+    /* see parse_http_version */
+    if (word_len[2] != 8 || memcmp(word[2], "HTTP/1.", 7) != 0 ||
+        !isdigit(word[2][7]))
+        return -1;
+    client->use_version_1_0 = (word[2][7] == '0');
 
-error:
-    octstr_destroy(method_str);
-    octstr_destroy(*url);
-    octstr_destroy(version);
-    *url = NULL;
-    return -1;
+    client->url = octstr_create_from_data((char *) word[1], word_len[1]);
+    return lf - data + 1;
 }
 
 
 static void receive_request(Connection *conn, void *data)
 {
     HTTPClient *client;
-    Octstr *line;
-    int ret;
+    long ret;
 
     if (run_status != running) {
         conn_unregister(conn);
@@ -2239,15 +2302,12 @@ static void receive_request(Connection *conn, void *data)
     for (;;) {
         switch (client->state) {
             case reading_request_line:
-                line = conn_read_line(conn);
-                if (line == NULL) {
+                ret = conn_read_parse(conn, parse_request_line, client);
+                if (ret == 0) {
                     if (conn_eof(conn) || conn_error(conn))
                         goto error;
                     return;
                 }
-                ret = parse_request_line(&client->method, &client->url,
-                                         &client->use_version_1_0, line);
-                octstr_destroy(line);
                 /* client sent bad request? */
                 if (ret == -1) {
                     /*
@@ -2516,10 +2576,9 @@ void http_close_all_ports(void)
  */
 static List *parse_cgivars(Octstr *url)
 {
-    HTTPCGIVar *v;
     List *list;
-    int query, et, equals;
-    Octstr *arg, *args;
+    long query;
+    Octstr *args;
 
     query = octstr_search_char(url, '?', 0);
     if (query == -1)
@@ -2527,31 +2586,39 @@ static List *parse_cgivars(Octstr *url)
 
     args = octstr_copy(url, query + 1, octstr_len(url));
     octstr_truncate(url, query);
+    list = http_parse_cgiargs(args);
+    octstr_destroy(args);
+
+    return list;
+}
+
+
+List *http_parse_cgiargs(Octstr *args)
+{
+    HTTPCGIVar *v;
+    List *list;
+    long pos, et, equals;
 
     list = gwlist_create();
 
-    while (octstr_len(args) > 0) {
-        et = octstr_search_char(args, '&', 0);
+    for (pos = 0; pos < octstr_len(args); pos = et + 1) {
+        et = octstr_search_char(args, '&', pos);
         if (et == -1)
             et = octstr_len(args);
-        arg = octstr_copy(args, 0, et);
-        octstr_delete(args, 0, et + 1);
 
-        equals = octstr_search_char(arg, '=', 0);
-        if (equals == -1)
-            equals = octstr_len(arg);
+        equals = octstr_search_char(args, '=', pos);
+        if (equals == -1 || equals > et)
+            equals = et;
 
         v = gw_malloc(sizeof(HTTPCGIVar));
-        v->name = octstr_copy(arg, 0, equals);
-        v->value = octstr_copy(arg, equals + 1, octstr_len(arg));
+        v->name = octstr_copy(args, pos, equals - pos);
+        v->value = octstr_copy(args, equals + 1,
+                               equals < et ? et - equals - 1 : 0);
         octstr_url_decode(v->name);
         octstr_url_decode(v->value);
 
-        octstr_destroy(arg);
-
         gwlist_append(list, v);
     }
-    octstr_destroy(args);
 
     return list;
 }
@@ -2597,6 +2664,8 @@ HTTPClient *http_accept_request(int port, Octstr **client_ip, Octstr **url,
     entity_destroy(client->request);
     client->request = NULL;
     
+    gw_metric_increase(server_requests_metric);
+
     return client;
 }
 
@@ -2654,13 +2723,16 @@ static const char *http_reason_phrase(int status)
 }
 
 
-void http_send_reply(HTTPClient *client, int status, List *headers, 
-    	    	     Octstr *body)
+/*
+ * Format the status line and headers of a reply. 'length' is the
+ * Content-Length header, or -1 for a body sent in chunks.
+ */
+static Octstr *reply_head(HTTPClient *client, int status, List *headers,
+                          long length)
 {
     Octstr *response;
     Octstr *date;
     long i;
-    int ret;
 
     if (client->use_version_1_0)
     	response = octstr_format("HTTP/1.0 %d %s\r\n", status, http_reason_phrase(status));
@@ -2675,7 +2747,10 @@ void http_send_reply(HTTPClient *client, int status, List *headers,
     octstr_format_append(response, "Date: %s\r\n", octstr_get_cstr(date));
     octstr_destroy(date);
     
-    octstr_format_append(response, "Content-Length: %ld\r\n", octstr_len(body));
+    if (length >= 0)
+        octstr_format_append(response, "Content-Length: %ld\r\n", length);
+    else if (!client->use_version_1_0)
+        octstr_format_append(response, "Transfer-Encoding: chunked\r\n");
 
     /* 
      * RFC2616, sec. 8.1.2.1 says that if the server chooses to close the 
@@ -2687,13 +2762,17 @@ void http_send_reply(HTTPClient *client, int status, List *headers,
     for (i = 0; i < gwlist_len(headers); ++i)
     	octstr_format_append(response, "%S\r\n", gwlist_get(headers, i));
     octstr_format_append(response, "\r\n");
-    
-    if (body != NULL && client->method != HTTP_METHOD_HEAD)
-    	octstr_append(response, body);
-	
-    ret = conn_write(client->conn, response);
-    octstr_destroy(response);
 
+    return response;
+}
+
+
+/*
+ * Hand the client back to the server after the last of the reply has
+ * been written, 'ret' being what conn_write returned for it.
+ */
+static void reply_written(HTTPClient *client, int ret)
+{
     /* obey return code of conn_write() */
     /* sending response was successful */
     if (ret == 0) { 
@@ -2718,6 +2797,70 @@ void http_send_reply(HTTPClient *client, int status, List *headers,
 }
 
 
+void http_send_reply(HTTPClient *client, int status, List *headers, 
+    	    	     Octstr *body)
+{
+    Octstr *response;
+    int ret;
+
+    response = reply_head(client, status, headers, octstr_len(body));
+    if (body != NULL && client->method != HTTP_METHOD_HEAD)
+    	octstr_append(response, body);
+	
+    ret = conn_write(client->conn, response);
+    octstr_destroy(response);
+
+    reply_written(client, ret);
+}
+
+
+void http_send_reply_start(HTTPClient *client, int status, List *headers)
+{
+    Octstr *response;
+
+    /* HTTP/1.0 has no chunks, the end of the body is the end of the connection */
+    if (client->use_version_1_0)
+        client->persistent_conn = 0;
+
+    response = reply_head(client, status, headers, -1);
+    conn_write(client->conn, response);
+    octstr_destroy(response);
+}
+
+
+int http_send_reply_chunk(HTTPClient *client, Octstr *data)
+{
+    Octstr *chunk;
+    int ret;
+
+    if (octstr_len(data) == 0 || client->method == HTTP_METHOD_HEAD)
+        return 0;
+
+    if (client->use_version_1_0) {
+        ret = conn_write(client->conn, data);
+    } else {
+        chunk = octstr_format("%lx\r\n%S\r\n", octstr_len(data), data);
+        ret = conn_write(client->conn, chunk);
+        octstr_destroy(chunk);
+    }
+
+    return ret == -1 ? -1 : 0;
+}
+
+
+void http_send_reply_end(HTTPClient *client)
+{
+    int ret;
+
+    if (client->use_version_1_0 || client->method == HTTP_METHOD_HEAD)
+        ret = conn_write(client->conn, octstr_imm(""));
+    else
+        ret = conn_write(client->conn, octstr_imm("0\r\n\r\n"));
+
+    reply_written(client, ret);
+}
+
+
 void http_close_client(HTTPClient *client)
 {
     client_destroy(client);
@@ -3025,20 +3168,34 @@ void http_append_headers(List *to, List *from)
 
 void http_header_combine(List *old_headers, List *new_headers)
 {
-    long i;
-    Octstr *name;
-    Octstr *value;
+    gw_headermap_t *replaced;
+    Octstr *h, *name;
+    long i, colon;
 
     /*
-     * Avoid doing this scan if old_headers is empty anyway.
+     * Avoid doing this scan if old_headers is empty anyway. Otherwise
+     * index the new headers by name, so that each old header is looked
+     * up once instead of scanning the old headers for each new one.
      */
-    if (gwlist_len(old_headers) > 0) {
-        for (i = 0; i < gwlist_len(new_headers); i++) {
-  	    http_header_get(new_headers, i, &name, &value);
-	    http_header_remove_all(old_headers, octstr_get_cstr(name));
+    if (gwlist_len(old_headers) > 0 && gwlist_len(new_headers) > 0) {
+        replaced = gw_headermap_from_list(new_headers);
+        i = 0;
+        while (i < gwlist_len(old_headers)) {
+            h = gwlist_get(old_headers, i);
+            colon = octstr_search_char(h, ':', 0);
+            if (colon == -1) {
+                i++;
+                continue;
+            }
+            name = octstr_copy(h, 0, colon);
+            if (gw_headermap_get(replaced, octstr_get_cstr(name)) != NULL) {
+                gwlist_delete(old_headers, i, 1);
+                octstr_destroy(h);
+            } else
+                i++;
             octstr_destroy(name);
-            octstr_destroy(value);
         }
+        gw_headermap_destroy(replaced);
     }
 
     http_append_headers(old_headers, new_headers);
@@ -3569,6 +3726,11 @@ void http_init(void)
 #ifdef HAVE_LIBSSL
     server_ssl_init();
 #endif /* HAVE_LIBSSL */
+
+    server_requests_metric = gw_metrics_counter("kannel_http_server_requests_total",
+        "HTTP requests accepted by the embedded servers.", NULL);
+    client_requests_metric = gw_metrics_counter("kannel_http_client_requests_total",
+        "HTTP requests started by the HTTP client.", NULL);
     
     run_status = running;
 }
@@ -3581,6 +3743,10 @@ void http_shutdown(void)
 
     run_status = terminating;
 
+    gw_metrics_unregister(server_requests_metric);
+    gw_metrics_unregister(client_requests_metric);
+    server_requests_metric = client_requests_metric = NULL;
+
     conn_pool_shutdown();
     client_shutdown();
     server_shutdown();
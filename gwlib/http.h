@@ -444,6 +444,21 @@ void http_send_reply(HTTPClient *client, int status, List *headers,
     	    	     Octstr *body);
 
 
+/*
+ * Send a reply whose body is not known in advance, piece by piece:
+ * http_send_reply_start sends the status and headers, http_send_reply_chunk
+ * one piece of the body and http_send_reply_end finishes the reply like
+ * http_send_reply does. HTTP/1.1 clients get the body in chunks, HTTP/1.0
+ * clients until the connection is closed. The calls for one client must
+ * not be made from several threads at once. http_send_reply_chunk does not
+ * block, what the client does not take yet stays queued. It returns -1
+ * once the connection is broken, 0 otherwise.
+ */
+void http_send_reply_start(HTTPClient *client, int status, List *headers);
+int http_send_reply_chunk(HTTPClient *client, Octstr *data);
+void http_send_reply_end(HTTPClient *client);
+
+
 /*
  * Don't send a reply to a previously accepted request, but only close
  * the connection to the client. This can be used to reject requests from
@@ -464,6 +479,14 @@ void http_close_port(int port);
 void http_close_all_ports(void);
 
 
+/*
+ * Parse CGI variables of the form "a=1&b=2", as found after the '?' of
+ * an url or in a form encoded body. Return a list of HTTPCGIVar objects,
+ * with names and values url decoded.
+ */
+List *http_parse_cgiargs(Octstr *args);
+
+
 /*
  * Destroy a list of HTTPCGIVar objects.
  */
@@ -497,6 +520,9 @@ int http_method(HTTPClient *client);
  *
  * Once you have a list of headers, you can use http_header_add and the
  * other functions to manipulate it.
+ *
+ * Each lookup goes through the whole list. Code that looks up many
+ * headers can convert the list to a header map, see gw-headermap.h.
  */
 List *http_create_empty_headers(void);
 void http_destroy_headers(List *headers);
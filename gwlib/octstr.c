@@ -73,6 +73,13 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+/* SSE2 is part of every x86-64 CPU; elsewhere the plain loops are used.
+ * The header comes before gwlib.h, which hides malloc and free. */
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define OCTSTR_SSE2 1
+#endif
+
 #include "gwlib.h"
 
 /* 
@@ -867,6 +874,48 @@ void octstr_convert_printable(Octstr *ostr)
 
 
 
+#ifdef OCTSTR_SSE2
+/*
+ * Fold the ASCII upper case letters in v to lower case. Adding 0x3F
+ * moves 'A'..'Z' to the bottom of the signed range, where no other
+ * byte ends up.
+ */
+static inline __m128i fold_sse2(__m128i v)
+{
+    __m128i t;
+
+    t = _mm_add_epi8(v, _mm_set1_epi8(0x3F));
+    t = _mm_cmplt_epi8(t, _mm_set1_epi8(-128 + 26));
+    return _mm_or_si128(v, _mm_and_si128(t, _mm_set1_epi8(0x20)));
+}
+#endif
+
+
+/*
+ * Return the index of the first of the len bytes of a and b that differ
+ * when case is ignored, or len if there is none.
+ */
+static long case_mismatch(const unsigned char *a, const unsigned char *b, long len)
+{
+    long i = 0;
+#ifdef OCTSTR_SSE2
+    __m128i x, y;
+    int mask;
+
+    for (; i + 16 <= len; i += 16) {
+        x = fold_sse2(_mm_loadu_si128((const __m128i *) (a + i)));
+        y = fold_sse2(_mm_loadu_si128((const __m128i *) (b + i)));
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (mask != 0xFFFF)
+            return i + __builtin_ctz(~mask);
+    }
+#endif
+    while (i < len && toupper(a[i]) == toupper(b[i]))
+        i++;
+    return i;
+}
+
+
 int octstr_compare(const Octstr *ostr1, const Octstr *ostr2)
 {
     int ret;
@@ -920,31 +969,20 @@ int octstr_case_compare(const Octstr *os1, const Octstr *os2)
         return 0;
     }
 
-    c1 = c2 = 0;
-    for (i = 0; i < len; ++i) {
-        c1 = toupper(os1->data[i]);
-        c2 = toupper(os2->data[i]);
-        if (c1 != c2)
-            break;
-    }
-
+    i = case_mismatch(os1->data, os2->data, len);
     if (i == len) {
         if (i == os1->len && i == os2->len)
             return 0;
         if (i == os1->len)
             return -1;
         return 1;
-    } else {
-        /*
-        c1 = toupper(os1->data[i]);
-        c2 = toupper(os2->data[i]);
-        */
-        if (c1 < c2)
-            return -1;
-        if (c1 == c2)
-            return 0;
-        return 1;
     }
+
+    c1 = toupper(os1->data[i]);
+    c2 = toupper(os2->data[i]);
+    if (c1 < c2)
+        return -1;
+    return 1;
 }
 
 
@@ -1045,9 +1083,57 @@ long octstr_search_chars(const Octstr *ostr, const Octstr *chars, long pos)
 }
 
 
+#ifdef OCTSTR_SSE2
+/*
+ * Search for needle, at least two bytes long, in haystack from *pos on,
+ * case folded if fold is set. 16 positions are checked at a time by
+ * comparing the first and the last byte of needle, and only where both
+ * match is the rest compared. Return the position of needle, or -1 and
+ * set *pos to where the plain loops must go on from when less than 16
+ * positions are left.
+ */
+static long search_sse2(const Octstr *haystack, const Octstr *needle,
+                        long *pos, int fold)
+{
+    const unsigned char *data = haystack->data;
+    long i, j, last = needle->len - 1;
+    __m128i first_byte, last_byte, x, y;
+    int mask;
+
+    first_byte = _mm_set1_epi8(fold ? tolower(needle->data[0]) : needle->data[0]);
+    last_byte = _mm_set1_epi8(fold ? tolower(needle->data[last]) : needle->data[last]);
+
+    for (i = *pos; i + last + 16 <= haystack->len; i += 16) {
+        x = _mm_loadu_si128((const __m128i *) (data + i));
+        y = _mm_loadu_si128((const __m128i *) (data + i + last));
+        if (fold) {
+            x = fold_sse2(x);
+            y = fold_sse2(y);
+        }
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, first_byte),
+                                               _mm_cmpeq_epi8(y, last_byte)));
+        while (mask != 0) {
+            j = i + __builtin_ctz(mask);
+            if (fold) {
+                if (case_mismatch(data + j + 1, needle->data + 1, last - 1) == last - 1)
+                    return j;
+            } else if (memcmp(data + j + 1, needle->data + 1, last - 1) == 0)
+                return j;
+            mask &= mask - 1;
+        }
+    }
+    *pos = i;
+    return -1;
+}
+#endif
+
+
 long octstr_search(const Octstr *haystack, const Octstr *needle, long pos)
 {
     int first;
+#ifdef OCTSTR_SSE2
+    long i;
+#endif
 
     seems_valid(haystack);
     seems_valid(needle);
@@ -1060,6 +1146,11 @@ long octstr_search(const Octstr *haystack, const Octstr *needle, long pos)
     if (needle->len == 1)
         return octstr_search_char(haystack, needle->data[0], pos);
 
+#ifdef OCTSTR_SSE2
+    if ((i = search_sse2(haystack, needle, &pos, 0)) != -1)
+        return i;
+#endif
+
     /* For each occurrence of needle's first character in ostr,
      * check if the rest of needle follows.  Stop if there are no
      * more occurrences, or if the rest of needle can't possibly
@@ -1090,6 +1181,11 @@ long octstr_case_search(const Octstr *haystack, const Octstr *needle, long pos)
     if (needle->len == 0)
         return 0;
 
+#ifdef OCTSTR_SSE2
+    if (needle->len > 1 && (i = search_sse2(haystack, needle, &pos, 1)) != -1)
+        return i;
+#endif
+
     for (i = pos; i <= haystack->len - needle->len; ++i) {
 	for (j = 0; j < needle->len; ++j) {
 	    c1 = toupper(haystack->data[i + j]);
@@ -0,0 +1,159 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * bench_charset.c - measure the speed of the character set conversions
+ *
+ * Converts a typical SMS text between the common character sets, with
+ * charset_convert and with plain iconv (by using names of the character
+ * sets that charset_convert does not recognize), and prints a line of
+ * conversions per second for each pair. Used by benchmarks/bench_charset.sh.
+ *
+ * Usage: bench_charset [rounds]
+ */
+
+#include "gwlib/gwlib.h"
+
+#define TEXT "Hello! Meeting at 18:00 in the caf\xc3\xa9, price 5 \xc2\xa3. " \
+             "R\xc3\xa9servez avant le 3 juin, s'il vous pla\xc3\xaet."
+
+static struct {
+    char *from, *to;
+    char *from_alias, *to_alias;
+} pairs[] = {
+    { "UTF-8", "ISO-8859-1", "ISO-10646/UTF8/", "CSISOLATIN1" },
+    { "ISO-8859-1", "UTF-8", "CSISOLATIN1", "ISO-10646/UTF8/" },
+    { "UTF-8", "UCS-2BE", "ISO-10646/UTF8/", "UNICODEBIG" },
+    { "UCS-2BE", "UTF-8", "UNICODEBIG", "ISO-10646/UTF8/" },
+    { "UTF-8", "UTF-16BE", "ISO-10646/UTF8/", "UTF16BE" },
+};
+#define NUM_PAIRS ((int) (sizeof(pairs) / sizeof(pairs[0])))
+
+
+/* Input text in the given character set */
+static Octstr *text_in(char *charset)
+{
+    Octstr *text;
+
+    text = octstr_create(TEXT);
+    charset_convert(text, "UTF-8", charset);
+    return text;
+}
+
+
+static double rate(long rounds, char *from, char *to, Octstr *text)
+{
+    Octstr *os;
+    long i;
+    long long start;
+
+    start = date_monotonic_usec();
+    for (i = 0; i < rounds; i++) {
+        os = octstr_duplicate(text);
+        charset_convert(os, from, to);
+        octstr_destroy(os);
+    }
+    return rounds * 1e6 / (date_monotonic_usec() - start + 1);
+}
+
+
+static double gsm_rate(long rounds, int to_utf8, Octstr *text)
+{
+    Octstr *os;
+    long i;
+    long long start;
+
+    start = date_monotonic_usec();
+    for (i = 0; i < rounds; i++) {
+        os = octstr_duplicate(text);
+        if (to_utf8)
+            charset_gsm_to_utf8(os);
+        else
+            charset_utf8_to_gsm(os);
+        octstr_destroy(os);
+    }
+    return rounds * 1e6 / (date_monotonic_usec() - start + 1);
+}
+
+
+int main(int argc, char **argv)
+{
+    Octstr *text;
+    long rounds;
+    int i;
+
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    rounds = (argc > 1) ? atol(argv[1]) : 100000;
+
+    for (i = 0; i < NUM_PAIRS; i++) {
+        text = text_in(pairs[i].from);
+        printf("%s\t%s\t%.0f\t%.0f\n", pairs[i].from, pairs[i].to,
+               rate(rounds, pairs[i].from, pairs[i].to, text),
+               rate(rounds, pairs[i].from_alias, pairs[i].to_alias, text));
+        octstr_destroy(text);
+    }
+
+    text = octstr_create(TEXT);
+    printf("UTF-8\tGSM\t%.0f\t-\n", gsm_rate(rounds, 0, text));
+    charset_utf8_to_gsm(text);
+    printf("GSM\tUTF-8\t%.0f\t-\n", gsm_rate(rounds, 1, text));
+    octstr_destroy(text);
+
+    gwlib_shutdown();
+    return 0;
+}
@@ -0,0 +1,674 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * bench_gwlib.c - measure the speed of the gwlib core primitives
+ *
+ * Runs each case with 1, 2, 4 ... threads up to the given number and
+ * prints a line of operations per second and allocations per operation
+ * for each, and writes the same as JSON with -o. Threads work on the
+ * same List, Dict and priority queue, the other cases are per thread.
+ * Used by benchmarks/bench_gwlib.sh.
+ *
+ * Usage: bench_gwlib [-r rounds] [-t threads] [-o file.json]
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gwlib/gwlib.h"
+#include "gw/msg.h"
+
+#define KEYS 1024
+
+#define TEXT "Hello! Meeting at 18:00 in the caf\xc3\xa9, price 5 \xc2\xa3. " \
+             "R\xc3\xa9servez avant le 3 juin, s'il vous pla\xc3\xaet."
+
+#define HEADERS "Host: localhost:13013\r\n" \
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\n" \
+    "Accept: text/html, application/xhtml+xml, */*;q=0.8\r\n" \
+    "Accept-Charset: utf-8, iso-8859-1;q=0.5\r\n" \
+    "Content-Type: text/plain; charset=\"UTF-8\"\r\n" \
+    "Content-Length: 160\r\n" \
+    "X-Kannel-From: 12345\r\n" \
+    "X-Kannel-To: 358401234567\r\n" \
+    "Connection: keep-alive\r\n"
+
+typedef struct {
+    const char *name;
+    /* operations done by one round */
+    int ops;
+    /* state shared by the threads, may be NULL */
+    void *(*setup)(void);
+    void (*run)(void *state, long thread, long rounds);
+    void (*cleanup)(void *state);
+} Case;
+
+typedef struct {
+    const Case *c;
+    void *state;
+    long thread;
+    long rounds;
+    long allocations;
+} Worker;
+
+
+/*
+ * List, shared by the threads.
+ */
+
+static void *list_setup(void)
+{
+    List *list;
+
+    list = gwlist_create();
+    gwlist_add_producer(list);
+    return list;
+}
+
+static void list_run(void *state, long thread, long rounds)
+{
+    long i;
+
+    for (i = 0; i < rounds; i++) {
+        gwlist_produce(state, &i);
+        gwlist_consume(state);
+    }
+}
+
+static void list_cleanup(void *state)
+{
+    gwlist_remove_producer(state);
+    gwlist_destroy(state, NULL);
+}
+
+
+/*
+ * Dict, shared by the threads, with own keys for each.
+ */
+
+static void *dict_setup(void)
+{
+    return dict_create(KEYS * 16, NULL);
+}
+
+static void dict_run(void *state, long thread, long rounds)
+{
+    Octstr *keys[KEYS];
+    long i;
+
+    for (i = 0; i < KEYS; i++)
+        keys[i] = octstr_format("key-%ld-%ld", thread, i);
+    for (i = 0; i < rounds; i++) {
+        dict_put(state, keys[i % KEYS], keys);
+        dict_get(state, keys[i % KEYS]);
+        dict_remove(state, keys[i % KEYS]);
+    }
+    for (i = 0; i < KEYS; i++)
+        octstr_destroy(keys[i]);
+}
+
+static void dict_cleanup(void *state)
+{
+    dict_destroy(state);
+}
+
+
+/*
+ * Octet strings.
+ */
+
+static void octstr_create_run(void *state, long thread, long rounds)
+{
+    long i;
+
+    for (i = 0; i < rounds; i++)
+        octstr_destroy(octstr_create(TEXT));
+}
+
+static void octstr_append_run(void *state, long thread, long rounds)
+{
+    Octstr *os, *word;
+    long i;
+
+    word = octstr_imm("word ");
+    os = octstr_create("");
+    for (i = 0; i < rounds; i++) {
+        octstr_append(os, word);
+        if (octstr_len(os) > 1000)
+            octstr_truncate(os, 0);
+    }
+    octstr_destroy(os);
+}
+
+static void octstr_format_run(void *state, long thread, long rounds)
+{
+    Octstr *os, *arg;
+    long i;
+
+    arg = octstr_imm("358401234567");
+    for (i = 0; i < rounds; i++) {
+        os = octstr_format("to=%S&id=%ld&text=%s", arg, i, "Hello");
+        octstr_destroy(os);
+    }
+}
+
+static void octstr_search_run(void *state, long thread, long rounds)
+{
+    Octstr *os, *needle;
+    long i;
+
+    os = octstr_create(TEXT TEXT);
+    needle = octstr_imm("vous");
+    for (i = 0; i < rounds; i++)
+        octstr_search(os, needle, 0);
+    octstr_destroy(os);
+}
+
+static void octstr_case_search_run(void *state, long thread, long rounds)
+{
+    Octstr *os, *needle;
+    long i;
+
+    os = octstr_create(HEADERS);
+    needle = octstr_imm("x-kannel-to:");
+    for (i = 0; i < rounds; i++)
+        octstr_case_search(os, needle, 0);
+    octstr_destroy(os);
+}
+
+static void octstr_case_compare_run(void *state, long thread, long rounds)
+{
+    Octstr *os1, *os2;
+    long i;
+
+    os1 = octstr_imm("X-Kannel-Content-Type-Parameters");
+    os2 = octstr_imm("x-kannel-content-type-parameterS");
+    for (i = 0; i < rounds; i++)
+        octstr_case_compare(os1, os2);
+}
+
+
+/*
+ * Priority queue, shared by the threads.
+ */
+
+static int prio_cmp(const void *a, const void *b)
+{
+    long x = *(const long *) a, y = *(const long *) b;
+
+    return (x > y) - (x < y);
+}
+
+static long prio_items[KEYS];
+
+static void *prio_setup(void)
+{
+    gw_prioqueue_t *pq;
+    long i;
+
+    pq = gw_prioqueue_create(prio_cmp);
+    for (i = 0; i < KEYS; i++) {
+        prio_items[i] = (i * 7919) % KEYS;
+        gw_prioqueue_insert(pq, &prio_items[i]);
+    }
+    return pq;
+}
+
+static void prio_run(void *state, long thread, long rounds)
+{
+    void *item;
+    long i;
+
+    for (i = 0; i < rounds; i++) {
+        item = gw_prioqueue_remove(state);
+        if (item != NULL)
+            gw_prioqueue_insert(state, item);
+    }
+}
+
+static void prio_cleanup(void *state)
+{
+    gw_prioqueue_destroy(state, NULL);
+}
+
+
+/*
+ * Message packing.
+ */
+
+static Msg *sms_msg(void)
+{
+    Msg *msg;
+
+    msg = msg_create(sms);
+    msg->sms.sender = octstr_create("12345");
+    msg->sms.receiver = octstr_create("358401234567");
+    msg->sms.msgdata = octstr_create(TEXT);
+    msg->sms.smsc_id = octstr_create("smpp");
+    msg->sms.service = octstr_create("default");
+    msg->sms.dlr_url = octstr_create("http://localhost/dlr?id=1&type=%d");
+    msg->sms.dlr_mask = 31;
+    return msg;
+}
+
+static void msg_pack_run(void *state, long thread, long rounds)
+{
+    Msg *msg;
+    long i;
+
+    msg = sms_msg();
+    for (i = 0; i < rounds; i++)
+        octstr_destroy(msg_pack(msg));
+    msg_destroy(msg);
+}
+
+static void msg_unpack_run(void *state, long thread, long rounds)
+{
+    Msg *msg;
+    Octstr *os;
+    long i;
+
+    msg = sms_msg();
+    os = msg_pack(msg);
+    for (i = 0; i < rounds; i++)
+        msg_destroy(msg_unpack(os));
+    octstr_destroy(os);
+    msg_destroy(msg);
+}
+
+
+/*
+ * Character sets.
+ */
+
+static void charset_ucs2_run(void *state, long thread, long rounds)
+{
+    Octstr *text, *os;
+    long i;
+
+    text = octstr_create(TEXT);
+    for (i = 0; i < rounds; i++) {
+        os = octstr_duplicate(text);
+        charset_convert(os, "UTF-8", "UCS-2BE");
+        octstr_destroy(os);
+    }
+    octstr_destroy(text);
+}
+
+static void charset_gsm_run(void *state, long thread, long rounds)
+{
+    Octstr *text, *os;
+    long i;
+
+    text = octstr_create(TEXT);
+    for (i = 0; i < rounds; i++) {
+        os = octstr_duplicate(text);
+        charset_utf8_to_gsm(os);
+        octstr_destroy(os);
+    }
+    octstr_destroy(text);
+}
+
+
+/*
+ * HTTP headers: split a request header block into a header list and
+ * look up what smsbox looks up for a sendsms request.
+ */
+
+static void http_headers_run(void *state, long thread, long rounds)
+{
+    Octstr *block, *line, *value, *type, *charset;
+    List *headers, *values;
+    long i, pos, end;
+
+    block = octstr_create(HEADERS);
+    for (i = 0; i < rounds; i++) {
+        headers = http_create_empty_headers();
+        for (pos = 0; (end = octstr_search_char(block, '\r', pos)) != -1; pos = end + 2) {
+            line = octstr_copy(block, pos, end - pos);
+            gwlist_append(headers, line);
+        }
+        http_header_get_content_type(headers, &type, &charset);
+        value = http_header_find_first(headers, "X-Kannel-To");
+        octstr_destroy(value);
+        value = http_header_find_first(headers, "Accept");
+        values = http_header_split_value(value);
+        gwlist_destroy(values, octstr_destroy_item);
+        octstr_destroy(value);
+        octstr_destroy(type);
+        octstr_destroy(charset);
+        http_destroy_headers(headers);
+    }
+    octstr_destroy(block);
+}
+
+
+/*
+ * Looking up the headers smsbox looks up for a sendsms request, in a
+ * header list and in a header map.
+ */
+
+static char *lookups[] = {
+    "X-Kannel-From", "X-Kannel-To", "X-Kannel-UDH", "Content-Type",
+    "X-Kannel-Priority"
+};
+#define NUM_LOOKUPS ((int) (sizeof(lookups) / sizeof(lookups[0])))
+
+static List *header_list(void)
+{
+    Octstr *block;
+    List *headers;
+    long pos, end;
+
+    block = octstr_create(HEADERS);
+    headers = http_create_empty_headers();
+    for (pos = 0; (end = octstr_search_char(block, '\r', pos)) != -1; pos = end + 2)
+        gwlist_append(headers, octstr_copy(block, pos, end - pos));
+    octstr_destroy(block);
+    return headers;
+}
+
+static void header_list_run(void *state, long thread, long rounds)
+{
+    List *headers;
+    long i;
+    int j;
+
+    headers = header_list();
+    for (i = 0; i < rounds; i++)
+        for (j = 0; j < NUM_LOOKUPS; j++)
+            octstr_destroy(http_header_find_first(headers, lookups[j]));
+    http_destroy_headers(headers);
+}
+
+static void header_map_run(void *state, long thread, long rounds)
+{
+    List *headers;
+    gw_headermap_t *map;
+    long i;
+    int j;
+
+    headers = header_list();
+    map = gw_headermap_from_list(headers);
+    for (i = 0; i < rounds; i++)
+        for (j = 0; j < NUM_LOOKUPS; j++)
+            gw_headermap_get(map, lookups[j]);
+    gw_headermap_destroy(map);
+    http_destroy_headers(headers);
+}
+
+
+/*
+ * Parking HTTP clients until the ack of their message, with IN_FLIGHT
+ * of them waiting per thread: in a Dict keyed by the uuid as text, as
+ * smsbox did, and in a uuid map.
+ */
+
+#define IN_FLIGHT 4096
+
+static void make_key(uuid_t key, long thread, long i)
+{
+    memset(key, 0, sizeof(uuid_t));
+    memcpy(key, &i, sizeof(i));
+    memcpy(key + sizeof(i), &thread, sizeof(thread));
+}
+
+static void *ack_dict_setup(void)
+{
+    return dict_create(32, NULL);
+}
+
+static Octstr *ack_dict_key(uuid_t key)
+{
+    char id[UUID_STR_LEN + 1];
+
+    uuid_unparse(key, id);
+    return octstr_create(id);
+}
+
+static void ack_dict_run(void *state, long thread, long rounds)
+{
+    uuid_t *keys;
+    Octstr *os;
+    long i;
+
+    keys = gw_malloc(IN_FLIGHT * sizeof(*keys));
+
+    for (i = 0; i < rounds + IN_FLIGHT; i++) {
+        if (i >= IN_FLIGHT) {
+            os = ack_dict_key(keys[i % IN_FLIGHT]);
+            dict_remove(state, os);
+            octstr_destroy(os);
+        }
+        if (i < rounds) {
+            make_key(keys[i % IN_FLIGHT], thread, i);
+            os = ack_dict_key(keys[i % IN_FLIGHT]);
+            dict_put(state, os, keys);
+            octstr_destroy(os);
+        }
+    }
+    gw_free(keys);
+}
+
+static void ack_dict_cleanup(void *state)
+{
+    dict_destroy(state);
+}
+
+static void *ack_map_setup(void)
+{
+    return gw_uuidmap_create(1024);
+}
+
+static void ack_map_run(void *state, long thread, long rounds)
+{
+    uuid_t *keys;
+    long i;
+
+    keys = gw_malloc(IN_FLIGHT * sizeof(*keys));
+
+    for (i = 0; i < rounds + IN_FLIGHT; i++) {
+        if (i >= IN_FLIGHT)
+            gw_uuidmap_remove(state, keys[i % IN_FLIGHT]);
+        if (i < rounds) {
+            make_key(keys[i % IN_FLIGHT], thread, i);
+            gw_uuidmap_put(state, keys[i % IN_FLIGHT], keys);
+        }
+    }
+    gw_free(keys);
+}
+
+static void ack_map_cleanup(void *state)
+{
+    gw_uuidmap_destroy(state);
+}
+
+
+static const Case cases[] = {
+    { "list_produce_consume", 2, list_setup, list_run, list_cleanup },
+    { "dict_put_get_remove", 3, dict_setup, dict_run, dict_cleanup },
+    { "octstr_create", 1, NULL, octstr_create_run, NULL },
+    { "octstr_append", 1, NULL, octstr_append_run, NULL },
+    { "octstr_format", 1, NULL, octstr_format_run, NULL },
+    { "octstr_search", 1, NULL, octstr_search_run, NULL },
+    { "octstr_case_search", 1, NULL, octstr_case_search_run, NULL },
+    { "octstr_case_compare", 1, NULL, octstr_case_compare_run, NULL },
+    { "prioqueue_remove_insert", 2, prio_setup, prio_run, prio_cleanup },
+    { "msg_pack", 1, NULL, msg_pack_run, NULL },
+    { "msg_unpack", 1, NULL, msg_unpack_run, NULL },
+    { "charset_utf8_to_ucs2", 1, NULL, charset_ucs2_run, NULL },
+    { "charset_utf8_to_gsm", 1, NULL, charset_gsm_run, NULL },
+    { "http_headers", 1, NULL, http_headers_run, NULL },
+    { "header_list_find", NUM_LOOKUPS, NULL, header_list_run, NULL },
+    { "header_map_get", NUM_LOOKUPS, NULL, header_map_run, NULL },
+    { "ack_dict_park_complete", 1, ack_dict_setup, ack_dict_run, ack_dict_cleanup },
+    { "ack_uuidmap_park_complete", 1, ack_map_setup, ack_map_run, ack_map_cleanup },
+};
+#define NUM_CASES ((int) (sizeof(cases) / sizeof(cases[0])))
+
+
+static void worker(void *arg)
+{
+    Worker *w = arg;
+    long before;
+
+    before = gwmem_allocations();
+    w->c->run(w->state, w->thread, w->rounds);
+    w->allocations = gwmem_allocations() - before;
+}
+
+/*
+ * Run case with given number of threads, each doing rounds rounds.
+ * Return operations per second, allocations per operation in *allocs,
+ * -1 if not known.
+ */
+static double run_case(const Case *c, long threads, long rounds, double *allocs)
+{
+    Worker *w;
+    void *state;
+    long long start, usec;
+    long i, total = 0;
+
+    state = (c->setup != NULL) ? c->setup() : NULL;
+    w = gw_malloc(threads * sizeof(*w));
+
+    start = date_monotonic_usec();
+    for (i = 0; i < threads; i++) {
+        w[i].c = c;
+        w[i].state = state;
+        w[i].thread = i;
+        w[i].rounds = rounds;
+        w[i].allocations = 0;
+    }
+    if (threads == 1)
+        worker(&w[0]);
+    else {
+        for (i = 0; i < threads; i++)
+            if ((w[i].thread = gwthread_create(worker, &w[i])) == -1)
+                panic(0, "Cannot create thread");
+        for (i = 0; i < threads; i++)
+            gwthread_join(w[i].thread);
+    }
+    usec = date_monotonic_usec() - start + 1;
+
+    for (i = 0; i < threads; i++)
+        total += w[i].allocations;
+    *allocs = (gwmem_allocations() == -1) ? -1 :
+        (double) total / (threads * rounds * c->ops);
+
+    gw_free(w);
+    if (c->cleanup != NULL)
+        c->cleanup(state);
+
+    return threads * rounds * c->ops * 1e6 / usec;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *json = NULL;
+    long rounds = 100000, max_threads = 4, threads;
+    double rate, allocs;
+    int opt, i, first = 1;
+
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    while ((opt = getopt(argc, argv, "r:t:o:")) != EOF) {
+        switch (opt) {
+        case 'r': rounds = atol(optarg); break;
+        case 't': max_threads = atol(optarg); break;
+        case 'o':
+            if ((json = fopen(optarg, "w")) == NULL)
+                panic(errno, "Cannot write `%s'", optarg);
+            break;
+        default:
+            panic(0, "Usage: bench_gwlib [-r rounds] [-t threads] [-o file.json]");
+        }
+    }
+    if (rounds < 1 || max_threads < 1)
+        panic(0, "Rounds and threads must be positive");
+
+    if (json != NULL)
+        fprintf(json, "{\n  \"rounds\": %ld,\n  \"benchmarks\": [\n", rounds);
+    for (i = 0; i < NUM_CASES; i++) {
+        for (threads = 1; threads <= max_threads; threads *= 2) {
+            rate = run_case(&cases[i], threads, rounds, &allocs);
+            if (allocs < 0)
+                printf("%s\t%ld\t%.0f\t-\n", cases[i].name, threads, rate);
+            else
+                printf("%s\t%ld\t%.0f\t%.2f\n", cases[i].name, threads, rate, allocs);
+            if (json == NULL)
+                continue;
+            fprintf(json, "%s    {\"name\": \"%s\", \"threads\": %ld, "
+                    "\"ops_per_sec\": %.0f, ", first ? "" : ",\n",
+                    cases[i].name, threads, rate);
+            if (allocs < 0)
+                fprintf(json, "\"allocs_per_op\": null}");
+            else
+                fprintf(json, "\"allocs_per_op\": %.2f}", allocs);
+            first = 0;
+        }
+    }
+    if (json != NULL) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+
+    gwlib_shutdown();
+    return 0;
+}
@@ -0,0 +1,805 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * bench_load.c - drive a mix of SMS traffic through bearerbox and smsbox
+ *
+ * Plays both the SMS center, accepting any number of SMPP binds, and the
+ * HTTP application, and measures each stage of three flows:
+ *
+ *   mo, mo_reply   deliver_sm "mo <n>" to the HTTP request for the
+ *                  sms-service, and to the submit_sm of its reply
+ *   sendsms, mt    sendsms HTTP request "mt <n>" to its response, and to
+ *                  the submit_sm of the message
+ *   dlr            delivery receipt for the MT to the HTTP request for
+ *                  its dlr-url
+ *
+ * Prints a line of count, throughput and latency percentiles for each
+ * stage, writes the same as JSON with -o, and compares with an earlier
+ * JSON report given with -B, exiting with 1 if a stage got slower. Used
+ * by benchmarks/bench_load.sh, see benchmarks/bench_load.conf for the
+ * Kannel side.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gwlib/gwlib.h"
+#include "gw/smsc/smpp_pdu.h"
+
+static long smpp_port = 2345;
+static long http_port = 8080;
+static long sendsms_port = 13013;
+static long admin_port = 13000;
+static char *admin_password = "bar";
+static char *sendsms_username = "tester";
+static char *sendsms_password = "foobar";
+
+static long num_mo = 1000;
+static long num_mt = 1000;
+static long mo_window = 100;
+static long concurrency = 10;
+static long binds = 1;
+static int want_dlr = 0;
+static double max_time = 60;
+static double tolerance = 10;
+
+enum {
+    STAGE_MO,
+    STAGE_MO_REPLY,
+    STAGE_SENDSMS,
+    STAGE_MT,
+    STAGE_DLR,
+    NUM_STAGES
+};
+
+static struct {
+    const char *name;
+    gw_histogram_t *hist;
+    long expected;
+} stages[NUM_STAGES] = {
+    { "mo", NULL, 0 },
+    { "mo_reply", NULL, 0 },
+    { "sendsms", NULL, 0 },
+    { "mt", NULL, 0 },
+    { "dlr", NULL, 0 },
+};
+
+/* start times in usec, by message number */
+static long long *mo_start;
+static long long *mt_start;
+static long long *dlr_start;
+
+/* free places in the MO and sendsms windows */
+static Semaphore *mo_free;
+static Semaphore *mt_free;
+
+static Counter *errors;
+static volatile int quitting = 0;
+
+
+static void record(int stage, long long *start, long n, long max)
+{
+    if (n < 0 || n >= max || start[n] == 0) {
+        warning(0, "Unexpected %s message %ld", stages[stage].name, n);
+        counter_increase(errors);
+        return;
+    }
+    gw_histogram_record(stages[stage].hist, date_monotonic_usec() - start[n]);
+}
+
+/* message number from text like "mt 42" */
+static long message_number(Octstr *text, const char *prefix)
+{
+    long n, len;
+
+    len = strlen(prefix);
+    if (octstr_ncompare(text, octstr_imm(prefix), len) != 0 ||
+        octstr_parse_long(&n, text, len, 10) == -1)
+        return -1;
+
+    return n;
+}
+
+
+/***********************************************************************
+ * SMS center emulator.
+ */
+
+typedef struct {
+    Connection *conn;
+    Octstr *system_id;
+    int receiver;
+    long tid;
+} SmppClient;
+
+static List *smpp_clients;
+static List *smpp_receivers;
+static Counter *smpp_seq;
+static Semaphore *bound;
+static long smpp_tid = -1;
+
+
+static void smpp_send(SmppClient *c, SMPP_PDU *pdu)
+{
+    Octstr *os;
+
+    os = smpp_pdu_pack(NULL, pdu);
+    conn_write(c->conn, os);
+    octstr_destroy(os);
+    smpp_pdu_destroy(pdu);
+}
+
+static void smpp_bound(SmppClient *c, Octstr *system_id, int receiver)
+{
+    c->system_id = octstr_duplicate(system_id);
+    if (receiver) {
+        c->receiver = 1;
+        gwlist_append(smpp_receivers, c);
+        semaphore_up(bound);
+    }
+}
+
+/* receipt goes to a receiver of the same SMSC as the submit */
+static SmppClient *smpp_receiver_for(SmppClient *c)
+{
+    SmppClient *r, *found = NULL;
+    long i;
+
+    if (c->receiver)
+        return c;
+
+    gwlist_lock(smpp_receivers);
+    for (i = 0; i < gwlist_len(smpp_receivers) && found == NULL; i++) {
+        r = gwlist_get(smpp_receivers, i);
+        if (octstr_compare(r->system_id, c->system_id) == 0)
+            found = r;
+    }
+    gwlist_unlock(smpp_receivers);
+
+    return found;
+}
+
+static void smpp_receipt(SmppClient *c, SMPP_PDU *submit, long n)
+{
+    SMPP_PDU *pdu;
+    SmppClient *r;
+
+    if ((r = smpp_receiver_for(c)) == NULL) {
+        warning(0, "No receiver bound for `%s'", octstr_get_cstr(c->system_id));
+        counter_increase(errors);
+        return;
+    }
+
+    pdu = smpp_pdu_create(deliver_sm, counter_increase(smpp_seq));
+    pdu->u.deliver_sm.esm_class = 0x04;
+    pdu->u.deliver_sm.source_addr = octstr_duplicate(submit->u.submit_sm.destination_addr);
+    pdu->u.deliver_sm.destination_addr = octstr_duplicate(submit->u.submit_sm.source_addr);
+    pdu->u.deliver_sm.receipted_message_id = octstr_format("%ld", n);
+    pdu->u.deliver_sm.message_state = 2;
+    pdu->u.deliver_sm.short_message = octstr_format("id:%ld sub:001 dlvrd:001 "
+        "submit date:0001010000 done date:0001010000 stat:DELIVRD err:000 text:", n);
+    dlr_start[n] = date_monotonic_usec();
+    smpp_send(r, pdu);
+}
+
+static void smpp_handle_pdu(SmppClient *c, SMPP_PDU *pdu)
+{
+    SMPP_PDU *resp = NULL;
+    long n;
+
+    switch (pdu->type) {
+    case bind_transmitter:
+        resp = smpp_pdu_create(bind_transmitter_resp,
+                               pdu->u.bind_transmitter.sequence_number);
+        smpp_bound(c, pdu->u.bind_transmitter.system_id, 0);
+        break;
+
+    case bind_receiver:
+        resp = smpp_pdu_create(bind_receiver_resp,
+                               pdu->u.bind_receiver.sequence_number);
+        smpp_bound(c, pdu->u.bind_receiver.system_id, 1);
+        break;
+
+    case bind_transceiver:
+        resp = smpp_pdu_create(bind_transceiver_resp,
+                               pdu->u.bind_transceiver.sequence_number);
+        smpp_bound(c, pdu->u.bind_transceiver.system_id, 1);
+        break;
+
+    case submit_sm:
+        resp = smpp_pdu_create(submit_sm_resp, pdu->u.submit_sm.sequence_number);
+        if ((n = message_number(pdu->u.submit_sm.short_message, "mt ")) != -1) {
+            record(STAGE_MT, mt_start, n, num_mt);
+            resp->u.submit_sm_resp.message_id = octstr_format("%ld", n);
+            smpp_send(c, resp);
+            resp = NULL;
+            if (pdu->u.submit_sm.registered_delivery && n < num_mt)
+                smpp_receipt(c, pdu, n);
+        } else if ((n = message_number(pdu->u.submit_sm.short_message, "reply ")) != -1) {
+            record(STAGE_MO_REPLY, mo_start, n, num_mo);
+            resp->u.submit_sm_resp.message_id = octstr_format("r%ld", n);
+            smpp_send(c, resp);
+            resp = NULL;
+            semaphore_up(mo_free);
+        } else {
+            warning(0, "Unexpected submit_sm `%s'",
+                    octstr_get_cstr(pdu->u.submit_sm.short_message));
+            counter_increase(errors);
+            resp->u.submit_sm_resp.message_id = octstr_create("0");
+        }
+        break;
+
+    case enquire_link:
+        resp = smpp_pdu_create(enquire_link_resp,
+                               pdu->u.enquire_link.sequence_number);
+        break;
+
+    case unbind:
+        resp = smpp_pdu_create(unbind_resp, pdu->u.unbind.sequence_number);
+        break;
+
+    case deliver_sm_resp:
+    case generic_nack:
+        break;
+
+    default:
+        error(0, "SMPP: Unhandled PDU type %s", pdu->type_name);
+        break;
+    }
+
+    if (resp != NULL)
+        smpp_send(c, resp);
+}
+
+
+static void smpp_reader(void *arg)
+{
+    SmppClient *c = arg;
+    SMPP_PDU *pdu;
+    Octstr *os;
+    long len = 0;
+
+    while (!quitting && conn_wait(c->conn, -1.0) != -1) {
+        for (;;) {
+            if (len == 0) {
+                len = smpp_pdu_read_len(c->conn);
+                if (len == -1) {
+                    error(0, "Client sent garbage, closing connection.");
+                    return;
+                } else if (len == 0) {
+                    if (conn_eof(c->conn) || conn_error(c->conn))
+                        return;
+                    break;
+                }
+            }
+            if ((os = smpp_pdu_read_data(c->conn, len)) == NULL) {
+                if (conn_eof(c->conn) || conn_error(c->conn))
+                    return;
+                break;
+            }
+            len = 0;
+            if ((pdu = smpp_pdu_unpack(NULL, os)) == NULL) {
+                error(0, "PDU unpacking failed!");
+                octstr_dump(os, 0);
+            } else {
+                smpp_handle_pdu(c, pdu);
+                smpp_pdu_destroy(pdu);
+            }
+            octstr_destroy(os);
+        }
+    }
+}
+
+static void smpp_server(void *arg)
+{
+    SmppClient *c;
+    Octstr *addr;
+    int fd, new_fd;
+
+    if ((fd = make_server_socket(smpp_port, NULL)) == -1)
+        panic(0, "Couldn't create SMPP listen port.");
+
+    while (!quitting && (new_fd = gw_accept(fd, &addr)) != -1) {
+        octstr_destroy(addr);
+        c = gw_malloc(sizeof(*c));
+        c->conn = conn_wrap_fd(new_fd, 0);
+        c->system_id = NULL;
+        c->receiver = 0;
+        gwlist_append(smpp_clients, c);
+        if ((c->tid = gwthread_create(smpp_reader, c)) == -1)
+            panic(0, "Couldn't start SMPP reader thread.");
+    }
+    close(fd);
+}
+
+static void smpp_start(void)
+{
+    smpp_clients = gwlist_create();
+    smpp_receivers = gwlist_create();
+    smpp_seq = counter_create();
+    bound = semaphore_create(0);
+    if ((smpp_tid = gwthread_create(smpp_server, NULL)) == -1)
+        panic(0, "Couldn't start SMPP emulator thread.");
+}
+
+static void smpp_stop(void)
+{
+    SmppClient *c;
+
+    gwthread_wakeup(smpp_tid);
+    gwthread_join(smpp_tid);
+    while ((c = gwlist_extract_first(smpp_clients)) != NULL) {
+        gwthread_wakeup(c->tid);
+        gwthread_join(c->tid);
+        conn_destroy(c->conn);
+        octstr_destroy(c->system_id);
+        gw_free(c);
+    }
+    gwlist_destroy(smpp_clients, NULL);
+    gwlist_destroy(smpp_receivers, NULL);
+    counter_destroy(smpp_seq);
+    semaphore_destroy(bound);
+}
+
+/* send MO messages round robin over the receivers, mo_window at a time */
+static void mo_sender(void *arg)
+{
+    SMPP_PDU *pdu;
+    SmppClient *r;
+    long n;
+
+    for (n = 0; n < num_mo; n++) {
+        semaphore_down(mo_free);
+        if (quitting)
+            break;
+        r = gwlist_get(smpp_receivers, n % gwlist_len(smpp_receivers));
+        pdu = smpp_pdu_create(deliver_sm, counter_increase(smpp_seq));
+        pdu->u.deliver_sm.source_addr = octstr_format("358%09ld", n);
+        pdu->u.deliver_sm.destination_addr = octstr_create("456");
+        pdu->u.deliver_sm.short_message = octstr_format("mo %ld", n);
+        mo_start[n] = date_monotonic_usec();
+        smpp_send(r, pdu);
+    }
+}
+
+
+/***********************************************************************
+ * HTTP application emulator, gets the sms-service and dlr-url requests.
+ */
+
+enum { HTTPD_THREADS = 4 };
+
+static List *text_headers;
+
+
+static void httpd(void *arg)
+{
+    HTTPClient *client;
+    Octstr *ip, *url, *body, *reply, *id;
+    List *headers, *cgivars;
+    long n;
+
+    while ((client = http_accept_request(http_port, &ip, &url, &headers,
+                                         &body, &cgivars)) != NULL) {
+        id = http_cgi_variable(cgivars, "id");
+        if (id == NULL || octstr_parse_long(&n, id, 0, 10) == -1)
+            n = -1;
+        reply = NULL;
+        if (octstr_compare(url, octstr_imm("/mo")) == 0) {
+            record(STAGE_MO, mo_start, n, num_mo);
+            reply = octstr_format("reply %ld", n);
+        } else if (octstr_compare(url, octstr_imm("/dlr")) == 0) {
+            record(STAGE_DLR, dlr_start, n, num_mt);
+        } else {
+            warning(0, "Unexpected HTTP request for `%s'", octstr_get_cstr(url));
+            counter_increase(errors);
+        }
+        http_send_reply(client, HTTP_OK, text_headers,
+                        reply != NULL ? reply : octstr_imm(""));
+        octstr_destroy(reply);
+        octstr_destroy(ip);
+        octstr_destroy(url);
+        octstr_destroy(body);
+        http_destroy_headers(headers);
+        http_destroy_cgiargs(cgivars);
+    }
+}
+
+
+/***********************************************************************
+ * sendsms client, keeps concurrency requests going.
+ */
+
+static HTTPCaller *caller;
+
+
+static void mt_sender(void *arg)
+{
+    Octstr *url, *dlr_url;
+    long n, *id;
+
+    for (n = 0; n < num_mt; n++) {
+        semaphore_down(mt_free);
+        if (quitting)
+            break;
+        url = octstr_format("http://127.0.0.1:%ld/cgi-bin/sendsms?"
+                            "username=%s&password=%s&from=123&to=358%09ld&text=mt+%ld",
+                            sendsms_port, sendsms_username, sendsms_password, n, n);
+        if (want_dlr) {
+            dlr_url = octstr_format("http://127.0.0.1:%ld/dlr?id=%ld&type=%%d",
+                                    http_port, n);
+            octstr_url_encode(dlr_url);
+            octstr_format_append(url, "&dlr-mask=%d&dlr-url=%S", 1, dlr_url);
+            octstr_destroy(dlr_url);
+        }
+        id = gw_malloc(sizeof(*id));
+        *id = n;
+        mt_start[n] = date_monotonic_usec();
+        http_start_request(caller, HTTP_METHOD_GET, url, NULL, NULL, 0, id, NULL);
+        octstr_destroy(url);
+    }
+}
+
+static void mt_receiver(void *arg)
+{
+    Octstr *final_url, *body;
+    List *headers;
+    long *id;
+    int status;
+
+    while ((id = http_receive_result(caller, &status, &final_url, &headers, &body)) != NULL) {
+        if (status == HTTP_OK || status == HTTP_ACCEPTED)
+            record(STAGE_SENDSMS, mt_start, *id, num_mt);
+        else {
+            warning(0, "sendsms request %ld failed with status %d", *id, status);
+            counter_increase(errors);
+        }
+        if (status != -1) {
+            octstr_destroy(final_url);
+            octstr_destroy(body);
+            http_destroy_headers(headers);
+        }
+        gw_free(id);
+        semaphore_up(mt_free);
+    }
+}
+
+
+/***********************************************************************
+ * Report.
+ */
+
+static double percentile(int stage, double p)
+{
+    return gw_histogram_percentile(stages[stage].hist, p) / 1000.0;
+}
+
+static void write_json(const char *name, double duration)
+{
+    FILE *f;
+    int i;
+
+    if ((f = fopen(name, "w")) == NULL)
+        panic(errno, "Cannot write report `%s'", name);
+
+    fprintf(f, "{\n  \"duration\": %.3f,\n", duration);
+    fprintf(f, "  \"config\": {\"mo\": %ld, \"mt\": %ld, \"mo_window\": %ld, "
+            "\"concurrency\": %ld, \"dlr\": %d, \"binds\": %ld},\n",
+            num_mo, num_mt, mo_window, concurrency, want_dlr, binds);
+    fprintf(f, "  \"errors\": %lu,\n  \"stages\": {\n", counter_value(errors));
+    for (i = 0; i < NUM_STAGES; i++) {
+        fprintf(f, "    \"%s\": {\"count\": %lu, \"expected\": %ld, "
+                "\"throughput\": %.1f, \"p50\": %.3f, \"p99\": %.3f, "
+                "\"p999\": %.3f, \"max\": %.3f}%s\n",
+                stages[i].name, gw_histogram_count(stages[i].hist),
+                stages[i].expected,
+                gw_histogram_count(stages[i].hist) / duration,
+                percentile(i, 50), percentile(i, 99), percentile(i, 99.9),
+                gw_histogram_max(stages[i].hist) / 1000.0,
+                i < NUM_STAGES - 1 ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    fclose(f);
+}
+
+/* value of key in the object of stage in a report written by write_json */
+static int baseline_value(Octstr *json, const char *stage, const char *key,
+                          double *value)
+{
+    Octstr *pat;
+    long start, end, pos;
+
+    pat = octstr_format("\"%s\": {", stage);
+    start = octstr_search(json, pat, 0);
+    octstr_destroy(pat);
+    if (start == -1)
+        return -1;
+    end = octstr_search_char(json, '}', start);
+
+    pat = octstr_format("\"%s\": ", key);
+    pos = octstr_search(json, pat, start);
+    if (pos == -1 || pos > end) {
+        octstr_destroy(pat);
+        return -1;
+    }
+    *value = strtod(octstr_get_cstr(json) + pos + octstr_len(pat), NULL);
+    octstr_destroy(pat);
+
+    return 0;
+}
+
+/*
+ * Print a line for each stage, with the baseline values if there is
+ * one. Return 1 if a stage is slower than in the baseline by more than
+ * the tolerance: less throughput, or p99 latency up by more than that
+ * and at least a millisecond.
+ */
+static int report(Octstr *baseline, double duration)
+{
+    double rate, p99, base_rate, base_p99;
+    int i, slower = 0;
+
+    for (i = 0; i < NUM_STAGES; i++) {
+        if (stages[i].expected == 0)
+            continue;
+        rate = gw_histogram_count(stages[i].hist) / duration;
+        p99 = percentile(i, 99);
+        printf("%s\t%lu\t%.1f\t%.3f\t%.3f\t%.3f", stages[i].name,
+               gw_histogram_count(stages[i].hist), rate,
+               percentile(i, 50), p99, percentile(i, 99.9));
+        if (baseline != NULL &&
+            baseline_value(baseline, stages[i].name, "throughput", &base_rate) == 0 &&
+            baseline_value(baseline, stages[i].name, "p99", &base_p99) == 0) {
+            printf("\t%.1f\t%.3f", base_rate, base_p99);
+            if (rate < base_rate * (1 - tolerance / 100) ||
+                (p99 > base_p99 * (1 + tolerance / 100) && p99 - base_p99 >= 1)) {
+                error(0, "Stage %s slower than baseline: %.1f/s p99 %.3f ms, "
+                      "was %.1f/s p99 %.3f ms", stages[i].name, rate, p99,
+                      base_rate, base_p99);
+                slower = 1;
+            }
+        } else
+            printf("\t-\t-");
+        printf("\n");
+    }
+
+    return slower;
+}
+
+
+/***********************************************************************
+ * Main program.
+ */
+
+static void kill_kannel(void)
+{
+    Octstr *url, *final_url, *reply_body;
+    List *reply_headers;
+
+    url = octstr_format("http://127.0.0.1:%ld/shutdown?password=%s",
+                        admin_port, admin_password);
+    if (http_get_real(HTTP_METHOD_GET, url, NULL, &final_url,
+                      &reply_headers, &reply_body) != -1) {
+        octstr_destroy(final_url);
+        http_destroy_headers(reply_headers);
+        octstr_destroy(reply_body);
+    }
+    octstr_destroy(url);
+}
+
+/* smsbox is up once it answers on the sendsms port */
+static void wait_for_smsbox(void)
+{
+    Octstr *url, *final_url, *reply_body;
+    List *reply_headers;
+    int status;
+
+    url = octstr_format("http://127.0.0.1:%ld/", sendsms_port);
+    while ((status = http_get_real(HTTP_METHOD_GET, url, NULL, &final_url,
+                                   &reply_headers, &reply_body)) == -1)
+        gwthread_sleep(0.1);
+    octstr_destroy(final_url);
+    http_destroy_headers(reply_headers);
+    octstr_destroy(reply_body);
+    octstr_destroy(url);
+}
+
+static int done(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_STAGES; i++)
+        if (gw_histogram_count(stages[i].hist) < (unsigned long) stages[i].expected)
+            return 0;
+    return 1;
+}
+
+static void help(void)
+{
+    info(0, "Usage: bench_load [options]");
+    info(0, "  -m N    MO messages to send (%ld)", num_mo);
+    info(0, "  -t N    MT messages to send with sendsms (%ld)", num_mt);
+    info(0, "  -w N    MO messages waiting for reply at most (%ld)", mo_window);
+    info(0, "  -c N    sendsms requests going at once (%ld)", concurrency);
+    info(0, "  -d      request delivery reports for MT messages");
+    info(0, "  -b N    SMPP receivers to wait for before starting (%ld)", binds);
+    info(0, "  -l S    give up after S seconds (%.0f)", max_time);
+    info(0, "  -o FILE write JSON report to FILE");
+    info(0, "  -B FILE compare with JSON report in FILE");
+    info(0, "  -T PCT  allowed slowdown from baseline in percent (%.0f)", tolerance);
+    info(0, "  -k      shut down bearerbox when done");
+    info(0, "  -v N    log level");
+}
+
+int main(int argc, char **argv)
+{
+    Octstr *baseline = NULL;
+    char *json = NULL;
+    long threads[HTTPD_THREADS], mo_tid, mt_tid, mt_rtid;
+    long long start;
+    double duration;
+    int opt, i, shutdown_kannel = 0, ret;
+
+    gwlib_init();
+
+    while ((opt = getopt(argc, argv, "m:t:w:c:db:l:o:B:T:kv:h")) != EOF) {
+        switch (opt) {
+        case 'm': num_mo = atol(optarg); break;
+        case 't': num_mt = atol(optarg); break;
+        case 'w': mo_window = atol(optarg); break;
+        case 'c': concurrency = atol(optarg); break;
+        case 'd': want_dlr = 1; break;
+        case 'b': binds = atol(optarg); break;
+        case 'l': max_time = atof(optarg); break;
+        case 'o': json = optarg; break;
+        case 'B':
+            if ((baseline = octstr_read_file(optarg)) == NULL)
+                panic(0, "Cannot read baseline `%s'", optarg);
+            break;
+        case 'T': tolerance = atof(optarg); break;
+        case 'k': shutdown_kannel = 1; break;
+        case 'v': log_set_output_level(atoi(optarg)); break;
+        case 'h':
+        default:
+            help();
+            exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (num_mo < 0 || num_mt < 0 || mo_window < 1 || concurrency < 1 || binds < 1)
+        panic(0, "Invalid arguments, see -h");
+
+    stages[STAGE_MO].expected = stages[STAGE_MO_REPLY].expected = num_mo;
+    stages[STAGE_SENDSMS].expected = stages[STAGE_MT].expected = num_mt;
+    stages[STAGE_DLR].expected = want_dlr ? num_mt : 0;
+    for (i = 0; i < NUM_STAGES; i++)
+        stages[i].hist = gw_histogram_create();
+    mo_start = gw_malloc((num_mo + 1) * sizeof(*mo_start));
+    mt_start = gw_malloc((num_mt + 1) * sizeof(*mt_start));
+    dlr_start = gw_malloc((num_mt + 1) * sizeof(*dlr_start));
+    memset(mo_start, 0, (num_mo + 1) * sizeof(*mo_start));
+    memset(mt_start, 0, (num_mt + 1) * sizeof(*mt_start));
+    memset(dlr_start, 0, (num_mt + 1) * sizeof(*dlr_start));
+    errors = counter_create();
+    mo_free = semaphore_create(mo_window);
+    mt_free = semaphore_create(concurrency);
+
+    text_headers = http_create_empty_headers();
+    http_header_add(text_headers, "Content-Type", "text/plain");
+    if (http_open_port(http_port, 0) == -1)
+        panic(0, "Can't open HTTP port %ld.", http_port);
+    for (i = 0; i < HTTPD_THREADS; i++)
+        threads[i] = gwthread_create(httpd, NULL);
+    smpp_start();
+
+    info(0, "Waiting for %ld SMPP receivers.", binds);
+    for (i = 0; i < binds; i++)
+        semaphore_down(bound);
+    info(0, "Waiting for smsbox.");
+    wait_for_smsbox();
+    info(0, "Starting %ld MO and %ld MT messages.", num_mo, num_mt);
+
+    start = date_monotonic_usec();
+    caller = http_caller_create();
+    mo_tid = gwthread_create(mo_sender, NULL);
+    mt_tid = gwthread_create(mt_sender, NULL);
+    mt_rtid = gwthread_create(mt_receiver, NULL);
+
+    while (!done() && (date_monotonic_usec() - start) / 1e6 < max_time)
+        gwthread_sleep(0.01);
+    duration = (date_monotonic_usec() - start) / 1e6;
+    if (!done())
+        error(0, "Gave up after %.1f seconds.", duration);
+
+    quitting = 1;
+    for (i = 0; i < mo_window + 1; i++)
+        semaphore_up(mo_free);
+    for (i = 0; i < concurrency + 1; i++)
+        semaphore_up(mt_free);
+    gwthread_join(mo_tid);
+    gwthread_join(mt_tid);
+    http_caller_signal_shutdown(caller);
+    gwthread_join(mt_rtid);
+
+    if (json != NULL)
+        write_json(json, duration);
+    ret = report(baseline, duration);
+    if (!done() || counter_value(errors) > 0)
+        ret = 1;
+
+    if (shutdown_kannel)
+        kill_kannel();
+    smpp_stop();
+    http_close_all_ports();
+    for (i = 0; i < HTTPD_THREADS; i++)
+        gwthread_join(threads[i]);
+
+    http_destroy_headers(text_headers);
+    http_caller_destroy(caller);
+    for (i = 0; i < NUM_STAGES; i++)
+        gw_histogram_destroy(stages[i].hist);
+    gw_free(mo_start);
+    gw_free(mt_start);
+    gw_free(dlr_start);
+    counter_destroy(errors);
+    semaphore_destroy(mo_free);
+    semaphore_destroy(mt_free);
+    octstr_destroy(baseline);
+    gwlib_shutdown();
+
+    return ret;
+}
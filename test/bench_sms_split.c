@@ -0,0 +1,167 @@
+/* ==================================================================== 
+ * The Kannel Software License, Version 1.0 
+ * 
+ * Copyright (c) 2001-2010 Kannel Group  
+ * Copyright (c) 1998-2001 WapIT Ltd.   
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright 
+ *    notice, this list of conditions and the following disclaimer in 
+ *    the documentation and/or other materials provided with the 
+ *    distribution. 
+ * 
+ * 3. The end-user documentation included with the redistribution, 
+ *    if any, must include the following acknowledgment: 
+ *       "This product includes software developed by the 
+ *        Kannel Group (http://www.kannel.org/)." 
+ *    Alternately, this acknowledgment may appear in the software itself, 
+ *    if and wherever such third-party acknowledgments normally appear. 
+ * 
+ * 4. The names "Kannel" and "Kannel Group" must not be used to 
+ *    endorse or promote products derived from this software without 
+ *    prior written permission. For written permission, please  
+ *    contact org@kannel.org. 
+ * 
+ * 5. Products derived from this software may not be called "Kannel", 
+ *    nor may "Kannel" appear in their name, without prior written 
+ *    permission of the Kannel Group. 
+ * 
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED.  IN NO EVENT SHALL THE KANNEL GROUP OR ITS CONTRIBUTORS 
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,  
+ * OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT  
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR  
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,  
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE  
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,  
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ * ==================================================================== 
+ * 
+ * This software consists of voluntary contributions made by many 
+ * individuals on behalf of the Kannel Group.  For more information on  
+ * the Kannel Group, please see <http://www.kannel.org/>. 
+ * 
+ * Portions of this software are based upon software originally written at  
+ * WapIT Ltd., Helsinki, Finland for the Kannel project.  
+ */ 
+
+/*
+ * bench_sms_split.c - measure the speed of splitting long SMS messages
+ *
+ * Splits 7 bit and UCS-2 messages of different lengths with sms_split,
+ * with catenation, and prints a line of splits and parts per second for
+ * each length. Used by benchmarks/bench_sms_split.sh.
+ *
+ * Usage: bench_sms_split [rounds]
+ */
+
+#include "gwlib/gwlib.h"
+#include "gw/sms.h"
+
+#define WORDS "Caf\xc3\xa9 at 5? "
+
+static long sizes[] = { 1, 2, 5, 10, 50, 100, 255 };
+#define NUM_SIZES ((int) (sizeof(sizes) / sizeof(sizes[0])))
+
+
+static long count_parts(Msg *msg, Octstr *split_chars)
+{
+    List *list;
+    long n;
+
+    list = sms_split(msg, NULL, NULL, NULL, split_chars, 1, 0, 255, 
+                     MAX_SMS_OCTETS);
+    n = gwlist_len(list);
+    gwlist_destroy(list, msg_destroy_item);
+    return n;
+}
+
+
+static void set_text(Msg *msg, long words)
+{
+    octstr_destroy(msg->sms.msgdata);
+    msg->sms.msgdata = octstr_create("");
+    while (words-- > 0)
+        octstr_append_cstr(msg->sms.msgdata, WORDS);
+    if (msg->sms.coding == DC_UCS2)
+        charset_convert(msg->sms.msgdata, "UTF-8", "UCS-2BE");
+}
+
+
+/* The longest message of repeated WORDS that splits into `parts' parts */
+static Msg *message(int coding, long parts, Octstr *split_chars)
+{
+    Msg *msg;
+    long low, high, words;
+
+    msg = msg_create(sms);
+    msg->sms.coding = coding;
+    low = 1;
+    high = parts * 160;
+    while (low < high) {
+        words = (low + high + 1) / 2;
+        set_text(msg, words);
+        if (count_parts(msg, split_chars) <= parts)
+            low = words;
+        else
+            high = words - 1;
+    }
+    set_text(msg, low);
+    return msg;
+}
+
+
+static void bench(long rounds, int coding, long parts, Octstr *split_chars)
+{
+    Msg *msg;
+    List *list;
+    long i, total;
+    long long start, usec;
+
+    msg = message(coding, parts, split_chars);
+    rounds = rounds / parts + 1;
+    total = 0;
+    start = date_monotonic_usec();
+    for (i = 0; i < rounds; i++) {
+        list = sms_split(msg, NULL, NULL, NULL, split_chars, 1, 0, 255, 
+                         MAX_SMS_OCTETS);
+        total += gwlist_len(list);
+        gwlist_destroy(list, msg_destroy_item);
+    }
+    usec = date_monotonic_usec() - start + 1;
+    printf("%s\t%ld\t%.0f\t%.0f\n", coding == DC_UCS2 ? "UCS-2" : "7 bit",
+           total / rounds, rounds * 1e6 / usec, total * 1e6 / usec);
+    msg_destroy(msg);
+}
+
+
+int main(int argc, char **argv)
+{
+    Octstr *split_chars;
+    long rounds;
+    int i;
+
+    gwlib_init();
+    log_set_output_level(GW_INFO);
+
+    rounds = (argc > 1) ? atol(argv[1]) : 100000;
+    split_chars = octstr_create(" ");
+
+    for (i = 0; i < NUM_SIZES; i++)
+        bench(rounds, DC_7BIT, sizes[i], split_chars);
+    for (i = 0; i < NUM_SIZES; i++)
+        bench(rounds, DC_UCS2, sizes[i], NULL);
+
+    octstr_destroy(split_chars);
+    gwlib_shutdown();
+    return 0;
+}
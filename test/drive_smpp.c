@@ -89,6 +89,12 @@ static time_t last_from_esme = (time_t) -1;
 static time_t first_from_bb = (time_t) -1;
 static time_t last_to_bb = (time_t) -1;
 static long enquire_interval = 1; /* Measured in messages, not time. */
+static volatile int smsbox_connected = 0;
+static long drop_at = 0;    /* drop the transmitter getting this MT */
+static Counter *num_submits;
+static Counter *num_transmitters_used;
+static Mutex *mt_lock;
+static long *mt_acked;      /* answered submits by message number */
 
 
 static void quit(void)
@@ -103,6 +109,8 @@ typedef struct {
     int transmitter;
     int receiver;
     long version;
+    long submits;
+    int dropped;
 } ESME;
 
 
@@ -115,6 +123,8 @@ static ESME *esme_create(Connection *conn)
     esme->transmitter = 0;
     esme->receiver = 0;
     esme->version = 0;
+    esme->submits = 0;
+    esme->dropped = 0;
     return esme;
 }
 
@@ -163,9 +173,30 @@ static SMPP_PDU *handle_submit_sm(ESME *esme, SMPP_PDU *pdu)
 {
     SMPP_PDU *resp;
     unsigned long id;
+    long n;
     
     debug("test.smpp", 0, "submit_sm: short_message = <%s>",
     	  octstr_get_cstr(pdu->u.submit_sm.short_message));
+
+    /* 
+     * Fail the session on the given MT: leave it and whatever follows on
+     * the connection unanswered, so bearerbox has to send them again.
+     */
+    if (counter_increase(num_submits) + 1 == drop_at) {
+    	info(0, "Dropping transmitter after %ld submits.", esme->submits);
+	esme->dropped = 1;
+	return NULL;
+    }
+
+    if (esme->submits++ == 0)
+    	counter_increase(num_transmitters_used);
+    if (octstr_parse_long(&n, pdu->u.submit_sm.short_message, 0, 10) != -1 &&
+        n >= 1 && n <= max_to_esme) {
+	mutex_lock(mt_lock);
+	mt_acked[n]++;
+	mutex_unlock(mt_lock);
+    }
+
     id = counter_increase(num_from_esme) + 1;
     if (id == max_to_esme)
     	info(0, "ESME has submitted all messages to SMSC.");
@@ -259,6 +290,11 @@ static void send_smpp_thread(void *arg)
 
     esme = arg;
     
+    /* bearerbox would keep the messages until its resend without smsbox */
+    while (!quitting && !smsbox_connected)
+    	gwthread_sleep(0.1);
+    gwthread_sleep(1.0);
+
     id = 0;
     while (!quitting && counter_value(num_to_esme) < max_to_esme) {
         id = counter_increase(num_to_esme) + 1;
@@ -336,6 +372,11 @@ static void receive_smpp_thread(void *arg)
 		    smpp_pdu_destroy(pdu);
 		}
 		octstr_destroy(os);
+		/* let bearerbox read the answers sent so far, then close */
+		if (esme->dropped) {
+		    gwthread_sleep(1.0);
+		    goto error;
+		}
 	    } else if (conn_eof(esme->conn) || conn_error(esme->conn))
 	    	goto error;
 	    else
@@ -351,8 +392,10 @@ error:
 	quit();
 	gwthread_join(sender_id);
     }
+    /* a dropped transmitter binds again, keep on serving the others */
+    if (!esme->dropped)
+    	quit();
     esme_destroy(esme);
-    quit();
     debug("test.smpp", 0, "%s terminates.", __func__);
 }
 
@@ -360,18 +403,11 @@ error:
 static void smsbox_thread(void *arg)
 {
     Connection *conn;
-    Msg *msg;
+    Msg *msg, *reply;
     Octstr *os;
     Octstr *reply_msg;
     unsigned long count;
     
-    msg = msg_create(sms);
-    msg->sms.sender = octstr_create("123");
-    msg->sms.receiver = octstr_create("456");
-    msg->sms.msgdata = octstr_create("hello world");
-    reply_msg = msg_pack(msg);
-    msg_destroy(msg);
-
     gwthread_sleep(1.0);
     conn = conn_open_tcp(bearerbox_host, port_for_smsbox, NULL);
     if (conn == NULL) {
@@ -381,6 +417,15 @@ static void smsbox_thread(void *arg)
 	    panic(0, "Couldn't connect to bearerbox as smsbox");
     }
 
+    /* bearerbox routes messages to a box only once it identified */
+    msg = msg_create(admin);
+    msg->admin.command = cmd_identify;
+    os = msg_pack(msg);
+    conn_write_withlen(conn, os);
+    octstr_destroy(os);
+    msg_destroy(msg);
+    smsbox_connected = 1;
+
     while (!quitting && conn_wait(conn, -1.0) != -1) {
     	for (;;) {
 	    os = conn_read_withlen(conn);
@@ -403,7 +448,15 @@ static void smsbox_thread(void *arg)
 		      count, octstr_get_cstr(msg->sms.msgdata));
 		if (count == max_to_esme)
 		    info(0, "Bearerbox has sent all messages to smsbox.");
+		/* the reply carries the number of the message it answers */
+		reply = msg_create(sms);
+		reply->sms.sender = octstr_create("123");
+		reply->sms.receiver = octstr_create("456");
+		reply->sms.msgdata = octstr_duplicate(msg->sms.msgdata);
+		reply_msg = msg_pack(reply);
+		msg_destroy(reply);
 		conn_write_withlen(conn, reply_msg);
+		octstr_destroy(reply_msg);
 		counter_increase(num_to_bearerbox);
 	    }
 	    msg_destroy(msg);
@@ -414,7 +467,6 @@ static void smsbox_thread(void *arg)
     
 error:
     conn_destroy(conn);
-    octstr_destroy(reply_msg);
     debug("test.smpp", 0, "%s terminates.", __func__);
 }
 
@@ -459,7 +511,8 @@ static void handler(int signal)
 
 static void help(void)
 {
-    info(0, "drive_smpp [-h] [-v level][-l logfile][-p port][-m msgs][-c config]");
+    info(0, "drive_smpp [-h] [-v level][-l logfile][-p port][-m msgs][-c config]"
+            "[-f drop]");
 }
 
 
@@ -470,6 +523,7 @@ int main(int argc, char **argv)
     int port;
     int opt;
     double run_time;
+    long i;
     char *log_file;
     char *config_file;
 
@@ -493,9 +547,12 @@ int main(int argc, char **argv)
     num_from_esme = counter_create();
     num_to_bearerbox = counter_create();
     num_from_bearerbox = counter_create();
+    num_submits = counter_create();
+    num_transmitters_used = counter_create();
+    mt_lock = mutex_create();
     log_file = config_file = NULL;
 
-    while ((opt = getopt(argc, argv, "hv:p:P:m:l:c:")) != EOF) {
+    while ((opt = getopt(argc, argv, "hv:p:P:m:l:c:f:")) != EOF) {
 	switch (opt) {
 	case 'v':
 	    log_set_output_level(atoi(optarg));
@@ -525,6 +582,10 @@ int main(int argc, char **argv)
         config_file = optarg;
         break;
 
+    case 'f':
+        drop_at = atol(optarg);
+        break;
+
 	case '?':
 	default:
 	    error(0, "Invalid option %c", opt);
@@ -548,6 +609,10 @@ int main(int argc, char **argv)
         cfg_destroy(cfg);
     }
             
+    mt_acked = gw_malloc((max_to_esme + 1) * sizeof(*mt_acked));
+    for (i = 0; i <= max_to_esme; i++)
+    	mt_acked[i] = 0;
+
     info(0, "Starting drive_smpp test.");
     gwthread_create(accept_thread, &port);
     gwthread_join_all();
@@ -574,6 +639,13 @@ int main(int argc, char **argv)
     	 counter_value(num_to_esme) / run_time);
     info(0, "SMPP messages ESME to SMSC: %.1f msgs/sec",
     	 counter_value(num_from_esme) / run_time);
+    info(0, "Number of transmitters used: %ld",
+    	 counter_value(num_transmitters_used));
+
+    /* each reply must have reached the SMSC exactly once */
+    for (i = 1; i <= max_to_esme; i++)
+    	if (mt_acked[i] != 1)
+	    error(0, "Message %ld was submitted %ld times.", i, mt_acked[i]);
 
     octstr_destroy(smsc_system_id);
     octstr_destroy(smsc_source_addr);
@@ -583,6 +655,10 @@ int main(int argc, char **argv)
     counter_destroy(num_to_bearerbox);
     counter_destroy(num_from_bearerbox);
     counter_destroy(message_id_counter);
+    counter_destroy(num_submits);
+    counter_destroy(num_transmitters_used);
+    mutex_destroy(mt_lock);
+    gw_free(mt_acked);
 
     gwlib_shutdown();
     return 0;
@@ -64,6 +64,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <errno.h>
 
 #include "gwlib/gwlib.h"
 #include "gwlib/http.h"
@@ -83,6 +84,7 @@ static Octstr *msg_text = NULL;
 static Octstr *ssl_client_certkey_file = NULL;
 static Octstr *extra_headers = NULL;
 static Octstr *content_file = NULL; /* if set use POST method */
+static FILE *body_file = NULL; /* if set reply bodies are written to it */
 static Octstr *method_name = NULL;
 static int file = 0;
 static List *split = NULL;
@@ -183,6 +185,8 @@ static int receive_reply(HTTPCaller *caller)
         debug("", 0, "Reply body:");
         octstr_dump(replyb, 1);
     }
+    if (body_file != NULL)
+        octstr_print(body_file, replyb);
     octstr_destroy(replyb);
 
     return 0;
@@ -299,6 +303,8 @@ static void help(void)
     info(0, "    of a POST method request (default: GET if no -B is set)");
     info(0, "-m method");
     info(0, "    use a specific HTTP method for request to server");
+    info(0, "-o filename");
+    info(0, "    write the body of each HTTP response to file 'filename'");
     info(0, "-s");
     info(0, "    use HTTPS scheme to access SSL-enabled HTTP server");
     info(0, "-c ssl_client_cert_key_file");
@@ -334,7 +340,7 @@ int main(int argc, char **argv)
     file = 0;
     fp = NULL;
     
-    while ((opt = getopt(argc, argv, "hv:qr:p:P:Se:t:i:a:u:sc:H:B:m:")) != EOF) {
+    while ((opt = getopt(argc, argv, "hv:qr:p:P:Se:t:i:a:u:sc:H:B:m:o:")) != EOF) {
 	switch (opt) {
 	case 'v':
 	    log_set_output_level(atoi(optarg));
@@ -440,6 +446,11 @@ int main(int argc, char **argv)
 	    method_name = octstr_create(optarg);
 	    break;
 
+    case 'o':
+        if ((body_file = fopen(optarg, "w")) == NULL)
+            panic(errno, "Cannot open file <%s> for writing", optarg);
+        break;
+
 	case '?':
 	default:
 	    error(0, "Invalid option %c", opt);
@@ -505,6 +516,8 @@ int main(int argc, char **argv)
     octstr_destroy(extra_headers);
     octstr_destroy(content_file);
     gwlist_destroy(split, octstr_destroy_item);
+    if (body_file != NULL)
+        fclose(body_file);
     
     gwlib_shutdown();
     
@@ -53,7 +53,6 @@
  * Portions of this software are based upon software originally written at  
  * WapIT Ltd., Helsinki, Finland for the Kannel project.  
  */ 
-
 /*
  * timers.c - timers and set of timers, mainly for WTP.
  *
@@ -61,31 +60,43 @@
  */
 
 #include <signal.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include "gwlib/gwlib.h"
 #include "wap_events.h"
 #include "timers.h"
 
 /*
- * Active timers are stored in a TimerHeap.  It is a partially ordered
- * array.  Each element i is the child of element i/2 (rounded down),
- * and a child never elapses before its parent.  The result is that
- * element 0, the top of the heap, is always the first timer to
- * elapse.  The heap is kept in this partial order by all operations on
- * it.  Maintaining a partial order is much cheaper than maintaining
- * a sorted list.
- * The array will be resized as needed.  The size field is the number
- * of elements for which space is reserved, and the len field is the
- * number of elements actually used.  The elements used will always be
- * at tab[0] through tab[len-1].
+ * Active timers are stored in a hierarchical timing wheel.  Time is
+ * counted in ticks of one millisecond.  The lowest level of the wheel
+ * has a slot for each of the next LEVEL0_SIZE ticks, each higher level
+ * has LEVEL_SIZE slots, each covering a whole turn of the level below.
+ * A slot is a doubly linked list of timers, so starting and stopping
+ * a timer are constant time operations.
+ * Whenever the lowest level has turned around, the next slot of the
+ * level above is cascaded: its timers are moved to the slots of the
+ * lower levels, where they now belong.  Timers further in the future
+ * than the wheel reaches are kept in the last slot of the top level
+ * and cascaded again until they fit.
  */
-struct TimerHeap
-{
-    Timer **tab;
-    long len;
-    long size;
-};
-typedef struct TimerHeap TimerHeap;
+#define WHEEL_LEVELS 4
+#define LEVEL0_BITS 8
+#define LEVEL_BITS 6
+#define LEVEL0_SIZE (1L << LEVEL0_BITS)
+#define LEVEL_SIZE (1L << LEVEL_BITS)
+#define LEVEL0_MASK (LEVEL0_SIZE - 1)
+#define LEVEL_MASK (LEVEL_SIZE - 1)
+/* The reach of the wheel, about 18 hours */
+#define WHEEL_MAX_TICKS \
+    ((1L << (LEVEL0_BITS + (WHEEL_LEVELS - 1) * LEVEL_BITS)) - 1)
+
+/*
+ * Upper limit for the number of timer sets.  We use one set per CPU,
+ * so that timers of different caller threads do not contend for the
+ * same lock.
+ */
+#define MAX_TIMER_SETS 8
 
 struct Timerset
 {
@@ -96,18 +107,33 @@ struct Timerset
     /*
      * The entire set is locked for any operation on it.  This is
      * not as expensive as it sounds because usually each set is
-     * used by one caller thread and one (internal) timer thread,
+     * used by few caller threads and one (internal) timer thread,
      * and the timer thread does not wake up very often.
      */
     Mutex *mutex;
     /*
-     * Active timers are stored here in a partially ordered structure.
-     * See the definition of TimerHeap, above, for an explanation.
+     * The slots of the timing wheel.  See the explanation above.
      */
-    TimerHeap *heap;
+    Timer *level0[LEVEL0_SIZE];
+    Timer *levels[WHEEL_LEVELS - 1][LEVEL_SIZE];
     /*
-     * The thread that watches the top of the heap, and processes
-     * timers that have elapsed.
+     * The next tick the timer thread will process, and the number
+     * of timers in the wheel.
+     */
+    long current;
+    long count;
+    /*
+     * Ticks the wheel has been turned by one, for timers_ticks_run.
+     */
+    long ticks_run;
+    /*
+     * The tick at which the timer thread is going to wake up.
+     * Starting a timer that elapses earlier has to wake it.
+     */
+    long wakeup;
+    /*
+     * The thread that turns the wheel, and processes timers that
+     * have elapsed.
      */
     long thread;
 };
@@ -115,6 +141,11 @@ typedef struct Timerset Timerset;
 
 struct Timer
 {
+    /*
+     * The timer set this timer belongs to.  It does not change
+     * during the lifetime of the timer.
+     */
+    Timerset *set;
     /*
      * An event is produced on the output list when the
      * timer elapses.  The timer is not considered to have
@@ -125,9 +156,9 @@ struct Timer
      */
     List *output;
     /*
-     * The timer is set to elapse at this time, expressed in
-     * Unix time format.  This field is set to -1 if the timer
-     * is not active (i.e. in the timer set's heap).
+     * The timer is set to elapse at this tick of the monotonic
+     * clock.  This field is set to -1 if the timer is not active
+     * (i.e. in the timer set's wheel).
      */
     long elapses;
     /*
@@ -144,20 +175,21 @@ struct Timer
      */
     WAPEvent *elapsed_event;
     /*
-     * Index in the timer set's heap.  This field is managed by
-     * the heap operations, and is used to make them faster.
-     * If this timer is not in the heap, this field is -1.
+     * Links of the wheel slot the timer is in.  pprev points to
+     * the previous timer's next field, or to the slot itself.  Both
+     * are NULL if this timer is not in the wheel.
      */
-    long index;
+    Timer *next;
+    Timer **pprev;
 };
 
+static Timerset *timers[MAX_TIMER_SETS];
+static long timers_count;
+
 /*
- * Currently we have one timerset (and thus one heap and one thread)
- * for all timers.  This might change in the future in order to tune
- * performance.  In that case, it will be necessary to add a "set"
- * field to the Timer structure.
+ * Timers are spread over the sets in creation order.
  */
-static Timerset *timers;
+static Counter *timers_next_set;
 
 /*
  * Used by timer functions to assert that the timer module has been
@@ -169,12 +201,16 @@ static int initialized = 0;
  * Internal functions
  */
 static void abort_elapsed(Timer *timer);
-static TimerHeap *heap_create(void);
-static void heap_destroy(TimerHeap *heap);
-static void heap_delete(TimerHeap *heap, long index);
-static int heap_adjust(TimerHeap *heap, long index);
-static void heap_insert(TimerHeap *heap, Timer *timer);
-static void heap_swap(TimerHeap *heap, long index1, long index2);
+static Timerset *timerset_create(void);
+static void timerset_destroy(Timerset *set);
+static long timers_now(void);
+static Timer **wheel_slot(Timerset *set, long elapses);
+static void wheel_link(Timer **slot, Timer *timer);
+static void wheel_unlink(Timer *timer);
+static int wheel_cascade(Timerset *set, int level, long index);
+static void wheel_run(Timerset *set, long now);
+static long wheel_next_elapse(Timerset *set);
+static void wheel_stop_all(Timerset *set);
 static void lock(Timerset *set);
 static void unlock(Timerset *set);
 static void watch_timers(void *arg);   /* The timer thread */
@@ -183,41 +219,63 @@ static void elapse_timer(Timer *timer);
 
 void timers_init(void)
 {
+    long i, cpus;
+
     if (initialized == 0) {
-        timers = gw_malloc(sizeof(*timers));
-        timers->mutex = mutex_create();
-        timers->heap = heap_create();
-        timers->stopping = 0;
-        timers->thread = gwthread_create(watch_timers, timers);
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        timers_count = cpus < 1 ? 1 : (cpus > MAX_TIMER_SETS ?
+                                       MAX_TIMER_SETS : cpus);
+        for (i = 0; i < timers_count; i++)
+            timers[i] = timerset_create();
+        timers_next_set = counter_create();
     }
     initialized++;
 }
 
 void timers_shutdown(void)
 {
+    long i;
+
     if (initialized > 1) {
         initialized--;
         return;
     }
-       
-    /* Stop all timers. */
-    if (timers->heap->len > 0)
-        warning(0, "Timers shutting down with %ld active timers.",
-                timers->heap->len);
-    while (timers->heap->len > 0)
-        gwtimer_stop(timers->heap->tab[0]);
-
-    /* Kill timer thread */
-    timers->stopping = 1;
-    gwthread_wakeup(timers->thread);
-    gwthread_join(timers->thread);
+
+    for (i = 0; i < timers_count; i++) {
+        /* Stop all timers. */
+        if (timers[i]->count > 0)
+            warning(0, "Timers shutting down with %ld active timers.",
+                    timers[i]->count);
+        wheel_stop_all(timers[i]);
+
+        /* Kill timer thread */
+        timers[i]->stopping = 1;
+        gwthread_wakeup(timers[i]->thread);
+        gwthread_join(timers[i]->thread);
+    }
 
     initialized = 0;
 
     /* Free resources */
-    heap_destroy(timers->heap);
-    mutex_destroy(timers->mutex);
-    gw_free(timers);
+    for (i = 0; i < timers_count; i++) {
+        timerset_destroy(timers[i]);
+        timers[i] = NULL;
+    }
+    counter_destroy(timers_next_set);
+}
+
+long timers_ticks_run(void)
+{
+    long i, ticks = 0;
+
+    gw_assert(initialized);
+
+    for (i = 0; i < timers_count; i++) {
+        lock(timers[i]);
+        ticks += timers[i]->ticks_run;
+        unlock(timers[i]);
+    }
+    return ticks;
 }
 
 
@@ -228,10 +286,12 @@ Timer *gwtimer_create(List *outputlist)
     gw_assert(initialized);
 
     t = gw_malloc(sizeof(*t));
+    t->set = timers[counter_increase(timers_next_set) % timers_count];
     t->elapses = -1;
     t->event = NULL;
     t->elapsed_event = NULL;
-    t->index = -1;
+    t->next = NULL;
+    t->pprev = NULL;
     t->output = outputlist;
     gwlist_add_producer(outputlist);
 
@@ -253,68 +313,81 @@ void gwtimer_destroy(Timer *timer)
 
 void gwtimer_start(Timer *timer, int interval, WAPEvent *event)
 {
-    int wakeup = 0;
+    gwtimer_start_msec(timer, interval * 1000L, event);
+}
+
+void gwtimer_start_msec(Timer *timer, long interval, WAPEvent *event)
+{
+    Timerset *set;
+    long now;
+    int wakeup;
 
     gw_assert(initialized);
     gw_assert(timer != NULL);
     gw_assert(event != NULL || timer->event != NULL);
 
-    lock(timers);
+    set = timer->set;
+    lock(set);
+
+    /* The wheel does not turn while it is empty, catch up with the
+     * clock before the first timer goes in */
+    now = timers_now();
+    if (set->count == 0)
+        set->current = now;
 
     /* Convert to absolute time */
-    interval += time(NULL);
+    interval += now;
 
-    if (timer->elapses > 0) {
+    if (timer->elapses >= 0) {
         /* Resetting an existing timer.  Move it to its new
-         * position in the heap. */
-        if (interval < timer->elapses && timer->index == 0)
-            wakeup = 1;
-        timer->elapses = interval;
-        gw_assert(timers->heap->tab[timer->index] == timer);
-        wakeup |= heap_adjust(timers->heap, timer->index);
+         * slot in the wheel. */
+        wheel_unlink(timer);
     } else {
         /* Setting a new timer, or resetting an elapsed one.
          * First deal with a possible elapse event that may
          * still be on the output list. */
         abort_elapsed(timer);
-
-        /* Then activate the timer. */
-        timer->elapses = interval;
-        gw_assert(timer->index < 0);
-        heap_insert(timers->heap, timer);
-        wakeup = timer->index == 0;  /* Do we have a new top? */
+        set->count++;
     }
 
+    /* Then activate the timer. */
+    timer->elapses = interval;
+    wheel_link(wheel_slot(set, interval), timer);
+    wakeup = interval < set->wakeup;  /* Before the thread wakes up? */
+
     if (event != NULL) {
 	wap_event_destroy(timer->event);
 	timer->event = event;
     }
 
-    unlock(timers);
+    unlock(set);
 
     if (wakeup)
-        gwthread_wakeup(timers->thread);
+        gwthread_wakeup(set->thread);
 }
 
 void gwtimer_stop(Timer *timer)
 {
+    Timerset *set;
+
     gw_assert(initialized);
     gw_assert(timer != NULL);
-    lock(timers);
+    set = timer->set;
+    lock(set);
 
     /*
      * If the timer is active, make it inactive and remove it from
-     * the heap.
+     * the wheel.
      */
-    if (timer->elapses > 0) {
+    if (timer->elapses >= 0) {
         timer->elapses = -1;
-        gw_assert(timers->heap->tab[timer->index] == timer);
-        heap_delete(timers->heap, timer->index);
+        wheel_unlink(timer);
+        set->count--;
     }
 
     abort_elapsed(timer);
 
-    unlock(timers);
+    unlock(set);
 }
 
 static void lock(Timerset *set)
@@ -352,160 +425,180 @@ static void abort_elapsed(Timer *timer)
 }
 
 /*
- * Create a new timer heap.
+ * Create a timer set with an empty wheel, and start its thread.
  */
-static TimerHeap *heap_create(void)
+static Timerset *timerset_create(void)
 {
-    TimerHeap *heap;
-
-    heap = gw_malloc(sizeof(*heap));
-    heap->tab = gw_malloc(sizeof(heap->tab[0]));
-    heap->size = 1;
-    heap->len = 0;
+    Timerset *set;
 
-    return heap;
+    set = gw_malloc(sizeof(*set));
+    memset(set->level0, 0, sizeof(set->level0));
+    memset(set->levels, 0, sizeof(set->levels));
+    set->mutex = mutex_create();
+    set->current = timers_now();
+    set->count = 0;
+    set->ticks_run = 0;
+    set->wakeup = LONG_MAX;
+    set->stopping = 0;
+    set->thread = gwthread_create(watch_timers, set);
+
+    return set;
 }
 
-static void heap_destroy(TimerHeap *heap)
+static void timerset_destroy(Timerset *set)
 {
-    if (heap == NULL)
+    if (set == NULL)
         return;
 
-    gw_free(heap->tab);
-    gw_free(heap);
+    gw_assert(set->count == 0);
+    mutex_destroy(set->mutex);
+    gw_free(set);
 }
 
 /*
- * Remove a timer from the heap.  Do this by swapping it with the element
- * in the last position, then shortening the heap, then moving the
- * swapped element up or down to maintain the partial ordering.
+ * The current tick.  The monotonic clock is used so that adjusting
+ * the system time does not make timers elapse early or late.
  */
-static void heap_delete(TimerHeap *heap, long index)
+static long timers_now(void)
 {
-    long last;
-
-    gw_assert(index >= 0);
-    gw_assert(index < heap->len);
-    gw_assert(heap->tab[index]->index == index);
-
-    last = heap->len - 1;
-    heap_swap(heap, index, last);
-    heap->tab[last]->index = -1;
-    heap->len--;
-    if (index != last)
-        heap_adjust(heap, index);
+    return (long) (date_monotonic_usec() / 1000);
 }
 
 /*
- * Add a timer to the heap.  Do this by adding it at the end, then
- * moving it up or down as necessary to achieve partial ordering.
+ * Return the slot of the wheel a timer elapsing at the given tick
+ * belongs to, relative to the current tick of the set.
  */
-static void heap_insert(TimerHeap *heap, Timer *timer)
+static Timer **wheel_slot(Timerset *set, long elapses)
 {
-    heap->len++;
-    if (heap->len > heap->size) {
-        heap->tab = gw_realloc(heap->tab,
-                                heap->len * sizeof(heap->tab[0]));
-        heap->size = heap->len;
+    long offset;
+    int level, shift;
+
+    offset = elapses - set->current;
+    if (offset < 0)
+        return &set->level0[set->current & LEVEL0_MASK];
+    if (offset < LEVEL0_SIZE)
+        return &set->level0[elapses & LEVEL0_MASK];
+
+    for (level = 0; level < WHEEL_LEVELS - 2; level++) {
+        shift = LEVEL0_BITS + level * LEVEL_BITS;
+        if (offset < (1L << (shift + LEVEL_BITS)))
+            return &set->levels[level][(elapses >> shift) & LEVEL_MASK];
     }
-    heap->tab[heap->len - 1] = timer;
-    timer->index = heap->len - 1;
-    heap_adjust(heap, timer->index);
+
+    /* Top level, this is cascaded again if it is too far away */
+    if (offset > WHEEL_MAX_TICKS)
+        elapses = set->current + WHEEL_MAX_TICKS;
+    shift = LEVEL0_BITS + level * LEVEL_BITS;
+    return &set->levels[level][(elapses >> shift) & LEVEL_MASK];
 }
 
-/*
- * Swap two elements of the heap, and update their index fields.
- * This is the basic heap operation.
- */
-static void heap_swap(TimerHeap *heap, long index1, long index2)
+static void wheel_link(Timer **slot, Timer *timer)
 {
-    Timer *t;
-
-    gw_assert(index1 >= 0);
-    gw_assert(index1 < heap->len);
-    gw_assert(index2 >= 0);
-    gw_assert(index2 < heap->len);
+    timer->next = *slot;
+    if (timer->next != NULL)
+        timer->next->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
 
-    if (index1 == index2)
-        return;
+static void wheel_unlink(Timer *timer)
+{
+    gw_assert(timer->pprev != NULL);
 
-    t = heap->tab[index1];
-    heap->tab[index1] = heap->tab[index2];
-    heap->tab[index2] = t;
-    heap->tab[index1]->index = index1;
-    heap->tab[index2]->index = index2;
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+        timer->next->pprev = timer->pprev;
+    timer->next = NULL;
+    timer->pprev = NULL;
 }
 
 /*
- * The current element has broken the partial ordering of the
- * heap (see explanation in the definition of Timerset), and
- * it has to be moved up or down until the ordering is restored.
- * Return 1 if the timer at the heap's top is now earlier than
- * before this operation, otherwise 0.
+ * Move the timers of a slot of a higher level to where they belong
+ * now.  Return 1 if the level has turned around, so that the level
+ * above has to be cascaded too.
  */
-static int heap_adjust(TimerHeap *heap, long index)
+static int wheel_cascade(Timerset *set, int level, long index)
 {
-    Timer *t;
-    Timer *parent;
-    long child_index;
+    Timer *timer, *next;
 
-    /*
-     * We can assume that the heap was fine before this element's
-     * elapse time was changed.  There are three cases to deal
-     * with:
-     *  - Element's new elapse time is too small; it should be
-     *    moved toward the top.
-     *  - Element's new elapse time is too large; it should be
-     *    moved toward the bottom.
-     *  - Element's new elapse time still fits here, we don't
-     *    have to do anything.
-     */
-
-    gw_assert(index >= 0);
-    gw_assert(index < heap->len);
-
-    /* Move to top? */
-    t = heap->tab[index];
-    parent = heap->tab[index / 2];
-    if (t->elapses < parent->elapses) {
-        /* This will automatically terminate when it reaches
-         * the top, because in that t == parent. */
-        do {
-            heap_swap(heap, index, index / 2);
-            index = index / 2;
-            parent = heap->tab[index / 2];
-        } while (t->elapses < parent->elapses);
-        /* We're done.  Return 1 if we changed the top. */
-        return index == 0;
+    next = set->levels[level][index];
+    set->levels[level][index] = NULL;
+    while ((timer = next) != NULL) {
+        next = timer->next;
+        wheel_link(wheel_slot(set, timer->elapses), timer);
     }
 
-    /* Move to bottom? */
-    for (; ; ) {
-        child_index = index * 2;
-        if (child_index >= heap->len)
-            return 0;   /* Already at bottom */
-        if (child_index == heap->len - 1) {
-            /* Only one child */
-            if (heap->tab[child_index]->elapses < t->elapses)
-                heap_swap(heap, index, child_index);
+    return index == 0;
+}
+
+/*
+ * Turn the wheel up to the given tick, and elapse all timers on the
+ * way.  We have the set locked.
+ */
+static void wheel_run(Timerset *set, long now)
+{
+    Timer *timer;
+    long index;
+    int level, shift;
+
+    while (set->current <= now) {
+        /* Nothing to do, catch up with the clock at once */
+        if (set->count == 0) {
+            set->current = now + 1;
             break;
         }
 
-        /* Find out which child elapses first */
-        if (heap->tab[child_index + 1]->elapses <
-            heap->tab[child_index]->elapses) {
-            child_index++;
+        index = set->current & LEVEL0_MASK;
+        if (index == 0) {
+            for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+                shift = LEVEL0_BITS + level * LEVEL_BITS;
+                if (!wheel_cascade(set, level,
+                                   (set->current >> shift) & LEVEL_MASK))
+                    break;
+            }
         }
 
-        if (heap->tab[child_index]->elapses < t->elapses) {
-            heap_swap(heap, index, child_index);
-            index = child_index;
-        } else {
-            break;
+        while ((timer = set->level0[index]) != NULL) {
+            wheel_unlink(timer);
+            set->count--;
+            elapse_timer(timer);
         }
+        set->current++;
+        set->ticks_run++;
+    }
+}
+
+/*
+ * Return the tick at which the timer thread has to run next, or -1 if
+ * the wheel is empty.  This is the next timer on the lowest level, or
+ * the next cascade, whichever comes first.
+ */
+static long wheel_next_elapse(Timerset *set)
+{
+    long tick;
+
+    if (set->count == 0)
+        return -1;
+
+    for (tick = set->current; ; tick++) {
+        if ((tick & LEVEL0_MASK) == 0 ||
+            set->level0[tick & LEVEL0_MASK] != NULL)
+            return tick;
     }
+}
 
-    return 0;
+static void wheel_stop_all(Timerset *set)
+{
+    long i;
+    int level;
+
+    for (i = 0; i < LEVEL0_SIZE; i++)
+        while (set->level0[i] != NULL)
+            gwtimer_stop(set->level0[i]);
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        for (i = 0; i < LEVEL_SIZE; i++)
+            while (set->levels[level][i] != NULL)
+                gwtimer_stop(set->levels[level][i]);
 }
 
 /*
@@ -514,7 +607,6 @@ static int heap_adjust(TimerHeap *heap, long index)
 static void elapse_timer(Timer *timer)
 {
     gw_assert(timer != NULL);
-    gw_assert(timers != NULL);
     /* This must be true because abort_elapsed is always called
      * before a timer is activated. */
     gw_assert(timer->elapsed_event == NULL);
@@ -532,7 +624,7 @@ static void elapse_timer(Timer *timer)
 static void watch_timers(void *arg)
 {
     Timerset *set;
-    long top_time;
+    long next;
     long now;
 
     set = arg;
@@ -540,26 +632,22 @@ static void watch_timers(void *arg)
     while (!set->stopping) {
         lock(set);
 
-	now = time(NULL);
-
-	while (set->heap->len > 0 && set->heap->tab[0]->elapses <= now) {
-	    elapse_timer(set->heap->tab[0]);
-	    heap_delete(set->heap, 0);
-	}
+	now = timers_now();
+	wheel_run(set, now);
 
 	/*
-	 * Now sleep until the next timer elapses.  If there isn't one,
-	 * then just sleep very long.  We will get woken up if the
-	 * top of the heap changes before we wake.
+	 * Now sleep until the next timer elapses, or the wheel has to
+	 * be cascaded.  If there isn't one, then just sleep very long.
+	 * We will get woken up if an earlier timer is started before
+	 * we wake.
 	 */
+	next = wheel_next_elapse(set);
+	set->wakeup = (next < 0) ? LONG_MAX : next;
+	unlock(set);
 
-        if (set->heap->len == 0) {
-            unlock(set);
+        if (next < 0)
             gwthread_sleep(1000000.0);
-        } else {
-	    top_time = set->heap->tab[0]->elapses;
-	    unlock(set);
-	    gwthread_sleep(top_time - now);
-	}
+        else
+            gwthread_sleep((next - now) / 1000.0);
     }
 }
@@ -58,8 +58,8 @@
  * timers.h - interface to timers and timer sets.
  *
  * Timers can be set to elapse after a specified number of seconds
- * (the "interval").  They can be stopped before elapsing, and the
- * interval can be changed.
+ * or milliseconds (the "interval").  They can be stopped before
+ * elapsing, and the interval can be changed.
  *
  * An "output list" is defined for each timer.  When it elapses, an
  * event is generated on this list.  The event may be removed from
@@ -104,6 +104,13 @@ void timers_init(void);
  */
 void timers_shutdown(void);
 
+/*
+ * Return the number of ticks the timer threads have turned their
+ * wheels by, one at a time, since timers_init.  An idle wheel is not
+ * turned.  Used by the checks.
+ */
+long timers_ticks_run(void);
+
 /*
  * Create a timer and tell it to use the specified output list when
  * it elapses.  Do not start it yet.  Return the new timer.
@@ -131,6 +138,11 @@ void gwtimer_destroy(Timer *timer);
  */
 void gwtimer_start(Timer *timer, int interval, WAPEvent *event);
 
+/*
+ * Like gwtimer_start, but the interval is given in milliseconds.
+ */
+void gwtimer_start_msec(Timer *timer, long interval, WAPEvent *event);
+
 /*
  * Stop this timer.  If it has already elapsed, try to remove its
  * event from the output list.
@@ -139,11 +139,14 @@ void wap_shutdown(void);
  *
  * Timer_freq is the timer 'tick' used. All wtp responder timers are 
  * multiplies of this value.
+ *
+ * Threads is the number of threads handling events in parallel. Events
+ * of one initiator are always handled by the same thread, in order.
  */
 void wtp_resp_init(wap_dispatch_func_t *datagram_dispatch,
                    wap_dispatch_func_t *session_dispatch,
                    wap_dispatch_func_t *push_dispatch, 
-                   long timer_freq);
+                   long timer_freq, long threads);
 void wtp_resp_dispatch_event(WAPEvent *event);
 void wtp_resp_shutdown(void);
 
@@ -122,6 +122,28 @@ int wap_addr_tuple_same(WAPAddrTuple *a, WAPAddrTuple *b)
 }
 
 
+/* Hash of the fields compared by wap_addr_tuple_same. */
+unsigned long wap_addr_tuple_hash(WAPAddrTuple *tuple)
+{
+    unsigned long h;
+
+    h = (unsigned long) tuple->remote->iaddr;
+    h = h * 31 + tuple->remote->port;
+    h = h * 31 + (unsigned long) tuple->local->iaddr;
+    h = h * 31 + tuple->local->port;
+    return h ^ (h >> 16);
+}
+
+
+/* Dict key of the fields compared by wap_addr_tuple_same. */
+Octstr *wap_addr_tuple_key(WAPAddrTuple *tuple)
+{
+    return octstr_format("%lu:%ld:%lu:%ld",
+                         (unsigned long) tuple->remote->iaddr, tuple->remote->port,
+                         (unsigned long) tuple->local->iaddr, tuple->local->port);
+}
+
+
 WAPAddrTuple *wap_addr_tuple_duplicate(WAPAddrTuple *tuple) 
 {
     if (tuple == NULL)
@@ -120,14 +120,27 @@ static wap_dispatch_func_t *dispatch_to_ota;
 static int resume_enabled = 1;
 
 static List *queue = NULL;
-static List *session_machines = NULL;
 static Counter *session_id_counter = NULL;
 
+/*
+ * Session machines are indexed by address tuple and by session id. A 
+ * client may have several sessions, the tuple index keeps a list of them
+ * with the newest first. Method and push machines are indexed by session
+ * id and transaction id, in addition to the lists of their session.
+ */
+static Dict *sessions_by_tuple = NULL;
+static Dict *sessions_by_id = NULL;
+static Dict *method_machines = NULL;
+static Dict *push_machines = NULL;
+
+/* hash table size hint of the indexes */
+#define WSP_MACHINES_SIZE 4096
+
 
 static WSPMachine *find_session_machine(WAPEvent *event, WSP_PDU *pdu);
 static void handle_session_event(WSPMachine *machine, WAPEvent *event, 
 				 WSP_PDU *pdu);
-static WSPMachine *machine_create(void);
+static WSPMachine *machine_create(WAPAddrTuple *tuple);
 static void machine_destroy(void *p);
 
 static void handle_method_event(WSPMachine *session, WSPMethodMachine *machine, WAPEvent *event, WSP_PDU *pdu);
@@ -141,7 +154,7 @@ static WSPPushMachine *push_machine_create(WSPMachine *session, long id);
 static void push_machine_destroy(void *p);
 
 static char *state_name(WSPState state);
-static unsigned long next_wsp_session_id(void);
+static void assign_session_id(WSPMachine *sm);
 
 static List *make_capabilities_reply(WSPMachine *m);
 static List *make_reply_headers(WSPMachine *m);
@@ -150,9 +163,8 @@ static Octstr *make_resume_reply_pdu(WSPMachine *m, List *headers);
 static WSP_PDU *make_confirmedpush_pdu(WAPEvent *e);
 static WSP_PDU *make_push_pdu(WAPEvent *e);
 
-static int transaction_belongs_to_session(void *session, void *tuple);
-static int find_by_session_id(void *session, void *idp);
-static int same_client(void *sm1, void *sm2);
+static WSPMachine *find_session_by_tuple(WAPAddrTuple *tuple);
+static WSPMachine *find_session_by_id(long session_id);
 static WSPMethodMachine *find_method_machine(WSPMachine *, long id);
 static WSPPushMachine *find_push_machine(WSPMachine *m, long id);
 
@@ -180,7 +192,6 @@ static void indicate_pushabort(WSPPushMachine *machine, long reason);
 static void confirm_push(WSPPushMachine *machine);
 
 static void main_thread(void *);
-static int id_belongs_to_session (void *, void *);
 static int wsp_encoding_string_to_version(Octstr *enc);
 static Octstr *wsp_encoding_version_to_string(int version);
 
@@ -196,7 +207,10 @@ void wsp_session_init(wap_dispatch_func_t *responder_dispatch,
                       wap_dispatch_func_t *push_ota_dispatch) {
 	queue = gwlist_create();
 	gwlist_add_producer(queue);
-	session_machines = gwlist_create();
+	sessions_by_tuple = dict_create(WSP_MACHINES_SIZE, NULL);
+	sessions_by_id = dict_create(WSP_MACHINES_SIZE, NULL);
+	method_machines = dict_create(WSP_MACHINES_SIZE, NULL);
+	push_machines = dict_create(WSP_MACHINES_SIZE, NULL);
 	session_id_counter = counter_create();
 	dispatch_to_wtp_resp = responder_dispatch;
 	dispatch_to_wtp_init = initiator_dispatch;
@@ -209,6 +223,10 @@ void wsp_session_init(wap_dispatch_func_t *responder_dispatch,
 
 
 void wsp_session_shutdown(void) {
+	List *keys, *sessions;
+	Octstr *key;
+	long left;
+
 	gw_assert(run_status == running);
 	run_status = terminating;
 	gwlist_remove_producer(queue);
@@ -216,9 +234,23 @@ void wsp_session_shutdown(void) {
 
 	gwlist_destroy(queue, wap_event_destroy_item);
 
-	debug("wap.wsp", 0, "WSP: %ld session machines left.",
-		gwlist_len(session_machines));
-	gwlist_destroy(session_machines, machine_destroy);
+	/* machine_destroy drops the list of a tuple with its last machine */
+	left = 0;
+	keys = dict_keys(sessions_by_tuple);
+	while ((key = gwlist_extract_first(keys)) != NULL) {
+		while ((sessions = dict_get(sessions_by_tuple, key)) != NULL) {
+			machine_destroy(gwlist_get(sessions, 0));
+			left++;
+		}
+		octstr_destroy(key);
+	}
+	gwlist_destroy(keys, NULL);
+	debug("wap.wsp", 0, "WSP: %ld session machines left.", left);
+
+	dict_destroy(sessions_by_tuple);
+	dict_destroy(sessions_by_id);
+	dict_destroy(method_machines);
+	dict_destroy(push_machines);
 
 	counter_destroy(session_id_counter);
         wsp_strings_shutdown();
@@ -350,9 +382,8 @@ static WSPMachine *find_session_machine(WAPEvent *event, WSP_PDU *pdu) {
 			/* Create a new session, even if there is already
 			 * a session open for this address.  The new session
 			 * will take care of killing the old ones. */
-			sm = machine_create();
 			gw_assert(tuple != NULL);
-			sm->addr_tuple = wap_addr_tuple_duplicate(tuple);
+			sm = machine_create(tuple);
 			sm->connect_handle = event->u.TR_Invoke_Ind.handle;
 	/* Third test is for class 2 TR-Invoke.ind with Resume PDU */
 	} else if (event->type == TR_Invoke_Ind &&
@@ -361,8 +392,7 @@ static WSPMachine *find_session_machine(WAPEvent *event, WSP_PDU *pdu) {
 		/* Pass to session identified by session id, not
 		 * the address tuple. */
 		session_id = pdu->u.Resume.sessionid;
-		sm = gwlist_search(session_machines, &session_id,
-				find_by_session_id);
+		sm = find_session_by_id(session_id);
 		if (sm == NULL) {
 			/* No session; TR-Abort.req(DISCONNECT) */
 			send_abort(WSP_ABORT_DISCONNECT,
@@ -373,8 +403,7 @@ static WSPMachine *find_session_machine(WAPEvent *event, WSP_PDU *pdu) {
 	 * TR-Invoke.ind here by ignoring them; this seems to be
 	 * an omission in the spec table. */
 	} else if (event->type == TR_Invoke_Ind) {
-		sm = gwlist_search(session_machines, tuple,
-				 transaction_belongs_to_session);
+		sm = find_session_by_tuple(tuple);
 		if (sm == NULL && (event->u.TR_Invoke_Ind.tcl == 1 ||
 				event->u.TR_Invoke_Ind.tcl == 2)) {
 			send_abort(WSP_ABORT_DISCONNECT,
@@ -384,11 +413,9 @@ static WSPMachine *find_session_machine(WAPEvent *event, WSP_PDU *pdu) {
 	 * do those later, after we've tried to handle them. */
 	} else {
 		if (session_id != -1) {
-			sm = gwlist_search(session_machines, &session_id,
-				find_by_session_id);
+			sm = find_session_by_id(session_id);
 		} else {
-			sm = gwlist_search(session_machines, tuple,
-				transaction_belongs_to_session);
+			sm = find_session_by_tuple(tuple);
 		}
 		/* The table doesn't really say what we should do with
 		 * non-Invoke events for which there is no session.  But
@@ -480,8 +507,10 @@ static void cant_handle_event(WSPMachine *sm, WAPEvent *event) {
 }
 
 
-static WSPMachine *machine_create(void) {
+static WSPMachine *machine_create(WAPAddrTuple *tuple) {
 	WSPMachine *p;
+	List *sessions;
+	Octstr *key;
 	
 	p = gw_malloc(sizeof(WSPMachine));
 	debug("wap.wsp", 0, "WSP: Created WSPMachine %p", (void *) p);
@@ -503,17 +532,28 @@ static WSPMachine *machine_create(void) {
 
 	p->client_SDU_size = 1400;
 	p->MOR_push = 1;
+	p->addr_tuple = wap_addr_tuple_duplicate(tuple);
 	
-	/* Insert new machine at the _front_, because 1) it's more likely
-	 * to get events than old machines are, so this speeds up the linear
-	 * search, and 2) we want the newest machine to get any method
-	 * invokes that come through before the Connect is established. */
-	gwlist_insert(session_machines, 0, p);
+	/* Insert new machine at the _front_ of the sessions of its client,
+	 * because we want the newest machine to get any method invokes that
+	 * come through before the Connect is established. */
+	key = wap_addr_tuple_key(tuple);
+	if ((sessions = dict_get(sessions_by_tuple, key)) == NULL) {
+		sessions = gwlist_create();
+		dict_put(sessions_by_tuple, key, sessions);
+	}
+	gwlist_insert(sessions, 0, p);
+	octstr_destroy(key);
 
 	return p;
 }
 
 
+static Octstr *transaction_key(long session_id, long transaction_id) {
+	return octstr_format("%ld/%ld", session_id, transaction_id);
+}
+
+
 static void destroy_methodmachines(List *machines) {
 	if (gwlist_len(machines) > 0) {
 		warning(0, "Destroying WSP session with %ld active methods\n",
@@ -534,10 +574,25 @@ static void destroy_pushmachines(List *machines) {
 
 static void machine_destroy(void *pp) {
 	WSPMachine *p;
+	List *sessions;
+	Octstr *key;
 	
 	p = pp;
 	debug("wap.wsp", 0, "Destroying WSPMachine %p", pp);
-	gwlist_delete_equal(session_machines, p);
+
+	key = wap_addr_tuple_key(p->addr_tuple);
+	sessions = dict_get(sessions_by_tuple, key);
+	gwlist_delete_equal(sessions, p);
+	if (gwlist_len(sessions) == 0) {
+		dict_remove(sessions_by_tuple, key);
+		gwlist_destroy(sessions, NULL);
+	}
+	octstr_destroy(key);
+	/* the id is not assigned before the Connect is handled */
+	key = octstr_format("%ld", p->session_id);
+	if (dict_get(sessions_by_id, key) == p)
+		dict_remove(sessions_by_id, key);
+	octstr_destroy(key);
 
 	#define INTEGER(name) p->name = 0;
 	#define OCTSTR(name) octstr_destroy(p->name);
@@ -606,6 +661,7 @@ end:
 static WSPMethodMachine *method_machine_create(WSPMachine *sm,
 			long wtp_handle) {
 	WSPMethodMachine *msm;
+	Octstr *key;
 	
 	msm = gw_malloc(sizeof(*msm));
 	
@@ -621,6 +677,9 @@ static WSPMethodMachine *method_machine_create(WSPMachine *sm,
 	msm->session_id = sm->session_id;
 
 	gwlist_append(sm->methodmachines, msm);
+	key = transaction_key(msm->session_id, msm->transaction_id);
+	dict_put(method_machines, key, msm);
+	octstr_destroy(key);
 
 	return msm;
 }
@@ -629,6 +688,7 @@ static WSPMethodMachine *method_machine_create(WSPMachine *sm,
 
 static void method_machine_destroy(void *p) {
 	WSPMethodMachine *msm;
+	Octstr *key;
 
 	if (p == NULL)
 		return;
@@ -638,6 +698,11 @@ static void method_machine_destroy(void *p) {
 	debug("wap.wsp", 0, "Destroying WSPMethodMachine %ld",
 			msm->transaction_id);
 
+	key = transaction_key(msm->session_id, msm->transaction_id);
+	if (dict_get(method_machines, key) == msm)
+		dict_remove(method_machines, key);
+	octstr_destroy(key);
+
 	#define INTEGER(name)
 	#define ADDRTUPLE(name) wap_addr_tuple_destroy(msm->name);
 	#define EVENT(name) wap_event_destroy(msm->name);
@@ -688,6 +753,7 @@ static WSPPushMachine *push_machine_create(WSPMachine *sm,
         long pid)
 {
         WSPPushMachine *m;
+        Octstr *key;
 
         m = gw_malloc(sizeof(WSPPushMachine));
 
@@ -704,6 +770,9 @@ static WSPPushMachine *push_machine_create(WSPMachine *sm,
 	m->session_id = sm->session_id;
 
 	gwlist_append(sm->pushmachines, m);
+	key = transaction_key(m->session_id, m->transaction_id);
+	dict_put(push_machines, key, m);
+	octstr_destroy(key);
 
 	return m;      
 }
@@ -711,12 +780,18 @@ static WSPPushMachine *push_machine_create(WSPMachine *sm,
 static void push_machine_destroy(void *p)
 {
         WSPPushMachine *m = NULL;   
+        Octstr *key;
 
 	if (p == NULL)
 	       return;  
         m = p;
         debug("wap.wsp", 0, "Destroying WSPPushMachine %ld",
 			m->transaction_id);
+
+        key = transaction_key(m->session_id, m->transaction_id);
+        if (dict_get(push_machines, key) == m)
+                dict_remove(push_machines, key);
+        octstr_destroy(key);
         #define INTEGER(name) 
         #define ADDRTUPLE(name) wap_addr_tuple_destroy(m->name);
         #define HTTPHEADER(name) http_destroy_headers(m->name);
@@ -746,8 +821,13 @@ static char *state_name(WSPState state) {
 }
 
 
-static unsigned long next_wsp_session_id(void) {
-	return counter_increase(session_id_counter);
+static void assign_session_id(WSPMachine *sm) {
+	Octstr *key;
+
+	sm->session_id = counter_increase(session_id_counter);
+	key = octstr_format("%ld", sm->session_id);
+	dict_put(sessions_by_id, key, sm);
+	octstr_destroy(key);
 }
 
 
@@ -1134,67 +1214,72 @@ static WSP_PDU *make_push_pdu(WAPEvent *e)
         return pdu;
 }
 
-static int transaction_belongs_to_session(void *wsp_ptr, void *tuple_ptr) {
-	WSPMachine *wsp;
-	WAPAddrTuple *tuple;
-	
-	wsp = wsp_ptr;
-	tuple = tuple_ptr;
-
-	return wap_addr_tuple_same(wsp->addr_tuple, tuple);
-}
+static WSPMachine *find_session_by_tuple(WAPAddrTuple *tuple) {
+	List *sessions;
+	Octstr *key;
 
+	key = wap_addr_tuple_key(tuple);
+	sessions = dict_get(sessions_by_tuple, key);
+	octstr_destroy(key);
 
-static int find_by_session_id(void *wsp_ptr, void *id_ptr) {
-	WSPMachine *wsp = wsp_ptr;
-	long *idp = id_ptr;
-	
-	return wsp->session_id == *idp;
+	return (gwlist_len(sessions) > 0 ? gwlist_get(sessions, 0) : NULL);
 }
 
 
-static int find_by_method_id(void *wspm_ptr, void *id_ptr) {
-	WSPMethodMachine *msm = wspm_ptr;
-	long *idp = id_ptr;
-
-	return msm->transaction_id == *idp;
-}
+static WSPMachine *find_session_by_id(long session_id) {
+	WSPMachine *sm;
+	Octstr *key;
 
-static int find_by_push_id(void *m_ptr, void *id_ptr) {
-	WSPPushMachine *m = m_ptr;
-	long *idp = id_ptr;
+	key = octstr_format("%ld", session_id);
+	sm = dict_get(sessions_by_id, key);
+	octstr_destroy(key);
 
-	return m->transaction_id == *idp;
+	return sm;
 }
 
+
 static WSPMethodMachine *find_method_machine(WSPMachine *sm, long id) {
-	return gwlist_search(sm->methodmachines, &id, find_by_method_id);
+	WSPMethodMachine *msm;
+	Octstr *key;
+
+	key = transaction_key(sm->session_id, id);
+	msm = dict_get(method_machines, key);
+	octstr_destroy(key);
+
+	return msm;
 }
 
 static WSPPushMachine *find_push_machine(WSPMachine *m, long id)
 {
-       return gwlist_search(m->pushmachines, &id, find_by_push_id);
-}
+       WSPPushMachine *pm;
+       Octstr *key;
 
-static int same_client(void *a, void *b) {
-	WSPMachine *sm1, *sm2;
-	
-	sm1 = a;
-	sm2 = b;
-	return wap_addr_tuple_same(sm1->addr_tuple, sm2->addr_tuple);
+       key = transaction_key(m->session_id, id);
+       pm = dict_get(push_machines, key);
+       octstr_destroy(key);
+
+       return pm;
 }
 
 
 static void disconnect_other_sessions(WSPMachine *sm) {
-	List *old_sessions;
+	List *sessions, *old_sessions;
 	WAPEvent *disconnect;
 	WSPMachine *sm2;
+	Octstr *key;
 	long i;
 
-	old_sessions = gwlist_search_all(session_machines, sm, same_client);
-	if (old_sessions == NULL)
+	key = wap_addr_tuple_key(sm->addr_tuple);
+	sessions = dict_get(sessions_by_tuple, key);
+	octstr_destroy(key);
+	if (sessions == NULL)
 		return;
 
+	/* copy, disconnecting removes the machines from the index */
+	old_sessions = gwlist_create();
+	for (i = 0; i < gwlist_len(sessions); i++)
+		gwlist_append(old_sessions, gwlist_get(sessions, i));
+
 	for (i = 0; i < gwlist_len(old_sessions); i++) {
 		sm2 = gwlist_get(old_sessions, i);
 		if (sm2 != sm) {
@@ -1433,19 +1518,7 @@ static void abort_pushes(WSPMachine *sm, long reason)
 
 WSPMachine *find_session_machine_by_id (int id) {
 
-	return gwlist_search(session_machines, &id, id_belongs_to_session);
-}
-
-
-static int id_belongs_to_session (void *wsp_ptr, void *pid) {
-	WSPMachine *wsp;
-	int *id;
-
-	wsp = wsp_ptr;
-	id = (int *) pid;
-
-	if (*id == wsp->session_id) return 1;
-	return 0;
+	return find_session_by_id(id);
 }
 
 
@@ -72,9 +72,30 @@
 /***********************************************************************
  * Internal data structures.
  *
- * List of responder WTP machines.
+ * Responder WTP machines are partitioned into shards, each with its own
+ * event queue and thread. Events are routed to a shard by a hash of the
+ * address four-tuple, so all events of an initiator are handled in order
+ * by the same thread. Machine ids encode the shard as mid % shard count,
+ * so events carrying only the machine id find their way too. Within a
+ * shard machines are indexed by address tuple and tid and by machine id,
+ * in hash tables chained through the machines themselves, so looking up
+ * the machine of an event allocates nothing. The tables double when
+ * there are more machines than buckets. Only the thread of the shard
+ * uses its tables.
  */
-static List *resp_machines = NULL;
+struct resp_shard {
+    List *queue;
+    WTPRespMachine **machines_by_tid;
+    WTPRespMachine **machines_by_mid;
+    long size;
+    long machines;
+};
+
+static struct resp_shard *resp_shards = NULL;
+static long resp_shard_count = 0;
+
+/* initial hash table size per shard, a power of two */
+#define RESP_MACHINES_SIZE 4096
 
 
 /*
@@ -100,11 +121,6 @@ wap_dispatch_func_t *dispatch_to_wdp;
 wap_dispatch_func_t *dispatch_to_wsp;
 wap_dispatch_func_t *dispatch_to_push;
 
-/*
- * Queue of events to be handled by WTP responder.
- */
-static List *resp_queue = NULL;
-
 /*
  * Timer 'tick'. All wtp responder timer values are multiplies of this one
  */
@@ -117,10 +133,24 @@ static long resp_timer_freq = -1;
  * Create and destroy an uniniatilized wtp responder state machine.
  */
 
-static WTPRespMachine *resp_machine_create(WAPAddrTuple *tuple, long tid, 
+static WTPRespMachine *resp_machine_create(struct resp_shard *shard,
+                                           WAPAddrTuple *tuple, long tid, 
                                            long tcl);
 static void resp_machine_destroy(void *sm);
 
+/*
+ * Create an empty machine index of a shard with size buckets.
+ */
+static WTPRespMachine **machine_table_create(long size);
+
+/*
+ * Fetch the identification of the machine an event belongs to: either 
+ * address four-tuple and tid, or machine id. Return -1 for events not 
+ * handled by the responder.
+ */
+static int event_machine_key(WAPEvent *event, WAPAddrTuple **tuple, long *tid,
+                             long *mid);
+
 /*
  * Checks whether wtp responser machines data structure includes a specific 
  * machine.
@@ -133,7 +163,8 @@ static void resp_machine_destroy(void *sm);
  * validated and If the event was RcvAck or RcvAbort, the event is ignored. 
  * If the event is RcvErrorPDU, new machine is created.
  */
-static WTPRespMachine *resp_machine_find_or_create(WAPEvent *event);
+static WTPRespMachine *resp_machine_find_or_create(struct resp_shard *shard,
+                                                   WAPEvent *event);
 
 
 /*
@@ -154,7 +185,8 @@ static char *name_resp_state(int name);
  * addresses and ports and the transaction identifier. Return a pointer to 
  * the machine, or NULL if not found.
  */
-static WTPRespMachine *resp_machine_find(WAPAddrTuple *tuple, long tid, 
+static WTPRespMachine *resp_machine_find(struct resp_shard *shard,
+                                         WAPAddrTuple *tuple, long tid, 
                                          long mid);
 static void main_thread(void *);
 
@@ -211,13 +243,22 @@ static void send_ack(WTPRespMachine *machine, long ack_type, int rid_flag);
 void wtp_resp_init(wap_dispatch_func_t *datagram_dispatch,
                    wap_dispatch_func_t *session_dispatch,
                    wap_dispatch_func_t *push_dispatch, 
-                   long timer_freq) 
+                   long timer_freq, long threads) 
 {
-    resp_machines = gwlist_create();
+    long i;
+
     resp_machine_id_counter = counter_create();
 
-    resp_queue = gwlist_create();
-    gwlist_add_producer(resp_queue);
+    resp_shard_count = (threads > 0 ? threads : 1);
+    resp_shards = gw_malloc(resp_shard_count * sizeof(*resp_shards));
+    for (i = 0; i < resp_shard_count; i++) {
+        resp_shards[i].queue = gwlist_create();
+        gwlist_add_producer(resp_shards[i].queue);
+        resp_shards[i].size = RESP_MACHINES_SIZE;
+        resp_shards[i].machines_by_tid = machine_table_create(RESP_MACHINES_SIZE);
+        resp_shards[i].machines_by_mid = machine_table_create(RESP_MACHINES_SIZE);
+        resp_shards[i].machines = 0;
+    }
 
     dispatch_to_wdp = datagram_dispatch;
     dispatch_to_wsp = session_dispatch;
@@ -229,20 +270,35 @@ void wtp_resp_init(wap_dispatch_func_t *datagram_dispatch,
 
     gw_assert(resp_run_status == limbo);
     resp_run_status = running;
-    gwthread_create(main_thread, NULL);
+    for (i = 0; i < resp_shard_count; i++)
+        gwthread_create(main_thread, &resp_shards[i]);
 }
 
 void wtp_resp_shutdown(void) 
 {
+    struct resp_shard *shard;
+    long i, j;
+
     gw_assert(resp_run_status == running);
     resp_run_status = terminating;
-    gwlist_remove_producer(resp_queue);
+    for (i = 0; i < resp_shard_count; i++)
+        gwlist_remove_producer(resp_shards[i].queue);
     gwthread_join_every(main_thread);
 
-    debug("wap.wtp", 0, "wtp_resp_shutdown: %ld resp_machines left",
-     	  gwlist_len(resp_machines));
-    gwlist_destroy(resp_machines, resp_machine_destroy);
-    gwlist_destroy(resp_queue, wap_event_destroy_item);
+    for (i = 0; i < resp_shard_count; i++) {
+        shard = &resp_shards[i];
+        debug("wap.wtp", 0, "wtp_resp_shutdown: %ld resp_machines left",
+              shard->machines);
+        for (j = 0; j < shard->size; j++)
+            while (shard->machines_by_mid[j] != NULL)
+                resp_machine_destroy(shard->machines_by_mid[j]);
+        gw_free(shard->machines_by_tid);
+        gw_free(shard->machines_by_mid);
+        gwlist_destroy(shard->queue, wap_event_destroy_item);
+    }
+    gw_free(resp_shards);
+    resp_shards = NULL;
+    resp_shard_count = 0;
 
     counter_destroy(resp_machine_id_counter);
 
@@ -252,7 +308,19 @@ void wtp_resp_shutdown(void)
 
 void wtp_resp_dispatch_event(WAPEvent *event) 
 {
-    gwlist_produce(resp_queue, event);
+    WAPAddrTuple *tuple;
+    long tid, mid, i;
+
+    /* unknown events are reported by the first shard */
+    i = 0;
+    if (resp_shard_count > 1 && 
+        event_machine_key(event, &tuple, &tid, &mid) == 0) {
+        if (tuple != NULL)
+            i = wap_addr_tuple_hash(tuple) % resp_shard_count;
+        else
+            i = mid % resp_shard_count;
+    }
+    gwlist_produce(resp_shards[i].queue, event);
 }
 
 
@@ -264,13 +332,14 @@ void wtp_resp_dispatch_event(WAPEvent *event)
 
 static void main_thread(void *arg) 
 {
+    struct resp_shard *shard = arg;
     WTPRespMachine *sm;
     WAPEvent *e;
 
     while (resp_run_status == running && 
-           (e = gwlist_consume(resp_queue)) != NULL) {
+           (e = gwlist_consume(shard->queue)) != NULL) {
 
-        sm = resp_machine_find_or_create(e);
+        sm = resp_machine_find_or_create(shard, e);
         if (sm == NULL) {
             wap_event_destroy(e);
         } else {
@@ -383,97 +452,112 @@ static void handle_erroneous_field_in(WAPEvent *event)
 }
 
 /*
- * Checks whether wtp machines data structure includes a specific machine.
- * The machine in question is identified with with source and destination
- * address and port and tid.  First test incoming events (WTP 10.2)
- * (Exception is tests nro 4 and 5: if we have a memory error, we panic. Nro 5 
- * is already checked)  If event was validated and if the machine does not 
- * exist and the event is RcvInvoke, a new machine is created and added in 
- * the machines data structure. If the event was RcvAck or RcvAbort, the 
- * event is ignored (test nro 3). If the event is RcvErrorPDU (test nro 4) 
- * new machine is created for handling this event. If the event is one of WSP 
- * primitives, we have an error.
+ * Fetch the identification of the machine an event belongs to, see the
+ * prototype.
  */
-static WTPRespMachine *resp_machine_find_or_create(WAPEvent *event)
+static int event_machine_key(WAPEvent *event, WAPAddrTuple **tuple, long *tid,
+                             long *mid)
 {
-    WTPRespMachine *resp_machine = NULL;
-    long tid, mid;
-    WAPAddrTuple *tuple;
-
-    tid = -1;
-    tuple = NULL;
-    mid = -1;
+    *tid = -1;
+    *tuple = NULL;
+    *mid = -1;
 
     switch (event->type) {
         case RcvInvoke:
-            /* check if erroneous fields are given */
-            if (erroneous_field_in(event)) {
-                handle_erroneous_field_in(event);
-                return NULL;
-            } else {
-                tid = event->u.RcvInvoke.tid;
-                tuple = event->u.RcvInvoke.addr_tuple;
-            }
+            *tid = event->u.RcvInvoke.tid;
+            *tuple = event->u.RcvInvoke.addr_tuple;
             break;
 
         case RcvSegInvoke:
-            tid = event->u.RcvSegInvoke.tid;
-            tuple = event->u.RcvSegInvoke.addr_tuple;
+            *tid = event->u.RcvSegInvoke.tid;
+            *tuple = event->u.RcvSegInvoke.addr_tuple;
             break;
 
         case RcvAck:
-            tid = event->u.RcvAck.tid;
-            tuple = event->u.RcvAck.addr_tuple;
+            *tid = event->u.RcvAck.tid;
+            *tuple = event->u.RcvAck.addr_tuple;
             break;
 
         case RcvNegativeAck:
-            tid = event->u.RcvAck.tid;
-            tuple = event->u.RcvAck.addr_tuple;
+            *tid = event->u.RcvAck.tid;
+            *tuple = event->u.RcvAck.addr_tuple;
             break;
 
         case RcvAbort:
-            tid = event->u.RcvAbort.tid;
-            tuple = event->u.RcvAbort.addr_tuple;
+            *tid = event->u.RcvAbort.tid;
+            *tuple = event->u.RcvAbort.addr_tuple;
             break;
 
         case RcvErrorPDU:
-            tid = event->u.RcvErrorPDU.tid;
-            tuple = event->u.RcvErrorPDU.addr_tuple;
+            *tid = event->u.RcvErrorPDU.tid;
+            *tuple = event->u.RcvErrorPDU.addr_tuple;
             break;
 
         case TR_Invoke_Res:
-            mid = event->u.TR_Invoke_Res.handle;
+            *mid = event->u.TR_Invoke_Res.handle;
             break;
 
         case TR_Result_Req:
-            mid = event->u.TR_Result_Req.handle;
+            *mid = event->u.TR_Result_Req.handle;
             break;
 
         case TR_Abort_Req:
-            mid = event->u.TR_Abort_Req.handle;
+            *mid = event->u.TR_Abort_Req.handle;
             break;
 
         case TimerTO_A:
-            mid = event->u.TimerTO_A.handle;
+            *mid = event->u.TimerTO_A.handle;
             break;
 
         case TimerTO_R:
-            mid = event->u.TimerTO_R.handle;
+            *mid = event->u.TimerTO_R.handle;
             break;
 
         case TimerTO_W:
-            mid = event->u.TimerTO_W.handle;
+            *mid = event->u.TimerTO_W.handle;
             break;
 
         default:
-            debug("wap.wtp", 0, "WTP: resp_machine_find_or_create:"
-                  "unhandled event"); 
-            wap_event_dump(event);
-            return NULL;
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Checks whether wtp machines data structure includes a specific machine.
+ * The machine in question is identified with with source and destination
+ * address and port and tid.  First test incoming events (WTP 10.2)
+ * (Exception is tests nro 4 and 5: if we have a memory error, we panic. Nro 5 
+ * is already checked)  If event was validated and if the machine does not 
+ * exist and the event is RcvInvoke, a new machine is created and added in 
+ * the machines data structure. If the event was RcvAck or RcvAbort, the 
+ * event is ignored (test nro 3). If the event is RcvErrorPDU (test nro 4) 
+ * new machine is created for handling this event. If the event is one of WSP 
+ * primitives, we have an error.
+ */
+static WTPRespMachine *resp_machine_find_or_create(struct resp_shard *shard,
+                                                   WAPEvent *event)
+{
+    WTPRespMachine *resp_machine = NULL;
+    long tid, mid;
+    WAPAddrTuple *tuple;
+
+    /* check if erroneous fields are given */
+    if (erroneous_field_in(event)) {
+        handle_erroneous_field_in(event);
+        return NULL;
+    }
+
+    if (event_machine_key(event, &tuple, &tid, &mid) == -1) {
+        debug("wap.wtp", 0, "WTP: resp_machine_find_or_create:"
+              "unhandled event"); 
+        wap_event_dump(event);
+        return NULL;
     }
 
     gw_assert(tuple != NULL || mid != -1);
-    resp_machine = resp_machine_find(tuple, tid, mid);
+    resp_machine = resp_machine_find(shard, tuple, tid, mid);
            
     if (resp_machine == NULL){
 
@@ -488,12 +572,12 @@ static WTPRespMachine *resp_machine_find_or_create(WAPEvent *event)
         case RcvErrorPDU:
             debug("wap.wtp_resp", 0, "an erronous pdu received");
             wap_event_dump(event);
-            resp_machine = resp_machine_create(tuple, tid, 
+            resp_machine = resp_machine_create(shard, tuple, tid, 
                                                event->u.RcvInvoke.tcl); 
             break;
            
         case RcvInvoke:
-            resp_machine = resp_machine_create(tuple, tid, 
+            resp_machine = resp_machine_create(shard, tuple, tid, 
                                                event->u.RcvInvoke.tcl);
             /* if SAR requested */
             if (!event->u.RcvInvoke.gtr || !event->u.RcvInvoke.ttr) {
@@ -552,63 +636,136 @@ static WTPRespMachine *resp_machine_find_or_create(WAPEvent *event)
    return resp_machine;
 }
 
-static int is_wanted_resp_machine(void *a, void *b) 
+static WTPRespMachine **machine_table_create(long size)
 {
-    machine_pattern *pat;
-    WTPRespMachine *m;
-	
-    m = a;
-    pat = b;
+    WTPRespMachine **table;
+
+    table = gw_malloc(size * sizeof(WTPRespMachine *));
+    memset(table, 0, size * sizeof(WTPRespMachine *));
+
+    return table;
+}
+
+
+/*
+ * Buckets of the machine indexes of a shard. Machine ids tell the shard
+ * in their remainder, the quotient spreads them over the buckets.
+ */
+static WTPRespMachine **tid_bucket(struct resp_shard *shard,
+                                   WAPAddrTuple *tuple, long tid)
+{
+    unsigned long h;
+
+    h = wap_addr_tuple_hash(tuple) * 31 + (unsigned long) tid;
+    return &shard->machines_by_tid[(h ^ (h >> 12)) & (shard->size - 1)];
+}
 
-    if (m->mid == pat->mid)
-	return 1;
 
-    if (pat->mid != -1)
-	return 0;
+static WTPRespMachine **mid_bucket(struct resp_shard *shard, unsigned long mid)
+{
+    return &shard->machines_by_mid[(mid / resp_shard_count) & 
+                                   (shard->size - 1)];
+}
+
+
+/*
+ * Double the machine indexes of a shard. Machines keep their order in
+ * the tid chains, so the one created last is still found first.
+ */
+static void resp_shard_grow(struct resp_shard *shard)
+{
+    WTPRespMachine **by_tid, **by_mid, **bucket, *m;
+    long i, size;
+
+    size = shard->size;
+    by_tid = shard->machines_by_tid;
+    by_mid = shard->machines_by_mid;
+    shard->size = 2 * size;
+    shard->machines_by_tid = machine_table_create(shard->size);
+    shard->machines_by_mid = machine_table_create(shard->size);
+
+    for (i = 0; i < size; i++) {
+        while ((m = by_tid[i]) != NULL) {
+            by_tid[i] = m->next_by_tid;
+            for (bucket = tid_bucket(shard, m->addr_tuple, m->tid); 
+                 *bucket != NULL; bucket = &(*bucket)->next_by_tid)
+                ;
+            m->next_by_tid = NULL;
+            *bucket = m;
+        }
+        while ((m = by_mid[i]) != NULL) {
+            by_mid[i] = m->next_by_mid;
+            bucket = mid_bucket(shard, m->mid);
+            m->next_by_mid = *bucket;
+            *bucket = m;
+        }
+    }
+    gw_free(by_tid);
+    gw_free(by_mid);
 
-    return m->tid == pat->tid && 
-           wap_addr_tuple_same(m->addr_tuple, pat->tuple);
+    debug("wap.wtp", 0, "WTP: Resp machine tables of a shard grown to %ld",
+          shard->size);
 }
 
 
-static WTPRespMachine *resp_machine_find(WAPAddrTuple *tuple, long tid, 
+/*
+ * Find the machine of an address tuple and tid, or of a machine id if it
+ * is not -1. Of machines with the same tuple and tid the one created last
+ * is found.
+ */
+static WTPRespMachine *resp_machine_find(struct resp_shard *shard,
+                                         WAPAddrTuple *tuple, long tid, 
                                          long mid) 
 {
-    machine_pattern pat;
     WTPRespMachine *m;
-	
-    pat.tuple = tuple;
-    pat.tid = tid;
-    pat.mid = mid;
-	
-    m = gwlist_search(resp_machines, &pat, is_wanted_resp_machine);
-    return m;
+
+    if (mid != -1) {
+        for (m = *mid_bucket(shard, mid); m != NULL; m = m->next_by_mid)
+            if (m->mid == (unsigned long) mid)
+                return m;
+        return NULL;
+    }
+
+    for (m = *tid_bucket(shard, tuple, tid); m != NULL; m = m->next_by_tid)
+        if (m->tid == tid && wap_addr_tuple_same(m->addr_tuple, tuple))
+            return m;
+    return NULL;
 }
 
 
-static WTPRespMachine *resp_machine_create(WAPAddrTuple *tuple, long tid, 
+static WTPRespMachine *resp_machine_create(struct resp_shard *shard,
+                                           WAPAddrTuple *tuple, long tid, 
                                            long tcl) 
 {
-    WTPRespMachine *resp_machine;
+    WTPRespMachine *resp_machine, **bucket;
 	
     resp_machine = gw_malloc(sizeof(WTPRespMachine)); 
         
     #define ENUM(name) resp_machine->name = LISTEN;
     #define EVENT(name) resp_machine->name = NULL;
     #define INTEGER(name) resp_machine->name = 0; 
-    #define TIMER(name) resp_machine->name = gwtimer_create(resp_queue); 
+    #define TIMER(name) resp_machine->name = gwtimer_create(shard->queue); 
     #define ADDRTUPLE(name) resp_machine->name = NULL; 
     #define LIST(name) resp_machine->name = NULL;
     #define SARDATA(name) resp_machine->name = NULL;
     #define MACHINE(field) field
     #include "wtp_resp_machine.def"
 
-    gwlist_append(resp_machines, resp_machine);
-
-    resp_machine->mid = counter_increase(resp_machine_id_counter);
+    /* the machine id tells the shard */
+    resp_machine->mid = counter_increase(resp_machine_id_counter) * 
+                        resp_shard_count + (shard - resp_shards);
     resp_machine->addr_tuple = wap_addr_tuple_duplicate(tuple);
     resp_machine->tid = tid;
     resp_machine->tcl = tcl;
+
+    bucket = tid_bucket(shard, tuple, tid);
+    resp_machine->next_by_tid = *bucket;
+    *bucket = resp_machine;
+    bucket = mid_bucket(shard, resp_machine->mid);
+    resp_machine->next_by_mid = *bucket;
+    *bucket = resp_machine;
+    if (++shard->machines > shard->size)
+        resp_shard_grow(shard);
 	
     debug("wap.wtp", 0, "WTP: Created WTPRespMachine %p (%ld)", 
 	  (void *) resp_machine, resp_machine->mid);
@@ -618,18 +775,28 @@ static WTPRespMachine *resp_machine_create(WAPAddrTuple *tuple, long tid,
 
 
 /*
- * Destroys a WTPRespMachine. Assumes it is safe to do so. Assumes it has 
- * already been deleted from the machines list.
+ * Destroys a WTPRespMachine. Assumes it is safe to do so. Removes it from
+ * the indexes of its shard.
  */
 static void resp_machine_destroy(void * p)
 {
-    WTPRespMachine *resp_machine;
+    WTPRespMachine *resp_machine, **m;
+    struct resp_shard *shard;
 
     resp_machine = p;
     debug("wap.wtp", 0, "WTP: Destroying WTPRespMachine %p (%ld)", 
 	  (void *) resp_machine, resp_machine->mid);
 	
-    gwlist_delete_equal(resp_machines, resp_machine);
+    shard = &resp_shards[resp_machine->mid % resp_shard_count];
+    for (m = tid_bucket(shard, resp_machine->addr_tuple, resp_machine->tid);
+         *m != resp_machine; m = &(*m)->next_by_tid)
+        ;
+    *m = resp_machine->next_by_tid;
+    for (m = mid_bucket(shard, resp_machine->mid); *m != resp_machine; 
+         m = &(*m)->next_by_mid)
+        ;
+    *m = resp_machine->next_by_mid;
+    shard->machines--;
         
     #define ENUM(name) resp_machine->name = LISTEN;
     #define EVENT(name) wap_event_destroy(resp_machine->name);
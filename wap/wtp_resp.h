@@ -114,6 +114,9 @@ typedef enum resp_states resp_states;
  */ 
 struct WTPRespMachine {
        unsigned long mid; 
+       /* chains of the machine indexes of the shard, see wtp_resp.c */
+       WTPRespMachine *next_by_tid;
+       WTPRespMachine *next_by_mid;
        #define INTEGER(name) int name; 
        #define TIMER(name) Timer *name; 
        #define ADDRTUPLE(name) WAPAddrTuple *name;